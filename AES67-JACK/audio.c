@@ -6,9 +6,6 @@ static jack_ringbuffer_t	 *buf;			// rtp/jack ipc audio buffer
 static size_t			  buf_frames;		// frames in buffer
 static size_t			  buf_stride;		// channels * sizeof(float)
 
-static pthread_cond_t 		  buf_cond = PTHREAD_COND_INITIALIZER;
-static pthread_mutex_t		  buf_lock = PTHREAD_MUTEX_INITIALIZER;
-
 static SRC_STATE		 *src	    = NULL;	// sample rate converter
 static double			  src_ratio = 1.0;	// output / input ratio
 static int			  src_mult  = 1;	// integer ratio for buffer scaling
@@ -94,10 +91,7 @@ size_t mai_audio_write(const void *data, size_t frames) {
 	if ((frames *= buf_stride) < bytes)
 		bytes = frames;
 	
-	bytes = jack_ringbuffer_write(buf, data, bytes);
-	
-	pthread_cond_signal(&buf_cond);
-	return(bytes);
+	return(jack_ringbuffer_write(buf, data, bytes));
 }
 
 size_t mai_audio_write_int(const char *data, size_t bytes) {
@@ -132,15 +126,27 @@ size_t mai_audio_read(void *data, size_t frames) {
 size_t mai_audio_read_int(char *data, size_t bytes) {
 	size_t samples = bytes / cvt_unit;
 	size_t buflen  = samples * sizeof(float);
+	size_t avail   = jack_ringbuffer_read_space(buf);
+	size_t size    = buf_frames * buf_stride;
 	
-	while (jack_ringbuffer_read_space(buf) < buflen) {
-		pthread_mutex_lock(&buf_lock);
-		pthread_cond_wait(&buf_cond, &buf_lock);
-		pthread_mutex_unlock(&buf_lock);
+	// a backlog past three quarters of the buffer is dropped back to half
+	if (avail > (size / 4 * 3)) {
+		size_t drop = (avail - (size / 2)) / buf_stride * buf_stride;
+		
+		jack_ringbuffer_read_advance(buf, drop);
+		MAI_STAT_ADD(audio.dropped, drop / buf_stride);
+		avail -= drop;
 	}
 	
 	float *in = alloca(buflen);
-	jack_ringbuffer_read(buf, (void *)in, buflen);
+	
+	// never wait for audio: the packet goes out on time as silence instead
+	if (avail < buflen) {
+		MAI_STAT_INC(audio.underrun);
+		MAI_STAT_INC(rtp.silent);
+		memset(in, 0, buflen);
+	} else
+		jack_ringbuffer_read(buf, (void *)in, buflen);
 	
 	int32_t quant;
 	float raw, rand, samp, *dither;
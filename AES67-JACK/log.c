@@ -0,0 +1,220 @@
+#include "mai.h"
+
+/* ######################################################################## */
+#define LOG_RECORDS	256				// queued messages, power of two
+#define LOG_LENGTH	240				// longest message kept
+#define LOG_SITES	64				// formats tracked for rate limiting
+#define LOG_LIMIT	10				// messages per format per second
+
+struct record {
+	size_t		 seq;				// ring position this record holds
+	size_t		 len;
+	char		 text[LOG_LENGTH];
+};
+
+struct site {
+	const char	*fmt;				// format string, one per call site
+	uint64_t	 window;			// second the count applies to
+	uint32_t	 count;
+	uint32_t	 suppressed;
+};
+
+static struct record	 log_ring[LOG_RECORDS];	// multi-producer, flusher consumes
+static size_t		 log_head    = 0;		// next position to claim
+static size_t		 log_tail    = 0;		// next position to write out
+static size_t		 log_dropped = 0;		// messages lost to a full ring
+
+static struct site	 log_sites[LOG_SITES];
+
+static int		 log_active  = 0;		// flusher running
+static pthread_t	 tid;
+
+/* ######################################################################## */
+static struct site *log_site(const char *fmt) {
+	// open addressing on the format pointer; slots are claimed once, never freed
+	size_t idx = ((uintptr_t)fmt >> 3) % LOG_SITES;
+	
+	for (size_t lp=0; lp < LOG_SITES; lp++, idx = (idx + 1) % LOG_SITES) {
+		const char *cur = __sync_val_compare_and_swap(&log_sites[idx].fmt, NULL, fmt);
+	
+		if (!cur || (cur == fmt))
+			return(&log_sites[idx]);
+	}
+	return(NULL);
+}
+
+static int log_allow(const char *fmt, uint32_t *suppressed) {
+	struct site *site = log_site(fmt);
+	struct timespec ts;
+	
+	if (!site)
+		return(1);				// table full: no limit
+	
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	
+	if (__atomic_load_n(&site->window, __ATOMIC_RELAXED) != (uint64_t)ts.tv_sec) {
+		__atomic_store_n(&site->window, ts.tv_sec, __ATOMIC_RELAXED);
+		__atomic_store_n(&site->count,  0,         __ATOMIC_RELAXED);
+	}
+	
+	if (__sync_fetch_and_add(&site->count, 1) >= LOG_LIMIT) {
+		__sync_fetch_and_add(&site->suppressed, 1);
+		return(0);
+	}
+	
+	*suppressed = __sync_lock_test_and_set(&site->suppressed, 0);
+	return(1);
+}
+
+/* ######################################################################## */
+static size_t log_format(char *text, uint32_t suppressed, const char *fmt, va_list args) {
+	int len = vsnprintf(text, LOG_LENGTH, fmt, args);
+	
+	len = (len < 0) ? 0 : (len >= LOG_LENGTH) ? LOG_LENGTH - 1 : len;
+	
+	// note the suppressed count ahead of the message's own newline
+	if (suppressed && len && (text[len - 1] == '\n')) {
+		int more = snprintf(text + len - 1, LOG_LENGTH - len + 1, " (%u more suppressed)\n", suppressed);
+	
+		len = (more < 0) ? len : ((len - 1 + more) >= LOG_LENGTH) ? LOG_LENGTH - 1 : (len - 1 + more);
+	}
+	
+	return(len);
+}
+
+/* ######################################################################## */
+static void log_flush(void) {
+	static char	last[LOG_LENGTH];		// last message written
+	static size_t	last_len = 0;
+	static size_t	repeats  = 0;
+	static size_t	reported = 0;
+	
+	size_t tail = log_tail;
+	
+	// a quiet pass reports repeats now rather than at the next message
+	if (repeats && (__atomic_load_n(&log_ring[tail % LOG_RECORDS].seq, __ATOMIC_ACQUIRE) != tail + 1)) {
+		fprintf(stderr, "Last message repeated %zu times\n", repeats);
+		repeats = 0;
+	}
+	
+	for (struct record *rec; __atomic_load_n(&(rec = &log_ring[tail % LOG_RECORDS])->seq, __ATOMIC_ACQUIRE) == tail + 1; tail++) {
+		if ((rec->len == last_len) && !memcmp(rec->text, last, last_len)) {
+			repeats++;
+		} else {
+			if (repeats)
+				fprintf(stderr, "Last message repeated %zu times\n", repeats);
+	
+			fwrite(rec->text, 1, rec->len, stderr);
+			memcpy(last, rec->text, rec->len);
+			last_len = rec->len;
+			repeats  = 0;
+		}
+	
+		// hand the record back to the producers
+		__atomic_store_n(&rec->seq, tail + LOG_RECORDS, __ATOMIC_RELEASE);
+	}
+	log_tail = tail;
+	
+	size_t dropped = __atomic_load_n(&log_dropped, __ATOMIC_RELAXED);
+	
+	if (dropped != reported) {
+		fprintf(stderr, "Log: %zu messages dropped\n", dropped - reported);
+		reported = dropped;
+	}
+	
+	fflush(stderr);
+}
+
+static void *log_thread(void *arg) {
+	const struct timespec interval = { .tv_sec = 0, .tv_nsec = 20000000 };
+	
+	while (__atomic_load_n(&log_active, __ATOMIC_ACQUIRE)) {
+		nanosleep(&interval, NULL);
+		log_flush();
+	}
+	
+	return(arg);
+}
+
+/* ######################################################################## */
+int mai_log_str(const char *fmt, ...) {
+	uint32_t suppressed = 0;
+	va_list  args;
+	
+	// over the limit: count it without formatting anything
+	if (!log_allow(fmt, &suppressed))
+		return(0);
+	
+	va_start(args, fmt);
+	
+	// not started (or stopped): write directly
+	if (!__atomic_load_n(&log_active, __ATOMIC_ACQUIRE)) {
+		char	text[LOG_LENGTH];
+		size_t	len = log_format(text, suppressed, fmt, args);
+	
+		va_end(args);
+		fwrite(text, 1, len, stderr);
+		return(len);
+	}
+	
+	// claim a record: its seq equals the position once the flusher freed it
+	struct record *rec;
+	size_t pos = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+	
+	for (;;) {
+		rec = &log_ring[pos % LOG_RECORDS];
+		size_t seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+	
+		if (seq == pos) {
+			size_t cur = __sync_val_compare_and_swap(&log_head, pos, pos + 1);
+	
+			if (cur == pos)
+				break;
+			pos = cur;
+		} else if (seq < pos) {
+			va_end(args);
+			__sync_fetch_and_add(&log_dropped, 1);
+			return(0);			// ring full
+		} else {
+			pos = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+		}
+	}
+	
+	rec->len = log_format(rec->text, suppressed, fmt, args);
+	va_end(args);
+	
+	// publish to the flusher
+	__atomic_store_n(&rec->seq, pos + 1, __ATOMIC_RELEASE);
+	
+	return(rec->len);
+}
+
+/* ######################################################################## */
+static void log_stop(void) {
+	if (!log_active)
+		return;
+	
+	__atomic_store_n(&log_active, 0, __ATOMIC_RELEASE);
+	pthread_join(tid, NULL);
+	
+	log_flush();
+	log_flush();				// and report any trailing repeats
+}
+
+int mai_log_init(void) {
+	for (size_t lp=0; lp < LOG_RECORDS; lp++)
+		log_ring[lp].seq = lp;
+	
+	log_active = 1;
+	
+	if (pthread_create(&tid, NULL, log_thread, NULL)) {
+		log_active = 0;
+		return(mai_error("could not start log thread: %m\n"));
+	}
+	
+	// flush whatever is queued however the process exits
+	atexit(log_stop);
+	return(0);
+}
+
+/* ######################################################################## */
@@ -0,0 +1,170 @@
+#include "mai.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+/* ######################################################################## */
+#define LOOP_MAX 16					// sockets and timers at most
+
+struct handler {
+	int		  fd;
+	int		  prio;				// MAI_LOOP_* level, lowest runs first
+	void		(*recv)(int fd);		// socket handler
+	void		(*tick)(uint64_t count);	// timer handler, with expirations
+};
+
+static struct handler	 loop_fds[LOOP_MAX];		// entries are never reused
+static size_t		 loop_used   =  0;		// number of entries added
+
+static int		 loop_epoll  = -1;		// readiness for every handler
+static int		 loop_wake   = -1;		// eventfd to interrupt the wait
+static int		 loop_active =  0;		// cleared to stop the thread
+static uint64_t		 loop_time   =  0;		// rtp clock at the last wakeup
+
+/* ######################################################################## */
+static void dispatch(struct handler *h) {
+	if (h->tick) {
+		uint64_t count;
+	
+		if (read(h->fd, &count, sizeof(count)) == sizeof(count))
+			(h->tick)(count);
+	} else if (h->recv) {
+		(h->recv)(h->fd);
+	}
+}
+
+/* ######################################################################## */
+static void *loop(void *arg) {
+	struct epoll_event events[LOOP_MAX];
+	
+	while (loop_active) {
+		int n = epoll_wait(loop_epoll, events, LOOP_MAX, -1);
+	
+		if (n < 0) {
+			if (errno != EINTR)
+				mai_error("epoll wait: %m\n");
+			continue;
+		}
+	
+		// one stamp for everything ready, taken before any handler runs
+		loop_time = mai_rtp_clock();
+	
+		MAI_STAT_INC(loop.wakeups);
+		MAI_STAT_ADD(loop.events, n);
+	
+		// handle by priority, so ptp events never queue behind audio
+		for (int prio = 0; prio < MAI_LOOP_LEVELS; prio++) {
+			for (int i = 0; i < n; i++) {
+				struct handler *h = events[i].data.ptr;
+	
+				if (h->prio == prio)
+					dispatch(h);
+			}
+		}
+	}
+	
+	return(arg);
+}
+
+/* ######################################################################## */
+static int loop_register(int fd, int prio, void (*recv)(int), void (*tick)(uint64_t)) {
+	if (loop_used >= LOOP_MAX)
+		return(mai_error("too many loop handlers\n"));
+	
+	struct handler *h = &loop_fds[loop_used++];
+	
+	h->fd   = fd;
+	h->prio = prio;
+	h->recv = recv;
+	h->tick = tick;
+	
+	// the entry is complete before the loop thread can see it
+	struct epoll_event event = { .events = EPOLLIN, .data.ptr = h };
+	
+	if (epoll_ctl(loop_epoll, EPOLL_CTL_ADD, fd, &event))
+		return(mai_error("epoll add: %m\n"));
+	
+	return(0);
+}
+
+int mai_loop_add(int fd, int prio, void (*func)(int fd)) {
+	return(loop_register(fd, prio, func, NULL));
+}
+
+int mai_loop_timer(long period, int prio, void (*func)(uint64_t count)) {
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	
+	if (fd < 0)
+		return(mai_error("timerfd create: %m\n"));
+	
+	// first expiry at once, then every period on a fixed cadence
+	struct itimerspec spec = {
+		.it_interval = { .tv_sec = period / 1000000000L, .tv_nsec = period % 1000000000L },
+		.it_value    = { .tv_sec = 0, .tv_nsec = 1 },
+	};
+	
+	if (timerfd_settime(fd, 0, &spec, NULL)) {
+		close(fd);
+		return(mai_error("timerfd set: %m\n"));
+	}
+	
+	if (loop_register(fd, prio, NULL, func)) {
+		close(fd);
+		return(-1);
+	}
+	
+	return(fd);
+}
+
+void mai_loop_del(int fd) {
+	epoll_ctl(loop_epoll, EPOLL_CTL_DEL, fd, NULL);
+	
+	for (size_t lp=0; lp < loop_used; lp++) {
+		if (loop_fds[lp].fd == fd) {
+			loop_fds[lp].recv = NULL;
+			loop_fds[lp].tick = NULL;
+		}
+	}
+}
+
+uint64_t mai_loop_stamp(void) {
+	return(loop_time);
+}
+
+/* ######################################################################## */
+static pthread_t tid;
+
+int mai_loop_init(void) {
+	if ((loop_epoll = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		return(mai_error("could not create epoll instance: %m\n"));
+	
+	if ((loop_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+		return(mai_error("could not create wakeup event: %m\n"));
+	
+	// the wakeup has no handler, it only ends the wait
+	return(loop_register(loop_wake, MAI_LOOP_BACKGROUND, NULL, NULL));
+}
+
+int mai_loop_start(void) {
+	loop_active = 1;
+	
+	if (pthread_create(&tid, NULL, loop, NULL))
+		return(mai_error("could not start loop thread: %m\n"));
+	
+	return(0);
+}
+
+int mai_loop_stop(void) {
+	uint64_t one = 1;
+	
+	loop_active = 0;
+	
+	if (write(loop_wake, &one, sizeof(one)) != sizeof(one))
+		mai_error("wakeup: %m\n");
+	
+	pthread_join(tid, NULL);
+	return(0);
+}
+
+/* ######################################################################## */
@@ -7,11 +7,14 @@ struct mai_func {
 };
 
 static struct mai_func mai_init[] = {
+	{ mai_log_init,		'*' },
+	{ mai_loop_init,	'*' },
 	{ mai_ptp_init,		'*' },
 	{ mai_rtp_init,		'*' },
 	{ mai_sap_init,		's' },
 	{ mai_jack_init,	'*' },
 
+	{ mai_loop_start,	'*' },
 	{ mai_ptp_start,	'*' },
 	{ mai_rtp_start,	'*' },
 	{ mai_sap_start,	's' },
@@ -19,6 +22,7 @@ static struct mai_func mai_init[] = {
 };
 
 static struct mai_func mai_fini[] = {
+	{ mai_loop_stop,	'*' },
 	{ mai_rtp_stop,		'*' },
 	{ mai_ptp_stop,		'*' },
 	{ mai_sap_stop,		's' },
@@ -38,10 +42,12 @@ static void stats(void) {
 	
 	fprintf(stderr, "Audio Clock Drift:     %zd\n",   MAI_STAT_GET(audio.drift));
 	fprintf(stderr, "Audio Buffer Underrun: %zu\n",   MAI_STAT_GET(audio.underrun));
-	fprintf(stderr, "Audio Buffer Overrun:  %zu\n\n", MAI_STAT_GET(audio.overrun));
+	fprintf(stderr, "Audio Buffer Overrun:  %zu\n",   MAI_STAT_GET(audio.overrun));
+	fprintf(stderr, "Audio Frames Dropped:  %zu\n\n", MAI_STAT_GET(audio.dropped));
 	
 	fprintf(stderr, "RTP Clock Resynced:    %zu\n",   MAI_STAT_GET(rtp.resynced));
 	fprintf(stderr, "RTP Total Packets:     %zu\n",   MAI_STAT_GET(rtp.packets));
+	fprintf(stderr, "RTP Silent Packets:    %zu\n",   MAI_STAT_GET(rtp.silent));
 	fprintf(stderr, "RTP Reordered Packets: %zu\n",   MAI_STAT_GET(rtp.reordered));
 	fprintf(stderr, "RTP Dropped Packets:   %zu\n\n", MAI_STAT_GET(rtp.skipped));
 	
@@ -49,6 +55,9 @@ static void stats(void) {
 	fprintf(stderr, "PTP Delay Updates:     %zu\n",   MAI_STAT_GET(ptp.requests));
 	fprintf(stderr, "PTP General Messages:  %zu\n",   MAI_STAT_GET(ptp.general));
 	fprintf(stderr, "PTP Event Messages:    %zu\n\n", MAI_STAT_GET(ptp.event));
+	
+	fprintf(stderr, "Loop Wakeups:          %zu\n",   MAI_STAT_GET(loop.wakeups));
+	fprintf(stderr, "Loop Events:           %zu\n\n", MAI_STAT_GET(loop.events));
 }
 
 /* ######################################################################## */
@@ -60,11 +60,13 @@ extern struct mai {
 			ssize_t			drift;			// total sample clock drift
 			size_t			overrun;		// buffer overrun
 			size_t			underrun;		// buffer underrun
+			size_t			dropped;		// frames dropped from a backlog
 		} audio;
 		
 		struct {
 			size_t			resynced;		// total rtp clock resyncs
 			size_t			packets;		// total packets sent/recv
+			size_t			silent;			// packets sent as silence
 			size_t			reordered;		// packets received out of order
 			size_t			skipped;		// packets we stopped waiting for
 		} rtp;
@@ -75,6 +77,11 @@ extern struct mai {
 			size_t			general;		// total ptp general messages
 			size_t			event;			// total ptp event messages
 		} ptp;
+		
+		struct {
+			size_t			wakeups;		// total loop wakeups
+			size_t			events;			// total handlers made ready
+		} loop;
 	} stat;
 } mai;
 
@@ -88,11 +95,16 @@ extern struct mai {
 #define MAI_STAT_DEC(t) MAI_STAT_ADD(t, -1)
 
 /* ######################################################################## */
-#define mai_log(l,f, ...) fprintf(stderr, "[%-5s] %-20s " f, l, __func__ , ##__VA_ARGS__)
+// lowest level compiled in: 0 debug, 1 info, 2 error
+#ifndef MAI_LOG_LEVEL
+#define MAI_LOG_LEVEL 0
+#endif
+
+#define mai_log(l,f, ...) mai_log_str("[%-5s] %-20s " f, l, __func__ , ##__VA_ARGS__)
 
-#define mai_debug(f, ...)    ({ if (mai.args.verbose) mai_log("DEBUG", f , ##__VA_ARGS__); 0; })
+#define mai_debug(f, ...)    ({ if ((MAI_LOG_LEVEL <= 0) && mai.args.verbose) mai_log("DEBUG", f , ##__VA_ARGS__); 0; })
 
-#define mai_info(f, ...)  ({ mai_log("INFO",  f , ##__VA_ARGS__);  0; })
+#define mai_info(f, ...)  ({ if (MAI_LOG_LEVEL <= 1) mai_log("INFO",  f , ##__VA_ARGS__);  0; })
 #define mai_error(f, ...) ({ mai_log("ERROR", f , ##__VA_ARGS__); -1; })
 
 /* ######################################################################## */
@@ -112,7 +124,24 @@ extern size_t		 mai_audio_read_int(       char *data, size_t bytes);
 extern int		 mai_jack_init(void);
 extern void		 mai_jack_clock(int64_t ptp);
 
+// loop.c
+#define MAI_LOOP_TIMING		0	// ptp event messages
+#define MAI_LOOP_AUDIO		1	// rtp send and receive
+#define MAI_LOOP_CONTROL	2	// ptp general messages
+#define MAI_LOOP_BACKGROUND	3	// sap announcements
+#define MAI_LOOP_LEVELS		4
+
+extern int		 mai_loop_init( void);
+extern int		 mai_loop_start(void);
+extern int		 mai_loop_stop( void);
+
+extern int		 mai_loop_add(int fd, int prio, void (*func)(int fd));
+extern int		 mai_loop_timer(long period, int prio, void (*func)(uint64_t count));
+extern void		 mai_loop_del(int fd);
+extern uint64_t		 mai_loop_stamp(void);
+
 // log.c
+extern int		 mai_log_init(void);
 extern int 		 mai_log_str(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
 
 // sap.c
@@ -17,13 +17,23 @@ struct packet {
         uint8_t		payload[];
 } __attribute__((__packed__));
 
+/* ######################################################################## */
+// delay request rate, log2 seconds between requests: fast while acquiring,
+// one step slower after each run of agreeing path delay measurements
+#define PTP_REQ_FAST		-3			// 8 per second
+#define PTP_REQ_SLOW		 3			// 1 per 8 seconds
+#define PTP_REQ_STABLE		 4			// agreeing measurements per step
+#define PTP_DLY_AVERAGE		 8			// path delay measurements averaged
+
 /* ######################################################################## */
 static char		ptp_source[32];		// PTP master source (decoded/text)
 
 static int 		ptp_sock  = -1;		// port 319: event messages
 static uint64_t		ptp_rate  =  0;		// audio system sample rate
+static uint64_t		ptp_scale =  0;		// samples per nanosecond, 20.44 fixed point
 static uint64_t         ptp_recv  =  0;   	// PTP SYNC Receiver  Timestamp (T'1)
 static uint64_t         ptp_sync  =  0;   	// PTP SYNC Sender    Timestamp (T1)
+static int		ptp_gap   = -3;		// PTP SYNC interval, log2 seconds
 
 static int		gen_sock  = -1;		// port 320: general messages
 static uint16_t	 	clk_seq   =  0;		// PTP Two Phase SYNC Sequence
@@ -33,6 +43,14 @@ static int		req_sock  = -1;		// socket for sending messages
 static uint16_t 	req_seq   =  0;		// request message sequence
 static uint64_t		req_sent  =  0;		// PTP DELAY Sender   Timestamp (T2)
 static uint64_t		req_sync  =  0;		// PTP DELAY Receiver Timestamp (T'2)
+static int64_t		req_path  =  0;		// SYNC transit (T'1 - T1) the request followed
+static uint64_t		req_next  =  0;		// earliest T'1 for the next request
+static int		req_wait  = PTP_REQ_FAST;	// request interval, log2 seconds
+static int		req_min   = PTP_REQ_FAST;	// master's minimum request interval
+static int		req_agree =  0;		// agreeing delay measurements in a row
+
+static int64_t		dly_sum   =  0;		// path delay, moving average sum
+static int		dly_valid =  0;		// path delay measured
 
 /* ######################################################################## */
 static uint64_t ptp_stamp(uint8_t *in) {
@@ -44,16 +62,56 @@ static uint64_t ptp_stamp(uint8_t *in) {
 	uint32_t nsec =	((uint64_t)in[6] << 24) | ((uint64_t)in[7] << 16) | 
 			((uint64_t)in[8] <<  8) | ((uint64_t)in[9]);
 			
-	// convert clock time to sample time
-	return((sec * ptp_rate) + ((nsec * ptp_rate) / 1000000000));
+	// convert clock time to sample time: nanoseconds by the reciprocal set
+	// with the rate, rounded to the nearest sample instead of cut, no division
+	return((sec * ptp_rate) + (((uint64_t)nsec * ptp_scale + (1ULL << 43)) >> 44));
 }
 
 /* ######################################################################## */
-static void ptp_update(void) {
-	// send delay requests only in sender mode and only every 2 seconds
-	if (!MAI_SENDER || (req_sync > ptp_sync) || ((ptp_sync - req_sync) < (ptp_rate * 2)))
+static uint64_t ptp_interval(int log2) {
+	// 2^log2 seconds in samples, log2 limited to the standard's -7 .. 7
+	log2 = (log2 < -7) ? -7 : (log2 > 7) ? 7 : log2;
+	return((ptp_rate << (log2 + 7)) >> 7);
+}
+
+/* ######################################################################## */
+static void ptp_reset(void) {
+	// acquire again: measure the path with every SYNC until it settles
+	req_wait  = PTP_REQ_FAST;
+	req_agree = 0;
+	req_next  = 0;
+}
+
+/* ######################################################################## */
+static void ptp_delay(int64_t delay) {
+	// software timestamps on a short path
+	if (delay < 0)
+		delay = 0;
+		
+	if (!dly_valid) {
+		dly_sum   = delay * PTP_DLY_AVERAGE;
+		dly_valid = 1;
 		return;
+	}
 	
+	int64_t mean = dly_sum / PTP_DLY_AVERAGE;
+	dly_sum += delay - mean;
+	
+	// within 100us of the average: a step slower after a run, else a step faster
+	if (llabs(delay - mean) <= (int64_t)(ptp_rate / 10000)) {
+		if ((++req_agree >= PTP_REQ_STABLE) && (req_wait < PTP_REQ_SLOW)) {
+			req_agree = 0;
+			req_wait++;
+		}
+	} else {
+		req_agree = 0;
+		if (req_wait > PTP_REQ_FAST)
+			req_wait--;
+	}
+}
+
+/* ######################################################################## */
+static void ptp_request(void) {
 	// expected size of DELAY REQUEST packet (header + 48bits + 32bits)
 	static const size_t pktlen = sizeof(struct packet) + ((48 + 32) / 8);
 	
@@ -71,122 +129,154 @@ static void ptp_update(void) {
 		mai_error("send: %m\n");
 		
 	req_sent = mai_rtp_clock();		// set delay request time (T2)
+	req_path = (int64_t)ptp_recv - (int64_t)ptp_sync;
 	MAI_STAT_INC(ptp.requests);
+	
+	// due half a SYNC early, so it goes with the SYNC nearest its time
+	uint64_t wait = ptp_interval((req_wait > req_min) ? req_wait : req_min);
+	uint64_t sync = ptp_interval(ptp_gap);
+	req_next = ptp_recv + wait - (((wait < sync) ? wait : sync) / 2);
 }
 
 /* ######################################################################## */
-static void *ptp_general(void *arg) {
+static void ptp_update(void) {
+	// send delay requests only in sender mode, at the adaptive rate; before
+	// the offset moves the rtp clock, so T2 and T'1 are on the same one
+	if (MAI_SENDER && (ptp_recv >= req_next))
+		ptp_request();
+		
+	if (!dly_valid)
+		return;
+		
+	// every SYNC gives an offset with the path delay measured in between
+	int64_t offset = (int64_t)ptp_recv - (int64_t)ptp_sync - (dly_sum / PTP_DLY_AVERAGE);
+	
+	// more than 1ms off: the path or the master moved, measure again
+	if (llabs(offset) > (int64_t)(ptp_rate / 1000))
+		ptp_reset();
+		
+	// send calculated PTP offset to RTP system
+	mai_rtp_offset(offset);
+}
+
+/* ######################################################################## */
+static void ptp_general(int sock) {
 	// packet data buffer and header overlay
-	uint8_t	type, data[2048];
+	static uint8_t data[2048];
 
 	// state data
 	struct packet *packet = (struct packet *)data;
+	ssize_t r;
 	
-	for (ssize_t r; 1; ) {
-		if ((r = recv(gen_sock, data, sizeof(data), 0)) <= 0)
+	if ((r = recv(sock, data, sizeof(data), MSG_DONTWAIT)) <= 0) {
+		if ((errno != EAGAIN) && (errno != EINTR))
 			mai_error("recv: %m\n");
-			
-		if (((packet->version & 0x0F) != 2) || (packet->domain != 0))
-			continue;				// skip: PTP VERSION != 2 or PTP DOMAIN != 0
-			
-		MAI_STAT_INC(ptp.general);
-			
-		type = packet->type & 0x0F;
+		return;
+	}
+		
+	if (((packet->version & 0x0F) != 2) || (packet->domain != 0))
+		return;					// skip: PTP VERSION != 2 or PTP DOMAIN != 0
+		
+	MAI_STAT_INC(ptp.general);
 		
-		if (type == 0x08) { 				// is this the second phase of a two-phase clock?
-			if (packet->sequence != clk_seq)	// is this the right sequence?
-				continue;
-				
-			ptp_recv = clk_recv;			// set received time (T'1)
-			ptp_sync = ptp_stamp(packet->payload);	// set master time   (T1)
+	uint8_t type = packet->type & 0x0F;
+	
+	if (type == 0x08) { 				// is this the second phase of a two-phase clock?
+		if (packet->sequence != clk_seq)	// is this the right sequence?
+			return;
 			
-			ptp_update();
+		ptp_recv = clk_recv;			// set received time (T'1)
+		ptp_sync = ptp_stamp(packet->payload);	// set master time   (T1)
+		
+		ptp_update();
+		
+	} else if (type == 0x09) { 			// is this a delay response message?
+		if (packet->sequence != req_seq)	// is this the right sequence?
+			return;
 			
-		} else if (type == 0x09) { 			// is this a delay response message?
-			if (packet->sequence != req_seq)	// is this the right sequence?
-				continue;
-				
-			req_sync = ptp_stamp(packet->payload);	// set master delay (T'2)
+		req_sync = ptp_stamp(packet->payload);	// set master delay (T'2)
+		
+		// the interval field is the fastest the master wants requests
+		if (((int8_t)packet->interval >= -7) && ((int8_t)packet->interval <= 7))
+			req_min = (int8_t)packet->interval;
 			
-			// send calculated PTP offset to RTP system
-			mai_rtp_offset(((int64_t)ptp_recv - (int64_t)ptp_sync - (int64_t)req_sync + (int64_t)req_sent) / 2);
-		}
+		// path delay: ((T'1 - T1) + (T'2 - T2)) / 2, with the SYNC the request followed
+		ptp_delay((req_path + (int64_t)req_sync - (int64_t)req_sent) / 2);
 	}
-
-	mai_error("Unexpected Thread Exit!");
-	return(arg);
 }
 
 /* ######################################################################## */
-static void *ptp_event(void *arg) {
+static void ptp_event(int sock) {
 	const uint16_t flag_two_step = htons(0x0200);
 	
 	// packet data buffer and header overlay
-	uint8_t	data[2048];
+	static uint8_t data[2048];
 
 	// state data
 	struct packet 	    *packet = (struct packet *)data;
 	static const size_t  pktlen = sizeof(*packet) + ((48 + 32) / 8);
 	
-	uint8_t source[sizeof(packet->source)];		// current PTP SYNC source
-	memset(source, 0, sizeof(source));		// clear current source and initiate sync
+	static uint8_t source[sizeof(packet->source)];	// current PTP SYNC source, zero until the first
+	ssize_t r;
 	
-	// receive packet loop
-	for (ssize_t r; 1; ) {
-		if ((r = recv(ptp_sock, data, sizeof(data), 0)) <= 0)
+	if ((r = recv(sock, data, sizeof(data), MSG_DONTWAIT)) <= 0) {
+		if ((errno != EAGAIN) && (errno != EINTR))
 			mai_error("recv: %m\n");
-			
-		if (((packet->version & 0x0F) != 2) || (packet->domain != 0))
-			continue;	// skip: PTP VERSION != 2 or PTP DOMAIN != 0
-			
-		MAI_STAT_INC(ptp.event);
-			
-		if (((size_t)r < pktlen) || (ntohs(packet->length) < pktlen))
-			continue;	// skip: PTP LENGTH < (sizeof(header) + sizeof(SYNC))
-			
-		if ((packet->type & 0x0F) != 0)
-			continue;	// skip: PTP TYPE != SYNC
-			
-		// check synchronization source
-		if (memcmp(source, packet->source, sizeof(source))) {
-			// we just got a SYNC from a different clock, start RESYNC
-			memcpy(source, packet->source, sizeof(source));
-			
-			// save a string copy of clock source (for SAP/SDP broadcasts)
-			sprintf(ptp_source, "%02X-%02X-%02X-%02X-%02X-%02X-%02X-%02X:0", 
-				packet->source[0], packet->source[1], packet->source[2], packet->source[3],
-				packet->source[4], packet->source[5], packet->source[6], packet->source[7]
-			);
-			
-			mai_info("Source: %s (#%zu).\n", ptp_source, MAI_STAT_INC(ptp.masters));
-		}
+		return;
+	}
 		
-		// convert ptp timestamp to clk sample stamp
-		uint64_t stamp = ptp_stamp(packet->payload);
+	if (((packet->version & 0x0F) != 2) || (packet->domain != 0))
+		return;		// skip: PTP VERSION != 2 or PTP DOMAIN != 0
 		
-		// let jack adjust it's sample rate from ptp rate
-		mai_jack_clock(stamp);
+	MAI_STAT_INC(ptp.event);
 		
-		if (packet->flags & flag_two_step) {	// is this a two-phase clock?
-			clk_seq  = packet->sequence;	// save sequence
-			clk_recv = mai_rtp_clock();	// save received time
-
-		} else {				// otherwise, it's a single phase clock
-			ptp_recv = mai_rtp_clock();	// set received time
-			ptp_sync = stamp;		// set master time
-			
-			ptp_update();
-		}
+	if (((size_t)r < pktlen) || (ntohs(packet->length) < pktlen))
+		return;		// skip: PTP LENGTH < (sizeof(header) + sizeof(SYNC))
+		
+	if ((packet->type & 0x0F) != 0)
+		return;		// skip: PTP TYPE != SYNC
+		
+	// check synchronization source
+	if (memcmp(source, packet->source, sizeof(source))) {
+		// we just got a SYNC from a different clock, start RESYNC
+		memcpy(source, packet->source, sizeof(source));
+		
+		// save a string copy of clock source (for SAP/SDP broadcasts)
+		sprintf(ptp_source, "%02X-%02X-%02X-%02X-%02X-%02X-%02X-%02X:0", 
+			packet->source[0], packet->source[1], packet->source[2], packet->source[3],
+			packet->source[4], packet->source[5], packet->source[6], packet->source[7]
+		);
+		
+		mai_info("Source: %s (#%zu).\n", ptp_source, MAI_STAT_INC(ptp.masters));
+		
+		// the path to it is measured afresh
+		dly_valid = 0;
+		req_min   = PTP_REQ_FAST;
+		ptp_reset();
 	}
 	
-	mai_error("Unexpected Thread Exit!");
-	return(arg);
+	ptp_gap = (int8_t)packet->interval;
+	
+	// convert ptp timestamp to clk sample stamp
+	uint64_t stamp = ptp_stamp(packet->payload);
+	
+	// let jack adjust it's sample rate from ptp rate
+	mai_jack_clock(stamp);
+	
+	// received time is the loop wakeup, taken before anything else ran
+	if (packet->flags & flag_two_step) {	// is this a two-phase clock?
+		clk_seq  = packet->sequence;	// save sequence
+		clk_recv = mai_loop_stamp();	// save received time
+
+	} else {				// otherwise, it's a single phase clock
+		ptp_recv = mai_loop_stamp();	// set received time
+		ptp_sync = stamp;		// set master time
+		
+		ptp_update();
+	}
 }
 
 /* ######################################################################## */
-static pthread_t evt_tid;
-static pthread_t gen_tid;
-
 int mai_ptp_init(void) {
 	if ((ptp_sock = mai_sock_open('r', "224.0.1.129", 319)) < 0)
 		return(mai_error("could not open PTP event socket\n"));
@@ -201,31 +291,20 @@ int mai_ptp_init(void) {
 }
 
 int mai_ptp_start(void) {
-	// kick off ptp general messages thread
-	if (pthread_create(&gen_tid, NULL, ptp_general, NULL))
-		return(mai_error("could not start general thread: %m\n"));
+	// event messages are stamped and handled ahead of everything else
+	if (mai_loop_add(ptp_sock, MAI_LOOP_TIMING, ptp_event))
+		return(mai_error("could not add ptp event handler\n"));
 
-	// kick off ptp thread
-	if (pthread_create(&evt_tid, NULL, ptp_event, NULL))
-		return(mai_error("could not start ptp thread: %m\n"));
+	if (mai_loop_add(gen_sock, MAI_LOOP_CONTROL, ptp_general))
+		return(mai_error("could not add ptp general handler\n"));
         
 	// wait for PTP to synchronize
-	struct timespec ts;
-	
 	for (int count=1; !MAI_STAT_GET(ptp.masters); count++) {
 		// loop banner
 		if (!(count % 5))
 			mai_info("Waiting.\n");
 			
-		// get current time
-		if (clock_gettime(CLOCK_REALTIME, &ts))
-			return(mai_error("could not get system clock: %m\n"));
-			
-		// try to join thread, 1s timeout
-		ts.tv_sec  += 1;
-		
-		if (!pthread_timedjoin_np(evt_tid, NULL, &ts))
-			return(mai_error("startup aborted.\n"));
+		sleep(1);
 			
 		// loop overflow
 		if (count > 60) {
@@ -238,14 +317,15 @@ int mai_ptp_start(void) {
 }
 
 int mai_ptp_stop(void) {
-	pthread_cancel(evt_tid);
-	pthread_cancel(gen_tid);
+	mai_loop_del(ptp_sock);
+	mai_loop_del(gen_sock);
 	return(0);
 }
 
 /* ######################################################################## */
 uint32_t mai_ptp_rate(uint32_t rate) {
-	ptp_rate = rate;
+	ptp_rate  = rate;
+	ptp_scale = ((uint64_t)rate << 44) / 1000000000;
 	return(ptp_rate);
 }
 
@@ -44,119 +44,107 @@ static void rob_scan(void) {
 }
 
 /* ######################################################################## */
-static void *rtp_recv(void *arg) {
-	uint8_t		 buffer[8192];				// packet data buffer
+static void rtp_recv(int sock) {
+	static uint8_t	 buffer[8192];				// packet data buffer
 	struct packet	*packet = (struct packet *)buffer;	// packet structure overlay
 	char		*data;					// variable pointer (to skip extensions)
 	ssize_t		 len;					// variable data length
 	
-	// loop on ringbuffer and send samples
-	while (1) {
-		if ((len = recv(rtp_sock, buffer, sizeof(buffer), 0)) <= 0)
-			mai_error("packet recv: %m\n");				// skip: receive error
-			
-		if ((len -= sizeof(*packet)) <= 0)
-			continue;						// skip: no payload
-			
-		if ((packet->vpxcc & 0b11000000) != 0b10000000)
-			continue;						// skip: bad version
-			
-		data = packet->payload;						// copy payload start
-		data += (packet->vpxcc & 0b00001111) * sizeof(uint32_t);	// skip any CSRC's
+	// one packet per wakeup, so ptp events are handled in between
+	if ((len = recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT)) <= 0) {
+		if ((errno != EAGAIN) && (errno != EINTR))
+			mai_error("packet recv: %m\n");		// skip: receive error
+		return;
+	}
+		
+	if ((len -= sizeof(*packet)) <= 0)
+		return;							// skip: no payload
+		
+	if ((packet->vpxcc & 0b11000000) != 0b10000000)
+		return;							// skip: bad version
+		
+	data = packet->payload;						// copy payload start
+	data += (packet->vpxcc & 0b00001111) * sizeof(uint32_t);	// skip any CSRC's
 
-		if (packet->vpxcc & 0b00010000)					// extension header?
-			data += (1 + ntohs(*((uint16_t *)(data + 2)))) * sizeof(uint32_t);
-			
-		if ((len -= (data - packet->payload)) < 0)		// skip if no data
-			continue;
-			
-		MAI_STAT_INC(rtp.packets);
-			
-		uint16_t seq      = ntohs(packet->seq);			// get packet sequence number
-		 int16_t seq_dist = seq - rtp_next;			// distance from expected sequence
-		uint16_t seq_abs  = abs(seq_dist);			// absolute distance
-		
-		if (seq_abs > (ROB_LEN * 2)) {				// distance too far out
-			seq_abs  = 0;					// resynchronize sequence
-			rtp_used = 0;					// and drop any reorder entries
-		} else if (seq_dist < 0) {
-			continue;					// skip: sequence in recent past
-		}
+	if (packet->vpxcc & 0b00010000)					// extension header?
+		data += (1 + ntohs(*((uint16_t *)(data + 2)))) * sizeof(uint32_t);
 		
-		if (seq_abs == 0) {					// this is the correct sequence number
-			mai_audio_write_int(data, len);			// send this packet to jack
-			rtp_next = seq + 1;				// set next sequence number from this packet
-			
-			rob_scan();					// scan buffer to see if we have next packet already
-			continue;					// ready for next packet 
-		}
+	if ((len -= (data - packet->payload)) < 0)			// skip if no data
+		return;
 		
-		if (seq_abs > ROB_LEN) {				// this sequence is outside of buffer range
-			MAI_STAT_INC(rtp.skipped);
-			
-			rtp_next += 1;					// skip past current next sequence number
-			rob_scan();					// scan buffer to see if we have expected packet now
-			
-			if (seq == rtp_next) {				// if current packet is now ready:
-				mai_audio_write_int(data, len);		// send this packet to jack
-				rtp_next = seq + 1;			// set next sequence from this packet
-				continue;				// ready for next packet
-			}
-		}
+	MAI_STAT_INC(rtp.packets);
 		
-		size_t idx = seq % ROB_LEN;				// get reorder index from sequence number
-		rtp_used += 1;						// increment reorder use counter
+	uint16_t seq      = ntohs(packet->seq);			// get packet sequence number
+	 int16_t seq_dist = seq - rtp_next;			// distance from expected sequence
+	uint16_t seq_abs  = abs(seq_dist);			// absolute distance
+	
+	if (seq_abs > (ROB_LEN * 2)) {				// distance too far out
+		seq_abs  = 0;					// resynchronize sequence
+		rtp_used = 0;					// and drop any reorder entries
+	} else if (seq_dist < 0) {
+		return;						// skip: sequence in recent past
+	}
+	
+	if (seq_abs == 0) {					// this is the correct sequence number
+		mai_audio_write_int(data, len);			// send this packet to jack
+		rtp_next = seq + 1;				// set next sequence number from this packet
 		
-		rob[idx].seq = seq;
-		rob[idx].len = len;
-		memcpy(rob[idx].payload, data, len);			// put this packet into reorder buffer
+		rob_scan();					// scan buffer to see if we have next packet already
+		return;						// ready for next packet 
+	}
+	
+	if (seq_abs > ROB_LEN) {				// this sequence is outside of buffer range
+		MAI_STAT_INC(rtp.skipped);
+		
+		rtp_next += 1;					// skip past current next sequence number
+		rob_scan();					// scan buffer to see if we have expected packet now
 		
-		MAI_STAT_INC(rtp.reordered);
+		if (seq == rtp_next) {				// if current packet is now ready:
+			mai_audio_write_int(data, len);		// send this packet to jack
+			rtp_next = seq + 1;			// set next sequence from this packet
+			return;					// ready for next packet
+		}
 	}
 	
-	mai_debug("Unexpected Thread Exit!\n");
-	return(arg);							// should not reach here
+	size_t idx = seq % ROB_LEN;				// get reorder index from sequence number
+	rtp_used += 1;						// increment reorder use counter
+	
+	rob[idx].seq = seq;
+	rob[idx].len = len;
+	memcpy(rob[idx].payload, data, len);			// put this packet into reorder buffer
+	
+	MAI_STAT_INC(rtp.reordered);
 }
 
 /* ######################################################################## */
-static void *rtp_send(void *arg) {
-	// create an RTP packet and set the static header values
-	const size_t   paylen = rtp_samples * mai.args.channels * (mai.args.bits / 8);
-	const size_t   pktlen = sizeof(struct packet) + paylen;
-        struct packet *packet = alloca(pktlen);
-	
-	packet->vpxcc = 0b10000000;			// Version=2, P=0, X=0, CC=0
-	packet->mpt   = 96;				// M=0, PT=96
-	packet->ssrc  = lrand48();			// Set Random SSRC IV
-	
-	uint16_t seq  = lrand48() & 0xFFFF;		// Set Random Initial Sequence
-	uint64_t time;
-	
-	// loop on ringbuffer and send samples
-	for (struct timespec ts = { .tv_sec = 0, .tv_nsec = mai.args.ptime * 900 }; 1; nanosleep(&ts, NULL)) {
-		mai_audio_read_int(packet->payload, paylen);		// get packet payload
+static struct packet	*rtp_packet = NULL;		// outgoing packet, static header filled in
+static size_t		 rtp_paylen = 0;		// outgoing payload bytes
+static uint16_t		 rtp_seq    = 0;		// outgoing sequence number
+
+static void rtp_send(uint64_t count) {
+	// one packet per period expired; the audio read never blocks, so the
+	// wire cadence holds through jack underruns and a late wakeup catches up
+	for (; count; count--) {
+		mai_audio_read_int(rtp_packet->payload, rtp_paylen);	// get packet payload
 		
-		time = __sync_fetch_and_add(&rtp_clock, rtp_samples);
+		uint64_t time = __sync_fetch_and_add(&rtp_clock, rtp_samples);
 		
-		packet->time = htonl(time & 0xFFFFFFFF);
-		packet->seq  = htons(seq++);
+		rtp_packet->time = htonl(time & 0xFFFFFFFF);
+		rtp_packet->seq  = htons(rtp_seq++);
 		
-		if (send(rtp_sock, packet, pktlen, 0) <= 0)		// send packet to network
+		if (send(rtp_sock, rtp_packet, sizeof(*rtp_packet) + rtp_paylen, 0) <= 0)	// send packet to network
 			mai_error("packet send: %m\n");
 		else
 			MAI_STAT_INC(rtp.packets);
 	}
-	
-	mai_debug("Unexpected Thread Exit!\n");
-	return(arg);							// should not reach here
 }
 
 /* ######################################################################## */
-static pthread_t tid;
+static int rtp_timer = -1;
 
 int mai_rtp_init(void) {
 	// samples/packet
-	rtp_samples = (mai.args.ptime * ((mai.args.rate == 96000) ? 96000 : 48000)) / 1000000;
+	rtp_samples = ((mai.args.ptime * ((mai.args.rate == 96000) ? 96000 : 48000)) + 500000) / 1000000;
 	
 	if ((rtp_sock = mai_sock_open(mai.args.mode, mai.args.addr, mai.args.port)) <= 0)
 		return(mai_error("could not open multicast socket\n"));
@@ -174,14 +162,35 @@ int mai_rtp_init(void) {
 }
 
 int mai_rtp_start(void) {
-	if (pthread_create(&tid, NULL, (MAI_SENDER ? rtp_send : rtp_recv), NULL))
-		return(mai_error("could not start rtp thread: %m\n"));
+	if (!MAI_SENDER) {
+		if (mai_loop_add(rtp_sock, MAI_LOOP_AUDIO, rtp_recv))
+			return(mai_error("could not add rtp handler\n"));
+		return(0);
+	}
+	
+	// create an RTP packet and set the static header values
+	rtp_paylen = rtp_samples * mai.args.channels * (mai.args.bits / 8);
+	
+	if (!(rtp_packet = calloc(1, sizeof(*rtp_packet) + rtp_paylen)))
+		return(mai_error("could not allocate rtp packet\n"));
+	
+	rtp_packet->vpxcc = 0b10000000;			// Version=2, P=0, X=0, CC=0
+	rtp_packet->mpt   = 96;				// M=0, PT=96
+	rtp_packet->ssrc  = lrand48();			// Set Random SSRC IV
+	
+	rtp_seq = lrand48() & 0xFFFF;			// Set Random Initial Sequence
+	
+	// packet period from whole samples, so 333us packets keep time exactly
+	const long period = (rtp_samples * 1000000000ULL) / ((mai.args.rate == 96000) ? 96000 : 48000);
+	
+	if ((rtp_timer = mai_loop_timer(period, MAI_LOOP_AUDIO, rtp_send)) < 0)
+		return(mai_error("could not start rtp timer\n"));
 		
 	return(0);
 }
 
 int mai_rtp_stop(void) {
-	pthread_cancel(tid);
+	mai_loop_del(MAI_SENDER ? rtp_timer : rtp_sock);
 	return(0);
 }
 
@@ -191,9 +200,12 @@ uint64_t mai_rtp_clock(void) {
 }
 
 void mai_rtp_offset(int64_t offset) {
-	// if we're within -2 .. +2 packets of master clock
-	if ((offset >= -((int64_t)(rtp_samples*2))) && (offset <= (rtp_samples*2)))
+	// if we're within -2 .. +2 packets of master clock, slew an eighth
+	// of the offset so drift is followed without timestamp jumps
+	if ((offset >= -((int64_t)(rtp_samples*2))) && (offset <= (rtp_samples*2))) {
+		__sync_fetch_and_sub(&rtp_clock, offset / 8);
 		return;
+	}
 		
 	// if not, apply offset to the rtp clock
 	MAI_STAT_INC(rtp.resynced);
@@ -14,15 +14,18 @@ struct packet {
 } __attribute__((__packed__));
 
 static int      sap_sock   = -1;
-static int	sap_active =  1;
 static uint32_t sap_source =  0;
 static char     sap_addr[INET_ADDRSTRLEN];
 
+static int      sap_timer  = -1;		// 1s announcement tick
+static uint32_t sap_due    =  0;		// ticks to the next announcement
+static uint8_t  sap_buffer[2048];		// announcement packet
+static size_t   sap_pktlen =  0;
+
 /* ######################################################################## */
-void *sap(void *arg) {
-	// create packet buffer and header object
-	uint8_t		 buffer[2048];
-	struct packet	*packet = (struct packet *)buffer;
+static void sap_build(void) {
+	// header object over the packet buffer
+	struct packet	*packet = (struct packet *)sap_buffer;
 	
 	// fill in header with static ipv4 annoucement values
 	packet->vartec  = 0b00100000;
@@ -61,31 +64,25 @@ void *sap(void *arg) {
 	payload += sprintf(payload, "a=ts-refclk:ptp=IEEE1588-2008:%s\r\n", mai_ptp_source());
 	payload += sprintf(payload, "a=mediaclk:direct=0\r\n");
 	
-	size_t pktlen = sizeof(*packet) + strlen(packet->payload);
-	
-	// announce the session every 5 minutes
-	for (int lp=0; sap_active; sleep(1)) {
-		if ((lp++ % 300) != 0)
-			continue;
-			
-		if (send(sap_sock, packet, pktlen, 0) <= 0)
-			mai_error("packet send: %m\n");
-			
-		mai_debug("Sent SAP Announce Packet.\n");
+	sap_pktlen = sizeof(*packet) + strlen(packet->payload);
+}
+
+/* ######################################################################## */
+static void sap(uint64_t count) {
+	// announce the session every 5 minutes, counted in 1s ticks
+	if (sap_due > count) {
+		sap_due -= count;
+		return;
 	}
+	sap_due = 300;
 	
-	// process shutdown: try to delete the session before exit
-	packet->vartec |= 0b00000100;		// Set T=1 to remove session
-	send(sap_sock, packet, pktlen, 0);	// Send final SAP packet
-	
-	// stop thread
-	mai_debug("Sent SAP Delete Packet.\n");
-	return(arg);
+	if (send(sap_sock, sap_buffer, sap_pktlen, 0) <= 0)
+		mai_error("packet send: %m\n");
+		
+	mai_debug("Sent SAP Announce Packet.\n");
 }
 
 /* ######################################################################## */
-static pthread_t tid;
-
 int mai_sap_init() {
 	// open SAP broadcast socket
 	if ((sap_sock = mai_sock_open('s', "239.255.255.255", 9875)) < 0)
@@ -102,17 +99,26 @@ int mai_sap_init() {
 
 /* ######################################################################## */
 int mai_sap_start() {
+	// the ptp source is known by now, so the packet is built once
+	sap_build();
+	
 	// start sap broadcaster
-	if (pthread_create(&tid, NULL, sap, NULL))
-		return(mai_error("could not start sap thread: %m\n"));
+	if ((sap_timer = mai_loop_timer(1000000000L, MAI_LOOP_BACKGROUND, sap)) < 0)
+		return(mai_error("could not start sap timer\n"));
 		
 	return(0);
 }
 
 int mai_sap_stop() {
-	sap_active = 0;				// request broadcast thread to stop
-	pthread_join(tid, NULL);		// then wait for it to terminate
+	mai_loop_del(sap_timer);		// no more announcements
+	
+	// process shutdown: try to delete the session before exit
+	struct packet *packet = (struct packet *)sap_buffer;
+	
+	packet->vartec |= 0b00000100;		// Set T=1 to remove session
+	send(sap_sock, packet, sap_pktlen, 0);	// Send final SAP packet
 	
+	mai_debug("Sent SAP Delete Packet.\n");
 	return(0);
 }
 
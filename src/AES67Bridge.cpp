@@ -1,27 +1,91 @@
 // AES67Bridge.cpp Phase 2
 #include "AES67Bridge.h"
+#include "Logger.h"
 #include <iostream>
 #include <cstring>
 #include <cmath>
 #include <chrono>
+#include <algorithm>
 
 namespace aes67 {
 
+namespace {
+
+bool validBitDepth(int bits) {
+    if (bits != 16 && bits != 24 && bits != 32) {
+        std::cerr << "Invalid bit depth: " << bits << ", must be 16, 24, or 32" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool validPacketTime(int microseconds) {
+    // Check for valid AES67 packet times
+    if (microseconds != 125 && microseconds != 250 && 
+        microseconds != 333 && microseconds != 1000 && 
+        microseconds != 4000) {
+        std::cerr << "Invalid packet time: " << microseconds 
+                  << "us, must be 125, 250, 333, 1000, or 4000" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Longest AES67 packet time, sizes the audio ring
+constexpr int MAX_PACKET_TIME = 4000;
+
+// Latency the ring can hold with two of the longest packets to spare
+constexpr float MAX_LATENCY = 70.0f;
+
+// Published configs reach the receive stream within this when no packets arrive
+constexpr uint64_t CONFIG_POLL_NS = 100000000;
+
+// A run of xruns gives one trace dump, not one each
+constexpr uint64_t XRUN_DUMP_INTERVAL_NS = 10000000000ULL;
+
+} // namespace
+
 AES67Bridge::AES67Bridge() 
     : JackClient<2, 2>("aes67_bridge"), 
-      mode(Mode::Inactive),
-      bitDepth(24),
-      packetTime(1000), // 1ms default
+      discovery(reactor),
       bufferSize(0),
-      threadRunning(false),
+      minLatency(0.0f),
+      maxLatency(20.0f),
+      latencyTarget(0),
+      requestedGain(1.0f),
+      requestedMute(false),
+      requestedTarget(0.0f),
+      gain(1.0f),
+      targetGain(1.0f),
+      muted(false),
+      bufferTarget(0),
+      timestampAnchor(0),
+      anchorValid(false),
+      playoutAligned(false),
+      transmitPackets(0),
+      transmitConcealed(0),
+      transmitDropped(0),
+      transmitSlipped(0),
+      transmitResyncs(0),
+      streamTimer(-1),
+      impairedPacket(2048),
+      txPacketSamples(0),
+      lastCaptureAnchor(0),
+      wireTimestamp(0),
+      wireLocked(false),
+      wireSteps(0),
+      jackPerf(true),
+      lastXrunDump(0),
       networkActive(false),
       bufferLevel(0.0f)
 {
     // Create network components
     network = std::make_unique<NetworkManager>();
     rtp = std::make_unique<RTPHandler>();
-    ptp = std::make_unique<PTPSync>();
+    ptp = std::make_unique<PTPSync>(reactor);
     converter = std::make_unique<AudioConverter>();
+    receiver = std::make_unique<StreamReceiver>(*rtp, *converter, jitter, jackBuffer, playout, concealer, *ptp,
+                                                networkPerf);
     
     std::cout << "AES67Bridge created" << std::endl;
 }
@@ -29,47 +93,46 @@ AES67Bridge::AES67Bridge()
 AES67Bridge::~AES67Bridge() {
     // Stop networking
     stopNetworking();
+    discovery.stop();
     
     std::cout << "AES67Bridge destroyed" << std::endl;
 }
 
 void AES67Bridge::process(jack_nframes_t numFrames) {
+    PerfScope probe(jackPerf, PerfCounters::STAGE_PROCESS);
+    AES67_TRACE_SCOPE("jack cycle");
+    
+    // The config stays valid until the next cycle reads it again
+    const StreamConfig* cfg = config.read(READER_JACK);
+    
+    // Take any control changes before producing this period
+    applyCommands();
+    
+    const size_t target = playoutTarget(numFrames);
+    
+    // With a link offset and PTP lock, play each frame at its RTP timestamp
+    long error = 0;
+    bool aligned = cfg->mode == Mode::Receive && networkActive && playoutError(*cfg, error);
+    playoutAligned.store(aligned, std::memory_order_relaxed);
+    
     // In receive mode, read from network buffer and output to JACK
-    if (mode == Mode::Receive && networkActive) {
-        // Copy audio from network buffer to JACK output
-        std::lock_guard<std::mutex> lock(bufferMutex);
-        
-        // Clear output if we don't have enough samples
-        if (jackBuffer.size() < numFrames * 2) {
-            clearBuffers(numFrames);
-            return;
-        }
-        
-        // Copy samples to output
-        for (unsigned int i = 0; i < numFrames; i++) {
-            sink[0][0][i] = jackBuffer[i * 2];
-            sink[0][1][i] = jackBuffer[i * 2 + 1];
-        }
-        
-        // Remove used samples from buffer
-        jackBuffer.erase(jackBuffer.begin(), jackBuffer.begin() + numFrames * 2);
+    if (cfg->mode == Mode::Receive && networkActive) {
+        receiver->play(sink[0], numFrames, target, aligned, error);
         
         // Update buffer level
-        bufferLevel = static_cast<float>(jackBuffer.size() / 2) / static_cast<float>(bufferSize);
+        bufferLevel = static_cast<float>(jackBuffer.readable()) / static_cast<float>(bufferSize);
+        AES67_TRACE_COUNTER("buffered frames", static_cast<int64_t>(jackBuffer.readable()));
     }
     // In transmit mode, read from JACK input and send to network
-    else if (mode == Mode::Transmit && networkActive) {
-        // Copy audio from JACK input to network buffer
-        std::lock_guard<std::mutex> lock(bufferMutex);
-        
-        // Append input samples to buffer
-        for (unsigned int i = 0; i < numFrames; i++) {
-            jackBuffer.push_back(source[0][0][i]);
-            jackBuffer.push_back(source[0][1][i]);
-        }
+    else if (cfg->mode == Mode::Transmit && networkActive) {
+        // Append input samples to buffer, dropping them if the network thread has fallen behind
+        size_t position = jackBuffer.getWritePosition();
+        jackBuffer.write(source[0], numFrames);
+        noteCaptureTime(*cfg, position);
         
         // Update buffer level
-        bufferLevel = static_cast<float>(jackBuffer.size() / 2) / static_cast<float>(bufferSize);
+        bufferLevel = static_cast<float>(jackBuffer.readable()) / static_cast<float>(bufferSize);
+        AES67_TRACE_COUNTER("buffered frames", static_cast<int64_t>(jackBuffer.readable()));
         
         // If in simple pass-through mode, also copy to output
         for (unsigned int i = 0; i < numFrames; i++) {
@@ -84,29 +147,195 @@ void AES67Bridge::process(jack_nframes_t numFrames) {
             sink[0][1][i] = source[0][1][i];
         }
     }
+    
+    applyGain(numFrames);
+}
+
+void AES67Bridge::applyCommands() {
+    ControlCommand command;
+    while (commands.pop(command)) {
+        switch (command.type) {
+            case ControlCommand::Type::Gain:
+                targetGain = command.value;
+                break;
+            case ControlCommand::Type::Mute:
+                muted = command.value != 0.0f;
+                break;
+            case ControlCommand::Type::BufferTarget:
+                bufferTarget = static_cast<size_t>(command.value * sampleRate / 1000.0f);
+                break;
+        }
+    }
+}
+
+size_t AES67Bridge::playoutTarget(jack_nframes_t numFrames) {
+    size_t target = receiver->playoutTarget(numFrames, bufferTarget, minLatency.load(std::memory_order_relaxed),
+                                            maxLatency.load(std::memory_order_relaxed));
+    latencyTarget.store(target, std::memory_order_relaxed);
+    return target;
+}
+
+bool AES67Bridge::playoutError(const StreamConfig& cfg, long& error) {
+    // JACK's clock is CLOCK_MONOTONIC, the base PTPSync measures against
+    jack_nframes_t frames;
+    jack_time_t usecs;
+    jack_time_t nextUsecs;
+    float periodUsecs;
+    if (jack_get_cycle_times(client, &frames, &usecs, &nextUsecs, &periodUsecs) != 0) {
+        return false;
+    }
+    
+    return receiver->playoutError(usecs * 1000, cfg.linkOffset, cfg.mediaClockOffset, error);
+}
+
+void AES67Bridge::noteCaptureTime(const StreamConfig& cfg, size_t position) {
+    if (!ptp->hasOffset()) {
+        return;
+    }
+    
+    jack_nframes_t frames;
+    jack_time_t usecs;
+    jack_time_t nextUsecs;
+    float periodUsecs;
+    if (jack_get_cycle_times(client, &frames, &usecs, &nextUsecs, &periodUsecs) != 0) {
+        return;
+    }
+    
+    // This period's input was captured over the cycle that just ended
+    uint64_t captured = usecs - static_cast<jack_time_t>(periodUsecs);
+    uint32_t timestamp = static_cast<uint32_t>(ptp->toMasterTime(captured * 1000).rounded()) + cfg.mediaClockOffset;
+    
+    timestampAnchor.store((static_cast<uint64_t>(static_cast<uint32_t>(position)) << 32) | timestamp,
+                          std::memory_order_release);
+    anchorValid.store(true, std::memory_order_release);
+}
+
+void AES67Bridge::applyGain(jack_nframes_t numFrames) {
+    const float target = muted ? 0.0f : targetGain;
+    
+    if (gain == 1.0f && target == 1.0f) {
+        return;
+    }
+    
+    // Ramp across the period so gain and mute changes never click
+    const float step = (target - gain) / static_cast<float>(numFrames);
+    for (int ch = 0; ch < 2; ch++) {
+        float* out = sink[0][ch];
+        float g = gain;
+        for (jack_nframes_t i = 0; i < numFrames; i++) {
+            g += step;
+            out[i] *= g;
+        }
+    }
+    
+    gain = target;
+}
+
+bool AES67Bridge::setOutputGain(float value) {
+    if (!(value >= 0.0f && value <= 4.0f)) {
+        std::cerr << "Invalid gain: " << value << ", must be 0 to 4" << std::endl;
+        return false;
+    }
+    
+    requestedGain = value;
+    return commands.push({ ControlCommand::Type::Gain, value });
+}
+
+bool AES67Bridge::setMute(bool mute) {
+    requestedMute = mute;
+    return commands.push({ ControlCommand::Type::Mute, mute ? 1.0f : 0.0f });
+}
+
+bool AES67Bridge::setBufferTarget(float milliseconds) {
+    if (!(milliseconds >= 0.0f && milliseconds <= 80.0f)) {
+        std::cerr << "Invalid buffer target: " << milliseconds << "ms, must be 0 to 80" << std::endl;
+        return false;
+    }
+    
+    requestedTarget = milliseconds;
+    return commands.push({ ControlCommand::Type::BufferTarget, milliseconds });
+}
+
+bool AES67Bridge::setLatencyBounds(float minMilliseconds, float maxMilliseconds) {
+    if (!(minMilliseconds >= 0.0f && minMilliseconds <= maxMilliseconds && maxMilliseconds <= MAX_LATENCY)) {
+        std::cerr << "Invalid latency bounds: " << minMilliseconds << "-" << maxMilliseconds
+                  << "ms, must satisfy 0 <= min <= max <= " << MAX_LATENCY << std::endl;
+        return false;
+    }
+    
+    minLatency = minMilliseconds;
+    maxLatency = maxMilliseconds;
+    
+    // The network thread sizes the playout bound from the new max when it
+    // picks up the next config
+    StreamConfig next = config.get();
+    return publishConfig(next);
+}
+
+float AES67Bridge::getLatencyTarget() const {
+    return sampleRate ? latencyTarget * 1000.0f / static_cast<float>(sampleRate) : 0.0f;
+}
+
+float AES67Bridge::getJitter() const {
+    return jitter.getJitterMicros() / 1000.0f;
 }
 
 void AES67Bridge::setSampleRate(jack_nframes_t sr) {
     sampleRate = sr;
+    timeBase.setSampleRate(sr);
+    receiver->setSampleRate(sr);
     
     // Update network components
     rtp->setSampleRate(sr);
     ptp->setSampleRate(sr);
     converter->setSampleRate(sr);
+    concealer.initialize(2, sr);
+    playout.initialize(2, sr);
+    txConcealer.initialize(2, sr);
+    txAdjuster.initialize(2, sr);
+    jitter.setSampleRate(sr);
     
-    // Recalculate buffer size
-    resizeBuffers(calculatePacketSamples() * 20); // Buffer 20 packets
+    // The ring holds 20 of the longest packets so packet time can change live
+    resizeBuffers(static_cast<size_t>(MAX_PACKET_TIME) * sr / 1000000 * 20);
+    updateBufferSize(config.get());
     
     std::cout << "Sample rate set to " << sr << " Hz" << std::endl;
 }
 
+void AES67Bridge::xrun() {
+    AES67_TRACE_INSTANT("xrun", 0);
+
+    // Keep the lead-up to the first xrun of a run
+    if (Tracer::isRunning()) {
+        uint64_t now = Tracer::now();
+        if (lastXrunDump == 0 || now - lastXrunDump >= XRUN_DUMP_INTERVAL_NS) {
+            lastXrunDump = now;
+            Tracer::requestDump();
+        }
+    }
+}
+
+void AES67Bridge::threadInit() {
+    // The counter group's syscalls happen here, not in process()
+    jackPerf.openThread();
+}
+
+void AES67Bridge::processStopped() {
+    // Config changes no longer wait for a JACK period that will not come
+    config.goOffline(READER_JACK);
+}
+
 bool AES67Bridge::setNetworkAddress(const std::string& address, int port) {
-    if (networkActive) {
-        std::cerr << "Cannot change network address while networking is active" << std::endl;
+    if (port <= 0 || port > 65535) {
+        std::cerr << "Invalid port: " << port << std::endl;
         return false;
     }
     
-    return true;
+    StreamConfig next = config.get();
+    next.multicastAddress = address;
+    next.networkPort = port;
+    
+    return publishConfig(next);
 }
 
 bool AES67Bridge::setNetworkInterface(const std::string& interface) {
@@ -118,53 +347,176 @@ bool AES67Bridge::setNetworkInterface(const std::string& interface) {
     return network->setInterface(interface);
 }
 
+bool AES67Bridge::setSecondaryNetwork(const std::string& address, const std::string& interface) {
+    if (networkActive) {
+        std::cerr << "Cannot change secondary network while networking is active" << std::endl;
+        return false;
+    }
+    
+    return network->setSecondaryPath(address, interface);
+}
+
+bool AES67Bridge::configureFromSDP(const SessionDescription& description) {
+    // There is no resampler on the receive path
+    if (description.sampleRate != static_cast<uint32_t>(sampleRate)) {
+        std::cerr << "Stream '" << description.name << "' runs at " << description.sampleRate
+                  << " Hz but JACK runs at " << sampleRate << " Hz" << std::endl;
+        return false;
+    }
+    
+    if (description.port == 0 || !validBitDepth(description.bitDepth) ||
+        !validPacketTime(description.packetTime)) {
+        return false;
+    }
+    
+    // Everything changes in one step, so the stream switches over once
+    StreamConfig next = config.get();
+    next.multicastAddress = description.group;
+    next.networkPort = description.port;
+    next.bitDepth = description.bitDepth;
+    next.packetTime = description.packetTime;
+    next.payloadType = description.payloadType;
+    next.streamChannels = description.channels;
+    next.mediaClockOffset = description.mediaClockOffset;
+    
+    // Keep a map that still fits, otherwise take the first two channels (or mono on both)
+    bool mapFits = true;
+    for (uint16_t source : next.channelMap) {
+        mapFits = mapFits && source < next.streamChannels;
+    }
+    if (!mapFits) {
+        next.channelMap = { 0, static_cast<uint16_t>(next.streamChannels > 1 ? 1 : 0) };
+    }
+    
+    std::cout << "Stream '" << description.name << "': " << description.encoding << "/"
+              << description.sampleRate << "/" << description.channels << " at "
+              << description.group << ":" << description.port << ", "
+              << description.packetTime << "us packets" << std::endl;
+    if (!description.refClock.empty()) {
+        std::cout << "Stream clock: " << description.refClock
+                  << ", media clock offset " << description.mediaClockOffset << std::endl;
+    }
+    
+    return publishConfig(next);
+}
+
+bool AES67Bridge::setChannelMap(const std::vector<uint16_t>& map) {
+    // One source channel per JACK output
+    if (map.size() != 2) {
+        std::cerr << "Channel map needs one stream channel per output" << std::endl;
+        return false;
+    }
+    
+    StreamConfig next = config.get();
+    next.channelMap = map;
+    
+    return publishConfig(next);
+}
+
+bool AES67Bridge::startDiscovery() {
+    if (!startReactor()) {
+        return false;
+    }
+    return discovery.start(network->getInterface());
+}
+
+bool AES67Bridge::subscribeSession(const std::string& name, int timeoutMs) {
+    // A live transmit stream would be moved into the subscribed session
+    if (networkActive && config.get().mode == Mode::Transmit) {
+        std::cerr << "Cannot subscribe to a session while transmitting" << std::endl;
+        return false;
+    }
+    
+    if (!discovery.isActive() && !startDiscovery()) {
+        return false;
+    }
+    
+    // Announcements arrive every few seconds to minutes; wait for the one we want
+    SAPListener::Session session;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!discovery.findByName(name, session)) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            std::cerr << "Session '" << name << "' not found" << std::endl;
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    
+    std::cout << "Subscribing to session '" << name << "' at "
+              << session.group << ":" << session.port << std::endl;
+    
+    // Configure the whole receive pipeline from the announced SDP
+    SessionDescription description;
+    if (SessionDescription::parse(session.sdp, description)) {
+        return configureFromSDP(description);
+    }
+    
+    std::cerr << "Warning: session '" << name << "' has no usable format, assuming defaults" << std::endl;
+    return setNetworkAddress(session.group, session.port);
+}
+
 bool AES67Bridge::startNetworking() {
     if (networkActive) {
         std::cerr << "Networking is already active" << std::endl;
         return false;
     }
     
-    if (mode == Mode::Inactive) {
+    const StreamConfig& cfg = config.get();
+    
+    if (cfg.mode == Mode::Inactive) {
         std::cerr << "Cannot start networking in inactive mode" << std::endl;
         return false;
     }
     
-    // Initialize network components
-    // TODO: Get these from configuration
-    std::string multicastAddr = "239.69.83.133"; // Example AES67 multicast address
-    int port = 5004; // Default AES67 port
+    if (!startReactor()) {
+        std::cerr << "Failed to start the network thread" << std::endl;
+        return false;
+    }
     
     // Initialize PTP synchronization
-    if (!ptp->initialize()) {
+    if (!ptp->initialize(network->getInterface())) {
         std::cerr << "Failed to initialize PTP synchronization" << std::endl;
         return false;
     }
     
+    // Serve time ourselves if no better master turns up
+    if (ptpMaster && !ptpMaster->initialize(network->getInterface())) {
+        std::cerr << "Failed to start the PTP master" << std::endl;
+        ptp->shutdown();
+        return false;
+    }
+    
     // Initialize network
-    if (!network->initialize(multicastAddr, port)) {
+    if (!network->initialize(cfg.multicastAddress, cfg.networkPort)) {
         std::cerr << "Failed to initialize network" << std::endl;
+        if (ptpMaster) {
+            ptpMaster->shutdown();
+        }
         ptp->shutdown();
         return false;
     }
     
-    // Initialize RTP handler
-    rtp->initialize(sampleRate, 2, 96); // L24 format, stereo
-    
-    // Initialize audio converter
-    converter->initialize(sampleRate, 2, bitDepth);
-    
-    // Start network thread
-    threadRunning = true;
+    if (!configureComponents(cfg)) {
+        network->shutdown();
+        if (ptpMaster) {
+            ptpMaster->shutdown();
+        }
+        ptp->shutdown();
+        return false;
+    }
     
-    if (mode == Mode::Receive) {
-        networkThread = std::thread(&AES67Bridge::networkReceiveLoop, this);
-    } else {
-        networkThread = std::thread(&AES67Bridge::networkTransmitLoop, this);
+    // Restart the impairment sequence so every run is repeatable
+    for (auto& stage : impairment) {
+        if (stage.isEnabled()) {
+            stage.reset();
+        }
     }
     
+    attachStream(cfg.mode);
+    
     networkActive = true;
     std::cout << "AES67 networking started in " 
-              << (mode == Mode::Receive ? "receive" : "transmit") 
+              << (cfg.mode == Mode::Receive ? "receive" : "transmit") 
               << " mode" << std::endl;
     
     return true;
@@ -175,78 +527,297 @@ bool AES67Bridge::stopNetworking() {
         return true; // Already stopped
     }
     
-    // Stop network thread
-    threadRunning = false;
+    detachStream();
     
-    if (networkThread.joinable()) {
-        networkThread.join();
-    }
+    // Stop the JACK callback using the buffers before clearing them
+    networkActive = false;
     
     // Shutdown network components
     network->shutdown();
+    if (ptpMaster) {
+        ptpMaster->shutdown();
+    }
     ptp->shutdown();
     
     // Clear buffers
-    std::lock_guard<std::mutex> lock(bufferMutex);
-    jackBuffer.clear();
+    jackBuffer.reset();
     networkBuffer.clear();
+    concealer.reset();
+    playout.reset();
+    jitter.reset();
+    anchorValid = false;
+    receiver->reset();
     
-    networkActive = false;
     std::cout << "AES67 networking stopped" << std::endl;
     
+    for (int i = 0; i < network->getPathCount(); i++) {
+        if (!impairment[i].isEnabled()) {
+            continue;
+        }
+        const NetworkImpairment::Stats& stats = impairment[i].getStats();
+        std::cout << "Impairment (path " << i << "): " << stats.received << " received, "
+                  << stats.lost << " lost, " << stats.burstDropped << " burst dropped, "
+                  << stats.reordered << " reordered, " << stats.duplicated << " duplicated, "
+                  << stats.delivered << " delivered" << std::endl;
+    }
+    
+    jackPerf.print(std::cout, "JACK");
+    networkPerf.print(std::cout, "network");
+    
     return true;
 }
 
 bool AES67Bridge::setMode(bool transmit) {
-    if (networkActive) {
-        std::cerr << "Cannot change mode while networking is active" << std::endl;
+    StreamConfig next = config.get();
+    next.mode = transmit ? Mode::Transmit : Mode::Receive;
+    
+    if (!publishConfig(next)) {
         return false;
     }
     
-    mode = transmit ? Mode::Transmit : Mode::Receive;
     std::cout << "Mode set to " << (transmit ? "transmit" : "receive") << std::endl;
-    
     return true;
 }
 
 void AES67Bridge::setBitDepth(int bits) {
-    if (networkActive) {
-        std::cerr << "Cannot change bit depth while networking is active" << std::endl;
+    if (!validBitDepth(bits)) {
         return;
     }
     
-    if (bits != 16 && bits != 24 && bits != 32) {
-        std::cerr << "Invalid bit depth: " << bits << ", must be 16, 24, or 32" << std::endl;
+    StreamConfig next = config.get();
+    next.bitDepth = bits;
+    
+    if (publishConfig(next)) {
+        std::cout << "Bit depth set to " << bits << std::endl;
+    }
+}
+
+void AES67Bridge::setPacketTime(int microseconds) {
+    if (!validPacketTime(microseconds)) {
         return;
     }
     
-    bitDepth = bits;
-    converter->setBitDepth(bits);
+    StreamConfig next = config.get();
+    next.packetTime = microseconds;
     
-    std::cout << "Bit depth set to " << bits << std::endl;
+    if (publishConfig(next)) {
+        std::cout << "Packet time set to " << microseconds << "us" << std::endl;
+    }
 }
 
-void AES67Bridge::setPacketTime(int microseconds) {
-    if (networkActive) {
-        std::cerr << "Cannot change packet time while networking is active" << std::endl;
-        return;
+bool AES67Bridge::setLinkOffset(float milliseconds) {
+    if (!(milliseconds >= 0.0f && milliseconds <= MAX_LATENCY)) {
+        std::cerr << "Invalid link offset: " << milliseconds << "ms, must be 0 to " << MAX_LATENCY << std::endl;
+        return false;
     }
     
-    // Check for valid AES67 packet times
-    if (microseconds != 125 && microseconds != 250 && 
-        microseconds != 333 && microseconds != 1000 && 
-        microseconds != 4000) {
-        std::cerr << "Invalid packet time: " << microseconds 
-                  << "us, must be 125, 250, 333, 1000, or 4000" << std::endl;
+    StreamConfig next = config.get();
+    next.linkOffset = static_cast<int>(milliseconds * 1000.0f);
+    
+    if (!publishConfig(next)) {
+        return false;
+    }
+    
+    std::cout << "Link offset set to " << milliseconds << "ms" << std::endl;
+    return true;
+}
+
+bool AES67Bridge::publishConfig(const StreamConfig& next) {
+    // A copy: the published one is freed by the publishes below
+    const StreamConfig current = config.get();
+    
+    // A direction change swaps the producer and consumer of the audio ring,
+    // so the old stream handlers and the JACK callback must both let go of it
+    bool restart = networkActive && next.mode != current.mode;
+    if (restart) {
+        detachStream();
+        
+        StreamConfig* idle = new StreamConfig(current);
+        idle->mode = Mode::Inactive;
+        idle->version = current.version + 1;
+        config.publish(idle);
+        
+        jackBuffer.reset();
+        anchorValid = false;
+        receiver->reset();
+    }
+    
+    StreamConfig* value = new StreamConfig(next);
+    value->version = config.get().version + 1;
+    
+    // The JACK callback and the stream pick this up at their next period or packet
+    config.publish(value);
+    
+    if (restart) {
+        const StreamConfig& cfg = config.get();
+        if (!cfg.sameDestination(current)) {
+            network->shutdown();
+            if (!network->initialize(cfg.multicastAddress, cfg.networkPort)) {
+                std::cerr << "Failed to initialize network" << std::endl;
+            }
+        }
+        configureComponents(cfg);
+        attachStream(cfg.mode);
+    }
+    
+    return true;
+}
+
+bool AES67Bridge::configureComponents(const StreamConfig& cfg) {
+    // Initialize RTP handler, received streams use the configured layout
+    uint16_t channels = cfg.mode == Mode::Receive ? cfg.streamChannels : 2;
+    rtp->initialize(sampleRate, channels, cfg.payloadType);
+    rtp->setBytesPerSample(cfg.bitDepth / 8);
+    
+    // Hold out-of-order packets for about 4 ms whatever the packet time;
+    // under a link offset the time they are due bounds the wait instead
+    rtp->setReorderDepth(std::max(2, std::min(16, 4000 / cfg.packetTime)));
+    
+    // Initialize audio converter, the decode kernel is chosen here once
+    converter->initialize(sampleRate, 2, cfg.bitDepth);
+    if (cfg.mode == Mode::Receive &&
+        !converter->setStreamFormat(cfg.streamChannels, cfg.bitDepth, cfg.channelMap)) {
+        return false;
+    }
+    
+    // Start with an empty merge buffer
+    rtp->resetBuffer();
+    
+    return true;
+}
+
+void AES67Bridge::applyReceiveConfig(const StreamConfig& current, const StreamConfig& next) {
+    // The receiver belongs to this thread, so its bound changes here
+    updateBufferSize(next);
+    
+    bool destination = !next.sameDestination(current);
+    bool format = !next.sameFormat(current);
+    
+    if (!destination && !format) {
         return;
     }
     
-    packetTime = microseconds;
+    // Leave the old group and join the new one; PTP is untouched
+    if (destination) {
+        detachSockets();
+        network->shutdown();
+        if (!network->initialize(next.multicastAddress, next.networkPort)) {
+            AES67_LOG_ERROR("Failed to switch to %s:%d", next.multicastAddress.c_str(), next.networkPort);
+        }
+        attachSockets();
+        
+        // Packets of the old stream still held for impairment are dropped
+        for (auto& stage : impairment) {
+            if (stage.isEnabled()) {
+                stage.reset();
+            }
+        }
+        
+        // The new sender's network path has its own jitter and timeline
+        jitter.reset();
+        receiver->restart();
+    }
+    
+    if (!configureComponents(next)) {
+        AES67_LOG_ERROR("Failed to apply the new stream format");
+    }
+    
+    // Everything written from here on is the new stream
+    receiver->splice();
+    
+    AES67_LOG_INFO("Receive stream switched to %s:%d", next.multicastAddress.c_str(), next.networkPort);
+}
+
+void AES67Bridge::applyTransmitConfig(const StreamConfig& current, const StreamConfig& next) {
+    updateBufferSize(next);
+    
+    if (!next.sameDestination(current)) {
+        network->shutdown();
+        if (!network->initialize(next.multicastAddress, next.networkPort)) {
+            AES67_LOG_ERROR("Failed to switch to %s:%d", next.multicastAddress.c_str(), next.networkPort);
+        }
+    }
     
-    // Recalculate buffer size
-    resizeBuffers(calculatePacketSamples() * 20); // Buffer 20 packets
+    // RTP sequence and timestamps carry on, so receivers see one continuous stream
+    if (next.bitDepth != current.bitDepth) {
+        converter->setBitDepth(next.bitDepth);
+        rtp->setBytesPerSample(next.bitDepth / 8);
+    }
     
-    std::cout << "Packet time set to " << microseconds << "us" << std::endl;
+    AES67_LOG_INFO("Transmit stream switched to %s:%d", next.multicastAddress.c_str(), next.networkPort);
+}
+
+bool AES67Bridge::setImpairment(const NetworkImpairment::Config& impairmentConfig) {
+    if (networkActive) {
+        std::cerr << "Cannot change network impairment while networking is active" << std::endl;
+        return false;
+    }
+    
+    // Each path gets its own sequence so losses on the two networks are independent
+    for (size_t i = 0; i < impairment.size(); i++) {
+        NetworkImpairment::Config pathConfig = impairmentConfig;
+        pathConfig.seed = impairmentConfig.seed + i;
+        impairment[i].configure(pathConfig);
+    }
+    
+    if (impairmentConfig.enabled) {
+        std::cout << "Network impairment enabled (seed " << impairmentConfig.seed << ")" << std::endl;
+    }
+    
+    return true;
+}
+
+void AES67Bridge::setNetworkThreadSettings(const ThreadSettings& settings) {
+    // Applied by the network thread when it starts
+    networkThreadSettings = settings;
+}
+
+void AES67Bridge::setPTPThreadSettings(const ThreadSettings& settings) {
+    // Merged into the network thread's settings, PTP runs on it
+    ptpThreadSettings = settings;
+}
+
+void AES67Bridge::setPerfCounters(bool enable) {
+    // The network thread's counters open at its first measured stage, the
+    // JACK thread's in threadInit(), so call this before start()
+    jackPerf.setEnabled(enable);
+    networkPerf.setEnabled(enable);
+}
+
+void AES67Bridge::setPTPMaster(bool enable, uint8_t priority1) {
+    // Takes effect when networking next starts
+    if (!enable) {
+        ptpMaster.reset();
+        return;
+    }
+    if (!ptpMaster) {
+        ptpMaster = std::make_unique<PTPMaster>(reactor, ptp.get());
+    }
+    ptpMasterConfig.priority1 = priority1;
+    ptpMaster->setConfig(ptpMasterConfig);
+}
+
+void AES67Bridge::setPTPProfile(PTPProfile profile) {
+    // Takes effect when networking next starts
+    ptp->setProfile(profile);
+    ptpMasterConfig.profile = profile;
+    if (ptpMaster) {
+        ptpMaster->setConfig(ptpMasterConfig);
+    }
+}
+
+void AES67Bridge::setPTPDomain(uint8_t domain) {
+    // Takes effect when networking next starts
+    ptp->setDomain(domain);
+    ptpMasterConfig.domain = domain;
+    if (ptpMaster) {
+        ptpMaster->setConfig(ptpMasterConfig);
+    }
+}
+
+bool AES67Bridge::setPTPStateFile(const std::string& path) {
+    // Read when networking next starts
+    return ptp->setStateFile(path);
 }
 
 bool AES67Bridge::isNetworkActive() const {
@@ -265,7 +836,7 @@ int AES67Bridge::getDroppedPackets() const {
     return rtp->getDroppedPackets();
 }
 
-const std::string& AES67Bridge::getMasterClock() const {
+std::string AES67Bridge::getMasterClock() const {
     return ptp->getMasterClockId();
 }
 
@@ -273,82 +844,311 @@ bool AES67Bridge::isPTPSynchronized() const {
     return ptp->isSynchronized();
 }
 
-void AES67Bridge::networkReceiveLoop() {
-    std::vector<uint8_t> packetBuffer(2048); // Buffer for incoming packets
-    std::vector<float> audioBuffer;
-    size_t bytesReceived;
+PTPMaster::State AES67Bridge::getPTPMasterState() const {
+    return ptpMaster ? ptpMaster->getState() : PTPMaster::STATE_DISABLED;
+}
+
+uint64_t AES67Bridge::getConcealedFrames() const {
+    return concealer.getConcealedFrames();
+}
+
+bool AES67Bridge::isStreamPrimed() const {
+    if (!networkActive) {
+        return false;
+    }
+    if (config.get().mode == Mode::Transmit) {
+        return transmitPackets.load(std::memory_order_relaxed) > 0;
+    }
+    return !receiver->isPriming();
+}
+
+const NetworkImpairment::Stats& AES67Bridge::getImpairmentStats(int path) const {
+    return impairment[path].getStats();
+}
+
+bool AES67Bridge::isRedundant() const {
+    return network->isRedundant();
+}
+
+RTPHandler::PathStats AES67Bridge::getPathStats(int path) const {
+    return rtp->getPathStats(path);
+}
+
+bool AES67Bridge::startReactor() {
+    // PTP shares the network thread, which runs at the higher of the two priorities
+    ThreadSettings settings = networkThreadSettings;
+    settings.priority = std::max(networkThreadSettings.priority, ptpThreadSettings.priority);
+    if (settings.cpu < 0) {
+        settings.cpu = ptpThreadSettings.cpu;
+    }
     
-    while (threadRunning) {
-        // Receive a packet
-        if (network->receivePacket(packetBuffer.data(), packetBuffer.size(), bytesReceived)) {
-            // Process the packet
-            RTPHandler::AudioData audio;
-            if (rtp->parsePacket(packetBuffer.data(), bytesReceived, audio)) {
-                // Convert audio from network format to float
-                audioBuffer.resize(audio.frameCount * audio.channelCount);
-                converter->intToFloat(
-                    packetBuffer.data() + sizeof(RTPHandler), // Skip RTP header
-                    audioBuffer.data(),
-                    audio.frameCount
-                );
-                
-                // Add to playback buffer
-                std::lock_guard<std::mutex> lock(bufferMutex);
-                jackBuffer.insert(jackBuffer.end(), audioBuffer.begin(), audioBuffer.end());
-                
-                // Trim buffer if it's getting too large
-                if (jackBuffer.size() > bufferSize * 2) {
-                    jackBuffer.resize(bufferSize * 2);
-                }
-            }
-        }
+    return reactor.start(settings);
+}
+
+void AES67Bridge::attachStream(Mode mode) {
+    reactor.run([this, mode] {
+        applied = *config.read(READER_NETWORK);
+        updateBufferSize(applied);
         
-        // Sleep a bit to avoid busy-waiting
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    }
-}
-
-void AES67Bridge::networkTransmitLoop() {
-    size_t packetSamples = calculatePacketSamples();
-    std::vector<float> audioBuffer;
-    std::vector<uint8_t> packetBuffer;
-    RTPHandler::AudioData audio;
-    
-    while (threadRunning) {
-        // Check if we have enough samples to send a packet
-        {
-            std::lock_guard<std::mutex> lock(bufferMutex);
-            if (jackBuffer.size() >= packetSamples * 2) {
-                // Copy samples to a temporary buffer
-                audioBuffer.assign(jackBuffer.begin(), jackBuffer.begin() + packetSamples * 2);
-                
-                // Remove used samples from buffer
-                jackBuffer.erase(jackBuffer.begin(), jackBuffer.begin() + packetSamples * 2);
-            } else {
-                // Not enough samples yet
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                continue;
-            }
+        if (mode == Mode::Receive) {
+            receiver->restart();
+            attachSockets();
+            
+            // Picks up published configs and releases impaired packets
+            streamTimer = reactor.addTimer(Reactor::PRIORITY_AUDIO, Reactor::nowNs(),
+                                           [this](uint64_t now) { return receiveTimer(now); });
+            return;
         }
         
-        // Set up audio data
-        audio.samples = audioBuffer;
-        audio.channelCount = 2;
-        audio.sampleRate = sampleRate;
-        audio.frameCount = packetSamples;
+        txPacketSamples = calculatePacketSamples(applied);
+        txPeriod = timeBase.nanoseconds(static_cast<int64_t>(txPacketSamples));
         
-        // Convert audio from float to network format
-        converter->processFloatToInt(audioBuffer, networkBuffer);
+        // RTP timestamps follow PTP once the media clock has locked; the
+        // last run's rate against the same master saves most of the pull-in
+        mediaClock.setSampleRate(static_cast<uint32_t>(sampleRate));
+        mediaClock.reset();
+        mediaClock.seedRatio(ptp->getRateRatio());
+        lastCaptureAnchor = 0;
         
-        // Create an RTP packet
-        if (rtp->createPacket(audio, packetBuffer)) {
-            // Send the packet
-            network->sendPacket(packetBuffer.data(), packetBuffer.size());
+        // The wire timeline: one packet per deadline, each packetSamples on
+        // from the last, whether or not capture kept up
+        wireTimestamp = 0;
+        wireLocked = false;
+        wireSteps = 0;
+        txAdjuster.reset();
+        txConcealer.reset();
+        
+        // Absolute packet deadlines with the fraction of a nanosecond kept,
+        // so send time never accumulates as drift
+        txDeadline = FixedTime(static_cast<int64_t>(Reactor::nowNs()));
+        streamTimer = reactor.addTimer(Reactor::PRIORITY_AUDIO, static_cast<uint64_t>(txDeadline.whole),
+                                       [this](uint64_t now) { return transmitTimer(now); });
+    });
+}
+
+void AES67Bridge::detachStream() {
+    reactor.run([this] {
+        reactor.removeTimer(streamTimer);
+        streamTimer = -1;
+        detachSockets();
+        
+        config.goOffline(READER_NETWORK);
+    });
+}
+
+void AES67Bridge::attachSockets() {
+    for (int i = 0; i < network->getPathCount(); i++) {
+        int fd = network->getReceiveSocket(i);
+        if (fd >= 0) {
+            reactor.addSocket(fd, Reactor::PRIORITY_AUDIO,
+                              [this, i](const uint8_t* data, size_t size, uint64_t arrivalNs) {
+                                  receivePacket(i, data, size, arrivalNs);
+                              });
+        }
+    }
+}
+
+void AES67Bridge::detachSockets() {
+    for (int i = 0; i < network->getPathCount(); i++) {
+        int fd = network->getReceiveSocket(i);
+        if (fd >= 0) {
+            reactor.removeSocket(fd);
+        }
+    }
+}
+
+bool AES67Bridge::syncReceiveConfig() {
+    // Switch over between packets when a new config is published
+    const StreamConfig* cfg = config.read(READER_NETWORK);
+    if (cfg->version == applied.version) {
+        return false;
+    }
+    
+    bool moved = !cfg->sameDestination(applied);
+    applyReceiveConfig(applied, *cfg);
+    applied = *cfg;
+    return moved;
+}
+
+void AES67Bridge::receivePacket(int path, const uint8_t* data, size_t size, uint64_t arrivalNs) {
+    AES67_TRACE_SCOPE("receive packet");
+    
+    // Packets reaped before a switch belong to the group just left
+    if (syncReceiveConfig()) {
+        return;
+    }
+    
+    if (impairment[path].isEnabled()) {
+        // Hand the packet to the impairment stage instead of parsing it directly
+        impairment[path].submit(data, size, arrivalNs);
+        uint64_t release = impairment[path].nextReleaseTime();
+        if (release != UINT64_MAX) {
+            reactor.scheduleTimer(streamTimer, release);
+        }
+        return;
+    }
+    
+    receiver->receive(data, size, path, arrivalNs, applied.linkOffset, applied.mediaClockOffset);
+}
+
+uint64_t AES67Bridge::receiveTimer(uint64_t nowNs) {
+    syncReceiveConfig();
+    
+    // Deliver any impaired packets that are due, and wake for the next one
+    uint64_t next = nowNs + CONFIG_POLL_NS;
+    size_t bytesReceived;
+    for (int i = 0; i < network->getPathCount(); i++) {
+        if (!impairment[i].isEnabled()) {
+            continue;
         }
+        while (impairment[i].poll(impairedPacket.data(), impairedPacket.size(), bytesReceived, Reactor::nowNs())) {
+            receiver->receive(impairedPacket.data(), bytesReceived, i, Reactor::nowNs(), applied.linkOffset,
+                              applied.mediaClockOffset);
+        }
+        uint64_t release = impairment[i].nextReleaseTime();
+        if (release != UINT64_MAX) {
+            next = std::min<uint64_t>(next, release);
+        }
+    }
+    
+    return next;
+}
+
+uint64_t AES67Bridge::transmitTimer(uint64_t nowNs) {
+    AES67_TRACE_SCOPE("transmit packet");
+    
+    // Switch over between packets when a new config is published
+    const StreamConfig* cfg = config.read(READER_NETWORK);
+    if (cfg->version != applied.version) {
+        applyTransmitConfig(applied, *cfg);
+        applied = *cfg;
+        txPacketSamples = calculatePacketSamples(applied);
+        txPeriod = timeBase.nanoseconds(static_cast<int64_t>(txPacketSamples));
+    }
+    const size_t packetSamples = txPacketSamples;
+    
+    // Feed the latest capture time from the JACK thread to the media clock
+    uint64_t anchor = timestampAnchor.load(std::memory_order_acquire);
+    if (anchorValid.load(std::memory_order_acquire) && anchor != lastCaptureAnchor) {
+        mediaClock.observe(static_cast<uint32_t>(anchor >> 32), static_cast<uint32_t>(anchor));
+        lastCaptureAnchor = anchor;
+    }
+    
+    // Keep the locked rate for the next run; only changes reach the state file
+    if (mediaClock.isLocked()) {
+        ptp->setRateRatio(mediaClock.getRatio());
+    }
+    
+    // Join the PTP timeline when the clock locks, and again after it steps
+    if (mediaClock.isLocked() && (!wireLocked || mediaClock.getSteps() != wireSteps)) {
+        wireTimestamp = mediaClock.timestampAt(static_cast<uint32_t>(jackBuffer.getReadPosition()));
+        wireLocked = true;
+        wireSteps = mediaClock.getSteps();
+    }
+    
+    txLeft.resize(packetSamples);
+    txRight.resize(packetSamples);
+    float* channels[2] = { txLeft.data(), txRight.data() };
+    
+    // Real audio where capture has it, concealment where it does not
+    size_t captured = captureForPacket(channels, packetSamples, wireTimestamp);
+    txConcealer.process(channels, captured);
+    if (captured < packetSamples) {
+        float* gap[2] = { txLeft.data() + captured, txRight.data() + captured };
+        txConcealer.conceal(gap, packetSamples - captured);
+        transmitConcealed++;
+    }
+    transmitSlipped = txAdjuster.getDroppedFrames() + txAdjuster.getInsertedFrames();
+    
+    // Interleave for the converter
+    streamAudio.resize(packetSamples * 2);
+    for (size_t i = 0; i < packetSamples; i++) {
+        streamAudio[i * 2] = txLeft[i];
+        streamAudio[i * 2 + 1] = txRight[i];
+    }
+    
+    bool created;
+    {
+        PerfScope probe(networkPerf, PerfCounters::STAGE_ENCODE);
         
-        // Sleep until it's time to send the next packet
-        std::this_thread::sleep_for(std::chrono::microseconds(packetTime));
+        // Convert audio from float to network format, at the bit depth
+        // applied last
+        converter->processFloatToInt(streamAudio, networkBuffer);
+        
+        // Create an RTP packet carrying the converted samples
+        txAudio.channelCount = 2;
+        txAudio.sampleRate = sampleRate;
+        txAudio.frameCount = packetSamples;
+        txAudio.payload = networkBuffer.data();
+        txAudio.payloadSize = networkBuffer.size();
+        rtp->setTimestamp(wireTimestamp);
+        created = rtp->createPacket(txAudio, txPacket);
+    }
+    if (!created) {
+        AES67_LOG_ERROR("Transmit payload of %zu bytes does not match %zu frames at %d bits",
+                        networkBuffer.size(), packetSamples, applied.bitDepth);
+    }
+    wireTimestamp += static_cast<uint32_t>(packetSamples);
+    
+    if (created) {
+        // Send the packet
+        PerfScope probe(networkPerf, PerfCounters::STAGE_SEND);
+        network->sendPacket(txPacket.data(), txPacket.size());
+        transmitPackets++;
+    }
+    
+    // The next packet is due a period on; missed deadlines come round
+    // immediately, so a late wakeup is caught up back to back
+    txDeadline += txPeriod;
+    if (static_cast<int64_t>(nowNs) > txDeadline.whole + 1000000000LL) {
+        // Far behind (suspended or stalled), restart the schedule from now
+        txDeadline = FixedTime(static_cast<int64_t>(nowNs));
+        transmitResyncs++;
     }
+    
+    // Never woken early for it
+    return static_cast<uint64_t>(txDeadline.ceiling());
+}
+
+size_t AES67Bridge::captureForPacket(float* const* out, size_t packetSamples, uint32_t timestamp) {
+    // A backlog beyond the buffer limit is dropped outright
+    size_t queued = jackBuffer.readable();
+    if (queued > bufferSize) {
+        transmitDropped += jackBuffer.skip(queued - packetSamples * 2);
+    }
+    
+    if (!mediaClock.isLocked()) {
+        // Without PTP, hold a couple of packets queued against clock drift
+        return txAdjuster.read(jackBuffer, out, packetSamples, packetSamples * 2);
+    }
+    
+    // Capture time of the oldest queued frame against this packet's time
+    uint32_t next = mediaClock.timestampAt(static_cast<uint32_t>(jackBuffer.getReadPosition()));
+    int32_t diff = static_cast<int32_t>(next - timestamp);
+    
+    // Nothing was captured for this packet's time: an xrun or a late period
+    if (diff >= static_cast<int32_t>(packetSamples)) {
+        return 0;
+    }
+    
+    // Audio older than the wire: drop it and catch up
+    if (diff <= -static_cast<int32_t>(packetSamples)) {
+        transmitDropped += jackBuffer.skip(static_cast<size_t>(-diff));
+        diff = 0;
+    }
+    
+    // Small offsets are slipped out a frame at a time
+    return txAdjuster.readCorrected(jackBuffer, out, packetSamples, -diff);
+}
+
+AES67Bridge::TransmitStats AES67Bridge::getTransmitStats() const {
+    TransmitStats stats;
+    stats.packets = transmitPackets;
+    stats.concealed = transmitConcealed;
+    stats.droppedFrames = transmitDropped;
+    stats.slippedFrames = transmitSlipped;
+    stats.resyncs = transmitResyncs;
+    return stats;
 }
 
 void AES67Bridge::clearBuffers(size_t numFrames) {
@@ -359,19 +1159,25 @@ void AES67Bridge::clearBuffers(size_t numFrames) {
 }
 
 void AES67Bridge::resizeBuffers(size_t numFrames) {
-    std::lock_guard<std::mutex> lock(bufferMutex);
-    
-    bufferSize = numFrames;
-    jackBuffer.reserve(numFrames * 2 * 2); // Reserve space for stereo frames with some headroom
-    networkBuffer.reserve(numFrames * 2 * (bitDepth / 8) + 100); // Reserve space for packet headers
+    jackBuffer.resize(numFrames, 2); // Stereo frames, rounded up to a power of two
+    networkBuffer.reserve(numFrames * 2 * 4 + 100); // Widest samples plus packet headers
     
-    std::cout << "Buffer size set to " << numFrames << " frames (" 
-              << (numFrames * 1000 / sampleRate) << "ms)" << std::endl;
+    AES67_LOG_INFO("Buffer size set to %zu frames (%zums)", numFrames,
+                   static_cast<size_t>(numFrames * 1000 / sampleRate));
+}
+
+void AES67Bridge::updateBufferSize(const StreamConfig& cfg) {
+    // Room above the largest target, or the link offset, for the packet that is arriving
+    float milliseconds = std::max<float>(maxLatency, cfg.linkOffset / 1000.0f);
+    size_t latency = static_cast<size_t>(milliseconds * sampleRate / 1000.0f);
+    bufferSize = latency + calculatePacketSamples(cfg) * 2;
+    receiver->setBufferSize(bufferSize);
 }
 
-size_t AES67Bridge::calculatePacketSamples() const {
-    // Calculate samples per packet based on packet time and sample rate
-    return (packetTime * sampleRate) / 1000000;
+size_t AES67Bridge::calculatePacketSamples(const StreamConfig& cfg) const {
+    // Calculate samples per packet based on packet time and sample rate,
+    // rounded so 333us is the 16 frames AES67 means at 48 kHz
+    return static_cast<size_t>((cfg.packetTime * sampleRate + 500000) / 1000000);
 }
 
 } // namespace aes67
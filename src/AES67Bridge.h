@@ -5,12 +5,30 @@
 #include "NetworkManager.h"
 #include "RTPHandler.h"
 #include "PTPSync.h"
+#include "PTPMaster.h"
 #include "AudioConverter.h"
+#include "NetworkImpairment.h"
+#include "LossConcealer.h"
+#include "JitterEstimator.h"
+#include "PlayoutAdjuster.h"
+#include "StreamReceiver.h"
+#include "MediaClock.h"
+#include "Reactor.h"
+#include "TimeBase.h"
+#include "PerfCounters.h"
+#include "Tracer.h"
+#include "Realtime.h"
+#include "AudioRing.h"
+#include "SAPListener.h"
+#include "SessionDescription.h"
+#include "StreamConfig.h"
+#include "RcuCell.h"
+#include "SPSCQueue.h"
 
 #include <atomic>
-#include <mutex>
 #include <thread>
 #include <vector>
+#include <array>
 #include <memory>
 
 namespace aes67 {
@@ -24,10 +42,23 @@ public:
     // From JackClient
     void process(jack_nframes_t numFrames) override;
     void setSampleRate(jack_nframes_t sr) override;
+    void xrun() override;
+    void threadInit() override;
+    void processStopped() override;
 
     // Network configuration methods
     bool setNetworkAddress(const std::string& address, int port);
     bool setNetworkInterface(const std::string& interface);
+    bool setSecondaryNetwork(const std::string& address, const std::string& interface);
+    
+    // Receive format from an SDP, and which stream channels feed the outputs
+    bool configureFromSDP(const SessionDescription& description);
+    bool setChannelMap(const std::vector<uint16_t>& map);
+    
+    // Session discovery
+    bool startDiscovery();
+    bool subscribeSession(const std::string& name, int timeoutMs);
+    const SAPListener& getDiscovery() const { return discovery; }
     
     // Operation control
     bool startNetworking();
@@ -37,58 +68,194 @@ public:
     bool setMode(bool transmit); // true = transmit, false = receive
     void setBitDepth(int bits);
     void setPacketTime(int microseconds);
+    bool setLinkOffset(float milliseconds); // 0 plays on arrival
+    bool setImpairment(const NetworkImpairment::Config& impairmentConfig);
+    void setNetworkThreadSettings(const ThreadSettings& settings);
+    void setPTPThreadSettings(const ThreadSettings& settings);
+    void setPerfCounters(bool enable);
+    void setPTPMaster(bool enable, uint8_t priority1 = 128);  // Grandmaster when none better is present
+    void setPTPDomain(uint8_t domain);
+    void setPTPProfile(PTPProfile profile);     // UDP, Ethernet or 802.1AS
+    bool setPTPStateFile(const std::string& path);  // Master and path delay across restarts
+    const StreamConfig& getConfig() const { return config.get(); }
+    
+    // Realtime controls, queued to the JACK thread. Call from one control
+    // thread only (the OSC server once it runs).
+    bool setOutputGain(float gain);
+    bool setMute(bool mute);
+    bool setBufferTarget(float milliseconds);
+    float getOutputGain() const { return requestedGain; }
+    bool isMuted() const { return requestedMute; }
+    float getBufferTarget() const { return requestedTarget; }
+    
+    // Bounds on the adaptive playout latency, used while no buffer target is set
+    bool setLatencyBounds(float minMilliseconds, float maxMilliseconds);
+    float getLatencyTarget() const;
+    float getJitter() const;
+    bool isPlayoutAligned() const { return playoutAligned; }
     
     // Status reporting
     bool isNetworkActive() const;
     float getBufferLevel() const;
     int getPacketCount() const;
     int getDroppedPackets() const;
-    const std::string& getMasterClock() const;
+    std::string getMasterClock() const;
     bool isPTPSynchronized() const;
-
-private:
-    // Operational mode
-    enum class Mode {
-        Receive,    // Receive AES67 audio and output to JACK
-        Transmit,   // Take JACK input and transmit as AES67
-        Inactive    // Not sending or receiving
+    PTPMaster::State getPTPMasterState() const;
+    uint64_t getConcealedFrames() const;
+    bool isStreamPrimed() const;    // Playing received audio, or sending
+    const NetworkImpairment::Stats& getImpairmentStats(int path = 0) const;
+    bool isRedundant() const;
+    RTPHandler::PathStats getPathStats(int path) const;
+    
+    // Transmit timeline statistics
+    struct TransmitStats {
+        uint64_t packets;        // Packets sent
+        uint64_t concealed;      // Packets with audio the capture side never delivered
+        uint64_t droppedFrames;  // Captured frames dropped as stale or backlogged
+        uint64_t slippedFrames;  // Frames dropped or repeated to follow the timeline
+        uint64_t resyncs;        // Schedule restarts after a stall
     };
+    TransmitStats getTransmitStats() const;
 
-    // Configuration
-    Mode mode;
-    int bitDepth;
-    int packetTime;  // in microseconds
+private:
+    using Mode = StreamConfig::Mode;
+    
+    // Stream configuration, published to the JACK and network threads.
+    // Setters work on a copy and publish it; both threads switch over at
+    // their next period or packet, so changes never stop the stream.
+    enum { READER_JACK = 0, READER_NETWORK = 1 };
+    RcuCell<StreamConfig, 2> config;
+    
+    // The network thread: PTP, the stream and discovery all run on it
+    Reactor reactor;
     
     // Network components
     std::unique_ptr<NetworkManager> network;
     std::unique_ptr<RTPHandler> rtp;
     std::unique_ptr<PTPSync> ptp;
+    std::unique_ptr<PTPMaster> ptpMaster;   // Set while the software master is enabled
+    PTPMaster::Config ptpMasterConfig;
     std::unique_ptr<AudioConverter> converter;
+    std::array<NetworkImpairment, NetworkManager::MAX_PATHS> impairment;
+    LossConcealer concealer;
+    JitterEstimator jitter;
+    PlayoutAdjuster playout;
+    std::unique_ptr<StreamReceiver> receiver;   // Receive stream over the components above
+    SAPListener discovery;
     
-    // Audio processing buffer
-    std::vector<float> jackBuffer;
+    // Audio processing buffer, shared lock-free with the JACK callback
+    AudioRing jackBuffer;
     std::vector<uint8_t> networkBuffer;
-    size_t bufferSize;
-    std::mutex bufferMutex;
+    std::atomic<size_t> bufferSize;     // Frames to buffer at most, the max latency plus two packets
+    
+    // Adaptive playout latency: the measured jitter plus one period, within bounds
+    std::atomic<float> minLatency;      // Milliseconds
+    std::atomic<float> maxLatency;
+    std::atomic<size_t> latencyTarget;  // Frames, as last used by the JACK thread
     
-    // Network thread
-    std::thread networkThread;
-    std::atomic<bool> threadRunning;
+    // Commands into the JACK thread
+    struct ControlCommand {
+        enum class Type { Gain, Mute, BufferTarget };
+        Type type;
+        float value;
+    };
+    SPSCQueue<ControlCommand, 64> commands;
+    std::atomic<float> requestedGain;
+    std::atomic<bool> requestedMute;
+    std::atomic<float> requestedTarget;
+    
+    // Control state owned by the JACK thread
+    float gain;             // Gain applied at the end of the last period
+    float targetGain;
+    bool muted;
+    size_t bufferTarget;    // Fixed playout depth in frames, 0 for adaptive
+    
+    // Nanoseconds and samples at the JACK rate, set with it
+    TimeBase timeBase;
+    
+    // RTP time of captured audio for the transmit media clock: the RTP
+    // timestamp of the latest period captured and the ring position it went
+    // to, packed as (position << 32) | timestamp
+    std::atomic<uint64_t> timestampAnchor;
+    std::atomic<bool> anchorValid;
+    std::atomic<bool> playoutAligned;   // The JACK thread is following PTP time
+    
+    // Transmit timeline, owned by the network thread
+    MediaClock mediaClock;
+    PlayoutAdjuster txAdjuster;
+    LossConcealer txConcealer;
+    std::atomic<uint64_t> transmitPackets;
+    std::atomic<uint64_t> transmitConcealed;
+    std::atomic<uint64_t> transmitDropped;
+    std::atomic<uint64_t> transmitSlipped;
+    std::atomic<uint64_t> transmitResyncs;
+    
+    // Stream state, owned by the network thread while a stream is attached
+    StreamConfig applied;               // Config the stream last switched to
+    int streamTimer;                    // Receive housekeeping or transmit cadence
+    std::vector<uint8_t> impairedPacket;
+    std::vector<float> streamAudio;
+    std::vector<float> txLeft;
+    std::vector<float> txRight;
+    std::vector<uint8_t> txPacket;
+    RTPHandler::AudioData txAudio;
+    size_t txPacketSamples;
+    FixedTime txPeriod;                 // Nanoseconds, with the fraction kept
+    FixedTime txDeadline;               // Next packet, CLOCK_MONOTONIC nanoseconds
+    uint64_t lastCaptureAnchor;
+    uint32_t wireTimestamp;             // The wire timeline: packetSamples per packet
+    bool wireLocked;
+    uint64_t wireSteps;
+    
+    // Network thread scheduling; PTP handling shares the thread
+    ThreadSettings networkThreadSettings;
+    ThreadSettings ptpThreadSettings;
+    
+    // Hardware counters per stage, reported when networking stops; the
+    // JACK thread's are opened before it runs and read without syscalls
+    PerfCounters jackPerf;
+    PerfCounters networkPerf;
+    
+    // Last trace dump taken for an xrun, on JACK's notification thread
+    uint64_t lastXrunDump;
     
     // Status
     std::atomic<bool> networkActive;
     std::atomic<float> bufferLevel;
     
-    // Network processing
-    void networkReceiveLoop();
-    void networkTransmitLoop();
+    // Configuration changes
+    bool publishConfig(const StreamConfig& next);
+    bool configureComponents(const StreamConfig& cfg);
+    void applyReceiveConfig(const StreamConfig& current, const StreamConfig& next);
+    void applyTransmitConfig(const StreamConfig& current, const StreamConfig& next);
+    
+    // Network processing, on the reactor thread
+    bool startReactor();
+    void attachStream(Mode mode);
+    void detachStream();
+    void attachSockets();
+    void detachSockets();
+    bool syncReceiveConfig();
+    void receivePacket(int path, const uint8_t* data, size_t size, uint64_t arrivalNs);
+    uint64_t receiveTimer(uint64_t nowNs);
+    uint64_t transmitTimer(uint64_t nowNs);
+    size_t captureForPacket(float* const* out, size_t packetSamples, uint32_t timestamp);
+    
+    // JACK thread helpers
+    void applyCommands();
+    void applyGain(jack_nframes_t numFrames);
+    size_t playoutTarget(jack_nframes_t numFrames);
+    bool playoutError(const StreamConfig& cfg, long& error);
+    void noteCaptureTime(const StreamConfig& cfg, size_t position);
     
     // Buffer management
     void clearBuffers(size_t numFrames);
     void resizeBuffers(size_t numFrames);
+    void updateBufferSize(const StreamConfig& cfg);   // On the network thread once networking runs
     
     // Helper functions
-    size_t calculatePacketSamples() const;
+    size_t calculatePacketSamples(const StreamConfig& cfg) const;
 };
 
 } // namespace aes67
@@ -10,7 +10,8 @@ namespace aes67 {
 AudioConverter::AudioConverter()
     : sampleRate(48000), channelCount(2), bitDepth(24),
       maxIntValue(8388607.0f), minIntValue(-8388608.0f),
-      ditherScale(4.0f / 8388607.0f), bytesPerSample(3)
+      ditherScale(4.0f / 8388607.0f), bytesPerSample(3),
+      decodeKernel(nullptr), streamChannels(2), streamBytes(3), channelMap{0, 1}
 {
     // Initialize dither states
     ditherStates.resize(channelCount);
@@ -20,6 +21,8 @@ AudioConverter::AudioConverter()
         state.errorPrev2 = 0.0f;
         state.random = 0.0f;
     }
+    
+    selectDecoder();
 }
 
 AudioConverter::~AudioConverter() {
@@ -47,6 +50,14 @@ void AudioConverter::setChannelCount(uint16_t channels) {
         state.errorPrev2 = 0.0f;
         state.random = 0.0f;
     }
+    
+    // Receive the same layout until a stream format says otherwise
+    streamChannels = channelCount;
+    channelMap.resize(channelCount);
+    for (uint16_t ch = 0; ch < channelCount; ch++) {
+        channelMap[ch] = ch;
+    }
+    selectDecoder();
 }
 
 void AudioConverter::setBitDepth(uint16_t bits) {
@@ -81,6 +92,112 @@ void AudioConverter::setBitDepth(uint16_t bits) {
             bytesPerSample = 3;
             break;
     }
+    
+    streamBytes = static_cast<uint16_t>(bytesPerSample);
+    selectDecoder();
+}
+
+bool AudioConverter::setStreamFormat(uint16_t channels, uint16_t bits, const std::vector<uint16_t>& map) {
+    if (bits != 16 && bits != 24 && bits != 32) {
+        std::cerr << "Unsupported stream bit depth: " << bits << std::endl;
+        return false;
+    }
+    
+    if (channels == 0 || map.empty()) {
+        std::cerr << "Invalid stream channel layout" << std::endl;
+        return false;
+    }
+    
+    for (uint16_t source : map) {
+        if (source >= channels) {
+            std::cerr << "Channel map refers to channel " << (source + 1)
+                      << " of a " << channels << " channel stream" << std::endl;
+            return false;
+        }
+    }
+    
+    streamChannels = channels;
+    streamBytes = bits / 8;
+    channelMap = map;
+    selectDecoder();
+    
+    return true;
+}
+
+void AudioConverter::selectDecoder() {
+    // Stereo outputs fed from the first two stream channels are by far the
+    // common case and get a kernel without the map lookup
+    bool stereo = channelMap.size() == 2 && channelMap[0] == 0 && channelMap[1] == 1;
+    
+    switch (streamBytes) {
+        case 2:
+            decodeKernel = stereo ? &decodeStereo<2> : &decodeMapped<2>;
+            break;
+        case 4:
+            decodeKernel = stereo ? &decodeStereo<4> : &decodeMapped<4>;
+            break;
+        default:
+            decodeKernel = stereo ? &decodeStereo<3> : &decodeMapped<3>;
+            break;
+    }
+}
+
+namespace {
+
+// Big-endian sample of Bytes bytes, scaled to [-1, 1)
+template<int Bytes>
+inline float decodeSample(const uint8_t* src);
+
+template<>
+inline float decodeSample<2>(const uint8_t* src) {
+    return static_cast<float>(static_cast<int16_t>((src[0] << 8) | src[1])) * (1.0f / 32768.0f);
+}
+
+template<>
+inline float decodeSample<3>(const uint8_t* src) {
+    // Build in the top of a 32-bit word so the sign comes for free
+    int32_t value = static_cast<int32_t>((static_cast<uint32_t>(src[0]) << 24) |
+                                         (static_cast<uint32_t>(src[1]) << 16) |
+                                         (static_cast<uint32_t>(src[2]) << 8));
+    return static_cast<float>(value) * (1.0f / 2147483648.0f);
+}
+
+template<>
+inline float decodeSample<4>(const uint8_t* src) {
+    int32_t value = static_cast<int32_t>((static_cast<uint32_t>(src[0]) << 24) |
+                                         (static_cast<uint32_t>(src[1]) << 16) |
+                                         (static_cast<uint32_t>(src[2]) << 8) |
+                                         static_cast<uint32_t>(src[3]));
+    return static_cast<float>(value) * (1.0f / 2147483648.0f);
+}
+
+} // namespace
+
+template<int Bytes>
+void AudioConverter::decodeMapped(const uint8_t* input, float* output, size_t frameCount,
+                                  size_t streamChannels, const uint16_t* map, size_t outputChannels) {
+    const size_t stride = streamChannels * Bytes;
+    for (size_t frame = 0; frame < frameCount; frame++) {
+        const uint8_t* src = input + frame * stride;
+        for (size_t ch = 0; ch < outputChannels; ch++) {
+            output[ch] = decodeSample<Bytes>(src + map[ch] * Bytes);
+        }
+        output += outputChannels;
+    }
+}
+
+template<int Bytes>
+void AudioConverter::decodeStereo(const uint8_t* input, float* output, size_t frameCount,
+                                  size_t streamChannels, const uint16_t* map, size_t outputChannels) {
+    (void)map;
+    (void)outputChannels;
+    const size_t stride = streamChannels * Bytes;
+    for (size_t frame = 0; frame < frameCount; frame++) {
+        const uint8_t* src = input + frame * stride;
+        output[0] = decodeSample<Bytes>(src);
+        output[1] = decodeSample<Bytes>(src + Bytes);
+        output += 2;
+    }
 }
 
 void AudioConverter::floatToInt(const float* input, uint8_t* output, size_t frameCount) {
@@ -148,46 +265,7 @@ void AudioConverter::floatToInt(const float* input, uint8_t* output, size_t fram
 }
 
 void AudioConverter::intToFloat(const uint8_t* input, float* output, size_t frameCount) {
-    for (size_t frame = 0; frame < frameCount; frame++) {
-        for (size_t channel = 0; channel < channelCount; channel++) {
-            const uint8_t* src = input + (frame * channelCount + channel) * bytesPerSample;
-            
-            // Convert from bytes to integer
-            int32_t value = 0;
-            
-            switch (bitDepth) {
-                case 16: {
-                    int16_t sample = static_cast<int16_t>((src[0] << 8) | src[1]);
-                    value = sample;
-                    break;
-                }
-                case 24: {
-                    // Sign extend 24-bit to 32-bit
-                    if (src[0] & 0x80) {
-                        value = 0xFF000000 | (src[0] << 16) | (src[1] << 8) | src[2];
-                    } else {
-                        value = (src[0] << 16) | (src[1] << 8) | src[2];
-                    }
-                    break;
-                }
-                case 32:
-                    value = (src[0] << 24) | (src[1] << 16) | (src[2] << 8) | src[3];
-                    break;
-            }
-            
-            // Convert to float
-            float sample = static_cast<float>(value) / maxIntValue;
-            
-            // Clip
-            if (sample > 1.0f) {
-                sample = 1.0f;
-            } else if (sample < -1.0f) {
-                sample = -1.0f;
-            }
-            
-            output[frame * channelCount + channel] = sample;
-        }
-    }
+    decodeKernel(input, output, frameCount, streamChannels, channelMap.data(), channelMap.size());
 }
 
 void AudioConverter::processFloatToInt(const std::vector<float>& input, std::vector<uint8_t>& output) {
@@ -208,8 +286,8 @@ void AudioConverter::processIntToFloat(const std::vector<uint8_t>& input, std::v
         return;
     }
     
-    size_t frameCount = input.size() / (channelCount * bytesPerSample);
-    output.resize(frameCount * channelCount);
+    size_t frameCount = input.size() / (streamChannels * streamBytes);
+    output.resize(frameCount * channelMap.size());
     
     intToFloat(input.data(), output.data(), frameCount);
 }
@@ -2,6 +2,7 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 #include <vector>
 
 namespace aes67 {
@@ -17,11 +18,18 @@ public:
     void setChannelCount(uint16_t channels);
     void setBitDepth(uint16_t bits);
     
+    // Receive format: stream channel count, sample size and which stream
+    // channel feeds each output. Selects the decode kernel once.
+    bool setStreamFormat(uint16_t streamChannels, uint16_t bits, const std::vector<uint16_t>& channelMap);
+    uint16_t getStreamChannels() const { return streamChannels; }
+    uint16_t getOutputChannels() const { return static_cast<uint16_t>(channelMap.size()); }
+    
     // Conversion functions
     // Convert from float to integer (JACK to AES67)
     void floatToInt(const float* input, uint8_t* output, size_t frameCount);
     
-    // Convert from integer to float (AES67 to JACK)
+    // Convert from integer to float (AES67 to JACK), output has one sample
+    // per mapped channel
     void intToFloat(const uint8_t* input, float* output, size_t frameCount);
     
     // Batch processing
@@ -49,6 +57,22 @@ private:
     };
     std::vector<DitherState> ditherStates;
     
+    // Decode kernel for the current receive format
+    typedef void (*DecodeKernel)(const uint8_t* input, float* output, size_t frameCount,
+                                 size_t streamChannels, const uint16_t* map, size_t outputChannels);
+    DecodeKernel decodeKernel;
+    uint16_t streamChannels;
+    uint16_t streamBytes;
+    std::vector<uint16_t> channelMap;
+    
+    template<int Bytes>
+    static void decodeMapped(const uint8_t* input, float* output, size_t frameCount,
+                             size_t streamChannels, const uint16_t* map, size_t outputChannels);
+    template<int Bytes>
+    static void decodeStereo(const uint8_t* input, float* output, size_t frameCount,
+                             size_t streamChannels, const uint16_t* map, size_t outputChannels);
+    void selectDecoder();
+    
     // Helper functions
     float convertIntToFloat(const uint8_t* input);
     void convertFloatToInt(float sample, uint8_t* output, DitherState& dither);
@@ -0,0 +1,137 @@
+// AudioRing.cpp
+#include "AudioRing.h"
+#include <algorithm>
+
+namespace aes67 {
+
+AudioRing::AudioRing()
+    : channelCount(0), capacity(0), mask(0), readPos(0), writePos(0)
+{
+}
+
+AudioRing::~AudioRing() {
+    // Nothing specific to clean up
+}
+
+void AudioRing::resize(size_t frames, uint16_t channels) {
+    // Round up to a power of two so positions wrap with a mask
+    size_t size = 1;
+    while (size < frames) {
+        size <<= 1;
+    }
+
+    channelCount = channels;
+    capacity = size;
+    mask = size - 1;
+    data.assign(capacity * channelCount, 0.0f);
+
+    reset();
+}
+
+void AudioRing::reset() {
+    readPos.store(0, std::memory_order_relaxed);
+    writePos.store(0, std::memory_order_release);
+}
+
+size_t AudioRing::readable() const {
+    return writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_acquire);
+}
+
+size_t AudioRing::writable() const {
+    return capacity - readable();
+}
+
+size_t AudioRing::write(const float* const* channels, size_t frames) {
+    const size_t w = writePos.load(std::memory_order_relaxed);
+    const size_t r = readPos.load(std::memory_order_acquire);
+    const size_t n = std::min(frames, capacity - (w - r));
+
+    for (size_t i = 0; i < n; i++) {
+        float* frame = &data[((w + i) & mask) * channelCount];
+        for (uint16_t ch = 0; ch < channelCount; ch++) {
+            frame[ch] = channels[ch][i];
+        }
+    }
+
+    writePos.store(w + n, std::memory_order_release);
+    return n;
+}
+
+size_t AudioRing::writeInterleaved(const float* input, size_t frames) {
+    const size_t w = writePos.load(std::memory_order_relaxed);
+    const size_t r = readPos.load(std::memory_order_acquire);
+    const size_t n = std::min(frames, capacity - (w - r));
+    if (n == 0) {
+        return 0;
+    }
+
+    // At most two contiguous runs, split where the ring wraps
+    const size_t start = w & mask;
+    const size_t first = std::min(n, capacity - start);
+    std::copy(input, input + first * channelCount, &data[start * channelCount]);
+    std::copy(input + first * channelCount, input + n * channelCount, data.begin());
+
+    writePos.store(w + n, std::memory_order_release);
+    return n;
+}
+
+size_t AudioRing::writeSilence(size_t frames) {
+    const size_t w = writePos.load(std::memory_order_relaxed);
+    const size_t r = readPos.load(std::memory_order_acquire);
+    const size_t n = std::min(frames, capacity - (w - r));
+    if (n == 0) {
+        return 0;
+    }
+
+    const size_t start = w & mask;
+    const size_t first = std::min(n, capacity - start);
+    std::fill(&data[start * channelCount], &data[start * channelCount] + first * channelCount, 0.0f);
+    std::fill(data.begin(), data.begin() + (n - first) * channelCount, 0.0f);
+
+    writePos.store(w + n, std::memory_order_release);
+    return n;
+}
+
+size_t AudioRing::read(float* const* channels, size_t frames) {
+    const size_t r = readPos.load(std::memory_order_relaxed);
+    const size_t w = writePos.load(std::memory_order_acquire);
+    const size_t n = std::min(frames, w - r);
+
+    for (size_t i = 0; i < n; i++) {
+        const float* frame = &data[((r + i) & mask) * channelCount];
+        for (uint16_t ch = 0; ch < channelCount; ch++) {
+            channels[ch][i] = frame[ch];
+        }
+    }
+
+    readPos.store(r + n, std::memory_order_release);
+    return n;
+}
+
+size_t AudioRing::skip(size_t frames) {
+    const size_t r = readPos.load(std::memory_order_relaxed);
+    const size_t w = writePos.load(std::memory_order_acquire);
+    const size_t n = std::min(frames, w - r);
+
+    readPos.store(r + n, std::memory_order_release);
+    return n;
+}
+
+size_t AudioRing::readInterleaved(float* output, size_t frames) {
+    const size_t r = readPos.load(std::memory_order_relaxed);
+    const size_t w = writePos.load(std::memory_order_acquire);
+    const size_t n = std::min(frames, w - r);
+    if (n == 0) {
+        return 0;
+    }
+
+    const size_t start = r & mask;
+    const size_t first = std::min(n, capacity - start);
+    std::copy(&data[start * channelCount], &data[start * channelCount] + first * channelCount, output);
+    std::copy(data.begin(), data.begin() + (n - first) * channelCount, output + first * channelCount);
+
+    readPos.store(r + n, std::memory_order_release);
+    return n;
+}
+
+} // namespace aes67
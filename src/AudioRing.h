@@ -0,0 +1,56 @@
+// AudioRing.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <vector>
+
+namespace aes67 {
+
+// Single-producer, single-consumer ring of interleaved audio frames.
+//
+// One side is the JACK callback and the other is the network thread. Reads
+// and writes never lock or allocate; the producer only moves the write
+// index and the consumer only moves the read index. resize() and reset()
+// must not run while either side is active.
+class AudioRing {
+public:
+    AudioRing();
+    ~AudioRing();
+
+    // Configuration (not RT-safe, allocates)
+    void resize(size_t frames, uint16_t channels);
+    void reset();
+
+    // Producer side, returns the number of frames written
+    size_t write(const float* const* channels, size_t frames);
+    size_t writeInterleaved(const float* input, size_t frames);
+    size_t writeSilence(size_t frames);
+
+    // Consumer side, returns the number of frames read
+    size_t read(float* const* channels, size_t frames);
+    size_t readInterleaved(float* output, size_t frames);
+    size_t skip(size_t frames);
+
+    // Status
+    size_t readable() const;
+    size_t writable() const;
+    size_t getCapacity() const { return capacity; }
+
+    // Total frames read and written since the last reset
+    size_t getReadPosition() const { return readPos.load(std::memory_order_acquire); }
+    size_t getWritePosition() const { return writePos.load(std::memory_order_acquire); }
+
+private:
+    std::vector<float> data;
+    uint16_t channelCount;
+    size_t capacity;   // frames, a power of two
+    size_t mask;
+
+    // Free-running frame counters, wrapped with the mask on access
+    std::atomic<size_t> readPos;
+    std::atomic<size_t> writePos;
+};
+
+} // namespace aes67
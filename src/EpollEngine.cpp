@@ -0,0 +1,158 @@
+// EpollEngine.cpp
+#include "EpollEngine.h"
+#include "Logger.h"
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+
+namespace aes67 {
+
+constexpr int EpollEngine::MAX_EVENTS;
+constexpr int EpollEngine::BATCH;
+
+EpollEngine::EpollEngine()
+    : epollFd(-1), readyCount(0), readyPos(0),
+      storage(BATCH * BUFFER_SIZE), batchCount(0), batchPos(0), batchTag(0), batchFd(-1)
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        std::cerr << "Failed to create epoll instance: " << strerror(errno) << std::endl;
+    }
+
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < BATCH; i++) {
+        iov[i].iov_base = storage.data() + i * BUFFER_SIZE;
+        iov[i].iov_len = BUFFER_SIZE;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+EpollEngine::~EpollEngine() {
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+}
+
+bool EpollEngine::addSocket(int fd, int tag) {
+    // Level triggered: a socket left with data is simply reported again
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u64 = (static_cast<uint64_t>(static_cast<uint32_t>(tag)) << 32) | static_cast<uint32_t>(fd);
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        std::cerr << "Failed to add socket to epoll: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void EpollEngine::removeSocket(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+
+    // Forget what was already reaped from this socket; packets and ready
+    // reports for the others are still delivered
+    if (batchFd == fd) {
+        batchCount = batchPos = 0;
+        batchFd = -1;
+    }
+
+    int kept = readyPos;
+    for (int i = readyPos; i < readyCount; i++) {
+        if (static_cast<int>(events[i].data.u64 & 0xFFFFFFFF) != fd) {
+            events[kept++] = events[i];
+        }
+    }
+    readyCount = kept;
+}
+
+bool EpollEngine::wait(int64_t timeoutUs) {
+    if (batchPos < batchCount || readyPos < readyCount) {
+        return true;
+    }
+    return poll(timeoutUs);
+}
+
+bool EpollEngine::poll(int64_t timeoutUs) {
+    // ppoll on the epoll descriptor gives a microsecond timeout
+    if (timeoutUs != 0) {
+        struct pollfd pfd;
+        pfd.fd = epollFd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        struct timespec timeout;
+        timeout.tv_sec = timeoutUs / 1000000;
+        timeout.tv_nsec = (timeoutUs % 1000000) * 1000;
+
+        int ready = ppoll(&pfd, 1, timeoutUs < 0 ? nullptr : &timeout, nullptr);
+        if (ready <= 0) {
+            if (ready < 0 && errno != EINTR) {
+                AES67_LOG_ERROR("Failed to poll sockets: %s", strerror(errno));
+            }
+            return false;
+        }
+    }
+
+    int count = epoll_wait(epollFd, events, MAX_EVENTS, 0);
+    readyCount = count > 0 ? count : 0;
+    readyPos = 0;
+    return readyCount > 0;
+}
+
+bool EpollEngine::receiveBatch() {
+    while (readyPos < readyCount) {
+        const uint64_t data = events[readyPos].data.u64;
+        const int fd = static_cast<int>(data & 0xFFFFFFFF);
+
+        int count = recvmmsg(fd, msgs, BATCH, MSG_DONTWAIT, nullptr);
+        if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            AES67_LOG_ERROR("Failed to receive packets: %s", strerror(errno));
+        }
+
+        // A full batch may have left more behind; stay on this socket
+        if (count < BATCH) {
+            readyPos++;
+        }
+
+        if (count > 0) {
+            batchCount = count;
+            batchPos = 0;
+            batchTag = static_cast<int32_t>(data >> 32);
+            batchFd = fd;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool EpollEngine::next(Packet& packet) {
+    if (batchPos >= batchCount && !receiveBatch()) {
+        // Everything reported has been drained; look once more without waiting
+        if (!poll(0) || !receiveBatch()) {
+            return false;
+        }
+    }
+
+    packet.tag = batchTag;
+    packet.data = static_cast<const uint8_t*>(iov[batchPos].iov_base);
+    packet.size = msgs[batchPos].msg_len;
+    packet.buffer = static_cast<uint32_t>(batchPos);
+    batchPos++;
+    return true;
+}
+
+void EpollEngine::release(const Packet&) {
+    // Batch storage is reused by the next recvmmsg
+}
+
+bool EpollEngine::send(int fd, const void* data, size_t size, const struct sockaddr_in* dest) {
+    ssize_t sent = sendto(fd, data, size, MSG_DONTWAIT,
+                          reinterpret_cast<const struct sockaddr*>(dest), dest ? sizeof(*dest) : 0);
+    return sent == static_cast<ssize_t>(size);
+}
+
+} // namespace aes67
@@ -0,0 +1,57 @@
+// EpollEngine.h
+#pragma once
+
+#include "IOEngine.h"
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+namespace aes67 {
+
+// IOEngine backend for kernels without multishot io_uring receive.
+// Ready sockets come from epoll and each is drained in batches with
+// recvmmsg; sends go straight out with sendto.
+class EpollEngine : public IOEngine {
+public:
+    EpollEngine();
+    ~EpollEngine() override;
+
+    bool addSocket(int fd, int tag) override;
+    void removeSocket(int fd) override;
+
+    bool wait(int64_t timeoutUs) override;
+    bool next(Packet& packet) override;
+    void release(const Packet& packet) override;
+
+    bool send(int fd, const void* data, size_t size, const struct sockaddr_in* dest = nullptr) override;
+
+    const char* getName() const override { return "epoll"; }
+    uint64_t getSendErrors() const override { return 0; }
+    uint64_t getOverruns() const override { return 0; }
+
+private:
+    static constexpr int MAX_EVENTS = 16;
+    static constexpr int BATCH = 32;
+
+    int epollFd;
+
+    // Sockets reported ready and not yet drained
+    struct epoll_event events[MAX_EVENTS];
+    int readyCount;
+    int readyPos;
+
+    // Packets from the last recvmmsg
+    struct mmsghdr msgs[BATCH];
+    struct iovec iov[BATCH];
+    std::vector<uint8_t> storage;
+    int batchCount;
+    int batchPos;
+    int batchTag;
+    int batchFd;
+
+    // Helper functions
+    bool poll(int64_t timeoutUs);
+    bool receiveBatch();
+};
+
+} // namespace aes67
@@ -0,0 +1,58 @@
+// IOEngine.cpp
+#include "IOEngine.h"
+#include "UringEngine.h"
+#include "EpollEngine.h"
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+namespace aes67 {
+
+constexpr size_t IOEngine::BUFFER_SIZE;
+
+static std::atomic<IOEngine::Backend> defaultBackend(IOEngine::Backend::Auto);
+static std::atomic<bool> reported(false);
+
+std::unique_ptr<IOEngine> IOEngine::create(Backend backend) {
+    if (backend == Backend::Auto) {
+        backend = defaultBackend.load();
+    }
+
+    std::unique_ptr<IOEngine> engine;
+    if (backend != Backend::Epoll) {
+        engine = UringEngine::create();
+        if (!engine && backend == Backend::IoUring) {
+            std::cerr << "io_uring unavailable, using epoll" << std::endl;
+        }
+    }
+
+    if (!engine) {
+        engine.reset(new EpollEngine());
+    }
+
+    // Every thread makes its own engine; say which backend once
+    if (!reported.exchange(true)) {
+        std::cout << "Network I/O: " << engine->getName() << std::endl;
+    }
+
+    return engine;
+}
+
+void IOEngine::setDefaultBackend(Backend backend) {
+    defaultBackend = backend;
+}
+
+bool IOEngine::parseBackend(const char* name, Backend& backend) {
+    if (strcmp(name, "auto") == 0) {
+        backend = Backend::Auto;
+    } else if (strcmp(name, "io_uring") == 0 || strcmp(name, "uring") == 0) {
+        backend = Backend::IoUring;
+    } else if (strcmp(name, "epoll") == 0) {
+        backend = Backend::Epoll;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace aes67
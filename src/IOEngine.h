@@ -0,0 +1,74 @@
+// IOEngine.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <netinet/in.h>
+
+namespace aes67 {
+
+// Batched datagram I/O for the network threads.
+//
+// Sockets are registered once and received packets are then reaped in
+// batches, so a burst of packets costs one wakeup instead of a poll and a
+// recv per packet. Two backends implement it: io_uring, which keeps a
+// multishot receive armed on every socket filling a ring of provided
+// buffers and transmits from registered buffers, and epoll, which drains
+// each ready socket with recvmmsg. io_uring needs Linux 6.0; older kernels
+// get epoll.
+//
+// An engine belongs to one thread at a time; each receiving thread creates
+// its own.
+class IOEngine {
+public:
+    enum class Backend {
+        Auto,       // io_uring where the kernel supports it, otherwise epoll
+        IoUring,
+        Epoll
+    };
+
+    // A received datagram. data stays valid until release().
+    struct Packet {
+        int tag;                // Tag given to addSocket()
+        const uint8_t* data;
+        size_t size;
+        uint32_t buffer;        // Backend buffer holding the data
+    };
+
+    // Largest datagram received or sent
+    static constexpr size_t BUFFER_SIZE = 2048;
+
+    virtual ~IOEngine() {}
+
+    // Create an engine, falling back to epoll if io_uring is unavailable.
+    // Auto uses the process default set below.
+    static std::unique_ptr<IOEngine> create(Backend backend = Backend::Auto);
+    static void setDefaultBackend(Backend backend);
+    static bool parseBackend(const char* name, Backend& backend);
+
+    // Sockets to receive from; the caller keeps ownership of the descriptor
+    // and must remove it before closing it
+    virtual bool addSocket(int fd, int tag) = 0;
+    virtual void removeSocket(int fd) = 0;
+
+    // Wait until packets are ready or timeoutUs passes (negative waits
+    // forever). Returns at once, without a syscall, while packets remain.
+    virtual bool wait(int64_t timeoutUs) = 0;
+
+    // Take the next ready packet without blocking. Release each packet
+    // before taking the next.
+    virtual bool next(Packet& packet) = 0;
+    virtual void release(const Packet& packet) = 0;
+
+    // Queue a datagram to dest (or the connected peer when null). The data
+    // is copied, so the caller's buffer can be reused at once.
+    virtual bool send(int fd, const void* data, size_t size, const struct sockaddr_in* dest = nullptr) = 0;
+
+    // Status
+    virtual const char* getName() const = 0;
+    virtual uint64_t getSendErrors() const = 0;     // Failures reported after send() returned
+    virtual uint64_t getOverruns() const = 0;       // Times receive buffers ran out
+};
+
+} // namespace aes67
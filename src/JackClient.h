@@ -10,6 +10,8 @@
 
 #include <jack/jack.h>
 
+#include "RTCheck.h"
+
 namespace aes67 {
 
 template<int NumIns, int NumOuts>
@@ -52,15 +54,36 @@ private:
 
     virtual void setSampleRate(jack_nframes_t sr) = 0;
 
+    // Called from JACK's notification thread after an xrun, not in process()
+    virtual void xrun() {}
+
+    // Called on the process thread once, before its first process()
+    virtual void threadInit() {}
+
+    // Called once JACK no longer calls process(), after deactivating
+    virtual void processStopped() {}
+
 private:
     // Static handlers for JACK API
     static int callback(jack_nframes_t numFrames, void *data) {
         auto *self = (JackClient*)(data);
+        rtcheck::ScopedRealtime realtime;
         self->preProcess(numFrames);
         self->process(numFrames);
         return 0;
     }
     
+    static void threadInitCallback(void *data) {
+        auto *self = (JackClient*)(data);
+        self->threadInit();
+    }
+    
+    static int xrunCallback(void *data) {
+        auto *self = (JackClient*)(data);
+        self->xrun();
+        return 0;
+    }
+    
     // Static handler for shutdown from JACK
     static void jack_shutdown(void* data) {
         (void)data;
@@ -94,6 +117,8 @@ public:
         }
 
         jack_set_process_callback(client, JackClient::callback, this);
+        jack_set_thread_init_callback(client, JackClient::threadInitCallback, this);
+        jack_set_xrun_callback(client, JackClient::xrunCallback, this);
         jack_on_shutdown(client, jack_shutdown, this);
 
         sampleRate = jack_get_sample_rate(client);
@@ -129,6 +154,7 @@ public:
 
     void cleanup() {
         jack_client_close(client);
+        this->processStopped();
     }
 
     void start() {
@@ -140,6 +166,7 @@ public:
 
     void stop() {
         jack_deactivate(client);
+        this->processStopped();
     }
 
     void connectAdcPorts() {
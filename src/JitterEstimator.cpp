@@ -0,0 +1,109 @@
+// JitterEstimator.cpp
+#include "JitterEstimator.h"
+#include <algorithm>
+
+namespace aes67 {
+
+constexpr size_t JitterEstimator::WINDOW;
+constexpr uint32_t JitterEstimator::BIN_US;
+constexpr size_t JitterEstimator::BINS;
+constexpr size_t JitterEstimator::UPDATE_INTERVAL;
+
+JitterEstimator::JitterEstimator(double pct)
+    : sampleRate(48000), timeBase(48000),
+      percentile(std::min(0.9999, std::max(0.5, pct))),
+      started(false), lastTimestamp(0), timestampHigh(0),
+      transit(WINDOW, 0), minQueue(WINDOW, 0), minHead(0), minTail(0),
+      bins(WINDOW, 0), histogram(BINS, 0), count(0),
+      jitterFrames(0), jitterMicros(0)
+{
+}
+
+JitterEstimator::~JitterEstimator() {
+    // Nothing specific to clean up
+}
+
+void JitterEstimator::reset() {
+    started = false;
+    lastTimestamp = 0;
+    timestampHigh = 0;
+    minHead = 0;
+    minTail = 0;
+    count = 0;
+    std::fill(histogram.begin(), histogram.end(), 0);
+    jitterFrames = 0;
+    jitterMicros = 0;
+}
+
+void JitterEstimator::addArrival(uint32_t rtpTimestamp, uint64_t arrivalNs) {
+    // Transit times measured at another rate are not comparable
+    uint32_t rate = sampleRate.load(std::memory_order_relaxed);
+    if (rate != timeBase.getSampleRate()) {
+        reset();
+        timeBase.setSampleRate(rate);
+    }
+
+    // Extend the 32-bit timestamp; small steps back are reordering, not wraps
+    if (started && rtpTimestamp < lastTimestamp && lastTimestamp - rtpTimestamp > 0x80000000u) {
+        timestampHigh += 1ULL << 32;
+    }
+    started = true;
+    lastTimestamp = rtpTimestamp;
+    uint64_t timestamp = timestampHigh | rtpTimestamp;
+
+    // Transit time, offset by an unknown constant that cancels out
+    int64_t t = static_cast<int64_t>(arrivalNs) -
+                timeBase.nanoseconds(static_cast<int64_t>(timestamp)).rounded();
+
+    size_t slot = count % WINDOW;
+
+    // Drop the sample leaving the window
+    if (count >= WINDOW) {
+        histogram[bins[slot]]--;
+        if (minHead != minTail && minQueue[minHead % WINDOW] + WINDOW <= count) {
+            minHead++;
+        }
+    }
+
+    // Keep queue transits increasing so its head is the window minimum
+    while (minHead != minTail && transit[minQueue[(minTail - 1) % WINDOW] % WINDOW] >= t) {
+        minTail--;
+    }
+    transit[slot] = t;
+    minQueue[minTail % WINDOW] = count;
+    minTail++;
+
+    int64_t minimum = transit[minQueue[minHead % WINDOW] % WINDOW];
+    uint64_t delay = static_cast<uint64_t>(t - minimum);
+    uint16_t bin = static_cast<uint16_t>(std::min<uint64_t>(delay / (BIN_US * 1000), BINS - 1));
+
+    bins[slot] = bin;
+    histogram[bin]++;
+    count++;
+
+    if (count % UPDATE_INTERVAL == 0) {
+        updatePercentile();
+    }
+}
+
+void JitterEstimator::updatePercentile() {
+    uint64_t samples = std::min<uint64_t>(count, WINDOW);
+    uint64_t wanted = static_cast<uint64_t>(samples * percentile);
+
+    uint64_t seen = 0;
+    size_t bin = 0;
+    for (; bin < BINS; bin++) {
+        seen += histogram[bin];
+        if (seen > wanted) {
+            break;
+        }
+    }
+
+    // Upper edge of the bin, so the estimate never undershoots
+    uint32_t micros = static_cast<uint32_t>((bin + 1) * BIN_US);
+    jitterMicros.store(micros, std::memory_order_relaxed);
+    jitterFrames.store(static_cast<uint32_t>(timeBase.samples(static_cast<int64_t>(micros) * 1000).ceiling()),
+                       std::memory_order_relaxed);
+}
+
+} // namespace aes67
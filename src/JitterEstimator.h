@@ -0,0 +1,68 @@
+// JitterEstimator.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <vector>
+
+#include "TimeBase.h"
+
+namespace aes67 {
+
+// Measures packet arrival jitter of a received stream.
+//
+// Each packet's transit time (arrival minus RTP timestamp) is compared with
+// the smallest transit in a sliding window; the difference is how late that
+// packet was. A histogram of the last WINDOW delays gives a high percentile
+// in constant memory, allocated up front. Only the network thread adds
+// arrivals or resets; any thread reads the result.
+class JitterEstimator {
+public:
+    explicit JitterEstimator(double percentile = 0.995);
+    ~JitterEstimator();
+
+    // Picked up by the next arrival, which restarts the measurement
+    void setSampleRate(uint32_t rate) { sampleRate = rate; }
+    void reset();
+
+    // Network thread: one call per received packet
+    void addArrival(uint32_t rtpTimestamp, uint64_t arrivalNs);
+
+    // Delay covering the percentile of recent packets, in frames
+    uint32_t getJitterFrames() const { return jitterFrames.load(std::memory_order_relaxed); }
+    uint32_t getJitterMicros() const { return jitterMicros.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t WINDOW = 4096;        // Packets considered
+    static constexpr uint32_t BIN_US = 50;        // Histogram resolution
+    static constexpr size_t BINS = 2000;          // Up to 100 ms
+    static constexpr size_t UPDATE_INTERVAL = 64; // Packets between percentile updates
+
+    std::atomic<uint32_t> sampleRate;
+    TimeBase timeBase;                // At the rate applied
+    double percentile;
+
+    // Extended RTP timestamp
+    bool started;
+    uint32_t lastTimestamp;
+    uint64_t timestampHigh;
+
+    // Transit times in the window in nanoseconds, and a monotonic queue for their minimum
+    std::vector<int64_t> transit;
+    std::vector<uint64_t> minQueue;   // Window positions with increasing transit
+    size_t minHead;
+    size_t minTail;
+
+    // Delay histogram over the same window
+    std::vector<uint16_t> bins;       // Bin of each sample in the window
+    std::vector<uint32_t> histogram;
+    uint64_t count;                   // Samples seen
+
+    std::atomic<uint32_t> jitterFrames;
+    std::atomic<uint32_t> jitterMicros;
+
+    void updatePercentile();
+};
+
+} // namespace aes67
@@ -0,0 +1,280 @@
+// Logger.cpp
+#include "Logger.h"
+#include "Realtime.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace aes67 {
+
+constexpr size_t Logger::RING_RECORDS;
+constexpr size_t Logger::MESSAGE_SIZE;
+constexpr size_t Logger::MAX_THREADS;
+constexpr uint32_t Logger::SITE_LIMIT;
+
+namespace {
+
+// How long a record may wait in a ring before it is written
+constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(20);
+
+struct Record {
+    LogLevel level;
+    size_t length;
+    char text[Logger::MESSAGE_SIZE];
+};
+
+// Written only by the thread that claimed it, read only by the flusher
+struct Ring {
+    std::atomic<bool> claimed{false};
+    std::atomic<size_t> head{0};        // Next record to write
+    std::atomic<size_t> tail{0};        // Next record to flush
+    std::atomic<uint64_t> dropped{0};
+    Record records[Logger::RING_RECORDS];
+
+    // Flusher state: the last message written and its repeats since
+    std::string last;
+    LogLevel lastLevel = LogLevel::Info;
+    uint32_t repeats = 0;
+    uint64_t droppedReported = 0;
+};
+
+Ring rings[Logger::MAX_THREADS];
+std::atomic<uint64_t> unclaimed{0};     // Messages from threads with no ring
+uint64_t unclaimedReported = 0;
+
+std::atomic<bool> running{false};
+std::thread flusher;
+std::mutex flushMutex;
+std::condition_variable flushWake;
+std::mutex directMutex;                 // Serializes writes while stopped
+
+// Gives the thread's ring back when the thread exits
+struct RingHandle {
+    Ring* ring = nullptr;
+    bool attached = false;
+
+    ~RingHandle() {
+        if (ring) {
+            ring->claimed.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local RingHandle handle;
+
+Ring* threadRing() {
+    if (!handle.attached) {
+        handle.attached = true;
+
+        // A ring is taken over once the flusher has emptied it
+        for (Ring& ring : rings) {
+            bool expected = false;
+            if (ring.head.load(std::memory_order_acquire) == ring.tail.load(std::memory_order_acquire) &&
+                ring.claimed.compare_exchange_strong(expected, true)) {
+                handle.ring = &ring;
+                break;
+            }
+        }
+    }
+    return handle.ring;
+}
+
+uint64_t coarseSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return static_cast<uint64_t>(now.tv_sec);
+}
+
+size_t formatMessage(char* text, uint32_t suppressed, const char* format, va_list args) {
+    int written = vsnprintf(text, Logger::MESSAGE_SIZE, format, args);
+    size_t length = written < 0 ? 0 : std::min<size_t>(written, Logger::MESSAGE_SIZE - 1);
+
+    if (suppressed > 0) {
+        written = snprintf(text + length, Logger::MESSAGE_SIZE - length, " (%u more suppressed)", suppressed);
+        length += written < 0 ? 0 : std::min<size_t>(written, Logger::MESSAGE_SIZE - 1 - length);
+    }
+    return length;
+}
+
+void emit(LogLevel level, const char* text, size_t length) {
+    // Same split as before: warnings and errors on stderr
+    FILE* out = level >= LogLevel::Warning ? stderr : stdout;
+    fwrite(text, 1, length, out);
+    fputc('\n', out);
+}
+
+void reportRepeats(Ring& ring) {
+    if (ring.repeats == 0) {
+        return;
+    }
+
+    char text[64];
+    int length = snprintf(text, sizeof(text), "Last message repeated %u times", ring.repeats);
+    emit(ring.lastLevel, text, static_cast<size_t>(length));
+    ring.repeats = 0;
+}
+
+void flushRing(Ring& ring) {
+    size_t tail = ring.tail.load(std::memory_order_relaxed);
+    const size_t head = ring.head.load(std::memory_order_acquire);
+
+    // A quiet ring reports its repeats now rather than at the next message
+    if (tail == head) {
+        reportRepeats(ring);
+    }
+
+    for (; tail != head; tail++) {
+        const Record& record = ring.records[tail % Logger::RING_RECORDS];
+        if (!ring.last.empty() && ring.last.compare(0, std::string::npos, record.text, record.length) == 0) {
+            ring.repeats++;
+        } else {
+            reportRepeats(ring);
+            emit(record.level, record.text, record.length);
+            ring.last.assign(record.text, record.length);
+            ring.lastLevel = record.level;
+        }
+        ring.tail.store(tail + 1, std::memory_order_release);
+    }
+
+    uint64_t dropped = ring.dropped.load(std::memory_order_relaxed);
+    if (dropped != ring.droppedReported) {
+        fprintf(stderr, "Log: %llu messages dropped, ring full\n",
+                static_cast<unsigned long long>(dropped - ring.droppedReported));
+        ring.droppedReported = dropped;
+    }
+}
+
+void flushAll() {
+    for (Ring& ring : rings) {
+        flushRing(ring);
+    }
+
+    uint64_t lost = unclaimed.load(std::memory_order_relaxed);
+    if (lost != unclaimedReported) {
+        fprintf(stderr, "Log: %llu messages dropped, no ring free\n",
+                static_cast<unsigned long long>(lost - unclaimedReported));
+        unclaimedReported = lost;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+}
+
+void flushLoop() {
+    realtime::configureBackgroundThread("aes67-log");
+
+    std::unique_lock<std::mutex> lock(flushMutex);
+    while (running) {
+        flushWake.wait_for(lock, FLUSH_INTERVAL);
+        flushAll();
+    }
+}
+
+} // namespace
+
+void Logger::start() {
+    std::lock_guard<std::mutex> lock(directMutex);
+    if (running) {
+        return;
+    }
+
+    running = true;
+    flusher = std::thread(flushLoop);
+
+    // Whatever way the process exits, queued messages are written first
+    static bool registered = false;
+    if (!registered) {
+        registered = true;
+        std::atexit([] { Logger::stop(); });
+    }
+}
+
+void Logger::stop() {
+    std::lock_guard<std::mutex> lock(directMutex);
+    {
+        std::lock_guard<std::mutex> flushLock(flushMutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+
+    flushWake.notify_all();
+    if (flusher.joinable()) {
+        flusher.join();
+    }
+
+    // Whatever came in after the last pass
+    flushAll();
+    for (Ring& ring : rings) {
+        reportRepeats(ring);
+    }
+    fflush(stdout);
+}
+
+void Logger::write(LogSite& site, LogLevel level, const char* format, ...) {
+    // Over the limit: count it, without formatting anything
+    const uint64_t second = coarseSeconds();
+    if (site.window.load(std::memory_order_relaxed) != second) {
+        site.window.store(second, std::memory_order_relaxed);
+        site.count.store(0, std::memory_order_relaxed);
+    }
+    if (site.count.fetch_add(1, std::memory_order_relaxed) >= SITE_LIMIT) {
+        site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const uint32_t suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+
+    va_list args;
+    va_start(args, format);
+
+    if (!running.load(std::memory_order_acquire)) {
+        char text[MESSAGE_SIZE];
+        size_t length = formatMessage(text, suppressed, format, args);
+        va_end(args);
+
+        std::lock_guard<std::mutex> lock(directMutex);
+        emit(level, text, length);
+        fflush(level >= LogLevel::Warning ? stderr : stdout);
+        return;
+    }
+
+    Ring* ring = threadRing();
+    if (!ring) {
+        va_end(args);
+        unclaimed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const size_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= RING_RECORDS) {
+        va_end(args);
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Record& record = ring->records[head % RING_RECORDS];
+    record.level = level;
+    record.length = formatMessage(record.text, suppressed, format, args);
+    va_end(args);
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+uint64_t Logger::getDropped() {
+    uint64_t total = unclaimed.load(std::memory_order_relaxed);
+    for (const Ring& ring : rings) {
+        total += ring.dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+} // namespace aes67
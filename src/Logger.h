@@ -0,0 +1,74 @@
+// Logger.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+// Lowest level compiled in: 0 debug, 1 info, 2 warning, 3 error
+#ifndef AES67_LOG_LEVEL
+#define AES67_LOG_LEVEL 1
+#endif
+
+namespace aes67 {
+
+enum class LogLevel {
+    Debug = 0,
+    Info,
+    Warning,
+    Error
+};
+
+// One logging call site. Each site may write a few messages a second; the
+// rest are counted and reported with the next one that gets through.
+struct LogSite {
+    std::atomic<uint64_t> window{0};        // Second the count applies to
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> suppressed{0};
+};
+
+// Logging for the network, PTP and discovery paths, where a burst of errors
+// must not turn into a burst of blocking writes.
+//
+// A message is formatted on the calling thread into a fixed-size record in
+// that thread's own ring, with no lock and no allocation, and a background
+// thread writes the records out. Repeats of the same message from a thread
+// are collapsed into a count. Before start() and after stop() messages are
+// written directly; the process exiting stops the logger.
+class Logger {
+public:
+    // Records per thread ring, and the longest message kept
+    static constexpr size_t RING_RECORDS = 64;
+    static constexpr size_t MESSAGE_SIZE = 240;
+
+    // Threads that can log at once, each with its own ring
+    static constexpr size_t MAX_THREADS = 16;
+
+    // Messages a call site may write per second
+    static constexpr uint32_t SITE_LIMIT = 10;
+
+    static void start();
+    static void stop();
+
+    static void write(LogSite& site, LogLevel level, const char* format, ...)
+        __attribute__((format(printf, 3, 4)));
+
+    // Messages lost to a full ring or with no ring free
+    static uint64_t getDropped();
+};
+
+} // namespace aes67
+
+// Levels below AES67_LOG_LEVEL compile to nothing, arguments included
+#define AES67_LOG(level, ...)                                               \
+    do {                                                                    \
+        if (static_cast<int>(level) >= AES67_LOG_LEVEL) {                   \
+            static ::aes67::LogSite aes67LogSite;                           \
+            ::aes67::Logger::write(aes67LogSite, level, __VA_ARGS__);      \
+        }                                                                   \
+    } while (0)
+
+#define AES67_LOG_DEBUG(...) AES67_LOG(::aes67::LogLevel::Debug, __VA_ARGS__)
+#define AES67_LOG_INFO(...)  AES67_LOG(::aes67::LogLevel::Info, __VA_ARGS__)
+#define AES67_LOG_WARN(...)  AES67_LOG(::aes67::LogLevel::Warning, __VA_ARGS__)
+#define AES67_LOG_ERROR(...) AES67_LOG(::aes67::LogLevel::Error, __VA_ARGS__)
@@ -0,0 +1,314 @@
+// LossConcealer.cpp
+#include "LossConcealer.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace aes67 {
+
+LossConcealer::LossConcealer()
+    : channelCount(0), sampleRate(48000),
+      historyLength(0), minPeriod(0), maxPeriod(0), matchWindow(0),
+      decimation(1), overlap(0), fadeStart(0), fadeLength(0),
+      historyFill(0), historyEnd(0), period(0), patternPos(0),
+      concealing(false), concealedRun(0), returnPos(0), returning(false),
+      concealedFrames(0), concealmentEvents(0)
+{
+}
+
+LossConcealer::~LossConcealer() {
+    // Nothing specific to clean up
+}
+
+void LossConcealer::initialize(uint16_t channels, uint32_t rate) {
+    channelCount = channels;
+    sampleRate = rate;
+
+    // Periods between 2.5 ms and 15 ms cover voice and most pitched material
+    minPeriod = rate / 400;
+    maxPeriod = rate * 15 / 1000;
+    matchWindow = rate * 5 / 1000;
+    decimation = std::max<size_t>(1, rate / 12000);
+    overlap = std::max<size_t>(8, rate / 1000);
+
+    // Hold full level for a few packets, then fade out over 20 ms
+    fadeStart = rate * 10 / 1000;
+    fadeLength = rate * 20 / 1000;
+
+    historyLength = maxPeriod + matchWindow + overlap;
+
+    history.assign(channelCount, std::vector<float>(historyLength * 2, 0.0f));
+    pattern.assign(channelCount, std::vector<float>(maxPeriod, 0.0f));
+    mono.assign(historyLength, 0.0f);
+
+    reset();
+}
+
+void LossConcealer::reset() {
+    for (auto& h : history) {
+        std::fill(h.begin(), h.end(), 0.0f);
+    }
+
+    historyFill = 0;
+    historyEnd = 0;
+    period = 0;
+    patternPos = 0;
+    concealing = false;
+    concealedRun = 0;
+    returnPos = 0;
+    returning = false;
+}
+
+void LossConcealer::process(float* const* channels, size_t frames) {
+    if (channelCount == 0 || frames == 0) {
+        return;
+    }
+
+    // Leaving a gap: crossfade from the concealed signal into real audio
+    if (concealing) {
+        concealing = false;
+        returning = true;
+        returnPos = 0;
+    }
+
+    if (returning) {
+        size_t n = std::min(frames, overlap - returnPos);
+
+        // Level the concealed signal had reached when audio returned
+        const float gain = period ? fadeGain(concealedRun) : 0.0f;
+
+        for (uint16_t ch = 0; ch < channelCount; ch++) {
+            float* __restrict out = channels[ch];
+            const float* __restrict tpl = pattern[ch].data();
+            size_t pos = patternPos;
+
+            // Continue the pattern underneath the incoming audio
+            for (size_t i = 0; i < n; i++) {
+                float w = static_cast<float>(returnPos + i + 1) / static_cast<float>(overlap + 1);
+                float faded = tpl[pos] * gain;
+                out[i] = faded + w * (out[i] - faded);
+                if (++pos >= period) {
+                    pos = 0;
+                }
+            }
+        }
+
+        patternPos = period ? (patternPos + n) % period : 0;
+        returnPos += n;
+
+        if (returnPos >= overlap) {
+            returning = false;
+        }
+    }
+
+    appendHistory(channels, frames);
+}
+
+void LossConcealer::conceal(float* const* channels, size_t frames) {
+    if (channelCount == 0 || frames == 0) {
+        return;
+    }
+
+    if (!concealing) {
+        concealing = true;
+        returning = false;
+        concealedRun = 0;
+        concealmentEvents++;
+        buildPattern();
+    }
+
+    concealedFrames += frames;
+
+    // Nothing to repeat yet, or already faded out
+    if (period == 0 || concealedRun >= fadeStart + fadeLength) {
+        for (uint16_t ch = 0; ch < channelCount; ch++) {
+            memset(channels[ch], 0, frames * sizeof(float));
+        }
+        concealedRun += frames;
+        return;
+    }
+
+    renderPattern(channels, frames);
+    applyFade(channels, frames);
+    concealedRun += frames;
+}
+
+void LossConcealer::splice() {
+    if (channelCount == 0 || concealing) {
+        return;
+    }
+
+    // A zero-length gap: process() runs its return crossfade from the pattern
+    buildPattern();
+    concealing = true;
+    returning = false;
+    concealedRun = 0;
+}
+
+float LossConcealer::fadeGain(size_t run) const {
+    if (run <= fadeStart) {
+        return 1.0f;
+    }
+    if (run >= fadeStart + fadeLength) {
+        return 0.0f;
+    }
+    return 1.0f - static_cast<float>(run - fadeStart) / static_cast<float>(fadeLength);
+}
+
+void LossConcealer::appendHistory(float* const* channels, size_t frames) {
+    // Only the most recent history window matters
+    size_t skip = frames > historyLength ? frames - historyLength : 0;
+    size_t count = frames - skip;
+
+    // Slide the window back to the start when the buffer is full
+    if (historyEnd + count > historyLength * 2) {
+        size_t keep = std::min(historyFill, historyLength - count);
+        for (uint16_t ch = 0; ch < channelCount; ch++) {
+            float* h = history[ch].data();
+            memmove(h, h + historyEnd - keep, keep * sizeof(float));
+        }
+        historyEnd = keep;
+    }
+
+    for (uint16_t ch = 0; ch < channelCount; ch++) {
+        memcpy(history[ch].data() + historyEnd, channels[ch] + skip, count * sizeof(float));
+    }
+
+    historyEnd += count;
+    historyFill = std::min(historyFill + count, historyLength);
+}
+
+size_t LossConcealer::findPeriod() {
+    if (historyFill < historyLength) {
+        return 0;
+    }
+
+    // Mono mix of the history window
+    const size_t start = historyEnd - historyLength;
+    const float scale = 1.0f / static_cast<float>(channelCount);
+
+    std::fill(mono.begin(), mono.end(), 0.0f);
+    for (uint16_t ch = 0; ch < channelCount; ch++) {
+        const float* __restrict h = history[ch].data() + start;
+        float* __restrict m = mono.data();
+        for (size_t i = 0; i < historyLength; i++) {
+            m[i] += h[i] * scale;
+        }
+    }
+
+    // Compare the most recent window against earlier copies of itself
+    const float* target = mono.data() + historyLength - matchWindow;
+
+    auto score = [&](size_t lag, size_t step) {
+        const float* candidate = target - lag;
+        float corr = 0.0f;
+        float energy = 1e-9f;
+        for (size_t i = 0; i < matchWindow; i += step) {
+            corr += target[i] * candidate[i];
+            energy += candidate[i] * candidate[i];
+        }
+        return corr / std::sqrt(energy);
+    };
+
+    // Coarse search on a decimated grid, then refine at full rate
+    size_t best = 0;
+    float bestScore = 0.0f;
+    for (size_t lag = minPeriod; lag <= maxPeriod; lag += decimation) {
+        float s = score(lag, decimation);
+        if (s > bestScore) {
+            bestScore = s;
+            best = lag;
+        }
+    }
+
+    if (best == 0) {
+        // Silence or uncorrelated material, repeat the longest period
+        return maxPeriod;
+    }
+
+    size_t lo = std::max(minPeriod, best - std::min(best, decimation));
+    size_t hi = std::min(maxPeriod, best + decimation);
+    bestScore = score(best, 1);
+    for (size_t lag = lo; lag <= hi; lag++) {
+        float s = score(lag, 1);
+        if (s > bestScore) {
+            bestScore = s;
+            best = lag;
+        }
+    }
+
+    return best;
+}
+
+void LossConcealer::buildPattern() {
+    period = findPeriod();
+    patternPos = 0;
+
+    if (period == 0) {
+        return;
+    }
+
+    const size_t fade = std::min(overlap, period);
+
+    for (uint16_t ch = 0; ch < channelCount; ch++) {
+        const float* h = history[ch].data() + historyEnd;
+        float* __restrict tpl = pattern[ch].data();
+
+        // The last period of history, repeated from its start
+        memcpy(tpl, h - period, period * sizeof(float));
+
+        // Smooth the loop point: the end of the pattern blends into the
+        // samples that preceded its start, so wrapping back is continuous
+        const float* before = h - period - fade;
+        float* tail = tpl + period - fade;
+        for (size_t i = 0; i < fade; i++) {
+            float w = static_cast<float>(i + 1) / static_cast<float>(fade + 1);
+            tail[i] += w * (before[i] - tail[i]);
+        }
+    }
+}
+
+void LossConcealer::renderPattern(float* const* channels, size_t frames) {
+    size_t pos = patternPos;
+
+    for (uint16_t ch = 0; ch < channelCount; ch++) {
+        float* __restrict out = channels[ch];
+        const float* __restrict tpl = pattern[ch].data();
+        size_t done = 0;
+        pos = patternPos;
+
+        // Copy whole contiguous runs of the pattern
+        while (done < frames) {
+            size_t n = std::min(frames - done, period - pos);
+            memcpy(out + done, tpl + pos, n * sizeof(float));
+            done += n;
+            pos += n;
+            if (pos >= period) {
+                pos = 0;
+            }
+        }
+    }
+
+    patternPos = pos;
+}
+
+void LossConcealer::applyFade(float* const* channels, size_t frames) {
+    if (concealedRun + frames <= fadeStart) {
+        return;
+    }
+
+    // Linear ramp from full level to silence across fadeLength
+    const float step = 1.0f / static_cast<float>(fadeLength);
+
+    for (uint16_t ch = 0; ch < channelCount; ch++) {
+        float* __restrict out = channels[ch];
+        for (size_t i = 0; i < frames; i++) {
+            size_t run = concealedRun + i;
+            float gain = run <= fadeStart ? 1.0f
+                : std::max(0.0f, 1.0f - static_cast<float>(run - fadeStart) * step);
+            out[i] *= gain;
+        }
+    }
+}
+
+} // namespace aes67
@@ -0,0 +1,89 @@
+// LossConcealer.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace aes67 {
+
+// Per-stream packet loss concealment for the JACK output.
+//
+// Gaps are filled by repeating the most recent pitch period of the stream
+// (waveform substitution). When real audio returns it is crossfaded in over
+// the concealed signal, and long outages fade to silence. All buffers are
+// allocated in initialize(); the per-cycle work is bounded by the history
+// length and never allocates, so both calls are safe on the JACK thread.
+class LossConcealer {
+public:
+    LossConcealer();
+    ~LossConcealer();
+
+    // Configuration (not RT-safe, allocates)
+    void initialize(uint16_t channels, uint32_t sampleRate);
+    void reset();
+
+    // Feed real audio that has just been written to the outputs.
+    // Applies the return crossfade in place and records history.
+    void process(float* const* channels, size_t frames);
+
+    // Synthesise frames for a gap in the stream
+    void conceal(float* const* channels, size_t frames);
+
+    // The stream is switching sources: crossfade from a continuation of the
+    // old signal into the audio passed to the next process() call
+    void splice();
+
+    // Status
+    bool isConcealing() const { return concealing; }
+    uint64_t getConcealedFrames() const { return concealedFrames; }
+    uint64_t getConcealmentEvents() const { return concealmentEvents; }
+
+private:
+    // Configuration
+    uint16_t channelCount;
+    uint32_t sampleRate;
+
+    // Timing in frames, derived from the sample rate
+    size_t historyLength;   // frames of history kept per channel
+    size_t minPeriod;       // shortest repeat period
+    size_t maxPeriod;       // longest repeat period
+    size_t matchWindow;     // frames compared during the period search
+    size_t decimation;      // coarse search decimation factor
+    size_t overlap;         // loop-point and return crossfade length
+    size_t fadeStart;       // concealed frames before fading begins
+    size_t fadeLength;      // frames to fade from full level to silence
+
+    // History, stored linearly in a double-length buffer per channel
+    std::vector<std::vector<float>> history;
+    size_t historyFill;     // valid frames at the end of the history window
+    size_t historyEnd;      // write position in the history buffers
+
+    // Repeat template, one period per channel with a smoothed loop point
+    std::vector<std::vector<float>> pattern;
+    size_t period;
+    size_t patternPos;
+
+    // Scratch for the period search (mono mix)
+    std::vector<float> mono;
+
+    // Concealment state
+    bool concealing;
+    size_t concealedRun;    // frames concealed in the current gap
+    size_t returnPos;       // progress through the return crossfade
+    bool returning;
+
+    // Statistics
+    uint64_t concealedFrames;
+    uint64_t concealmentEvents;
+
+    // Helper functions
+    void appendHistory(float* const* channels, size_t frames);
+    size_t findPeriod();
+    void buildPattern();
+    void renderPattern(float* const* channels, size_t frames);
+    void applyFade(float* const* channels, size_t frames);
+    float fadeGain(size_t run) const;
+};
+
+} // namespace aes67
@@ -0,0 +1,105 @@
+// MediaClock.cpp
+#include "MediaClock.h"
+#include <cmath>
+#include <algorithm>
+
+namespace aes67 {
+
+namespace {
+
+constexpr double WRAP = 4294967296.0;
+
+// Reduce to [-2^31, 2^31)
+double wrapDifference(double value) {
+    return value - WRAP * std::floor(value / WRAP + 0.5);
+}
+
+} // namespace
+
+constexpr double MediaClock::GAIN;
+constexpr double MediaClock::MAX_DEVIATION;
+
+MediaClock::MediaClock()
+    : stepLimit(4800.0), started(false), locked(false), basePosition(0), baseTime(0.0),
+      ratio(1.0), observations(0), steps(0)
+{
+}
+
+MediaClock::~MediaClock() {
+    // Nothing specific to clean up
+}
+
+void MediaClock::setSampleRate(uint32_t rate) {
+    stepLimit = rate / 10.0;
+}
+
+void MediaClock::reset() {
+    started = false;
+    locked = false;
+    basePosition = 0;
+    baseTime = 0.0;
+    ratio = 1.0;
+    observations = 0;
+}
+
+void MediaClock::seedRatio(double seed) {
+    if (started || seed == 0.0) {
+        return;
+    }
+    ratio = std::min(1.0 + MAX_DEVIATION, std::max(1.0 - MAX_DEVIATION, seed));
+}
+
+double MediaClock::predict(uint32_t position) const {
+    // Positions before the base give a negative distance
+    int32_t frames = static_cast<int32_t>(position - basePosition);
+    return baseTime + static_cast<double>(frames) * ratio;
+}
+
+void MediaClock::observe(uint32_t position, uint32_t timestamp) {
+    if (!started) {
+        started = true;
+        basePosition = position;
+        baseTime = timestamp;
+        return;
+    }
+
+    int32_t frames = static_cast<int32_t>(position - basePosition);
+    if (frames <= 0) {
+        return;
+    }
+
+    double predicted = predict(position);
+    double error = wrapDifference(static_cast<double>(timestamp) - predicted);
+
+    // A PTP step or a long stall: restart the phase from this observation.
+    // Neither changes how fast the two clocks run, so the rate is kept.
+    if (std::fabs(error) > stepLimit) {
+        started = true;
+        locked = false;
+        basePosition = position;
+        baseTime = timestamp;
+        observations = 0;
+        steps++;
+        return;
+    }
+
+    // Critically damped: the offset follows at GAIN per observation and the
+    // rate absorbs what is left, so steady drift leaves no residual error
+    baseTime = predicted + GAIN * error;
+    ratio += GAIN * GAIN / 4.0 * error / static_cast<double>(frames);
+    ratio = std::min(1.0 + MAX_DEVIATION, std::max(1.0 - MAX_DEVIATION, ratio));
+    basePosition = position;
+    baseTime = std::fmod(baseTime + WRAP, WRAP);
+
+    // Lock once the initial transient has had a few time constants
+    if (++observations > static_cast<uint64_t>(4.0 / GAIN)) {
+        locked = true;
+    }
+}
+
+uint32_t MediaClock::timestampAt(uint32_t position) const {
+    double time = std::fmod(std::floor(predict(position) + 0.5) + WRAP, WRAP);
+    return static_cast<uint32_t>(time);
+}
+
+} // namespace aes67
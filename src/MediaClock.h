@@ -0,0 +1,57 @@
+// MediaClock.h
+#pragma once
+
+#include <cstdint>
+
+namespace aes67 {
+
+// RTP media clock for transmitted audio, locked to PTP.
+//
+// The JACK thread notes the PTP time (in samples, plus the media clock
+// offset) at which each period of input was captured, against the ring
+// position it was written to. Those observations are noisy and the JACK
+// sample clock drifts from PTP, so they steer a second-order loop that
+// tracks both the offset and the rate ratio between the two clocks. RTP
+// timestamps read from the loop advance smoothly and follow PTP without
+// steps. All arithmetic is modulo 2^32, like RTP timestamps and the low
+// bits of ring positions. Owned by the network thread.
+class MediaClock {
+public:
+    MediaClock();
+    ~MediaClock();
+
+    void setSampleRate(uint32_t rate);
+    void reset();
+    
+    // Start the loop from a rate ratio measured before, such as last run's
+    // against the same master, instead of from 1. After reset() only.
+    void seedRatio(double seed);
+
+    // The frame at ring position was captured at RTP time timestamp
+    void observe(uint32_t position, uint32_t timestamp);
+
+    // RTP timestamp of the frame at a ring position
+    uint32_t timestampAt(uint32_t position) const;
+
+    // Status
+    bool isLocked() const { return locked; }
+    double getRatio() const { return ratio; }   // PTP samples per JACK frame
+    uint64_t getSteps() const { return steps; }
+
+private:
+    static constexpr double GAIN = 0.01;            // Offset correction per observation
+    static constexpr double MAX_DEVIATION = 500e-6; // Rate limit, 500 ppm
+
+    double stepLimit;       // Error in samples that re-seeds the loop, 100 ms
+    bool started;
+    bool locked;
+    uint32_t basePosition;
+    double baseTime;        // RTP time at basePosition, in [0, 2^32)
+    double ratio;
+    uint64_t observations;
+    uint64_t steps;
+
+    double predict(uint32_t position) const;
+};
+
+} // namespace aes67
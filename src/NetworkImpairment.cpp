@@ -0,0 +1,310 @@
+// NetworkImpairment.cpp
+#include "NetworkImpairment.h"
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+
+namespace aes67 {
+
+NetworkImpairment::NetworkImpairment()
+    : stats(), uniform(0.0, 1.0), badState(false), packetIndex(0),
+      nextOrder(0), holding(false), heldSlot(0)
+{
+}
+
+NetworkImpairment::~NetworkImpairment() {
+    // Nothing specific to clean up
+}
+
+bool NetworkImpairment::parse(const std::string& spec, Config& config) {
+    std::istringstream stream(spec);
+    std::string item;
+    std::vector<std::string> seen;
+
+    while (std::getline(stream, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            std::cerr << "Invalid impairment option: " << item << std::endl;
+            return false;
+        }
+
+        std::string key = item.substr(0, eq);
+        std::string text = item.substr(eq + 1);
+
+        // Each option once, so the result never depends on their order
+        if (std::find(seen.begin(), seen.end(), key) != seen.end()) {
+            std::cerr << "Impairment option given twice: " << key << std::endl;
+            return false;
+        }
+        seen.push_back(key);
+
+        char* end = nullptr;
+        if (key == "seed") {
+            // All 64 bits, which a double would round
+            config.seed = strtoull(text.c_str(), &end, 10);
+            if (text.empty() || text[0] == '-' || *end != '\0') {
+                std::cerr << "Invalid value for impairment option " << key << ": " << text << std::endl;
+                return false;
+            }
+            continue;
+        }
+
+        double value = strtod(text.c_str(), &end);
+        if (text.empty() || *end != '\0' || value < 0.0) {
+            std::cerr << "Invalid value for impairment option " << key << ": " << text << std::endl;
+            return false;
+        }
+
+        if (key == "loss" || key == "loss-good") {
+            // Loss outside bursts; without ge-p that is independent (Bernoulli) loss
+            config.lossGood = value;
+        } else if (key == "ge-p") {
+            config.goodToBad = value;
+        } else if (key == "ge-r") {
+            config.badToGood = value;
+        } else if (key == "loss-bad") {
+            config.lossBad = value;
+        } else if (key == "delay") {
+            config.delay = value;
+        } else if (key == "jitter") {
+            config.jitterScale = value;
+        } else if (key == "jitter-shape") {
+            config.jitterShape = value;
+        } else if (key == "jitter-max") {
+            config.jitterMax = value;
+        } else if (key == "reorder") {
+            config.reorder = value;
+        } else if (key == "dup") {
+            config.duplicate = value;
+        } else if (key == "burst-every") {
+            config.burstInterval = static_cast<uint32_t>(value);
+        } else if (key == "burst-len") {
+            config.burstLength = static_cast<uint32_t>(value);
+        } else {
+            std::cerr << "Unknown impairment option: " << key << std::endl;
+            return false;
+        }
+    }
+
+    // loss and loss-good are two names for the same probability
+    if (std::count(seen.begin(), seen.end(), "loss") && std::count(seen.begin(), seen.end(), "loss-good")) {
+        std::cerr << "Impairment options loss and loss-good conflict, give one" << std::endl;
+        return false;
+    }
+
+    if (config.jitterScale > 0.0 && config.jitterShape <= 0.0) {
+        std::cerr << "Impairment jitter-shape must be positive" << std::endl;
+        return false;
+    }
+
+    config.enabled = true;
+    return true;
+}
+
+void NetworkImpairment::configure(const Config& cfg) {
+    config = cfg;
+
+    // Allocate the packet pool once, the packet path never allocates
+    pool.assign(MAX_PENDING * MAX_PACKET_SIZE, 0);
+    slots.assign(MAX_PENDING, Slot());
+    pending.clear();
+    pending.reserve(MAX_PENDING);
+
+    reset();
+}
+
+void NetworkImpairment::reset() {
+    rng.seed(config.seed);
+    uniform.reset();
+
+    stats = Stats();
+    badState = false;
+    packetIndex = 0;
+    nextOrder = 0;
+    holding = false;
+    heldSlot = 0;
+
+    for (auto& slot : slots) {
+        slot.used = false;
+    }
+    pending.clear();
+}
+
+void NetworkImpairment::submit(const uint8_t* data, size_t size, uint64_t nowNs) {
+    stats.received++;
+
+    // Draw every random value in a fixed order so runs stay repeatable
+    bool drop = dropPacket();
+    uint64_t delay = sampleDelay();
+    bool reorder = uniform(rng) < config.reorder;
+    bool duplicate = uniform(rng) < config.duplicate;
+
+    if (drop) {
+        return;
+    }
+
+    size_t slot;
+    if (!store(data, size, slot)) {
+        return;
+    }
+
+    uint64_t releaseTime = nowNs + delay;
+
+    if (reorder && !holding) {
+        // Hold this packet until the next one has been queued
+        holding = true;
+        heldSlot = slot;
+        slots[slot].releaseTime = releaseTime;
+        stats.reordered++;
+        return;
+    }
+
+    enqueue(slot, releaseTime);
+
+    if (duplicate) {
+        size_t copy;
+        if (store(data, size, copy)) {
+            enqueue(copy, releaseTime);
+            stats.duplicated++;
+        }
+    }
+
+    // Release a held packet behind the one we just queued
+    if (holding) {
+        holding = false;
+        enqueue(heldSlot, std::max(slots[heldSlot].releaseTime, releaseTime));
+    }
+}
+
+bool NetworkImpairment::poll(uint8_t* buffer, size_t maxSize, size_t& bytesRead, uint64_t nowNs) {
+    // A held packet never waits longer than the jitter cap for a successor
+    if (holding && nowNs >= slots[heldSlot].releaseTime + static_cast<uint64_t>(config.jitterMax * 1000.0)) {
+        holding = false;
+        enqueue(heldSlot, slots[heldSlot].releaseTime);
+    }
+
+    if (pending.empty()) {
+        return false;
+    }
+
+    Slot& slot = slots[pending.front()];
+    if (slot.releaseTime > nowNs) {
+        return false;
+    }
+
+    bytesRead = std::min(slot.size, maxSize);
+    memcpy(buffer, &pool[pending.front() * MAX_PACKET_SIZE], bytesRead);
+
+    slot.used = false;
+    pending.erase(pending.begin());
+    stats.delivered++;
+
+    return true;
+}
+
+uint64_t NetworkImpairment::nextReleaseTime() const {
+    uint64_t next = UINT64_MAX;
+
+    if (!pending.empty()) {
+        next = slots[pending.front()].releaseTime;
+    }
+
+    if (holding) {
+        next = std::min(next, slots[heldSlot].releaseTime + static_cast<uint64_t>(config.jitterMax * 1000.0));
+    }
+
+    return next;
+}
+
+bool NetworkImpairment::dropPacket() {
+    uint64_t index = packetIndex++;
+
+    // Gilbert-Elliott: transition first, then lose according to the new state
+    double transition = uniform(rng);
+    if (badState) {
+        if (transition < config.badToGood) {
+            badState = false;
+        }
+    } else if (transition < config.goodToBad) {
+        badState = true;
+    }
+
+    double loss = uniform(rng);
+    bool lost = loss < (badState ? config.lossBad : config.lossGood);
+
+    // Deterministic bursts at the end of every interval
+    if (config.burstInterval > 0 && config.burstLength > 0) {
+        uint64_t position = index % config.burstInterval;
+        if (position >= config.burstInterval - std::min(config.burstLength, config.burstInterval)) {
+            stats.burstDropped++;
+            return true;
+        }
+    }
+
+    if (lost) {
+        stats.lost++;
+    }
+
+    return lost;
+}
+
+uint64_t NetworkImpairment::sampleDelay() {
+    double u = uniform(rng);
+    double delay = config.delay;
+
+    if (config.jitterScale > 0.0) {
+        // Lomax (Pareto type II): xm * (u^(-1/alpha) - 1), heavy tailed from zero
+        double jitter = config.jitterScale * (std::pow(1.0 - u, -1.0 / config.jitterShape) - 1.0);
+        delay += std::min(jitter, config.jitterMax);
+    }
+
+    // Configured in microseconds, drawn to the nanosecond
+    return static_cast<uint64_t>(delay * 1000.0);
+}
+
+size_t NetworkImpairment::allocateSlot() {
+    for (size_t i = 0; i < slots.size(); i++) {
+        if (!slots[i].used) {
+            return i;
+        }
+    }
+    return slots.size();
+}
+
+void NetworkImpairment::enqueue(size_t slot, uint64_t releaseTime) {
+    slots[slot].releaseTime = releaseTime;
+    slots[slot].order = nextOrder++;
+
+    // Keep the queue sorted by release time, stable for equal times
+    auto pos = std::upper_bound(pending.begin(), pending.end(), slot,
+        [this](size_t a, size_t b) {
+            if (slots[a].releaseTime != slots[b].releaseTime) {
+                return slots[a].releaseTime < slots[b].releaseTime;
+            }
+            return slots[a].order < slots[b].order;
+        });
+    pending.insert(pos, slot);
+}
+
+bool NetworkImpairment::store(const uint8_t* data, size_t size, size_t& slot) {
+    slot = allocateSlot();
+    if (slot >= slots.size() || size > MAX_PACKET_SIZE) {
+        stats.overflowed++;
+        return false;
+    }
+
+    memcpy(&pool[slot * MAX_PACKET_SIZE], data, size);
+    slots[slot].size = size;
+    slots[slot].used = true;
+
+    return true;
+}
+
+} // namespace aes67
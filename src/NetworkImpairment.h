@@ -0,0 +1,115 @@
+// NetworkImpairment.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <random>
+
+namespace aes67 {
+
+// Optional impairment stage that sits between the stream receive handler
+// and RTP parsing. Every decision is drawn from a seeded generator in packet
+// order, so the same seed and input stream give the same impaired stream.
+class NetworkImpairment {
+public:
+    struct Config {
+        bool enabled = false;
+        uint64_t seed = 1;
+
+        // Gilbert-Elliott loss model
+        double goodToBad = 0.0;     // p: chance of entering the bad state per packet
+        double badToGood = 1.0;     // r: chance of leaving the bad state per packet
+        double lossGood = 0.0;      // loss probability while in the good state
+        double lossBad = 1.0;       // loss probability while in the bad state
+
+        // Delay: fixed base plus Pareto (Lomax) distributed jitter, in microseconds
+        double delay = 0.0;
+        double jitterScale = 0.0;   // 0 disables jitter
+        double jitterShape = 2.5;
+        double jitterMax = 20000.0;
+
+        // Reordering and duplication
+        double reorder = 0.0;       // chance a packet is held back behind the next one
+        double duplicate = 0.0;     // chance a packet is delivered twice
+
+        // Deterministic burst drops
+        uint32_t burstInterval = 0; // packets between bursts, 0 disables
+        uint32_t burstLength = 0;   // packets dropped per burst
+    };
+
+    struct Stats {
+        uint64_t received;
+        uint64_t lost;
+        uint64_t burstDropped;
+        uint64_t reordered;
+        uint64_t duplicated;
+        uint64_t delivered;
+        uint64_t overflowed;
+    };
+
+    NetworkImpairment();
+    ~NetworkImpairment();
+
+    // Parse a spec such as "seed=42,loss=0.01,jitter=300,reorder=0.02"
+    static bool parse(const std::string& spec, Config& config);
+
+    // Configuration
+    void configure(const Config& config);
+    void reset();
+    bool isEnabled() const { return config.enabled; }
+    const Config& getConfig() const { return config; }
+
+    // Packet flow, times are in nanoseconds on any monotonic clock
+    void submit(const uint8_t* data, size_t size, uint64_t nowNs);
+    bool poll(uint8_t* buffer, size_t maxSize, size_t& bytesRead, uint64_t nowNs);
+
+    // Release time of the next pending packet, or UINT64_MAX if none
+    uint64_t nextReleaseTime() const;
+
+    // Status
+    const Stats& getStats() const { return stats; }
+
+private:
+    static constexpr size_t MAX_PENDING = 256;
+    static constexpr size_t MAX_PACKET_SIZE = 2048;
+
+    struct Slot {
+        uint64_t releaseTime;
+        uint64_t order;       // tie breaker so equal release times keep arrival order
+        size_t size;
+        bool used;
+    };
+
+    Config config;
+    Stats stats;
+
+    std::mt19937_64 rng;
+    std::uniform_real_distribution<double> uniform;
+
+    // Gilbert-Elliott state
+    bool badState;
+
+    // Burst position
+    uint64_t packetIndex;
+
+    // Fixed packet pool and pending queue sorted by release time
+    std::vector<uint8_t> pool;
+    std::vector<Slot> slots;
+    std::vector<size_t> pending;
+    uint64_t nextOrder;
+
+    // Packet held back for reordering, released behind the next arrival
+    bool holding;
+    size_t heldSlot;
+
+    // Helper functions
+    bool dropPacket();
+    uint64_t sampleDelay();
+    size_t allocateSlot();
+    void enqueue(size_t slot, uint64_t releaseTime);
+    bool store(const uint8_t* data, size_t size, size_t& slot);
+};
+
+} // namespace aes67
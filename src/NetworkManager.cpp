@@ -1,5 +1,6 @@
 // NetworkManager.cpp
 #include "NetworkManager.h"
+#include "Logger.h"
 
 #include <cstring>
 #include <sys/types.h>
@@ -16,10 +17,18 @@
 namespace aes67 {
 
 NetworkManager::NetworkManager() 
-    : sendSocket(-1), recvSocket(-1), port(0), 
-      interfaceAddr(0), interfaceIndex(0), interfaceMTU(1500),
-      active(false)
+    : sendSocket(-1), port(0), pathCount(1),
+      io(IOEngine::create()), active(false)
 {
+    for (auto& path : paths) {
+        path.recvSocket = -1;
+        path.followsPrimary = false;
+        path.interfaceAddr = 0;
+        path.interfaceIndex = 0;
+        path.interfaceMTU = 1500;
+        memset(&path.dest, 0, sizeof(path.dest));
+        path.sendErrors = 0;
+    }
 }
 
 NetworkManager::~NetworkManager() {
@@ -28,68 +37,45 @@ NetworkManager::~NetworkManager() {
 
 bool NetworkManager::initialize(const std::string& addr, uint16_t port, const std::string& interface) {
     // Store configuration
-    this->multicastAddr = addr;
+    paths[0].multicastAddr = addr;
     this->port = port;
     
+    if (pathCount > 1 && paths[1].followsPrimary) {
+        paths[1].multicastAddr = addr;
+    }
+    
     // Set the interface if provided
     if (!interface.empty() && !setInterface(interface)) {
         return false;
     }
     
-    // Create sockets
+    // Create the send socket, shared by every path
     sendSocket = socket(AF_INET, SOCK_DGRAM, 0);
     if (sendSocket < 0) {
         std::cerr << "Failed to create send socket: " << strerror(errno) << std::endl;
         return false;
     }
     
-    recvSocket = socket(AF_INET, SOCK_DGRAM, 0);
-    if (recvSocket < 0) {
-        std::cerr << "Failed to create receive socket: " << strerror(errno) << std::endl;
-        close(sendSocket);
-        sendSocket = -1;
-        return false;
-    }
-    
     // Configure sockets
     if (!setSocketOptions()) {
         shutdown();
         return false;
     }
     
-    // Join multicast group for receiving
-    if (!joinMulticastGroup()) {
-        shutdown();
-        return false;
-    }
-    
-    // Bind receive socket to port
-    struct sockaddr_in addr_in;
-    memset(&addr_in, 0, sizeof(addr_in));
-    addr_in.sin_family = AF_INET;
-    addr_in.sin_port = htons(port);
-    addr_in.sin_addr.s_addr = INADDR_ANY;
-    
-    if (bind(recvSocket, (struct sockaddr*)&addr_in, sizeof(addr_in)) < 0) {
-        std::cerr << "Failed to bind receive socket: " << strerror(errno) << std::endl;
-        shutdown();
-        return false;
-    }
-    
-    // Connect send socket to destination
-    memset(&addr_in, 0, sizeof(addr_in));
-    addr_in.sin_family = AF_INET;
-    addr_in.sin_port = htons(port);
-    if (inet_aton(multicastAddr.c_str(), &addr_in.sin_addr) == 0) {
-        std::cerr << "Invalid multicast address: " << multicastAddr << std::endl;
-        shutdown();
-        return false;
+    // Open a receive socket and destination for each network
+    for (int i = 0; i < pathCount; i++) {
+        if (!openPath(paths[i])) {
+            shutdown();
+            return false;
+        }
     }
     
-    if (connect(sendSocket, (struct sockaddr*)&addr_in, sizeof(addr_in)) < 0) {
-        std::cerr << "Failed to connect send socket: " << strerror(errno) << std::endl;
-        shutdown();
-        return false;
+    if (pathCount > 1) {
+        std::cout << "ST 2022-7 redundancy: primary " << paths[0].multicastAddr
+                  << " (" << (paths[0].interfaceName.empty() ? "default" : paths[0].interfaceName)
+                  << "), secondary " << paths[1].multicastAddr
+                  << " (" << (paths[1].interfaceName.empty() ? "default" : paths[1].interfaceName)
+                  << ")" << std::endl;
     }
     
     active = true;
@@ -104,9 +90,11 @@ void NetworkManager::shutdown() {
         sendSocket = -1;
     }
     
-    if (recvSocket >= 0) {
-        close(recvSocket);
-        recvSocket = -1;
+    for (auto& path : paths) {
+        if (path.recvSocket >= 0) {
+            close(path.recvSocket);
+            path.recvSocket = -1;
+        }
     }
 }
 
@@ -115,35 +103,105 @@ bool NetworkManager::sendPacket(const void* data, size_t size) {
         return false;
     }
     
-    ssize_t result = send(sendSocket, data, size, 0);
-    if (result < 0) {
-        std::cerr << "Failed to send packet: " << strerror(errno) << std::endl;
-        return false;
+    // A single path needs no per-copy interface, so it can go through the
+    // engine's registered buffers
+    if (pathCount == 1) {
+        if (!io->send(sendSocket, data, size, &paths[0].dest)) {
+            paths[0].sendErrors++;
+            return false;
+        }
+        return true;
+    }
+    
+    // One message per path, sent together with a single sendmmsg()
+    struct mmsghdr msgs[MAX_PATHS];
+    struct iovec iov[MAX_PATHS];
+    alignas(struct cmsghdr) uint8_t control[MAX_PATHS][CMSG_SPACE(sizeof(struct in_pktinfo))];
+    
+    memset(msgs, 0, sizeof(msgs));
+    
+    for (int i = 0; i < pathCount; i++) {
+        Path& path = paths[i];
+        
+        iov[i].iov_base = const_cast<void*>(data);
+        iov[i].iov_len = size;
+        
+        msgs[i].msg_hdr.msg_name = &path.dest;
+        msgs[i].msg_hdr.msg_namelen = sizeof(path.dest);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        
+        // Select the outgoing interface for this copy
+        if (path.interfaceIndex != 0) {
+            memset(control[i], 0, sizeof(control[i]));
+            msgs[i].msg_hdr.msg_control = control[i];
+            msgs[i].msg_hdr.msg_controllen = sizeof(control[i]);
+            
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+            cmsg->cmsg_level = IPPROTO_IP;
+            cmsg->cmsg_type = IP_PKTINFO;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+            
+            struct in_pktinfo* info = reinterpret_cast<struct in_pktinfo*>(CMSG_DATA(cmsg));
+            info->ipi_ifindex = path.interfaceIndex;
+            info->ipi_spec_dst.s_addr = path.interfaceAddr;
+        }
+    }
+    
+    int sent = sendmmsg(sendSocket, msgs, pathCount, 0);
+    if (sent < 0) {
+        AES67_LOG_ERROR("Failed to send packet: %s", strerror(errno));
+        sent = 0;
+    }
+    
+    // Anything not sent counts against its path; one good path is enough
+    bool ok = false;
+    for (int i = 0; i < pathCount; i++) {
+        if (i < sent && msgs[i].msg_len == size) {
+            ok = true;
+        } else {
+            paths[i].sendErrors++;
+        }
     }
     
-    return static_cast<size_t>(result) == size;
+    return ok;
 }
 
-bool NetworkManager::receivePacket(void* buffer, size_t maxSize, size_t& bytesRead) {
-    if (!active || recvSocket < 0) {
+uint64_t NetworkManager::getSendErrors(int path) const {
+    // Sends through the engine can also fail after they were queued
+    return paths[path].sendErrors + (path == 0 ? io->getSendErrors() : 0);
+}
+
+bool NetworkManager::setInterface(const std::string& ifName) {
+    paths[0].interfaceName = ifName;
+    return getInterfaceInfo(paths[0]);
+}
+
+bool NetworkManager::setSecondaryPath(const std::string& addr, const std::string& ifName) {
+    if (active) {
+        std::cerr << "Cannot add a secondary path while active" << std::endl;
         return false;
     }
     
-    ssize_t result = recv(recvSocket, buffer, maxSize, 0);
-    if (result < 0) {
-        std::cerr << "Failed to receive packet: " << strerror(errno) << std::endl;
+    if (addr.empty() && ifName.empty()) {
+        pathCount = 1;
+        return true;
+    }
+    
+    // The secondary network carries the same stream, on its own group if given
+    Path& path = paths[1];
+    path.multicastAddr = addr;
+    path.followsPrimary = addr.empty();
+    path.interfaceName = ifName;
+    
+    if (!getInterfaceInfo(path)) {
         return false;
     }
     
-    bytesRead = static_cast<size_t>(result);
+    pathCount = 2;
     return true;
 }
 
-bool NetworkManager::setInterface(const std::string& ifName) {
-    interfaceName = ifName;
-    return getInterfaceInfo();
-}
-
 std::vector<std::string> NetworkManager::getAvailableInterfaces() const {
     std::vector<std::string> interfaces;
     struct ifaddrs* ifap = nullptr;
@@ -164,22 +222,68 @@ std::vector<std::string> NetworkManager::getAvailableInterfaces() const {
     return interfaces;
 }
 
-bool NetworkManager::joinMulticastGroup() {
+bool NetworkManager::openPath(Path& path) {
+    path.recvSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (path.recvSocket < 0) {
+        std::cerr << "Failed to create receive socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    
+    // Allow reuse of address/port, both paths may share a group and port
+    int optval = 1;
+    if (setsockopt(path.recvSocket, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) < 0) {
+        std::cerr << "Failed to set SO_REUSEADDR: " << strerror(errno) << std::endl;
+        return false;
+    }
+    
+    // Only deliver groups joined on this socket, so each socket sees its own network
+    optval = 0;
+    if (setsockopt(path.recvSocket, IPPROTO_IP, IP_MULTICAST_ALL, &optval, sizeof(optval)) < 0) {
+        std::cerr << "Failed to clear IP_MULTICAST_ALL: " << strerror(errno) << std::endl;
+        // Non-critical, continue anyway
+    }
+    
+    // Join multicast group for receiving
+    if (!joinMulticastGroup(path)) {
+        return false;
+    }
+    
+    // Bind receive socket to the group and port
+    struct sockaddr_in addr_in;
+    memset(&addr_in, 0, sizeof(addr_in));
+    addr_in.sin_family = AF_INET;
+    addr_in.sin_port = htons(port);
+    if (inet_aton(path.multicastAddr.c_str(), &addr_in.sin_addr) == 0) {
+        std::cerr << "Invalid multicast address: " << path.multicastAddr << std::endl;
+        return false;
+    }
+    
+    if (bind(path.recvSocket, (struct sockaddr*)&addr_in, sizeof(addr_in)) < 0) {
+        std::cerr << "Failed to bind receive socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    
+    // Destination for transmitted copies on this path
+    path.dest = addr_in;
+    return true;
+}
+
+bool NetworkManager::joinMulticastGroup(Path& path) {
     struct ip_mreqn mreq;
     memset(&mreq, 0, sizeof(mreq));
     
     // Set the multicast group address
-    if (inet_aton(multicastAddr.c_str(), &mreq.imr_multiaddr) == 0) {
-        std::cerr << "Invalid multicast address: " << multicastAddr << std::endl;
+    if (inet_aton(path.multicastAddr.c_str(), &mreq.imr_multiaddr) == 0) {
+        std::cerr << "Invalid multicast address: " << path.multicastAddr << std::endl;
         return false;
     }
     
     // Set the interface
-    mreq.imr_address.s_addr = interfaceAddr;
-    mreq.imr_ifindex = interfaceIndex;
+    mreq.imr_address.s_addr = path.interfaceAddr;
+    mreq.imr_ifindex = path.interfaceIndex;
     
     // Join the multicast group
-    if (setsockopt(recvSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+    if (setsockopt(path.recvSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
         std::cerr << "Failed to join multicast group: " << strerror(errno) << std::endl;
         return false;
     }
@@ -188,12 +292,7 @@ bool NetworkManager::joinMulticastGroup() {
 }
 
 bool NetworkManager::setSocketOptions() {
-    // Allow reuse of address/port
-    int optval = 1;
-    if (setsockopt(recvSocket, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) < 0) {
-        std::cerr << "Failed to set SO_REUSEADDR: " << strerror(errno) << std::endl;
-        return false;
-    }
+    int optval;
     
     // Set multicast TTL
     optval = 32;
@@ -202,10 +301,10 @@ bool NetworkManager::setSocketOptions() {
         return false;
     }
     
-    // Set outgoing interface
-    if (interfaceAddr != 0) {
+    // Set default outgoing interface (per-path copies override it with IP_PKTINFO)
+    if (paths[0].interfaceAddr != 0) {
         struct in_addr addr;
-        addr.s_addr = interfaceAddr;
+        addr.s_addr = paths[0].interfaceAddr;
         if (setsockopt(sendSocket, IPPROTO_IP, IP_MULTICAST_IF, &addr, sizeof(addr)) < 0) {
             std::cerr << "Failed to set multicast interface: " << strerror(errno) << std::endl;
             return false;
@@ -222,18 +321,18 @@ bool NetworkManager::setSocketOptions() {
     return true;
 }
 
-bool NetworkManager::getInterfaceInfo() {
-    if (interfaceName.empty()) {
+bool NetworkManager::getInterfaceInfo(Path& path) {
+    if (path.interfaceName.empty()) {
         // Default to any available interface
-        interfaceAddr = INADDR_ANY;
-        interfaceIndex = 0;
+        path.interfaceAddr = INADDR_ANY;
+        path.interfaceIndex = 0;
         return true;
     }
     
     // Get interface information
     struct ifreq ifr;
     memset(&ifr, 0, sizeof(ifr));
-    strncpy(ifr.ifr_name, interfaceName.c_str(), IFNAMSIZ - 1);
+    strncpy(ifr.ifr_name, path.interfaceName.c_str(), IFNAMSIZ - 1);
     
     int tempSocket = socket(AF_INET, SOCK_DGRAM, 0);
     if (tempSocket < 0) {
@@ -247,7 +346,7 @@ bool NetworkManager::getInterfaceInfo() {
         close(tempSocket);
         return false;
     }
-    interfaceIndex = ifr.ifr_ifindex;
+    path.interfaceIndex = ifr.ifr_ifindex;
     
     // Get interface address
     if (ioctl(tempSocket, SIOCGIFADDR, &ifr) < 0) {
@@ -255,15 +354,15 @@ bool NetworkManager::getInterfaceInfo() {
         close(tempSocket);
         return false;
     }
-    interfaceAddr = ((struct sockaddr_in*)&ifr.ifr_addr)->sin_addr.s_addr;
+    path.interfaceAddr = ((struct sockaddr_in*)&ifr.ifr_addr)->sin_addr.s_addr;
     
     // Get interface MTU
     if (ioctl(tempSocket, SIOCGIFMTU, &ifr) < 0) {
         std::cerr << "Failed to get interface MTU: " << strerror(errno) << std::endl;
         // Non-critical, use default
-        interfaceMTU = 1500;
+        path.interfaceMTU = 1500;
     } else {
-        interfaceMTU = ifr.ifr_mtu;
+        path.interfaceMTU = ifr.ifr_mtu;
     }
     
     close(tempSocket);
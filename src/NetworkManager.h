@@ -5,56 +5,80 @@
 #include <cstdint>
 #include <atomic>
 #include <vector>
+#include <array>
 #include <thread>
 #include <mutex>
+#include <memory>
+#include <netinet/in.h>
+#include "IOEngine.h"
 
 namespace aes67 {
 
 class NetworkManager {
 public:
+    // SMPTE ST 2022-7 paths: primary and optional secondary network
+    static constexpr int MAX_PATHS = 2;
+
     NetworkManager();
     ~NetworkManager();
 
     // Socket configuration
     bool initialize(const std::string& multicastAddr, uint16_t port, const std::string& interface = "");
     void shutdown();
-    
+
     // Socket operations
     bool sendPacket(const void* data, size_t size);
-    bool receivePacket(void* buffer, size_t maxSize, size_t& bytesRead);
-    
+
+    // Receive sockets, one per path, read by the caller's reactor
+    int getReceiveSocket(int path) const { return paths[path].recvSocket; }
+
     // Interface management
     bool setInterface(const std::string& interfaceName);
+    bool setSecondaryPath(const std::string& multicastAddr, const std::string& interfaceName);
     std::vector<std::string> getAvailableInterfaces() const;
-    
+
     // Status
     bool isActive() const { return active; }
-    const std::string& getMulticastAddress() const { return multicastAddr; }
+    bool isRedundant() const { return pathCount > 1; }
+    int getPathCount() const { return pathCount; }
+    const std::string& getMulticastAddress() const { return paths[0].multicastAddr; }
     uint16_t getPort() const { return port; }
-    const std::string& getInterface() const { return interfaceName; }
-    
+    const std::string& getInterface() const { return paths[0].interfaceName; }
+    uint64_t getSendErrors(int path) const;
+
 private:
-    // Socket descriptors
+    // Per-network state
+    struct Path {
+        int recvSocket;
+        std::string multicastAddr;
+        std::string interfaceName;
+        bool followsPrimary;     // Group tracks the primary address
+        uint32_t interfaceAddr;  // Interface IP address
+        uint32_t interfaceIndex; // Interface index
+        uint32_t interfaceMTU;   // Interface MTU
+        struct sockaddr_in dest; // Multicast destination
+        std::atomic<uint64_t> sendErrors;
+    };
+
+    // Socket descriptors (one sender serves every path)
     int sendSocket;
-    int recvSocket;
-    
+
     // Configuration
-    std::string multicastAddr;
     uint16_t port;
-    std::string interfaceName;
-    
-    // Interface information
-    uint32_t interfaceAddr;  // Interface IP address
-    uint32_t interfaceIndex; // Interface index
-    uint32_t interfaceMTU;   // Interface MTU
-    
+    std::array<Path, MAX_PATHS> paths;
+    int pathCount;
+
+    // Transmit through registered buffers
+    std::unique_ptr<IOEngine> io;
+
     // Status
     std::atomic<bool> active;
-    
+
     // Helper functions
-    bool joinMulticastGroup();
+    bool openPath(Path& path);
+    bool joinMulticastGroup(Path& path);
     bool setSocketOptions();
-    bool getInterfaceInfo();
+    bool getInterfaceInfo(Path& path);
 };
 
 } // namespace aes67
@@ -0,0 +1,325 @@
+// OSCServer.cpp
+#include "OSCServer.h"
+#include "AES67Bridge.h"
+#include "Realtime.h"
+#include "Tracer.h"
+#include <cstring>
+#include <iostream>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <poll.h>
+
+namespace aes67 {
+
+namespace {
+
+// How long the server waits for a packet before rechecking for shutdown
+constexpr int POLL_TIMEOUT_MS = 250;
+
+// OSC strings and blobs are padded to a multiple of four bytes
+size_t padded(size_t length) {
+    return (length + 4) & ~static_cast<size_t>(3);
+}
+
+// Read a padded OSC string, advancing offset
+bool readString(const uint8_t* data, size_t size, size_t& offset, std::string& out) {
+    if (offset >= size) {
+        return false;
+    }
+    const void* end = memchr(data + offset, '\0', size - offset);
+    if (!end) {
+        return false;
+    }
+    size_t length = static_cast<const uint8_t*>(end) - (data + offset);
+    out.assign(reinterpret_cast<const char*>(data + offset), length);
+    offset += padded(length);
+    return offset <= size;
+}
+
+void writeString(std::vector<uint8_t>& out, const std::string& value) {
+    size_t start = out.size();
+    out.resize(start + padded(value.size()), 0);
+    memcpy(out.data() + start, value.data(), value.size());
+}
+
+void writeInt(std::vector<uint8_t>& out, uint32_t value) {
+    uint32_t be = htonl(value);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&be);
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+} // namespace
+
+OSCServer::OSCServer(AES67Bridge& b)
+    : bridge(b), socketFd(-1), port(0), active(false)
+{
+}
+
+OSCServer::~OSCServer() {
+    stop();
+}
+
+bool OSCServer::start(uint16_t listenPort, const std::string& bindAddress) {
+    if (active) {
+        return true;
+    }
+
+    socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socketFd < 0) {
+        std::cerr << "Failed to create OSC socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(listenPort);
+    addr.sin_addr.s_addr = inet_addr(bindAddress.c_str());
+
+    if (bind(socketFd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "Failed to bind OSC socket to " << bindAddress << ":" << listenPort
+                  << ": " << strerror(errno) << std::endl;
+        close(socketFd);
+        socketFd = -1;
+        return false;
+    }
+
+    port = listenPort;
+    active = true;
+    serverThread = std::thread(&OSCServer::serverLoop, this);
+
+    std::cout << "OSC server: " << bindAddress << ":" << port << std::endl;
+    return true;
+}
+
+void OSCServer::stop() {
+    if (!active) {
+        return;
+    }
+
+    active = false;
+
+    if (serverThread.joinable()) {
+        serverThread.join();
+    }
+
+    if (socketFd >= 0) {
+        close(socketFd);
+        socketFd = -1;
+    }
+}
+
+void OSCServer::serverLoop() {
+    uint8_t buffer[2048];
+
+    realtime::configureBackgroundThread("aes67-osc");
+
+    while (active) {
+        struct pollfd pfd;
+        pfd.fd = socketFd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        if (poll(&pfd, 1, POLL_TIMEOUT_MS) <= 0) {
+            continue;
+        }
+
+        struct sockaddr_in from;
+        socklen_t fromLength = sizeof(from);
+        ssize_t len = recvfrom(socketFd, buffer, sizeof(buffer), MSG_DONTWAIT,
+                               (struct sockaddr*)&from, &fromLength);
+        if (len > 0) {
+            handlePacket(buffer, static_cast<size_t>(len), from);
+        }
+    }
+}
+
+void OSCServer::handlePacket(const uint8_t* data, size_t size, const struct sockaddr_in& from) {
+    // Bundles: "#bundle", 8-byte time tag, then size-prefixed elements
+    if (size >= 16 && memcmp(data, "#bundle", 8) == 0) {
+        size_t offset = 16;
+        while (offset + 4 <= size) {
+            uint32_t length;
+            memcpy(&length, data + offset, sizeof(length));
+            length = ntohl(length);
+            offset += 4;
+            if (length > size - offset) {
+                return;
+            }
+            handlePacket(data + offset, length, from);
+            offset += length;
+        }
+        return;
+    }
+
+    std::string address;
+    std::vector<Argument> args;
+    if (!parseMessage(data, size, address, args)) {
+        return;
+    }
+
+    handleMessage(address, args, from);
+}
+
+void OSCServer::handleMessage(const std::string& address, const std::vector<Argument>& args,
+                              const struct sockaddr_in& from) {
+    auto numeric = [&](size_t index) {
+        return index < args.size() && (args[index].type == 'i' || args[index].type == 'f');
+    };
+
+    if (address == "/aes67/gain" && numeric(0)) {
+        if (!bridge.setOutputGain(args[0].asFloat())) {
+            sendError(from, "gain rejected");
+        }
+    } else if (address == "/aes67/mute" && numeric(0)) {
+        bridge.setMute(args[0].asInt() != 0);
+    } else if (address == "/aes67/buffer/target" && numeric(0)) {
+        if (!bridge.setBufferTarget(args[0].asFloat())) {
+            sendError(from, "buffer target rejected");
+        }
+    } else if (address == "/aes67/subscribe" && !args.empty() && args[0].type == 's') {
+        // The session's group would become the outgoing stream's destination
+        if (bridge.isNetworkActive() && bridge.getConfig().mode == StreamConfig::Mode::Transmit) {
+            sendError(from, "cannot subscribe while transmitting");
+            return;
+        }
+        
+        // Sessions already in the directory resolve at once
+        int timeoutMs = numeric(1) ? args[1].asInt() : 0;
+        if (!bridge.subscribeSession(args[0].s, timeoutMs)) {
+            sendError(from, "session not found: " + args[0].s);
+            return;
+        }
+        if (!bridge.isNetworkActive()) {
+            bridge.setMode(false);
+            if (!bridge.startNetworking()) {
+                sendError(from, "failed to start receiving");
+                return;
+            }
+        }
+        sendMessage(from, "/aes67/subscribed", { { 's', 0, 0.0f, args[0].s } });
+    } else if (address == "/aes67/unsubscribe") {
+        bridge.stopNetworking();
+        sendMessage(from, "/aes67/unsubscribed", {});
+    } else if (address == "/aes67/sessions") {
+        for (const auto& session : bridge.getDiscovery().getSessions()) {
+            sendMessage(from, "/aes67/session", {
+                { 's', 0, 0.0f, session.name },
+                { 's', 0, 0.0f, session.group },
+                { 'i', session.port, 0.0f, "" } });
+        }
+    } else if (address == "/aes67/status") {
+        sendMessage(from, "/aes67/status", {
+            { 'f', 0, bridge.getBufferLevel(), "" },
+            { 'i', bridge.getPacketCount(), 0.0f, "" },
+            { 'i', bridge.getDroppedPackets(), 0.0f, "" },
+            { 'i', static_cast<int32_t>(bridge.getConcealedFrames()), 0.0f, "" },
+            { 'i', bridge.isPTPSynchronized() ? 1 : 0, 0.0f, "" },
+            { 'f', 0, bridge.getOutputGain(), "" },
+            { 'i', bridge.isMuted() ? 1 : 0, 0.0f, "" },
+            { 'f', 0, bridge.getLatencyTarget(), "" },
+            { 'f', 0, bridge.getJitter(), "" } });
+    } else if (address == "/aes67/trace/dump") {
+        if (!Tracer::isRunning()) {
+            sendError(from, "tracing not enabled");
+            return;
+        }
+        Tracer::requestDump();
+    } else {
+        sendError(from, "unknown command: " + address);
+    }
+}
+
+void OSCServer::sendMessage(const struct sockaddr_in& to, const std::string& address,
+                            const std::vector<Argument>& args) {
+    std::vector<uint8_t> packet;
+    packet.reserve(256);
+
+    writeString(packet, address);
+
+    std::string tags = ",";
+    for (const auto& arg : args) {
+        tags += arg.type;
+    }
+    writeString(packet, tags);
+
+    for (const auto& arg : args) {
+        switch (arg.type) {
+            case 'i':
+                writeInt(packet, static_cast<uint32_t>(arg.i));
+                break;
+            case 'f': {
+                uint32_t bits;
+                memcpy(&bits, &arg.f, sizeof(bits));
+                writeInt(packet, bits);
+                break;
+            }
+            case 's':
+                writeString(packet, arg.s);
+                break;
+        }
+    }
+
+    // Never wait on a slow client
+    sendto(socketFd, packet.data(), packet.size(), MSG_DONTWAIT,
+           (const struct sockaddr*)&to, sizeof(to));
+}
+
+void OSCServer::sendError(const struct sockaddr_in& to, const std::string& message) {
+    sendMessage(to, "/aes67/error", { { 's', 0, 0.0f, message } });
+}
+
+bool OSCServer::parseMessage(const uint8_t* data, size_t size, std::string& address,
+                             std::vector<Argument>& args) {
+    size_t offset = 0;
+    if (size < 4 || data[0] != '/' || !readString(data, size, offset, address)) {
+        return false;
+    }
+
+    // Messages without a type tag string carry no arguments
+    std::string tags;
+    if (offset >= size) {
+        return true;
+    }
+    if (!readString(data, size, offset, tags) || tags.empty() || tags[0] != ',') {
+        return false;
+    }
+
+    for (size_t t = 1; t < tags.size(); t++) {
+        Argument arg = { tags[t], 0, 0.0f, "" };
+
+        switch (tags[t]) {
+            case 'i':
+            case 'f': {
+                if (offset + 4 > size) {
+                    return false;
+                }
+                uint32_t bits;
+                memcpy(&bits, data + offset, sizeof(bits));
+                bits = ntohl(bits);
+                offset += 4;
+                if (tags[t] == 'i') {
+                    arg.i = static_cast<int32_t>(bits);
+                } else {
+                    memcpy(&arg.f, &bits, sizeof(arg.f));
+                }
+                break;
+            }
+            case 's':
+                if (!readString(data, size, offset, arg.s)) {
+                    return false;
+                }
+                break;
+            default:
+                // Unsupported argument types end parsing; earlier ones still apply
+                return true;
+        }
+
+        args.push_back(arg);
+    }
+
+    return true;
+}
+
+} // namespace aes67
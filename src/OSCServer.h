@@ -0,0 +1,72 @@
+// OSCServer.h
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <netinet/in.h>
+
+namespace aes67 {
+
+class AES67Bridge;
+
+// Local UDP OSC control server for norns.
+//
+// Runs on its own low-priority thread. Gain, mute and buffer target are
+// queued to the JACK thread through the bridge's SPSC command queue;
+// subscribe and unsubscribe publish a new stream config. Replies are sent
+// from this thread, so no OSC work ever reaches process().
+//
+//   /aes67/gain f            output gain, linear 0..4
+//   /aes67/mute i            1 mutes, 0 unmutes
+//   /aes67/buffer/target f   fixed playout depth in milliseconds, 0 for adaptive
+//   /aes67/subscribe s [i]   receive a SAP session by name, optional wait in ms;
+//                            refused while transmitting
+//   /aes67/unsubscribe       stop receiving
+//   /aes67/sessions          reply /aes67/session s s i per known session
+//   /aes67/status            reply /aes67/status f i i i i f i f f
+//   /aes67/trace/dump        write the recent event trace (tracing builds)
+class OSCServer {
+public:
+    explicit OSCServer(AES67Bridge& bridge);
+    ~OSCServer();
+
+    bool start(uint16_t port, const std::string& bindAddress = "127.0.0.1");
+    void stop();
+
+    bool isActive() const { return active; }
+    uint16_t getPort() const { return port; }
+
+private:
+    // One OSC argument
+    struct Argument {
+        char type;          // 'i', 'f' or 's'
+        int32_t i;
+        float f;
+        std::string s;
+
+        float asFloat() const { return type == 'f' ? f : static_cast<float>(i); }
+        int32_t asInt() const { return type == 'i' ? i : static_cast<int32_t>(f); }
+    };
+
+    AES67Bridge& bridge;
+    int socketFd;
+    uint16_t port;
+    std::atomic<bool> active;
+    std::thread serverThread;
+
+    // Helper functions
+    void serverLoop();
+    void handlePacket(const uint8_t* data, size_t size, const struct sockaddr_in& from);
+    void handleMessage(const std::string& address, const std::vector<Argument>& args,
+                       const struct sockaddr_in& from);
+    void sendMessage(const struct sockaddr_in& to, const std::string& address,
+                     const std::vector<Argument>& args);
+    void sendError(const struct sockaddr_in& to, const std::string& message);
+    static bool parseMessage(const uint8_t* data, size_t size, std::string& address,
+                             std::vector<Argument>& args);
+};
+
+} // namespace aes67
@@ -0,0 +1,442 @@
+// PTPMaster.cpp
+#include "PTPMaster.h"
+#include "PTPSync.h"
+#include "Logger.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace aes67 {
+
+namespace {
+
+// TAI minus UTC since 2017, for a timescale taken from the system clock
+constexpr int16_t UTC_OFFSET = 37;
+
+// Announce timeSource: free-running internal oscillator
+constexpr uint8_t TIME_SOURCE_INTERNAL = 0xA0;
+
+// 802.1AS TLVs: the Follow_Up information and the Announce path trace
+constexpr uint16_t TLV_ORGANIZATION_EXTENSION = 0x0003;
+constexpr uint16_t TLV_PATH_TRACE = 0x0008;
+constexpr size_t PATH_TRACE_SIZE = 4 + 8;   // Type, length and our identity
+
+} // namespace
+
+PTPMaster::PTPMaster(Reactor& reactor, PTPSync* local)
+    : reactor(reactor), local(local), eventSocket(-1), generalSocket(-1), ethernetSocket(-1),
+      ethernetIndex(0), timer(-1),
+      state(STATE_DISABLED), timescaleOffset(0), listenDeadline(0), nextAnnounce(0),
+      nextSync(0), foreignDeadline(0), announceSequence(0), syncSequence(0)
+{
+    memset(&eventAddr, 0, sizeof(eventAddr));
+    memset(&generalAddr, 0, sizeof(generalAddr));
+    memset(identity, 0, sizeof(identity));
+    memset(buffer, 0, sizeof(buffer));
+}
+
+PTPMaster::~PTPMaster() {
+    shutdown();
+}
+
+void PTPMaster::setConfig(const Config& cfg) {
+    config = cfg;
+}
+
+void PTPMaster::setTransport(const Transport& replacement) {
+    transport = replacement;
+}
+
+void PTPMaster::setIdentity(const uint8_t* id) {
+    memcpy(identity, id, sizeof(identity));
+}
+
+bool PTPMaster::initialize(const std::string& interfaceName, const std::string& multicastAddr) {
+    if (!findPTPIdentity(interfaceName, identity)) {
+        std::cerr << "PTP master: no MAC address for a clock identity on "
+                  << (interfaceName.empty() ? "any interface" : interfaceName) << std::endl;
+        return false;
+    }
+
+    // One socket for everything over Ethernet
+    if (config.profile != PTP_PROFILE_UDP) {
+        ethernetSocket = openPTPEthernetSocket(interfaceName, ethernetIndex);
+        if (ethernetSocket < 0) {
+            return false;
+        }
+
+        start(Reactor::nowNs());
+        reactor.addSocket(ethernetSocket, Reactor::PRIORITY_TIMING,
+                          [this](const uint8_t* data, size_t size, uint64_t arrivalNs) {
+                              if (size > 0 && (data[0] & 0x0F) < PTP_FIRST_GENERAL) {
+                                  handleEventMessage(data, size, arrivalNs);
+                              } else {
+                                  handleGeneralMessage(data, size, arrivalNs);
+                              }
+                          });
+        timer = reactor.addTimer(Reactor::PRIORITY_TIMING, listenDeadline,
+                                 [this](uint64_t now) { return poll(now); });
+
+        std::cout << "PTP master " << formatPTPIdentity(identity) << " listening over "
+                  << ptpProfileName(config.profile) << " on " << interfaceName << ", domain "
+                  << static_cast<int>(config.domain) << ", priority " << static_cast<int>(config.priority1)
+                  << std::endl;
+        return true;
+    }
+
+    eventSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    generalSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (eventSocket < 0 || generalSocket < 0) {
+        std::cerr << "PTP master: failed to create sockets: " << strerror(errno) << std::endl;
+        shutdown();
+        return false;
+    }
+
+    // Shares the ports with PTPSync and any other PTP software on the host
+    if (!openPTPSocket(eventSocket, 319, interfaceName, multicastAddr) ||
+        !openPTPSocket(generalSocket, 320, interfaceName, multicastAddr)) {
+        shutdown();
+        return false;
+    }
+
+    eventAddr.sin_family = AF_INET;
+    eventAddr.sin_addr.s_addr = inet_addr(multicastAddr.c_str());
+    eventAddr.sin_port = htons(319);
+    generalAddr = eventAddr;
+    generalAddr.sin_port = htons(320);
+
+    // Delay requests are timestamped and answered first
+    start(Reactor::nowNs());
+    reactor.addSocket(eventSocket, Reactor::PRIORITY_TIMING,
+                      [this](const uint8_t* data, size_t size, uint64_t arrivalNs) {
+                          handleEventMessage(data, size, arrivalNs);
+                      });
+    reactor.addSocket(generalSocket, Reactor::PRIORITY_CONTROL,
+                      [this](const uint8_t* data, size_t size, uint64_t arrivalNs) {
+                          handleGeneralMessage(data, size, arrivalNs);
+                      });
+    timer = reactor.addTimer(Reactor::PRIORITY_TIMING, listenDeadline,
+                             [this](uint64_t now) { return poll(now); });
+
+    std::cout << "PTP master " << formatPTPIdentity(identity) << " listening on domain "
+              << static_cast<int>(config.domain) << ", priority " << static_cast<int>(config.priority1)
+              << std::endl;
+    return true;
+}
+
+void PTPMaster::shutdown() {
+    if (timer >= 0) {
+        reactor.removeTimer(timer);
+        timer = -1;
+    }
+
+    // Close sockets, once the reactor has let go of them
+    if (ethernetSocket >= 0) {
+        reactor.removeSocket(ethernetSocket);
+        close(ethernetSocket);
+        ethernetSocket = -1;
+    }
+    if (eventSocket >= 0) {
+        reactor.removeSocket(eventSocket);
+        close(eventSocket);
+        eventSocket = -1;
+    }
+    if (generalSocket >= 0) {
+        reactor.removeSocket(generalSocket);
+        close(generalSocket);
+        generalSocket = -1;
+    }
+
+    // Hand the local clock back on the thread PTPSync runs on
+    reactor.run([this]() {
+        if (state == STATE_MASTER && local) {
+            local->clearLocalMaster();
+        }
+        state = STATE_DISABLED;
+    });
+}
+
+const char* PTPMaster::stateName(State state) {
+    switch (state) {
+        case STATE_DISABLED:  return "disabled";
+        case STATE_LISTENING: return "listening";
+        case STATE_MASTER:    return "master";
+        case STATE_PASSIVE:   return "passive";
+    }
+    return "unknown";
+}
+
+void PTPMaster::start(uint64_t now) {
+    // Give any master already on the network the chance to announce itself
+    state = STATE_LISTENING;
+    listenDeadline = now + config.announceReceiptTimeout * ptpIntervalNs(config.logAnnounceInterval);
+}
+
+uint64_t PTPMaster::poll(uint64_t now) {
+    if (state == STATE_DISABLED) {
+        return 0;
+    }
+    if (state == STATE_LISTENING) {
+        if (now < listenDeadline) {
+            return listenDeadline;
+        }
+        becomeMaster(now);
+    }
+    if (state == STATE_PASSIVE) {
+        if (now < foreignDeadline) {
+            return foreignDeadline;
+        }
+        AES67_LOG_INFO("PTP master: better master timed out");
+        becomeMaster(now);
+    }
+
+    if (now >= nextAnnounce) {
+        sendAnnounce();
+        nextAnnounce = std::max(nextAnnounce + ptpIntervalNs(config.logAnnounceInterval), now + 1);
+    }
+    if (now >= nextSync) {
+        sendSync();
+        nextSync = std::max(nextSync + ptpIntervalNs(config.logSyncInterval), now + 1);
+    }
+    return std::min(nextAnnounce, nextSync);
+}
+
+void PTPMaster::becomeMaster(uint64_t now) {
+    // Carry on the time of the master we followed, else TAI from the system clock
+    if (transport.nowNs) {
+        timescaleOffset = 0;
+    } else if (local && local->hasOffset()) {
+        timescaleOffset = local->getTimescaleOffset();
+    } else {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        int64_t tai = (static_cast<int64_t>(ts.tv_sec) + UTC_OFFSET) * 1000000000LL + ts.tv_nsec;
+        timescaleOffset = tai - static_cast<int64_t>(Reactor::nowNs());
+    }
+
+    state = STATE_MASTER;
+    nextAnnounce = now;
+    nextSync = now;
+    if (local) {
+        local->setLocalMaster(identity, timescaleOffset);
+    }
+
+    AES67_LOG_INFO("PTP master: %s is grandmaster", formatPTPIdentity(identity).c_str());
+    AES67_TRACE_INSTANT("ptp master state", STATE_MASTER);
+}
+
+void PTPMaster::becomePassive(uint64_t now, const PTPClockDataset& better, int8_t logAnnounceInterval) {
+    if (state != STATE_PASSIVE) {
+        if (state == STATE_MASTER && local) {
+            local->clearLocalMaster();
+        }
+        state = STATE_PASSIVE;
+        AES67_LOG_INFO("PTP master: passive, %s is better", formatPTPIdentity(better.identity).c_str());
+        AES67_TRACE_INSTANT("ptp master state", STATE_PASSIVE);
+    }
+
+    // Its own announce interval
+    foreignDeadline = now + config.announceReceiptTimeout * ptpIntervalNs(logAnnounceInterval);
+}
+
+PTPClockDataset PTPMaster::ownDataset() const {
+    PTPClockDataset dataset;
+    dataset.priority1 = config.priority1;
+    dataset.clockClass = config.clockClass;
+    dataset.clockAccuracy = config.clockAccuracy;
+    dataset.offsetScaledLogVariance = config.offsetScaledLogVariance;
+    dataset.priority2 = config.priority2;
+    memcpy(dataset.identity, identity, sizeof(identity));
+    dataset.stepsRemoved = 0;
+    return dataset;
+}
+
+void PTPMaster::handleEventMessage(const uint8_t* data, size_t len, uint64_t arrivalNs) {
+    if (state != STATE_MASTER || len < sizeof(PTPHeader) + sizeof(PTPTimestamp)) {
+        return;
+    }
+
+    const PTPHeader* header = reinterpret_cast<const PTPHeader*>(data);
+    if (!acceptPTPMessage(*header, config.domain, config.profile)) {
+        return;
+    }
+
+    if ((header->messageType & 0x0F) == PTP_DELAY_REQ) {
+        sendDelayResponse(*header, arrivalNs);
+    }
+}
+
+void PTPMaster::handleGeneralMessage(const uint8_t* data, size_t len, uint64_t arrivalNs) {
+    if (state == STATE_DISABLED || len < sizeof(PTPHeader) + sizeof(PTPAnnounce)) {
+        return;
+    }
+
+    const PTPHeader* header = reinterpret_cast<const PTPHeader*>(data);
+    if (!acceptPTPMessage(*header, config.domain, config.profile) ||
+        (header->messageType & 0x0F) != PTP_ANNOUNCE) {
+        return;
+    }
+
+    // Our own Announce, back over multicast loopback
+    if (memcmp(header->sourcePortId, identity, sizeof(identity)) == 0) {
+        return;
+    }
+
+    const PTPAnnounce* announce = reinterpret_cast<const PTPAnnounce*>(data + sizeof(PTPHeader));
+    PTPClockDataset foreign = readPTPAnnounce(*announce);
+    if (foreign.stepsRemoved >= 255) {
+        return;
+    }
+
+    if (comparePTPDatasets(foreign, ownDataset()) < 0) {
+        becomePassive(arrivalNs, foreign, header->logMessageInt);
+    } else if (state == STATE_LISTENING) {
+        // Only worse masters about, no need to wait out the listening period
+        becomeMaster(arrivalNs);
+        wake();
+    }
+}
+
+size_t PTPMaster::writeHeader(PTPMessageType type, uint8_t control, int8_t logInterval,
+                              uint16_t sequence, size_t bodySize) {
+    size_t size = sizeof(PTPHeader) + bodySize;
+    memset(buffer, 0, size);
+
+    PTPHeader* header = reinterpret_cast<PTPHeader*>(buffer);
+    header->messageType = type | (config.profile == PTP_PROFILE_GPTP ? PTP_TRANSPORT_GPTP : 0);
+    header->versionPTP = 2;
+    header->messageLength = htons(static_cast<uint16_t>(size));
+    header->domainNumber = config.domain;
+    memcpy(header->sourcePortId, identity, sizeof(identity));
+    header->sourcePortId[9] = 1;    // Port 1
+    header->sequenceId = htons(sequence);
+    header->control = control;
+    header->logMessageInt = logInterval;
+    return size;
+}
+
+void PTPMaster::sendAnnounce() {
+    bool gptp = config.profile == PTP_PROFILE_GPTP;
+    size_t size = writeHeader(PTP_ANNOUNCE, 5, config.logAnnounceInterval, announceSequence++,
+                              sizeof(PTPAnnounce) + (gptp ? PATH_TRACE_SIZE : 0));
+    PTPHeader* header = reinterpret_cast<PTPHeader*>(buffer);
+    header->flags = htons(PTP_FLAG_TIMESCALE);
+
+    PTPAnnounce* announce = reinterpret_cast<PTPAnnounce*>(buffer + sizeof(PTPHeader));
+    writePTPTimestamp(announce->originTimestamp, nowNs() + timescaleOffset);
+    announce->currentUtcOffset = htons(UTC_OFFSET);
+    announce->priority1 = config.priority1;
+    announce->clockClass = config.clockClass;
+    announce->clockAccuracy = config.clockAccuracy;
+    announce->offsetScaledLogVariance = htons(config.offsetScaledLogVariance);
+    announce->priority2 = config.priority2;
+    memcpy(announce->grandmasterIdentity, identity, sizeof(identity));
+    announce->stepsRemoved = 0;
+    announce->timeSource = TIME_SOURCE_INTERNAL;
+
+    // 802.1AS: the path so far, which is just us
+    if (gptp) {
+        uint8_t* tlv = buffer + sizeof(PTPHeader) + sizeof(PTPAnnounce);
+        uint16_t field = htons(TLV_PATH_TRACE);
+        memcpy(tlv, &field, 2);
+        field = htons(8);
+        memcpy(tlv + 2, &field, 2);
+        memcpy(tlv + 4, identity, sizeof(identity));
+    }
+    sendGeneral(size);
+}
+
+void PTPMaster::sendSync() {
+    // Two-step: the departure time goes out in the Follow_Up
+    uint16_t sequence = syncSequence++;
+    size_t size = writeHeader(PTP_SYNC, 0, config.logSyncInterval, sequence, sizeof(PTPTimestamp));
+    reinterpret_cast<PTPHeader*>(buffer)->flags = htons(PTP_FLAG_TWO_STEP);
+    if (!sendEvent(size)) {
+        return;
+    }
+
+    // Read once the send returns, closest to when it reached the wire
+    uint64_t departure = nowNs() + timescaleOffset;
+
+    bool gptp = config.profile == PTP_PROFILE_GPTP;
+    size = writeHeader(PTP_FOLLOW_UP, 2, config.logSyncInterval, sequence,
+                       sizeof(PTPTimestamp) + (gptp ? sizeof(PTPFollowUpInfo) : 0));
+    writePTPTimestamp(*reinterpret_cast<PTPTimestamp*>(buffer + sizeof(PTPHeader)), departure);
+
+    // 802.1AS: we are the grandmaster, so no rate offset or phase change to report
+    if (gptp) {
+        PTPFollowUpInfo* info = reinterpret_cast<PTPFollowUpInfo*>(buffer + sizeof(PTPHeader) + sizeof(PTPTimestamp));
+        info->tlvType = htons(TLV_ORGANIZATION_EXTENSION);
+        info->lengthField = htons(sizeof(PTPFollowUpInfo) - 4);
+        info->organizationId[0] = 0x00;
+        info->organizationId[1] = 0x80;
+        info->organizationId[2] = 0xC2;
+        info->organizationSubType[2] = 1;
+    }
+    sendGeneral(size);
+}
+
+void PTPMaster::sendDelayResponse(const PTPHeader& request, uint64_t arrivalNs) {
+    size_t size = writeHeader(PTP_DELAY_RESP, 3, config.logDelayReqInterval, ntohs(request.sequenceId),
+                              sizeof(PTPDelayResponse));
+    reinterpret_cast<PTPHeader*>(buffer)->correction = request.correction;
+
+    PTPDelayResponse* response = reinterpret_cast<PTPDelayResponse*>(buffer + sizeof(PTPHeader));
+    writePTPTimestamp(response->receiveTimestamp, arrivalNs + timescaleOffset);
+    memcpy(response->requestingPortId, request.sourcePortId, sizeof(response->requestingPortId));
+    sendGeneral(size);
+}
+
+bool PTPMaster::sendEvent(size_t size) {
+    if (transport.sendEvent) {
+        return transport.sendEvent(buffer, size);
+    }
+    if (ethernetSocket >= 0) {
+        return sendFrame(size);
+    }
+    if (sendto(eventSocket, buffer, size, 0, (struct sockaddr*)&eventAddr, sizeof(eventAddr)) <= 0) {
+        AES67_LOG_ERROR("PTP master: failed to send event message: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool PTPMaster::sendGeneral(size_t size) {
+    if (transport.sendGeneral) {
+        return transport.sendGeneral(buffer, size);
+    }
+    if (ethernetSocket >= 0) {
+        return sendFrame(size);
+    }
+    if (sendto(generalSocket, buffer, size, 0, (struct sockaddr*)&generalAddr, sizeof(generalAddr)) <= 0) {
+        AES67_LOG_ERROR("PTP master: failed to send general message: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool PTPMaster::sendFrame(size_t size) {
+    if (!sendPTPFrame(ethernetSocket, ethernetIndex, buffer, size, config.profile)) {
+        AES67_LOG_ERROR("PTP master: failed to send frame: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+uint64_t PTPMaster::nowNs() const {
+    return transport.nowNs ? transport.nowNs() : Reactor::nowNs();
+}
+
+void PTPMaster::wake() {
+    // The timer may be asleep until a later listening deadline
+    if (timer >= 0) {
+        reactor.scheduleTimer(timer, nowNs());
+    }
+}
+
+} // namespace aes67
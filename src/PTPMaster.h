@@ -0,0 +1,144 @@
+// PTPMaster.h
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <netinet/in.h>
+
+#include "Reactor.h"
+#include "PTPMessage.h"
+
+namespace aes67 {
+
+class PTPSync;
+
+// Software PTPv2 grandmaster for networks without one.
+//
+// Sends Announce, two-step Sync/Follow_Up and Delay_Resp over UDP on the
+// PTP multicast group (E2E delay mechanism). Time is the local steady clock
+// plus a fixed offset: the time of the master PTPSync last followed if it
+// had one, so receivers see no step when the master falls back to us, or
+// else CLOCK_REALTIME on the TAI timescale. The best master clock algorithm
+// runs on every Announce heard: a better grandmaster puts us in PASSIVE
+// until its Announces stop for announceReceiptTimeout intervals. Over
+// Ethernet everything goes through one AF_PACKET socket; as an 802.1AS
+// grandmaster the Follow_Up and Announce carry the TLVs that profile
+// requires, and the local PTPSync answers the neighbour's peer delay
+// requests.
+class PTPMaster {
+public:
+    enum State {
+        STATE_DISABLED = 0,
+        STATE_LISTENING,    // Waiting to hear any other master first
+        STATE_MASTER,
+        STATE_PASSIVE       // A better master is on the network
+    };
+
+    struct Config {
+        PTPProfile profile = PTP_PROFILE_UDP;
+        uint8_t domain = 0;
+        uint8_t priority1 = 128;
+        uint8_t priority2 = 128;
+        uint8_t clockClass = 248;           // Default, not locked to a reference
+        uint8_t clockAccuracy = 0xFE;       // Unknown
+        uint16_t offsetScaledLogVariance = 0xFFFF;
+        int8_t logSyncInterval = -3;        // 8 per second, the AES67 media profile
+        int8_t logAnnounceInterval = 1;
+        int8_t logDelayReqInterval = -3;
+        uint8_t announceReceiptTimeout = 3;
+    };
+
+    // Replaces the sockets and the steady clock, so a simulation can run
+    // the master on virtual time. A replaced clock is taken as PTP time.
+    struct Transport {
+        std::function<bool(const uint8_t* data, size_t size)> sendEvent;    // Port 319
+        std::function<bool(const uint8_t* data, size_t size)> sendGeneral;  // Port 320
+        std::function<uint64_t()> nowNs;
+    };
+
+    // local, if given, follows this master while it is active
+    PTPMaster(Reactor& reactor, PTPSync* local);
+    ~PTPMaster();
+
+    // Configuration and control
+    void setConfig(const Config& config);
+    void setTransport(const Transport& transport);
+    void setIdentity(const uint8_t* identity);
+
+    // The clock identity comes from the interface's MAC address, or the
+    // first one found if interfaceName is empty
+    bool initialize(const std::string& interfaceName, const std::string& multicastAddr = "224.0.1.129");
+    void shutdown();
+
+    // Without the reactor: start listening at nowNs. poll() does whatever is
+    // due and returns the next deadline; call it again after every message.
+    void start(uint64_t nowNs);
+    uint64_t poll(uint64_t nowNs);
+
+    // Message handlers; arrival times on the local clock in nanoseconds
+    void handleEventMessage(const uint8_t* data, size_t len, uint64_t arrivalNs);
+    void handleGeneralMessage(const uint8_t* data, size_t len, uint64_t arrivalNs);
+
+    // Status
+    State getState() const { return state; }
+    bool isMaster() const { return state == STATE_MASTER; }
+    const uint8_t* getIdentity() const { return identity; }
+
+    static const char* stateName(State state);
+
+private:
+    Reactor& reactor;
+    PTPSync* local;
+    Config config;
+    Transport transport;
+
+    // Socket descriptors
+    int eventSocket;
+    int generalSocket;
+    int ethernetSocket;     // All messages, over Ethernet
+    int ethernetIndex;      // Its interface
+    int timer;
+    struct sockaddr_in eventAddr;
+    struct sockaddr_in generalAddr;
+
+    uint8_t identity[8];
+    std::atomic<State> state;
+
+    // PTP time is the local clock plus this, fixed while master
+    int64_t timescaleOffset;
+
+    // Schedule, local nanoseconds
+    uint64_t listenDeadline;
+    uint64_t nextAnnounce;
+    uint64_t nextSync;
+    uint64_t foreignDeadline;   // When the better master is given up on
+
+    // Sequence counters
+    uint16_t announceSequence;
+    uint16_t syncSequence;
+
+    // Message buffer, room for an 802.1AS Announce or Follow_Up with its TLV
+    uint8_t buffer[96];
+
+    // State changes
+    void becomeMaster(uint64_t nowNs);
+    void becomePassive(uint64_t nowNs, const PTPClockDataset& better, int8_t logAnnounceInterval);
+    PTPClockDataset ownDataset() const;
+
+    // Messages
+    void sendAnnounce();
+    void sendSync();
+    void sendDelayResponse(const PTPHeader& request, uint64_t arrivalNs);
+    size_t writeHeader(PTPMessageType type, uint8_t control, int8_t logInterval,
+                       uint16_t sequence, size_t bodySize);
+    bool sendEvent(size_t size);
+    bool sendGeneral(size_t size);
+    bool sendFrame(size_t size);
+
+    uint64_t nowNs() const;
+    void wake();
+};
+
+} // namespace aes67
@@ -0,0 +1,216 @@
+// PTPMessage.cpp
+#include "PTPMessage.h"
+#include <cerrno>
+#include <iostream>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/if_ether.h>
+#include <netpacket/packet.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace aes67 {
+
+namespace {
+
+// DSCP EF, as AES67 recommends for PTP
+constexpr int PTP_TOS = 46 << 2;
+
+// Annex F destinations
+constexpr uint8_t PTP_PRIMARY_MAC[6] = {0x01, 0x1B, 0x19, 0x00, 0x00, 0x00};
+constexpr uint8_t PTP_PEER_MAC[6] = {0x01, 0x80, 0xC2, 0x00, 0x00, 0x0E};
+
+// Linux 4.20; older kernels reject it and the handlers skip their own frames
+#ifndef PACKET_IGNORE_OUTGOING
+#define PACKET_IGNORE_OUTGOING 23
+#endif
+
+constexpr uint16_t PTP_ETHERTYPE = 0x88F7;
+
+bool findMac(const std::string& interfaceName, uint8_t* mac) {
+    if (!interfaceName.empty()) {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct ifreq ifr;
+        memset(&ifr, 0, sizeof(ifr));
+        strncpy(ifr.ifr_name, interfaceName.c_str(), IFNAMSIZ - 1);
+        bool found = ioctl(fd, SIOCGIFHWADDR, &ifr) == 0;
+        close(fd);
+        if (found) {
+            memcpy(mac, ifr.ifr_hwaddr.sa_data, 6);
+        }
+        return found;
+    }
+
+    // The first interface with a MAC address that is not loopback
+    struct ifaddrs* ifap;
+    if (getifaddrs(&ifap) != 0) {
+        return false;
+    }
+    bool found = false;
+    for (struct ifaddrs* ifa = ifap; ifa && !found; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_PACKET || (ifa->ifa_flags & IFF_LOOPBACK)) {
+            continue;
+        }
+        const struct sockaddr_ll* link = reinterpret_cast<const struct sockaddr_ll*>(ifa->ifa_addr);
+        static const uint8_t zero[6] = {};
+        if (link->sll_halen == 6 && memcmp(link->sll_addr, zero, 6) != 0) {
+            memcpy(mac, link->sll_addr, 6);
+            found = true;
+        }
+    }
+    freeifaddrs(ifap);
+    return found;
+}
+
+} // namespace
+
+bool findPTPIdentity(const std::string& interfaceName, uint8_t* identity) {
+    uint8_t mac[6];
+    if (!findMac(interfaceName, mac)) {
+        return false;
+    }
+
+    // EUI-64 from the MAC address
+    identity[0] = mac[0];
+    identity[1] = mac[1];
+    identity[2] = mac[2];
+    identity[3] = 0xFF;
+    identity[4] = 0xFE;
+    identity[5] = mac[3];
+    identity[6] = mac[4];
+    identity[7] = mac[5];
+    return true;
+}
+
+bool openPTPSocket(int fd, uint16_t port, const std::string& interfaceName, const std::string& multicastAddr) {
+    // Shares the port with any other PTP software on the host
+    int optval = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) < 0) {
+        std::cerr << "Failed to set SO_REUSEADDR: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Only the groups this socket joined, and on its interface only
+    optval = 0;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_ALL, &optval, sizeof(optval));
+    if (!interfaceName.empty() &&
+        setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, interfaceName.c_str(), interfaceName.size()) < 0) {
+        std::cerr << "Warning: PTP port " << port << " not bound to " << interfaceName
+                  << ": " << strerror(errno) << std::endl;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "Failed to bind PTP port " << port << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (!setPTPMulticastInterface(fd, interfaceName, multicastAddr)) {
+        return false;
+    }
+    struct ip_mreqn mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.imr_multiaddr.s_addr = inet_addr(multicastAddr.c_str());
+    mreq.imr_ifindex = interfaceName.empty() ? 0 : if_nametoindex(interfaceName.c_str());
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        std::cerr << "Failed to join PTP multicast group on port " << port << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool setPTPMulticastInterface(int fd, const std::string& interfaceName, const std::string& multicastAddr) {
+    struct ip_mreqn mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.imr_multiaddr.s_addr = inet_addr(multicastAddr.c_str());
+    mreq.imr_ifindex = interfaceName.empty() ? 0 : if_nametoindex(interfaceName.c_str());
+    if (!interfaceName.empty() && mreq.imr_ifindex == 0) {
+        std::cerr << "Unknown PTP interface: " << interfaceName << std::endl;
+        return false;
+    }
+    if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &mreq, sizeof(mreq)) < 0) {
+        std::cerr << "Failed to set PTP multicast interface: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Non-critical, continue anyway
+    int optval = PTP_TOS;
+    setsockopt(fd, IPPROTO_IP, IP_TOS, &optval, sizeof(optval));
+    return true;
+}
+
+int openPTPEthernetSocket(const std::string& interfaceName, int& ifindex) {
+    if (interfaceName.empty()) {
+        std::cerr << "PTP over Ethernet needs an interface" << std::endl;
+        return -1;
+    }
+    ifindex = if_nametoindex(interfaceName.c_str());
+    if (ifindex == 0) {
+        std::cerr << "Unknown PTP interface: " << interfaceName << std::endl;
+        return -1;
+    }
+
+    // Datagram mode: the kernel adds and strips the Ethernet header
+    int fd = socket(AF_PACKET, SOCK_DGRAM, htons(PTP_ETHERTYPE));
+    if (fd < 0) {
+        std::cerr << "Failed to create PTP Ethernet socket: " << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(PTP_ETHERTYPE);
+    addr.sll_ifindex = ifindex;
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "Failed to bind PTP Ethernet socket to " << interfaceName << ": " << strerror(errno) << std::endl;
+        close(fd);
+        return -1;
+    }
+
+    const uint8_t* groups[] = {PTP_PRIMARY_MAC, PTP_PEER_MAC};
+    for (const uint8_t* group : groups) {
+        struct packet_mreq mreq;
+        memset(&mreq, 0, sizeof(mreq));
+        mreq.mr_ifindex = ifindex;
+        mreq.mr_type = PACKET_MR_MULTICAST;
+        mreq.mr_alen = 6;
+        memcpy(mreq.mr_address, group, 6);
+        if (setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            std::cerr << "Failed to join PTP Ethernet multicast on " << interfaceName << ": " << strerror(errno) << std::endl;
+            close(fd);
+            return -1;
+        }
+    }
+
+    // Non-critical, continue anyway
+    int optval = 1;
+    setsockopt(fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &optval, sizeof(optval));
+    return fd;
+}
+
+bool sendPTPFrame(int fd, int ifindex, const uint8_t* data, size_t size, PTPProfile profile) {
+    uint8_t type = data[0] & 0x0F;
+    bool peer = profile == PTP_PROFILE_GPTP || type == PTP_PDELAY_REQ || type == PTP_PDELAY_RESP ||
+                type == PTP_PDELAY_RESP_FOLLOW_UP;
+
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(PTP_ETHERTYPE);
+    addr.sll_ifindex = ifindex;
+    addr.sll_halen = 6;
+    memcpy(addr.sll_addr, peer ? PTP_PEER_MAC : PTP_PRIMARY_MAC, 6);
+    return sendto(fd, data, size, 0, (struct sockaddr*)&addr, sizeof(addr)) > 0;
+}
+
+} // namespace aes67
@@ -0,0 +1,249 @@
+// PTPMessage.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <arpa/inet.h>
+
+namespace aes67 {
+
+// PTPv2 (IEEE 1588-2008) wire format shared by the slave, the master and
+// the simulation. Multi-byte fields are in network order.
+
+enum PTPMessageType : uint8_t {
+    PTP_SYNC = 0x0,
+    PTP_DELAY_REQ = 0x1,
+    PTP_PDELAY_REQ = 0x2,
+    PTP_PDELAY_RESP = 0x3,
+    PTP_FOLLOW_UP = 0x8,
+    PTP_DELAY_RESP = 0x9,
+    PTP_PDELAY_RESP_FOLLOW_UP = 0xA,
+    PTP_ANNOUNCE = 0xB
+};
+
+// How messages travel and how the path delay is measured
+enum PTPProfile : uint8_t {
+    PTP_PROFILE_UDP = 0,    // IPv4 multicast on ports 319 and 320, end-to-end delay (AES67)
+    PTP_PROFILE_ETHERNET,   // Ethernet frames (IEEE 1588 Annex F), end-to-end delay
+    PTP_PROFILE_GPTP        // IEEE 802.1AS: Ethernet frames, peer delay
+};
+
+// flagField bits
+constexpr uint16_t PTP_FLAG_TWO_STEP = 0x0200;
+constexpr uint16_t PTP_FLAG_TIMESCALE = 0x0008;
+
+// transportSpecific nibble of messageType that 802.1AS messages carry
+constexpr uint8_t PTP_TRANSPORT_GPTP = 0x10;
+
+// Messages below this type are event messages, timestamped on arrival
+constexpr uint8_t PTP_FIRST_GENERAL = 0x8;
+
+// PTP packet structure
+struct PTPHeader {
+    uint8_t  messageType;  // Message type and transport specific
+    uint8_t  versionPTP;   // Version PTP
+    uint16_t messageLength;// Message length
+    uint8_t  domainNumber; // Domain number
+    uint8_t  reserved1;    // Reserved
+    uint16_t flags;        // Flags
+    int64_t  correction;   // Correction
+    uint32_t reserved2;    // Reserved
+    uint8_t  sourcePortId[10]; // Source port identity
+    uint16_t sequenceId;   // Sequence ID
+    uint8_t  control;      // Control
+    int8_t   logMessageInt;// Log message interval
+} __attribute__((__packed__));
+
+// PTP timestamp structure
+struct PTPTimestamp {
+    uint8_t seconds[6];    // 48-bit seconds
+    uint32_t nanoseconds;  // 32-bit nanoseconds
+} __attribute__((__packed__));
+
+// Announce body, after the header
+struct PTPAnnounce {
+    PTPTimestamp originTimestamp;
+    int16_t  currentUtcOffset;
+    uint8_t  reserved;
+    uint8_t  priority1;
+    uint8_t  clockClass;
+    uint8_t  clockAccuracy;
+    uint16_t offsetScaledLogVariance;
+    uint8_t  priority2;
+    uint8_t  grandmasterIdentity[8];
+    uint16_t stepsRemoved;
+    uint8_t  timeSource;
+} __attribute__((__packed__));
+
+// Delay_Resp body, after the header
+struct PTPDelayResponse {
+    PTPTimestamp receiveTimestamp;
+    uint8_t requestingPortId[10];
+} __attribute__((__packed__));
+
+// Pdelay_Req body; Pdelay_Resp and Pdelay_Resp_Follow_Up are laid out like
+// Delay_Resp, with the request's receipt and the response's departure time
+struct PTPPeerDelayRequest {
+    PTPTimestamp originTimestamp;
+    uint8_t reserved[10];
+} __attribute__((__packed__));
+
+// 802.1AS Follow_Up information TLV, after the Follow_Up body
+struct PTPFollowUpInfo {
+    uint16_t tlvType;
+    uint16_t lengthField;
+    uint8_t  organizationId[3];
+    uint8_t  organizationSubType[3];
+    int32_t  cumulativeScaledRateOffset;
+    uint16_t gmTimeBaseIndicator;
+    uint8_t  lastGmPhaseChange[12];
+    int32_t  scaledLastGmFreqChange;
+} __attribute__((__packed__));
+
+// Wire sizes: 34-byte header, 10-byte timestamp
+static_assert(sizeof(PTPHeader) == 34, "PTP header must match the wire format");
+static_assert(sizeof(PTPTimestamp) == 10, "PTP timestamp must match the wire format");
+static_assert(sizeof(PTPAnnounce) == 30, "PTP announce must match the wire format");
+static_assert(sizeof(PTPDelayResponse) == 20, "PTP delay response must match the wire format");
+static_assert(sizeof(PTPPeerDelayRequest) == 20, "PTP peer delay request must match the wire format");
+static_assert(sizeof(PTPFollowUpInfo) == 32, "802.1AS follow up TLV must match the wire format");
+
+// Version 2, the domain, and the 802.1AS transportSpecific if the profile wants it
+inline bool acceptPTPMessage(const PTPHeader& header, uint8_t domain, PTPProfile profile) {
+    if ((header.versionPTP & 0x0F) != 2 || header.domainNumber != domain) {
+        return false;
+    }
+    return profile != PTP_PROFILE_GPTP || (header.messageType & 0xF0) == PTP_TRANSPORT_GPTP;
+}
+
+// What the best master clock algorithm compares, in the order it does
+struct PTPClockDataset {
+    uint8_t priority1;
+    uint8_t clockClass;
+    uint8_t clockAccuracy;
+    uint16_t offsetScaledLogVariance;
+    uint8_t priority2;
+    uint8_t identity[8];
+    uint16_t stepsRemoved;
+};
+
+// Negative if a is the better grandmaster, positive if b is, 0 if the same.
+// Ties between the same grandmaster go to the shorter path.
+inline int comparePTPDatasets(const PTPClockDataset& a, const PTPClockDataset& b) {
+    int identity = memcmp(a.identity, b.identity, sizeof(a.identity));
+    if (identity == 0) {
+        return static_cast<int>(a.stepsRemoved) - static_cast<int>(b.stepsRemoved);
+    }
+    if (a.priority1 != b.priority1) return a.priority1 < b.priority1 ? -1 : 1;
+    if (a.clockClass != b.clockClass) return a.clockClass < b.clockClass ? -1 : 1;
+    if (a.clockAccuracy != b.clockAccuracy) return a.clockAccuracy < b.clockAccuracy ? -1 : 1;
+    if (a.offsetScaledLogVariance != b.offsetScaledLogVariance) {
+        return a.offsetScaledLogVariance < b.offsetScaledLogVariance ? -1 : 1;
+    }
+    if (a.priority2 != b.priority2) return a.priority2 < b.priority2 ? -1 : 1;
+    return identity;
+}
+
+// The grandmaster an Announce describes
+inline PTPClockDataset readPTPAnnounce(const PTPAnnounce& announce) {
+    PTPClockDataset dataset;
+    dataset.priority1 = announce.priority1;
+    dataset.clockClass = announce.clockClass;
+    dataset.clockAccuracy = announce.clockAccuracy;
+    dataset.offsetScaledLogVariance = ntohs(announce.offsetScaledLogVariance);
+    dataset.priority2 = announce.priority2;
+    memcpy(dataset.identity, announce.grandmasterIdentity, sizeof(dataset.identity));
+    dataset.stepsRemoved = ntohs(announce.stepsRemoved);
+    return dataset;
+}
+
+// Timestamps as nanoseconds on the PTP timescale
+inline uint64_t readPTPTimestamp(const PTPTimestamp& timestamp) {
+    uint64_t seconds = 0;
+    for (int i = 0; i < 6; i++) {
+        seconds = (seconds << 8) | timestamp.seconds[i];
+    }
+    return seconds * 1000000000ULL + ntohl(timestamp.nanoseconds);
+}
+
+inline void writePTPTimestamp(PTPTimestamp& timestamp, uint64_t ns) {
+    uint64_t seconds = ns / 1000000000ULL;
+    for (int i = 0; i < 6; i++) {
+        timestamp.seconds[i] = static_cast<uint8_t>(seconds >> (8 * (5 - i)));
+    }
+    timestamp.nanoseconds = htonl(static_cast<uint32_t>(ns % 1000000000ULL));
+}
+
+// correctionField, in nanoseconds; the low 16 bits are fractions
+inline int64_t readPTPCorrection(const PTPHeader& header) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&header.correction);
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | bytes[i];
+    }
+    return static_cast<int64_t>(value) / 65536;
+}
+
+// Message intervals are powers of two seconds; the standard's range is -7 to 7
+inline uint64_t ptpIntervalNs(int8_t logInterval) {
+    logInterval = logInterval < -7 ? -7 : logInterval > 7 ? 7 : logInterval;
+    return logInterval >= 0 ? 1000000000ULL << logInterval : 1000000000ULL >> -logInterval;
+}
+
+// "00-1D-C1-FF-FE-12-34-56"
+inline std::string formatPTPIdentity(const uint8_t* identity) {
+    char text[24];
+    snprintf(text, sizeof(text), "%02X-%02X-%02X-%02X-%02X-%02X-%02X-%02X",
+             identity[0], identity[1], identity[2], identity[3],
+             identity[4], identity[5], identity[6], identity[7]);
+    return text;
+}
+
+// "udp", "l2" or "gptp"
+inline bool parsePTPProfile(const std::string& name, PTPProfile& profile) {
+    if (name == "udp") {
+        profile = PTP_PROFILE_UDP;
+    } else if (name == "l2") {
+        profile = PTP_PROFILE_ETHERNET;
+    } else if (name == "gptp") {
+        profile = PTP_PROFILE_GPTP;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline const char* ptpProfileName(PTPProfile profile) {
+    switch (profile) {
+        case PTP_PROFILE_UDP:      return "udp";
+        case PTP_PROFILE_ETHERNET: return "l2";
+        case PTP_PROFILE_GPTP:     return "gptp";
+    }
+    return "unknown";
+}
+
+// Clock identity: the EUI-64 of the interface's MAC address, or of the
+// first interface with one if interfaceName is empty
+bool findPTPIdentity(const std::string& interfaceName, uint8_t* identity);
+
+// Bind a UDP socket to a PTP port and join the group on the interface, or
+// on the default one if interfaceName is empty. Other PTP software on the
+// host can share the port.
+bool openPTPSocket(int fd, uint16_t port, const std::string& interfaceName, const std::string& multicastAddr);
+
+// Send to the group from the interface, marked DSCP EF
+bool setPTPMulticastInterface(int fd, const std::string& interfaceName, const std::string& multicastAddr);
+
+// AF_PACKET socket for ethertype 0x88F7 on the interface, member of both
+// PTP multicast addresses, and not seeing its own host's frames. Returns the
+// descriptor and the interface index for sendPTPFrame(), or -1.
+int openPTPEthernetSocket(const std::string& interfaceName, int& ifindex);
+
+// Peer delay messages, and every 802.1AS message, go to 01-80-C2-00-00-0E,
+// which bridges do not forward; the rest to 01-1B-19-00-00-00
+bool sendPTPFrame(int fd, int ifindex, const uint8_t* data, size_t size, PTPProfile profile);
+
+} // namespace aes67
@@ -0,0 +1,124 @@
+// PTPState.cpp
+#include "PTPState.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace aes67 {
+
+namespace {
+
+constexpr uint32_t STATE_MAGIC = 0x50373641;   // "A67P"
+constexpr uint32_t STATE_VERSION = 2;
+
+} // namespace
+
+PTPState::PTPState() : slots(nullptr), sequence(0) {
+}
+
+PTPState::~PTPState() {
+    close();
+}
+
+bool PTPState::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open PTP state file " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // A new or truncated file reads as zeros, which no slot accepts
+    size_t size = 2 * sizeof(Slot);
+    if (ftruncate(fd, size) < 0) {
+        std::cerr << "Failed to size PTP state file " << path << ": " << strerror(errno) << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map PTP state file " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    slots = static_cast<Slot*>(mapping);
+
+    sequence = 0;
+    for (int i = 0; i < 2; i++) {
+        if (intact(slots[i]) && slots[i].sequence > sequence) {
+            sequence = slots[i].sequence;
+        }
+    }
+    return true;
+}
+
+void PTPState::close() {
+    if (slots) {
+        flush();
+        munmap(slots, 2 * sizeof(Slot));
+        slots = nullptr;
+    }
+}
+
+void PTPState::flush() {
+    if (slots) {
+        msync(slots, 2 * sizeof(Slot), MS_SYNC);
+    }
+}
+
+bool PTPState::load(Record& record) const {
+    if (!slots) {
+        return false;
+    }
+
+    const Slot* newest = nullptr;
+    for (int i = 0; i < 2; i++) {
+        if (intact(slots[i]) && (!newest || slots[i].sequence > newest->sequence)) {
+            newest = &slots[i];
+        }
+    }
+    if (!newest) {
+        return false;
+    }
+    record = newest->record;
+    return true;
+}
+
+void PTPState::store(const Record& record) {
+    if (!slots) {
+        return;
+    }
+
+    // Built aside, padding included, so the checksum covers known bytes
+    Slot slot;
+    memset(static_cast<void*>(&slot), 0, sizeof(slot));
+    slot.magic = STATE_MAGIC;
+    slot.version = STATE_VERSION;
+    slot.sequence = ++sequence;
+    memcpy(&slot.record, &record, sizeof(record));
+    slot.checksum = checksum(slot);
+
+    // Over the older slot, never the newest
+    memcpy(&slots[sequence & 1], &slot, sizeof(slot));
+}
+
+uint32_t PTPState::checksum(const Slot& slot) {
+    // FNV-1a
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&slot);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(Slot, checksum); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+bool PTPState::intact(const Slot& slot) {
+    return slot.magic == STATE_MAGIC && slot.version == STATE_VERSION && slot.checksum == checksum(slot);
+}
+
+} // namespace aes67
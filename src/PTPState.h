@@ -0,0 +1,58 @@
+// PTPState.h
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "PTPMessage.h"
+
+namespace aes67 {
+
+// What PTPSync learned about the network, kept across restarts so the next
+// start can follow the same master from its first messages.
+//
+// The file is memory-mapped, so storing a record is a copy into the mapping
+// with no system call and is safe on the network thread; the kernel writes
+// it back in its own time and close() flushes it. Records go alternately
+// into two checksummed slots, so whatever a power cut tears, the other slot
+// still holds the one before.
+class PTPState {
+public:
+    struct Record {
+        uint8_t domain = 0;
+        PTPProfile profile = PTP_PROFILE_UDP;
+        uint8_t masterPortIdentity[10] = {};
+        int64_t pathDelay = 0;      // Nanoseconds, mean path or link delay
+        double rateRatio = 0.0;     // Master samples per audio clock frame, 0 if not measured
+    };
+
+    PTPState();
+    ~PTPState();
+
+    // Maps the file, creating it if needed
+    bool open(const std::string& path);
+    void close();
+    void flush();
+    bool isOpen() const { return slots != nullptr; }
+
+    // The newest intact record, false if there is none
+    bool load(Record& record) const;
+    void store(const Record& record);
+
+private:
+    struct Slot {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sequence;      // Newer records have higher ones
+        Record record;
+        uint32_t checksum;      // Of everything before it
+    };
+
+    Slot* slots;                // Two, in the mapping
+    uint64_t sequence;          // Of the newest slot
+
+    static uint32_t checksum(const Slot& slot);
+    static bool intact(const Slot& slot);
+};
+
+} // namespace aes67
@@ -1,52 +1,113 @@
 // PTPSync.cpp
 #include "PTPSync.h"
+#include "PTPMessage.h"
+#include "Logger.h"
+#include "Tracer.h"
 #include <cstring>
 #include <iostream>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <unistd.h>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
 
 namespace aes67 {
 
-// PTP packet structure
-struct PTPHeader {
-    uint8_t  messageType;  // Message type and transport specific
-    uint8_t  versionPTP;   // Version PTP
-    uint16_t messageLength;// Message length
-    uint8_t  domainNumber; // Domain number
-    uint8_t  reserved1;    // Reserved
-    uint16_t flags;        // Flags
-    int64_t  correction;   // Correction
-    uint32_t reserved2;    // Reserved
-    uint8_t  sourcePortId[10]; // Source port identity
-    uint16_t sequenceId;   // Sequence ID
-    uint8_t  control;      // Control
-    int8_t   logMessageInt;// Log message interval
-};
-
-// PTP timestamp structure
-struct PTPTimestamp {
-    uint8_t seconds[6];    // 48-bit seconds
-    uint32_t nanoseconds;  // 32-bit nanoseconds
-};
-
-PTPSync::PTPSync()
-    : eventSocket(-1), generalSocket(-1), requestSocket(-1), 
-      sampleRate(48000), active(false), synchronized(false),
-      clockOffset(0), masterTimestamp(0), localTimestamp(0),
-      syncSequence(0), delaySequence(0)
+PTPSync::PTPSync(Reactor& reactor)
+    : reactor(reactor), eventSocket(-1), generalSocket(-1), requestSocket(-1), 
+      ethernetSocket(-1), ethernetIndex(0), peerTimer(-1),
+      timeBase(48000), domain(0), profile(PTP_PROFILE_UDP), active(false), synchronized(false),
+      selected(-1), foreignMasters(0),
+      timescaleOffset(0), clockOffset(0), offsetValid(false), masterTimestamp(0), localTimestamp(0), t3(0),
+      t1(0), t2(0), syncArrival(0), syncCorrection(0), syncIntervalNs(125000000), pathDelayValid(false), pathDelay(0),
+      delayRequestInterval(DELAY_REQUEST_FAST), masterDelayRequestInterval(DELAY_REQUEST_FAST),
+      stableMeasurements(0), nextDelayRequest(0), requestT1(0), requestT2(0), requestCorrection(0),
+      peerSequence(0), peerRequestSent(0), peerRequestReceipt(0), peerResponseArrival(0),
+      peerCorrection(0), peerResponsePending(false),
+      syncSequence(0), delaySequence(0),
+      localMaster(false), warmStart(false), rateRatio(0.0)
 {
+    memset(portIdentity, 0, sizeof(portIdentity));
+    memset(foreign, 0, sizeof(foreign));
 }
 
 PTPSync::~PTPSync() {
     shutdown();
 }
 
-bool PTPSync::initialize(const std::string& addr) {
+bool PTPSync::initialize(const std::string& interfaceName, const std::string& addr) {
     multicastAddr = addr;
     
+    // Our port identity, for delay requests and to know our own master
+    if (!findPTPIdentity(interfaceName, portIdentity)) {
+        std::random_device random;
+        for (int i = 0; i < 8; i++) {
+            portIdentity[i] = static_cast<uint8_t>(random());
+        }
+        std::cerr << "Warning: no MAC address for a PTP clock identity, using a random one" << std::endl;
+    }
+    portIdentity[8] = 0;
+    portIdentity[9] = 1;
+    
+    // Start from no known masters
+    for (auto& master : foreign) {
+        master.used = false;
+    }
+    selected = -1;
+    foreignMasters = 0;
+    setMasterClockId("");
+    peerResponsePending = false;
+    pathDelayValid = false;
+    pathDelay = 0;
+    resetDelayRequests();
+    
+    // Pick up where the last run left off, if it was on the same network
+    warmStart = state.load(warm) && warm.domain == domain && warm.profile == profile;
+    saved = warmStart ? warm : PTPState::Record();
+    rateRatio = saved.rateRatio;
+    if (warmStart) {
+        // The link to the neighbour is the same whoever is master
+        if (profile == PTP_PROFILE_GPTP) {
+            pathDelay = warm.pathDelay;
+            pathDelayValid = true;
+        }
+        std::cout << "PTP warm start: master " << formatPTPIdentity(warm.masterPortIdentity)
+                  << ", path delay " << warm.pathDelay << " ns" << std::endl;
+    }
+    
+    // Event and general messages share one socket over Ethernet
+    if (profile != PTP_PROFILE_UDP) {
+        ethernetSocket = openPTPEthernetSocket(interfaceName, ethernetIndex);
+        if (ethernetSocket < 0) {
+            return false;
+        }
+        
+        active = true;
+        reactor.addSocket(ethernetSocket, Reactor::PRIORITY_TIMING,
+                          [this](const uint8_t* data, size_t size, uint64_t arrivalNs) {
+                              if (size > 0 && (data[0] & 0x0F) < PTP_FIRST_GENERAL) {
+                                  handleEventMessage(data, size, arrivalNs);
+                              } else {
+                                  handleGeneralMessage(data, size, arrivalNs);
+                              }
+                          });
+        if (profile == PTP_PROFILE_GPTP) {
+            peerTimer = reactor.addTimer(Reactor::PRIORITY_TIMING, Reactor::nowNs(),
+                                         [this](uint64_t nowNs) {
+                                             sendPeerDelayRequest();
+                                             return nowNs + PEER_DELAY_INTERVAL_NS;
+                                         });
+        }
+        
+        std::cout << "PTP Synchronization initialized over " << ptpProfileName(profile) << " on " << interfaceName
+                  << ", domain " << static_cast<int>(domain) << ", clock " << formatPTPIdentity(portIdentity) << std::endl;
+        return true;
+    }
+    
     // Create sockets
     eventSocket = socket(AF_INET, SOCK_DGRAM, 0);
     if (eventSocket < 0) {
@@ -72,53 +133,17 @@ bool PTPSync::initialize(const std::string& addr) {
         return false;
     }
     
-    // Set socket options
-    int optval = 1;
-    if (setsockopt(eventSocket, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) < 0 ||
-        setsockopt(generalSocket, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) < 0) {
-        std::cerr << "Failed to set SO_REUSEADDR: " << strerror(errno) << std::endl;
+    // Event socket (port 319) and general socket (port 320) on the interface
+    if (!openPTPSocket(eventSocket, 319, interfaceName, multicastAddr) ||
+        !openPTPSocket(generalSocket, 320, interfaceName, multicastAddr) ||
+        !setPTPMulticastInterface(requestSocket, interfaceName, multicastAddr)) {
         shutdown();
         return false;
     }
     
-    // Join multicast groups
     struct sockaddr_in addr_in;
-    struct ip_mreq mreq;
-    
     memset(&addr_in, 0, sizeof(addr_in));
     addr_in.sin_family = AF_INET;
-    addr_in.sin_addr.s_addr = INADDR_ANY;
-    
-    // Set up event socket (port 319)
-    addr_in.sin_port = htons(319);
-    if (bind(eventSocket, (struct sockaddr*)&addr_in, sizeof(addr_in)) < 0) {
-        std::cerr << "Failed to bind event socket: " << strerror(errno) << std::endl;
-        shutdown();
-        return false;
-    }
-    
-    memset(&mreq, 0, sizeof(mreq));
-    mreq.imr_multiaddr.s_addr = inet_addr(multicastAddr.c_str());
-    mreq.imr_interface.s_addr = INADDR_ANY;
-    if (setsockopt(eventSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
-        std::cerr << "Failed to join event multicast group: " << strerror(errno) << std::endl;
-        shutdown();
-        return false;
-    }
-    
-    // Set up general socket (port 320)
-    addr_in.sin_port = htons(320);
-    if (bind(generalSocket, (struct sockaddr*)&addr_in, sizeof(addr_in)) < 0) {
-        std::cerr << "Failed to bind general socket: " << strerror(errno) << std::endl;
-        shutdown();
-        return false;
-    }
-    
-    if (setsockopt(generalSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
-        std::cerr << "Failed to join general multicast group: " << strerror(errno) << std::endl;
-        shutdown();
-        return false;
-    }
     
     // Set up request socket (for sending delay requests)
     addr_in.sin_port = htons(319);
@@ -129,34 +154,46 @@ bool PTPSync::initialize(const std::string& addr) {
         return false;
     }
     
-    // Start worker threads
+    // Event messages carry the timing, so they are stamped and handled first
     active = true;
-    eventThread = std::thread(&PTPSync::eventThreadFunc, this);
-    generalThread = std::thread(&PTPSync::generalThreadFunc, this);
+    reactor.addSocket(eventSocket, Reactor::PRIORITY_TIMING,
+                      [this](const uint8_t* data, size_t size, uint64_t arrivalNs) {
+                          handleEventMessage(data, size, arrivalNs);
+                      });
+    reactor.addSocket(generalSocket, Reactor::PRIORITY_CONTROL,
+                      [this](const uint8_t* data, size_t size, uint64_t arrivalNs) {
+                          handleGeneralMessage(data, size, arrivalNs);
+                      });
     
-    std::cout << "PTP Synchronization initialized with multicast address " << multicastAddr << std::endl;
+    std::cout << "PTP Synchronization initialized with multicast address " << multicastAddr
+              << ", domain " << static_cast<int>(domain) << ", clock " << formatPTPIdentity(portIdentity)
+              << (interfaceName.empty() ? "" : " on " + interfaceName) << std::endl;
     return true;
 }
 
 void PTPSync::shutdown() {
     active = false;
     
-    // Join threads if they're running
-    if (eventThread.joinable()) {
-        eventThread.join();
+    if (peerTimer >= 0) {
+        reactor.removeTimer(peerTimer);
+        peerTimer = -1;
     }
     
-    if (generalThread.joinable()) {
-        generalThread.join();
+    // Close sockets, once the reactor has let go of them
+    if (ethernetSocket >= 0) {
+        reactor.removeSocket(ethernetSocket);
+        close(ethernetSocket);
+        ethernetSocket = -1;
     }
     
-    // Close sockets
     if (eventSocket >= 0) {
+        reactor.removeSocket(eventSocket);
         close(eventSocket);
         eventSocket = -1;
     }
     
     if (generalSocket >= 0) {
+        reactor.removeSocket(generalSocket);
         close(generalSocket);
         generalSocket = -1;
     }
@@ -167,10 +204,72 @@ void PTPSync::shutdown() {
     }
     
     synchronized = false;
+    offsetValid = false;
+    state.flush();
+}
+
+void PTPSync::setDomain(uint8_t number) {
+    domain = number;
+}
+
+void PTPSync::setProfile(PTPProfile replacement) {
+    profile = replacement;
+}
+
+bool PTPSync::setStateFile(const std::string& path) {
+    if (path.empty()) {
+        state.close();
+        return true;
+    }
+    return state.open(path);
 }
 
 void PTPSync::setSampleRate(uint32_t rate) {
-    sampleRate = rate;
+    timeBase.setSampleRate(rate);
+    clockOffset = -timeBase.samples(timescaleOffset).rounded();
+}
+
+void PTPSync::setLocalMaster(const uint8_t* identity, int64_t offsetNs) {
+    localMaster = true;
+    setMasterClockId(formatPTPIdentity(identity));
+    
+    // The offset is exact, nothing to measure
+    timescaleOffset = offsetNs;
+    clockOffset = -timeBase.samples(offsetNs).rounded();
+    offsetValid = true;
+    synchronized = true;
+    AES67_TRACE_INSTANT("ptp master change", 1);
+}
+
+void PTPSync::clearLocalMaster() {
+    // Keep the offset until the next master's is measured; the master
+    // selection starts over from the Announces tracked meanwhile
+    localMaster = false;
+    setMasterClockId("");
+    selected = -1;
+    selectMaster(nowNanos());
+}
+
+void PTPSync::setTransport(const Transport& replacement) {
+    transport = replacement;
+}
+
+uint64_t PTPSync::nowNanos() const {
+    if (transport.nowNs) {
+        return transport.nowNs();
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string PTPSync::getMasterClockId() const {
+    std::lock_guard<std::mutex> lock(masterMutex);
+    return masterClockId;
+}
+
+void PTPSync::setMasterClockId(const std::string& id) {
+    std::lock_guard<std::mutex> lock(masterMutex);
+    masterClockId = id;
 }
 
 int64_t PTPSync::getClockOffset() const {
@@ -178,214 +277,512 @@ int64_t PTPSync::getClockOffset() const {
 }
 
 uint64_t PTPSync::getCurrentTimestamp() const {
-    return localTimestamp.load() - clockOffset.load();
+    return static_cast<uint64_t>(toMasterTime(localTimestamp).rounded());
 }
 
-void PTPSync::eventThreadFunc() {
-    uint8_t buffer[1500];
-    PTPHeader* header = reinterpret_cast<PTPHeader*>(buffer);
-    struct sockaddr_in src_addr;
-    socklen_t src_addr_len = sizeof(src_addr);
+FixedTime PTPSync::toMasterTime(uint64_t localNs) const {
+    // Same local time base the offset was measured against
+    return timeBase.samples(static_cast<int64_t>(localNs) + timescaleOffset.load());
+}
+
+void PTPSync::handleEventMessage(const uint8_t* data, size_t len, uint64_t arrivalNs) {
+    if (len < sizeof(PTPHeader)) {
+        return;  // Packet too small
+    }
     
-    while (active) {
-        // Receive a PTP event message
-        ssize_t len = recvfrom(eventSocket, buffer, sizeof(buffer), 0, 
-                             (struct sockaddr*)&src_addr, &src_addr_len);
-        
-        if (len <= 0) {
-            if (active) {
-                std::cerr << "Error receiving PTP event message: " << strerror(errno) << std::endl;
-            }
-            continue;
+    const PTPHeader* header = reinterpret_cast<const PTPHeader*>(data);
+    
+    // Validate PTP version (2), domain and profile
+    if (!acceptPTPMessage(*header, domain, profile)) {
+        return;
+    }
+    
+    // Get the message type
+    uint8_t messageType = header->messageType & 0x0F;
+    
+    // Peer delay is between this port and its neighbour, whoever is master
+    if (messageType == PTP_PDELAY_REQ || messageType == PTP_PDELAY_RESP) {
+        handlePeerDelay(data, len, arrivalNs);
+        return;
+    }
+    
+    // The master's own messages come back over multicast loopback
+    if (localMaster) {
+        return;
+    }
+    
+    // Handle SYNC message (type 0)
+    if (messageType == PTP_SYNC) {
+        // A master that stopped announcing is given up on here too
+        if (selected >= 0 && !isQualified(foreign[selected], arrivalNs)) {
+            selectMaster(arrivalNs);
         }
         
-        if (len < sizeof(PTPHeader)) {
-            continue;  // Packet too small
+        // Only the selected master's time is followed
+        if (!fromSelected(*header)) {
+            return;
         }
         
-        // Validate PTP version (2) and domain (0)
-        if ((header->versionPTP & 0x0F) != 2 || header->domainNumber != 0) {
-            continue;
-        }
+        // The sync's arrival is t2, whichever message carries t1
+        syncArrival = arrivalNs;
+        syncCorrection = readPTPCorrection(*header);
+        syncIntervalNs = ptpIntervalNs(header->logMessageInt);
         
-        // Get the message type
-        uint8_t messageType = header->messageType & 0x0F;
+        // Check if this is a two-step clock
+        bool twoStep = (ntohs(header->flags) & PTP_FLAG_TWO_STEP) != 0;
         
-        // Handle SYNC message (type 0)
-        if (messageType == 0) {
-            // Extract master clock ID
-            char clockId[32];
-            snprintf(clockId, sizeof(clockId), "%02X-%02X-%02X-%02X-%02X-%02X-%02X-%02X",
-                    header->sourcePortId[0], header->sourcePortId[1],
-                    header->sourcePortId[2], header->sourcePortId[3],
-                    header->sourcePortId[4], header->sourcePortId[5],
-                    header->sourcePortId[6], header->sourcePortId[7]);
+        // Record the sequence ID for two-step clocks
+        if (twoStep) {
+            syncSequence = ntohs(header->sequenceId);
+            // Timestamp will be in the follow-up message
+        } else {
+            // Single-step clock, timestamp is in this message
+            if (len >= sizeof(PTPHeader) + sizeof(PTPTimestamp)) {
+                t1 = readPTPTimestamp(*reinterpret_cast<const PTPTimestamp*>(data + sizeof(PTPHeader)));
+                t2 = syncArrival;
+                masterTimestamp = t1;
+                localTimestamp = t2;
+                completeSync(0);
+                
+                synchronized = true;
+            }
+        }
+    }
+}
+
+void PTPSync::handleGeneralMessage(const uint8_t* data, size_t len, uint64_t arrivalNs) {
+    if (len < sizeof(PTPHeader)) {
+        return;  // Packet too small
+    }
+    
+    const PTPHeader* header = reinterpret_cast<const PTPHeader*>(data);
+    
+    // Validate PTP version (2), domain and profile
+    if (!acceptPTPMessage(*header, domain, profile)) {
+        return;
+    }
+    
+    // Get the message type
+    uint8_t messageType = header->messageType & 0x0F;
+    
+    // Announces are tracked even while this host is the master, so the
+    // selection is ready when it stops being one
+    if (messageType == PTP_ANNOUNCE) {
+        if (len >= sizeof(PTPHeader) + sizeof(PTPAnnounce) &&
+            memcmp(header->sourcePortId, portIdentity, 8) != 0) {
+            const PTPAnnounce* announce = reinterpret_cast<const PTPAnnounce*>(data + sizeof(PTPHeader));
+            handleAnnounce(*header, *announce, arrivalNs);
+        }
+        return;
+    }
+    
+    if (messageType == PTP_PDELAY_RESP_FOLLOW_UP) {
+        handlePeerDelay(data, len, arrivalNs);
+        return;
+    }
+    
+    // The master's own messages come back over multicast loopback
+    if (localMaster || !fromSelected(*header)) {
+        return;
+    }
+    
+    // Handle FOLLOW_UP message (type 8) - second phase of two-step clock sync
+    if (messageType == PTP_FOLLOW_UP) {
+        // Check if this is the follow-up for our recorded sync message
+        if (ntohs(header->sequenceId) == syncSequence) {
+            if (len >= sizeof(PTPHeader) + sizeof(PTPTimestamp)) {
+                t1 = readPTPTimestamp(*reinterpret_cast<const PTPTimestamp*>(data + sizeof(PTPHeader)));
+                t2 = syncArrival;
+                masterTimestamp = t1;
+                localTimestamp = t2;
+                completeSync(readPTPCorrection(*header));
+                
+                synchronized = true;
+            }
+        }
+    }
+    // Handle DELAY_RESP message (type 9)
+    else if (messageType == PTP_DELAY_RESP) {
+        if (len < sizeof(PTPHeader) + sizeof(PTPDelayResponse)) {
+            return;
+        }
+        const PTPDelayResponse* response = reinterpret_cast<const PTPDelayResponse*>(data + sizeof(PTPHeader));
+        
+        // Check if this is the response to our delay request, and not to
+        // another slave's with the same sequence number
+        if (ntohs(header->sequenceId) == delaySequence &&
+            memcmp(response->requestingPortId, portIdentity, sizeof(portIdentity)) == 0) {
+            uint64_t t4 = readPTPTimestamp(response->receiveTimestamp);
             
-            // Check if this is a new master clock
-            if (masterClockId != clockId) {
-                masterClockId = clockId;
-                std::cout << "New PTP master clock detected: " << masterClockId << std::endl;
-                synchronized = false;  // Reset synchronization with new master
+            // Its interval field is the fastest the master wants requests
+            if (header->logMessageInt >= -7 && header->logMessageInt <= 7) {
+                masterDelayRequestInterval = header->logMessageInt;
             }
             
-            // Check if this is a two-step clock
-            bool twoStep = (ntohs(header->flags) & 0x0200) != 0;
+            // Mean path delay: ((t2 - t1) + (t4 - t3)) / 2 with the Sync the
+            // request followed, less what transparent clocks on the way added
+            int64_t roundTrip = (static_cast<int64_t>(requestT2) - static_cast<int64_t>(requestT1)) +
+                                (static_cast<int64_t>(t4) - static_cast<int64_t>(t3.load()));
+            int64_t delay = (roundTrip - requestCorrection - readPTPCorrection(*header)) / 2;
+            adaptDelayRequests(updatePathDelay(delay));
             
-            // Record the sequence ID for two-step clocks
-            if (twoStep) {
-                syncSequence = ntohs(header->sequenceId);
-                // Timestamp will be in the follow-up message
-            } else {
-                // Single-step clock, timestamp is in this message
-                if (len >= sizeof(PTPHeader) + sizeof(PTPTimestamp)) {
-                    // Extract timestamp
-                    PTPTimestamp* ts = reinterpret_cast<PTPTimestamp*>(buffer + sizeof(PTPHeader));
-                    masterTimestamp = ptpToSamples(reinterpret_cast<uint8_t*>(ts));
-                    
-                    // Record our local time
-                    localTimestamp = std::chrono::duration_cast<std::chrono::microseconds>(
-                        std::chrono::steady_clock::now().time_since_epoch()).count() * sampleRate / 1000000;
-                    
-                    // Send delay request periodically
-                    sendDelayRequest();
-                    
-                    synchronized = true;
-                }
-            }
+            AES67_LOG_DEBUG("PTP path delay: %lld ns, requests every 2^%d s",
+                            static_cast<long long>(pathDelay.load()), delayRequestInterval.load());
+            AES67_TRACE_COUNTER("ptp path delay", pathDelay);
         }
     }
 }
 
-void PTPSync::generalThreadFunc() {
-    uint8_t buffer[1500];
-    PTPHeader* header = reinterpret_cast<PTPHeader*>(buffer);
-    struct sockaddr_in src_addr;
-    socklen_t src_addr_len = sizeof(src_addr);
-    
-    // Variables for delay request-response
-    uint64_t t1 = 0;  // Master sync timestamp
-    uint64_t t2 = 0;  // Local sync receive time
-    uint64_t t3 = 0;  // Local delay request send time
-    uint64_t t4 = 0;  // Master delay response timestamp
-    
-    while (active) {
-        // Receive a PTP general message
-        ssize_t len = recvfrom(generalSocket, buffer, sizeof(buffer), 0, 
-                             (struct sockaddr*)&src_addr, &src_addr_len);
-        
-        if (len <= 0) {
-            if (active) {
-                std::cerr << "Error receiving PTP general message: " << strerror(errno) << std::endl;
-            }
-            continue;
+void PTPSync::handleAnnounce(const PTPHeader& header, const PTPAnnounce& announce, uint64_t arrivalNs) {
+    // Its slot, else a free one, else one that has timed out
+    int slot = -1;
+    for (size_t i = 0; i < MAX_FOREIGN_MASTERS && slot < 0; i++) {
+        if (foreign[i].used && memcmp(foreign[i].portIdentity, header.sourcePortId, 10) == 0) {
+            slot = static_cast<int>(i);
         }
-        
-        if (len < sizeof(PTPHeader)) {
-            continue;  // Packet too small
+    }
+    for (size_t i = 0; i < MAX_FOREIGN_MASTERS && slot < 0; i++) {
+        const ForeignMaster& master = foreign[i];
+        if (!master.used ||
+            (static_cast<int>(i) != selected &&
+             arrivalNs >= master.lastAnnounce + ANNOUNCE_RECEIPT_TIMEOUT * master.intervalNs)) {
+            slot = static_cast<int>(i);
         }
-        
-        // Validate PTP version (2) and domain (0)
-        if ((header->versionPTP & 0x0F) != 2 || header->domainNumber != 0) {
+    }
+    if (slot < 0) {
+        return;  // Table full of live masters
+    }
+    
+    ForeignMaster& master = foreign[slot];
+    if (!master.used) {
+        master.used = true;
+        memcpy(master.portIdentity, header.sourcePortId, sizeof(master.portIdentity));
+        master.previousAnnounce = 0;
+        master.lastAnnounce = 0;
+    }
+    master.dataset = readPTPAnnounce(announce);
+    master.intervalNs = ptpIntervalNs(header.logMessageInt);
+    master.previousAnnounce = master.lastAnnounce;
+    master.lastAnnounce = arrivalNs;
+    
+    // The last run's master qualifies on its first Announce
+    if (master.previousAnnounce == 0 && warmStart &&
+        memcmp(master.portIdentity, warm.masterPortIdentity, sizeof(master.portIdentity)) == 0) {
+        master.previousAnnounce = arrivalNs > master.intervalNs ? arrivalNs - master.intervalNs : 1;
+    }
+    
+    selectMaster(arrivalNs);
+}
+
+bool PTPSync::isQualified(const ForeignMaster& master, uint64_t nowNs) const {
+    return master.used && master.previousAnnounce != 0 &&
+           master.lastAnnounce - master.previousAnnounce <= FOREIGN_MASTER_WINDOW * master.intervalNs &&
+           nowNs < master.lastAnnounce + ANNOUNCE_RECEIPT_TIMEOUT * master.intervalNs;
+}
+
+void PTPSync::selectMaster(uint64_t nowNs) {
+    int best = -1;
+    size_t qualified = 0;
+    for (size_t i = 0; i < MAX_FOREIGN_MASTERS; i++) {
+        if (!isQualified(foreign[i], nowNs)) {
+            continue;
+        }
+        qualified++;
+        if (best < 0) {
+            best = static_cast<int>(i);
             continue;
         }
         
-        // Get the message type
-        uint8_t messageType = header->messageType & 0x0F;
-        
-        // Handle FOLLOW_UP message (type 8) - second phase of two-step clock sync
-        if (messageType == 8) {
-            // Check if this is the follow-up for our recorded sync message
-            if (ntohs(header->sequenceId) == syncSequence) {
-                if (len >= sizeof(PTPHeader) + sizeof(PTPTimestamp)) {
-                    // Extract timestamp
-                    PTPTimestamp* ts = reinterpret_cast<PTPTimestamp*>(buffer + sizeof(PTPHeader));
-                    t1 = ptpToSamples(reinterpret_cast<uint8_t*>(ts));
-                    masterTimestamp = t1;
-                    
-                    // Get our local time
-                    t2 = std::chrono::duration_cast<std::chrono::microseconds>(
-                        std::chrono::steady_clock::now().time_since_epoch()).count() * sampleRate / 1000000;
-                    localTimestamp = t2;
-                    
-                    // Send delay request
-                    sendDelayRequest();
-                    
-                    synchronized = true;
-                }
-            }
+        // Same grandmaster through two ports goes to the lower port identity
+        int order = comparePTPDatasets(foreign[i].dataset, foreign[best].dataset);
+        if (order < 0 || (order == 0 && memcmp(foreign[i].portIdentity, foreign[best].portIdentity, 10) < 0)) {
+            best = static_cast<int>(i);
         }
-        // Handle DELAY_RESP message (type 9)
-        else if (messageType == 9) {
-            // Check if this is the response to our delay request
-            if (ntohs(header->sequenceId) == delaySequence) {
-                if (len >= sizeof(PTPHeader) + sizeof(PTPTimestamp)) {
-                    // Extract timestamp
-                    PTPTimestamp* ts = reinterpret_cast<PTPTimestamp*>(buffer + sizeof(PTPHeader));
-                    t4 = ptpToSamples(reinterpret_cast<uint8_t*>(ts));
-                    
-                    // Calculate clock offset: ((t2 - t1) + (t4 - t3)) / 2
-                    int64_t offset = ((static_cast<int64_t>(t2) - static_cast<int64_t>(t1)) + 
-                                      (static_cast<int64_t>(t4) - static_cast<int64_t>(t3))) / 2;
-                    
-                    // Update our clock offset
-                    clockOffset = offset;
-                    
-                    std::cout << "PTP clock offset: " << offset << " samples" << std::endl;
-                }
-            }
+    }
+    foreignMasters = qualified;
+    
+    if (best == selected) {
+        return;
+    }
+    selected = best;
+    if (localMaster) {
+        return;  // Followed once PTPMaster lets go
+    }
+    
+    if (best < 0) {
+        // Hold the last offset until another master qualifies
+        AES67_LOG_INFO("PTP master clock lost");
+        setMasterClockId("");
+        return;
+    }
+    
+    std::string clockId = formatPTPIdentity(foreign[best].portIdentity);
+    setMasterClockId(clockId);
+    AES67_LOG_INFO("New PTP master clock detected: %s", clockId.c_str());
+    AES67_TRACE_INSTANT("ptp master change", 0);
+    synchronized = false;  // Reset synchronization with new master
+    offsetValid = false;
+    
+    // The path to it is measured afresh, the link to the neighbour stays
+    if (profile != PTP_PROFILE_GPTP) {
+        pathDelayValid = false;
+    }
+    masterDelayRequestInterval = DELAY_REQUEST_FAST;
+    resetDelayRequests();
+    
+    // Unless it is the last run's master, whose path and rate are known
+    if (warmStart && memcmp(foreign[best].portIdentity, warm.masterPortIdentity, sizeof(warm.masterPortIdentity)) == 0) {
+        pathDelay = warm.pathDelay;
+        pathDelayValid = true;
+    } else {
+        rateRatio = 0.0;
+    }
+    warmStart = false;
+    saveState();
+}
+
+bool PTPSync::fromSelected(const PTPHeader& header) const {
+    return selected >= 0 && memcmp(header.sourcePortId, foreign[selected].portIdentity, 10) == 0;
+}
+
+void PTPSync::handlePeerDelay(const uint8_t* data, size_t len, uint64_t arrivalNs) {
+    // All three messages have a timestamp and a port identity after the header
+    if (profile != PTP_PROFILE_GPTP || len < sizeof(PTPHeader) + sizeof(PTPDelayResponse)) {
+        return;
+    }
+    
+    const PTPHeader* header = reinterpret_cast<const PTPHeader*>(data);
+    uint8_t messageType = header->messageType & 0x0F;
+    
+    if (messageType == PTP_PDELAY_REQ) {
+        // Our own request, if the socket could not be told to skip them
+        if (memcmp(header->sourcePortId, portIdentity, 8) != 0) {
+            sendPeerDelayResponse(*header, arrivalNs);
         }
+        return;
+    }
+    
+    // Responses to our request only
+    const PTPDelayResponse* response = reinterpret_cast<const PTPDelayResponse*>(data + sizeof(PTPHeader));
+    if (ntohs(header->sequenceId) != peerSequence ||
+        memcmp(response->requestingPortId, portIdentity, sizeof(portIdentity)) != 0) {
+        return;
+    }
+    
+    if (messageType == PTP_PDELAY_RESP) {
+        peerRequestReceipt = readPTPTimestamp(response->receiveTimestamp);
+        peerResponseArrival = arrivalNs;
+        peerCorrection = readPTPCorrection(*header);
+        peerResponsePending = true;
+    } else if (messageType == PTP_PDELAY_RESP_FOLLOW_UP && peerResponsePending) {
+        peerResponsePending = false;
+        uint64_t responseOrigin = readPTPTimestamp(response->receiveTimestamp);
+        
+        // ((t4 - t1) - (t3 - t2)) / 2: the round trip less the time the
+        // neighbour took to answer, each side on its own clock
+        int64_t delay = (static_cast<int64_t>(peerResponseArrival - peerRequestSent) -
+                         (static_cast<int64_t>(responseOrigin) - static_cast<int64_t>(peerRequestReceipt)) -
+                         peerCorrection - readPTPCorrection(*header)) / 2;
+        updatePathDelay(delay);
+        
+        AES67_LOG_DEBUG("PTP peer delay: %lld ns", static_cast<long long>(pathDelay.load()));
+        AES67_TRACE_COUNTER("ptp path delay", pathDelay);
     }
 }
 
-void PTPSync::sendDelayRequest() {
-    // Only send delay requests if we're synchronized
-    if (!synchronized) {
+void PTPSync::sendPeerDelayRequest() {
+    uint8_t buffer[sizeof(PTPHeader) + sizeof(PTPPeerDelayRequest)];
+    size_t size = writeHeader(buffer, PTP_PDELAY_REQ, 5, ++peerSequence, sizeof(PTPPeerDelayRequest));
+    reinterpret_cast<PTPHeader*>(buffer)->logMessageInt = 0;    // Once a second
+    
+    peerResponsePending = false;
+    if (!sendMessage(buffer, size)) {
         return;
     }
     
-    // Create a delay request packet
-    uint8_t buffer[sizeof(PTPHeader) + sizeof(PTPTimestamp)];
-    PTPHeader* header = reinterpret_cast<PTPHeader*>(buffer);
+    // Read once the send returns, closest to when it reached the wire
+    peerRequestSent = nowNanos();
+}
+
+void PTPSync::sendPeerDelayResponse(const PTPHeader& request, uint64_t arrivalNs) {
+    // Two-step: the receipt time in the response, the departure in its follow up
+    uint8_t buffer[sizeof(PTPHeader) + sizeof(PTPDelayResponse)];
+    uint16_t sequence = ntohs(request.sequenceId);
+    size_t size = writeHeader(buffer, PTP_PDELAY_RESP, 5, sequence, sizeof(PTPDelayResponse));
+    reinterpret_cast<PTPHeader*>(buffer)->flags = htons(PTP_FLAG_TWO_STEP);
     
-    // Fill in the header
-    memset(header, 0, sizeof(PTPHeader));
-    header->messageType = 1;  // Delay Request
-    header->versionPTP = 2;   // PTP Version 2
-    header->messageLength = htons(sizeof(PTPHeader) + sizeof(PTPTimestamp));
-    header->sequenceId = htons(++delaySequence);
+    PTPDelayResponse* response = reinterpret_cast<PTPDelayResponse*>(buffer + sizeof(PTPHeader));
+    writePTPTimestamp(response->receiveTimestamp, arrivalNs);
+    memcpy(response->requestingPortId, request.sourcePortId, sizeof(response->requestingPortId));
+    if (!sendMessage(buffer, size)) {
+        return;
+    }
+    uint64_t departure = nowNanos();
     
-    // Send the packet
-    if (send(requestSocket, buffer, sizeof(PTPHeader) + sizeof(PTPTimestamp), 0) <= 0) {
-        std::cerr << "Failed to send delay request: " << strerror(errno) << std::endl;
+    size = writeHeader(buffer, PTP_PDELAY_RESP_FOLLOW_UP, 5, sequence, sizeof(PTPDelayResponse));
+    writePTPTimestamp(response->receiveTimestamp, departure);
+    memcpy(response->requestingPortId, request.sourcePortId, sizeof(response->requestingPortId));
+    sendMessage(buffer, size);
+}
+
+void PTPSync::completeSync(int64_t followUpCorrection) {
+    int64_t correction = syncCorrection + followUpCorrection;
+    
+    // End to end, the path is measured now and then; 802.1AS has its own timer
+    if (profile != PTP_PROFILE_GPTP) {
+        sendDelayRequest(correction);
+    }
+    updateOffset(correction);
+}
+
+void PTPSync::updateOffset(int64_t correction) {
+    // Nothing to take the path out with yet
+    if (!pathDelayValid) {
+        return;
+    }
+    
+    // The Sync arrived at t1 plus the path delay and what the clocks on the
+    // way added to its correction, in PTP time
+    int64_t offset = static_cast<int64_t>(t1) + pathDelay + correction - static_cast<int64_t>(t2);
+    
+    // The master or the path moved
+    if (offsetValid && std::llabs(offset - timescaleOffset.load()) > OFFSET_JUMP_NS) {
+        resetDelayRequests();
+    }
+    
+    // Update our clock offset
+    timescaleOffset = offset;
+    clockOffset = -timeBase.samples(offset).rounded();
+    offsetValid = true;
+    
+    AES67_LOG_DEBUG("PTP clock offset: %lld samples", static_cast<long long>(clockOffset.load()));
+    AES67_TRACE_COUNTER("ptp offset", clockOffset);
+}
+
+bool PTPSync::updatePathDelay(int64_t delay) {
+    if (delay < 0) {
+        delay = 0;  // Software timestamps on a short path
+    }
+    if (!pathDelayValid) {
+        pathDelay = delay;
+        pathDelayValid = true;
+        return false;
+    }
+    
+    // A path's delay rarely changes; average out the timestamp noise
+    int64_t average = pathDelay;
+    bool agreed = std::llabs(delay - average) <= PATH_DELAY_TOLERANCE_NS;
+    pathDelay = average + (delay - average) / PATH_DELAY_SMOOTHING;
+    if (agreed) {
+        saveState();
+    }
+    return agreed;
+}
+
+void PTPSync::adaptDelayRequests(bool agreed) {
+    // One step faster on an outlier, one slower after a run of agreement
+    if (!agreed) {
+        stableMeasurements = 0;
+        delayRequestInterval = std::max(delayRequestInterval.load() - 1, static_cast<int>(DELAY_REQUEST_FAST));
+        return;
+    }
+    if (++stableMeasurements >= DELAY_REQUEST_STABLE) {
+        stableMeasurements = 0;
+        delayRequestInterval = std::min(delayRequestInterval.load() + 1, static_cast<int>(DELAY_REQUEST_SLOW));
+    }
+}
+
+void PTPSync::resetDelayRequests() {
+    // Acquire again: a request with the next Sync, then with every one
+    delayRequestInterval = DELAY_REQUEST_FAST;
+    stableMeasurements = 0;
+    nextDelayRequest = 0;
+}
+
+void PTPSync::setRateRatio(double ratio) {
+    rateRatio = ratio;
+    saveState();
+}
+
+void PTPSync::saveState() {
+    if (!state.isOpen() || selected < 0 || !pathDelayValid) {
         return;
     }
     
-    // Record the send time
-    uint64_t t3 = std::chrono::duration_cast<std::chrono::microseconds>(
-        std::chrono::steady_clock::now().time_since_epoch()).count() * sampleRate / 1000000;
+    PTPState::Record record;
+    record.domain = domain;
+    record.profile = profile;
+    memcpy(record.masterPortIdentity, foreign[selected].portIdentity, sizeof(record.masterPortIdentity));
+    record.pathDelay = pathDelay;
+    record.rateRatio = rateRatio;
     
-    // Store it for later calculation
-    this->t3 = t3;
+    // Only real changes, so the page is not dirtied with every measurement
+    if (record.domain == saved.domain && record.profile == saved.profile &&
+        memcmp(record.masterPortIdentity, saved.masterPortIdentity, sizeof(record.masterPortIdentity)) == 0 &&
+        std::llabs(record.pathDelay - saved.pathDelay) < STATE_PATH_DELAY_STEP_NS &&
+        std::fabs(record.rateRatio - saved.rateRatio) < STATE_RATE_STEP) {
+        return;
+    }
+    state.store(record);
+    saved = record;
 }
 
-uint64_t PTPSync::ptpToSamples(const uint8_t* timestamp) const {
-    // Extract 48-bit seconds field
-    uint64_t seconds = 0;
-    for (int i = 0; i < 6; i++) {
-        seconds = (seconds << 8) | timestamp[i];
+void PTPSync::sendDelayRequest(int64_t correction) {
+    // Only send delay requests if we're synchronized, and when one is due
+    uint64_t now = nowNanos();
+    if (!synchronized || now < nextDelayRequest) {
+        return;
     }
     
-    // Extract 32-bit nanoseconds field
-    uint32_t nanoseconds = 0;
-    for (int i = 0; i < 4; i++) {
-        nanoseconds = (nanoseconds << 8) | timestamp[6 + i];
+    // Create a delay request packet
+    uint8_t buffer[sizeof(PTPHeader) + sizeof(PTPTimestamp)];
+    size_t size = writeHeader(buffer, PTP_DELAY_REQ, 1, ++delaySequence, sizeof(PTPTimestamp));
+    
+    // Send the packet
+    if (!sendMessage(buffer, size)) {
+        return;
     }
     
-    // Convert to samples
-    uint64_t samples = seconds * sampleRate;
-    samples += (static_cast<uint64_t>(nanoseconds) * sampleRate) / 1000000000;
+    // Record the send time and the Sync it goes with for the path delay
+    t3 = nowNanos();
+    requestT1 = t1;
+    requestT2 = t2;
+    requestCorrection = correction;
+    
+    // Due half a Sync early, so the request goes with the Sync nearest
+    // when it is due rather than the one after
+    int interval = std::max(delayRequestInterval.load(), masterDelayRequestInterval);
+    uint64_t intervalNs = ptpIntervalNs(static_cast<int8_t>(interval));
+    nextDelayRequest = now + intervalNs - std::min(intervalNs, syncIntervalNs) / 2;
+}
+
+size_t PTPSync::writeHeader(uint8_t* buffer, PTPMessageType type, uint8_t control,
+                            uint16_t sequence, size_t bodySize) const {
+    size_t size = sizeof(PTPHeader) + bodySize;
+    memset(buffer, 0, size);
     
-    return samples;
+    PTPHeader* header = reinterpret_cast<PTPHeader*>(buffer);
+    header->messageType = type | (profile == PTP_PROFILE_GPTP ? PTP_TRANSPORT_GPTP : 0);
+    header->versionPTP = 2;   // PTP Version 2
+    header->messageLength = htons(static_cast<uint16_t>(size));
+    header->domainNumber = domain;
+    memcpy(header->sourcePortId, portIdentity, sizeof(portIdentity));
+    header->sequenceId = htons(sequence);
+    header->control = control;
+    header->logMessageInt = 0x7F;   // Not used in requests and responses
+    return size;
+}
+
+bool PTPSync::sendMessage(const uint8_t* data, size_t size) {
+    if (transport.send) {
+        return transport.send(data, size);
+    }
+    bool sent = ethernetSocket >= 0 ? sendPTPFrame(ethernetSocket, ethernetIndex, data, size, profile)
+                                    : send(requestSocket, data, size, 0) > 0;
+    if (!sent) {
+        AES67_LOG_ERROR("Failed to send PTP message: %s", strerror(errno));
+    }
+    return sent;
 }
 
 } // namespace aes67
@@ -4,65 +4,230 @@
 #include <string>
 #include <cstdint>
 #include <atomic>
-#include <thread>
+#include <functional>
 #include <mutex>
 
+#include "Reactor.h"
+#include "PTPMessage.h"
+#include "PTPState.h"
+#include "TimeBase.h"
+
 namespace aes67 {
 
+// PTPv2 slave over UDP (E2E delay mechanism).
+//
+// Every Announce on the configured domain goes into a small table of
+// foreign masters. A master qualifies once two of its Announces arrive
+// within four announce intervals, and drops out when none has come for
+// three. The best qualified one by the BMCA dataset comparison is the only
+// source whose Sync, Follow_Up and Delay_Resp are used, so a second master
+// on the wire cannot make the offset flap.
+//
+// Every Sync gives an offset: its arrival less its departure, the path
+// delay and whatever the corrections add, all in nanoseconds so nothing is
+// rounded until a time is turned into samples. End to end, the path delay is
+// measured with Delay_Req at a rate set by how well the measurements agree:
+// every Sync while acquiring and after a master change or an offset jump,
+// backing off to one every 8 seconds once they settle, and never faster
+// than the master allows.
+//
+// Over Ethernet the messages share one AF_PACKET socket. The 802.1AS profile
+// measures the link delay to the neighbour with Pdelay requests once a
+// second instead, and answers the neighbour's own.
+//
+// With a state file, the master followed and its path delay outlive the
+// process. If the same master turns up after a restart it is followed from
+// its first Announce, and the first Sync gives an offset.
 class PTPSync {
 public:
-    PTPSync();
+    explicit PTPSync(Reactor& reactor);
     ~PTPSync();
     
     // Configuration and control
-    bool initialize(const std::string& multicastAddr = "224.0.1.129");
+    // The sockets bind to interfaceName, or any interface if it is empty
+    bool initialize(const std::string& interfaceName = "", const std::string& multicastAddr = "224.0.1.129");
     void shutdown();
     void setSampleRate(uint32_t rate);
+    void setDomain(uint8_t domain);
+    void setProfile(PTPProfile profile);    // Before initialize()
+    bool setStateFile(const std::string& path);     // Before initialize(), empty for none
+    
+    // Replaces the request socket and steady_clock, so a simulation can
+    // drive PTPSync on virtual time without initialize()
+    struct Transport {
+        std::function<bool(const uint8_t* data, size_t size)> send;  // Delay requests
+        std::function<uint64_t()> nowNs;                            // Local clock
+    };
+    void setTransport(const Transport& transport);
+    
+    // Message handlers, called for the sockets or by whatever replaces them;
+    // arrival times are on the local clock in nanoseconds
+    void handleEventMessage(const uint8_t* data, size_t len, uint64_t arrivalNs);
+    void handleGeneralMessage(const uint8_t* data, size_t len, uint64_t arrivalNs);
+    
+    // While this host is the grandmaster: Announces are still tracked, but
+    // timing messages are ignored and PTP time is the local clock plus
+    // offsetNs. Called by PTPMaster on the reactor thread.
+    void setLocalMaster(const uint8_t* identity, int64_t offsetNs);
+    void clearLocalMaster();
+    bool isLocalMaster() const { return localMaster; }
     
     // Clock operations
     int64_t getClockOffset() const;
     uint64_t getCurrentTimestamp() const;
     
+    // PTP time in samples at a CLOCK_MONOTONIC instant in nanoseconds
+    FixedTime toMasterTime(uint64_t localNs) const;
+    
+    // The audio clock's rate against the master's, as a media clock
+    // measured it, kept across restarts with the master. 0 while unknown.
+    // On the reactor thread.
+    void setRateRatio(double ratio);
+    double getRateRatio() const { return rateRatio; }
+    
+    // PTP time minus CLOCK_MONOTONIC time, in nanoseconds
+    int64_t getTimescaleOffset() const { return timescaleOffset; }
+    
     // Status
     bool isActive() const { return active; }
     bool isSynchronized() const { return synchronized; }
-    const std::string& getMasterClockId() const { return masterClockId; }
+    bool hasOffset() const { return synchronized && offsetValid; }
+    uint8_t getDomain() const { return domain; }
+    PTPProfile getProfile() const { return profile; }
+    int64_t getPathDelay() const { return pathDelay; }     // Nanoseconds, the link's for 802.1AS
+    int getDelayRequestInterval() const { return delayRequestInterval; }  // Log2 seconds
+    std::string getMasterClockId() const;
+    size_t getForeignMasterCount() const { return foreignMasters; }
     
 private:
+    // Runs the message handlers
+    Reactor& reactor;
+    
     // Socket descriptors
     int eventSocket;  // For PTP event messages (port 319)
     int generalSocket; // For PTP general messages (port 320)
     int requestSocket; // For sending delay requests
+    int ethernetSocket; // All messages, over Ethernet
+    int ethernetIndex;  // Its interface
+    int peerTimer;      // Peer delay requests
     
     // Configuration
     std::string multicastAddr;
-    uint32_t sampleRate;
+    TimeBase timeBase;
+    std::atomic<uint8_t> domain;
+    PTPProfile profile;
+    uint8_t portIdentity[10];   // Our clock identity and port 1
     
     // Synchronization state
     std::atomic<bool> active;
     std::atomic<bool> synchronized;
+    mutable std::mutex masterMutex;     // Guards masterClockId for other threads
     std::string masterClockId;
     
-    // PTP timestamps
-    std::atomic<int64_t> clockOffset;
+    // Foreign masters heard, owned by the reactor thread
+    static constexpr size_t MAX_FOREIGN_MASTERS = 8;
+    static constexpr int FOREIGN_MASTER_WINDOW = 4;     // Announce intervals for two Announces
+    static constexpr int ANNOUNCE_RECEIPT_TIMEOUT = 3;  // Announce intervals before dropping out
+    struct ForeignMaster {
+        bool used;
+        uint8_t portIdentity[10];
+        PTPClockDataset dataset;
+        uint64_t previousAnnounce;  // Local nanoseconds, 0 before the second
+        uint64_t lastAnnounce;
+        uint64_t intervalNs;        // Its announce interval
+    };
+    ForeignMaster foreign[MAX_FOREIGN_MASTERS];
+    int selected;                   // Index of the master followed, -1 for none
+    std::atomic<size_t> foreignMasters;
+    
+    // PTP timestamps, nanoseconds
+    static constexpr int64_t OFFSET_JUMP_NS = 1000000;     // More than drift and jitter explain
+    std::atomic<int64_t> timescaleOffset;   // PTP time less local time
+    std::atomic<int64_t> clockOffset;       // Local less PTP, in samples for status
+    std::atomic<bool> offsetValid;  // A delay response has been measured for this master
     std::atomic<uint64_t> masterTimestamp;
     std::atomic<uint64_t> localTimestamp;
+    std::atomic<uint64_t> t3;  // Local delay request send time
+    
+    // Exchange in progress, owned by the reactor thread; nanoseconds
+    uint64_t t1;            // Master sync timestamp
+    uint64_t t2;            // Local sync receive time
+    uint64_t syncArrival;   // Local receive time of the last sync
+    int64_t syncCorrection; // Its correctionField, nanoseconds
+    uint64_t syncIntervalNs;    // The master's Sync interval
+    
+    // Path delay, owned by the reactor thread
+    static constexpr int PATH_DELAY_SMOOTHING = 8;             // Measurements averaged over
+    static constexpr int64_t PATH_DELAY_TOLERANCE_NS = 100000;  // Agreeing with the average
+    bool pathDelayValid;
+    std::atomic<int64_t> pathDelay;     // Nanoseconds
+    
+    // Delay request rate, log2 seconds between requests
+    static constexpr int DELAY_REQUEST_FAST = -3;
+    static constexpr int DELAY_REQUEST_SLOW = 3;
+    static constexpr int DELAY_REQUEST_STABLE = 4;     // Agreeing measurements before slowing
+    std::atomic<int> delayRequestInterval;
+    int masterDelayRequestInterval;     // The master's minimum, from its Delay_Resp
+    int stableMeasurements;
+    uint64_t nextDelayRequest;          // Local nanoseconds
+    uint64_t requestT1;                 // The Sync the outstanding request followed
+    uint64_t requestT2;
+    int64_t requestCorrection;
+    
+    // Peer delay, owned by the reactor thread; local nanoseconds except the
+    // peer's receipt time, which is on its own clock
+    static constexpr uint64_t PEER_DELAY_INTERVAL_NS = 1000000000ULL;
+    uint16_t peerSequence;
+    uint64_t peerRequestSent;
+    uint64_t peerRequestReceipt;
+    uint64_t peerResponseArrival;
+    int64_t peerCorrection;
+    bool peerResponsePending;       // Pdelay_Resp in, waiting for its follow up
     
     // Sequence counters
     uint16_t syncSequence;
     uint16_t delaySequence;
     
-    // Worker threads
-    std::thread eventThread;
-    std::thread generalThread;
+    // Set while this host is the grandmaster
+    std::atomic<bool> localMaster;
+    
+    // Replaced socket and clock, if any
+    Transport transport;
+    
+    // Kept across restarts
+    static constexpr int64_t STATE_PATH_DELAY_STEP_NS = 1000;  // Change worth storing
+    static constexpr double STATE_RATE_STEP = 1e-6;            // 1 ppm
+    PTPState state;
+    PTPState::Record saved;         // Last stored
+    PTPState::Record warm;          // Loaded at initialize()
+    bool warmStart;                 // Until a master is selected
+    double rateRatio;               // For the selected master, or the last run's until one is
+    
+    // Best master selection
+    void handleAnnounce(const PTPHeader& header, const PTPAnnounce& announce, uint64_t arrivalNs);
+    bool isQualified(const ForeignMaster& master, uint64_t nowNs) const;
+    void selectMaster(uint64_t nowNs);
+    bool fromSelected(const PTPHeader& header) const;
+    void setMasterClockId(const std::string& id);
+    
+    // Peer delay (802.1AS)
+    void handlePeerDelay(const uint8_t* data, size_t len, uint64_t arrivalNs);
+    void sendPeerDelayRequest();
+    void sendPeerDelayResponse(const PTPHeader& request, uint64_t arrivalNs);
     
-    // Thread functions
-    void eventThreadFunc();
-    void generalThreadFunc();
-    void sendDelayRequest();
+    // Offset and path delay
+    void completeSync(int64_t followUpCorrection);
+    void updateOffset(int64_t correction);
+    bool updatePathDelay(int64_t delayNs);
+    void adaptDelayRequests(bool agreed);
+    void resetDelayRequests();
+    void saveState();
     
-    // Timestamp conversion
-    uint64_t ptpToSamples(const uint8_t* timestamp) const;
+    void sendDelayRequest(int64_t correction);
+    size_t writeHeader(uint8_t* buffer, PTPMessageType type, uint8_t control,
+                       uint16_t sequence, size_t bodySize) const;
+    bool sendMessage(const uint8_t* data, size_t size);
+    uint64_t nowNanos() const;
 };
 
 } // namespace aes67
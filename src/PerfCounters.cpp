@@ -0,0 +1,293 @@
+// PerfCounters.cpp
+#include "PerfCounters.h"
+#include <cstring>
+#include <cerrno>
+#include <iomanip>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace aes67 {
+
+namespace {
+
+const uint64_t EVENT_CONFIG[PerfCounters::EVENT_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+const char* const EVENT_NAMES[PerfCounters::EVENT_COUNT] = {
+    "cycles", "instructions", "cache misses", "branch misses"
+};
+
+int perfEventOpen(struct perf_event_attr* attr, int groupFd) {
+    // This thread, any CPU
+    return static_cast<int>(syscall(__NR_perf_event_open, attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC));
+}
+
+int openEvent(uint64_t config, int groupFd, bool user) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.disabled = groupFd < 0 ? 1 : 0;
+    attr.exclude_kernel = user ? 1 : 0;
+    attr.exclude_hv = 1;
+    return perfEventOpen(&attr, groupFd);
+}
+
+// A counter through its mapped page, as the kernel documents for
+// self-monitoring: retried while the kernel updates the page, and false
+// when the event is not on a counter or user reads are not allowed
+bool readMapped(const volatile perf_event_mmap_page* page, uint64_t& value) {
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t sequence;
+    do {
+        sequence = page->lock;
+        __asm__ __volatile__("" ::: "memory");
+
+        uint32_t index = page->index;
+        if (!page->cap_user_rdpmc || index == 0) {
+            return false;
+        }
+
+        uint32_t low, high;
+        __asm__ __volatile__("rdpmc" : "=a"(low), "=d"(high) : "c"(index - 1));
+        uint16_t width = page->pmc_width;
+        int64_t count = static_cast<int64_t>((static_cast<uint64_t>(high) << 32) | low);
+        count = static_cast<int64_t>(static_cast<uint64_t>(count) << (64 - width)) >> (64 - width);
+        value = static_cast<uint64_t>(page->offset + count);
+
+        __asm__ __volatile__("" ::: "memory");
+    } while (page->lock != sequence);
+    return true;
+#else
+    (void)page;
+    (void)value;
+    return false;
+#endif
+}
+
+} // namespace
+
+PerfCounters::PerfCounters(bool realtime)
+    : enabled(false), realtime(realtime), opened(false), available(false), groupSize(0),
+      pageSize(static_cast<size_t>(sysconf(_SC_PAGESIZE))),
+      cpuClock(0), cpuClockValid(false)
+{
+    for (int i = 0; i < EVENT_COUNT; i++) {
+        fds[i] = -1;
+        groupIndex[i] = -1;
+        pages[i] = nullptr;
+    }
+    for (Totals& stage : totals) {
+        stage.calls = 0;
+        for (auto& value : stage.values) {
+            value = 0;
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (perf_event_mmap_page* page : pages) {
+        if (page) {
+            munmap(page, pageSize);
+        }
+    }
+    for (int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+const char* PerfCounters::getStageName(Stage stage) {
+    switch (stage) {
+        case STAGE_PROCESS: return "process";
+        case STAGE_JITTER:  return "jitter buffer";
+        case STAGE_DECODE:  return "decode";
+        case STAGE_ENCODE:  return "encode";
+        case STAGE_SEND:    return "send syscall";
+        default:            return "unknown";
+    }
+}
+
+bool PerfCounters::open() {
+    // The thread's CPU clock can be read from the reporting thread later
+    if (pthread_getcpuclockid(pthread_self(), &cpuClock) == 0) {
+        cpuClockValid = true;
+    }
+
+    // Kernel time is part of the cost of a syscall; without the permission
+    // for it (perf_event_paranoid), count user space only
+    bool user = false;
+    fds[0] = openEvent(EVENT_CONFIG[0], -1, user);
+    if (fds[0] < 0 && (errno == EACCES || errno == EPERM)) {
+        user = true;
+        fds[0] = openEvent(EVENT_CONFIG[0], -1, user);
+    }
+    if (fds[0] < 0) {
+        std::cerr << "Performance counters unavailable: " << strerror(errno) << std::endl;
+        return false;
+    }
+    groupIndex[0] = groupSize++;
+
+    // Counters this CPU lacks are reported as zero
+    for (int i = 1; i < EVENT_COUNT; i++) {
+        fds[i] = openEvent(EVENT_CONFIG[i], fds[0], user);
+        if (fds[i] >= 0) {
+            groupIndex[i] = groupSize++;
+        }
+    }
+
+    ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    if (realtime && !mapPages()) {
+        std::cerr << "Performance counters need user-space reads (rdpmc) on the realtime thread; "
+                  << "not counting it" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool PerfCounters::mapPages() {
+    for (int i = 0; i < EVENT_COUNT; i++) {
+        if (fds[i] < 0) {
+            continue;
+        }
+        void* page = mmap(nullptr, pageSize, PROT_READ, MAP_SHARED, fds[i], 0);
+        if (page != MAP_FAILED) {
+            pages[i] = static_cast<perf_event_mmap_page*>(page);
+        }
+    }
+
+    // The cycle counter must be readable now, on the thread it counts
+    uint64_t value;
+    return pages[0] && readMapped(pages[0], value);
+}
+
+void PerfCounters::openThread() {
+    if (!enabled.load(std::memory_order_relaxed) || opened) {
+        return;
+    }
+    opened = true;
+    available = open();
+}
+
+bool PerfCounters::read(Sample& sample) const {
+    // Realtime: no syscall, counters that are not mapped read as zero
+    if (realtime) {
+        for (int i = 0; i < EVENT_COUNT; i++) {
+            sample.values[i] = 0;
+            if (pages[i] && !readMapped(pages[i], sample.values[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // One read for the whole group: the count, then a value per member
+    uint64_t buffer[1 + EVENT_COUNT];
+    ssize_t size = ::read(fds[0], buffer, sizeof(buffer));
+    if (size < static_cast<ssize_t>(sizeof(uint64_t) * (1 + groupSize))) {
+        return false;
+    }
+
+    for (int i = 0; i < EVENT_COUNT; i++) {
+        sample.values[i] = groupIndex[i] >= 0 ? buffer[1 + groupIndex[i]] : 0;
+    }
+    return true;
+}
+
+bool PerfCounters::begin(Sample& start) {
+    if (!enabled.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    // A realtime thread never opens its group here: that is four syscalls
+    if (!opened) {
+        if (realtime) {
+            return false;
+        }
+        opened = true;
+        available = open();
+    }
+
+    return available && read(start);
+}
+
+void PerfCounters::end(Stage stage, const Sample& start) {
+    Sample now;
+    if (!read(now)) {
+        return;
+    }
+
+    // Only this thread writes, the reporting thread only reads
+    Totals& total = totals[stage];
+    total.calls.store(total.calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    for (int i = 0; i < EVENT_COUNT; i++) {
+        uint64_t value = total.values[i].load(std::memory_order_relaxed);
+        total.values[i].store(value + (now.values[i] - start.values[i]), std::memory_order_relaxed);
+    }
+}
+
+void PerfCounters::print(std::ostream& out, const char* thread) const {
+    if (!enabled) {
+        return;
+    }
+
+    // Nothing to report for a thread that never ran or had no counters
+    uint64_t allCalls = 0;
+    for (const Totals& total : totals) {
+        allCalls += total.calls.load(std::memory_order_relaxed);
+    }
+    if (allCalls == 0) {
+        return;
+    }
+
+    out << "Performance (" << thread << " thread)";
+    if (cpuClockValid) {
+        struct timespec cpu;
+        if (clock_gettime(cpuClock, &cpu) == 0) {
+            out << ": " << std::fixed << std::setprecision(3)
+                << (cpu.tv_sec + cpu.tv_nsec / 1e9) << "s CPU";
+        }
+    }
+    out << std::endl;
+
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        const Totals& total = totals[s];
+        uint64_t calls = total.calls.load(std::memory_order_relaxed);
+        if (calls == 0) {
+            continue;
+        }
+
+        uint64_t cycles = total.values[EVENT_CYCLES].load(std::memory_order_relaxed);
+        uint64_t instructions = total.values[EVENT_INSTRUCTIONS].load(std::memory_order_relaxed);
+
+        out << "  " << std::left << std::setw(14) << getStageName(static_cast<Stage>(s)) << std::right
+            << calls << " calls, per call:";
+        for (int e = 0; e < EVENT_COUNT; e++) {
+            out << " " << std::setprecision(0) << static_cast<double>(total.values[e].load(std::memory_order_relaxed)) / calls
+                << " " << EVENT_NAMES[e] << (e + 1 < EVENT_COUNT ? "," : "");
+        }
+        if (cycles > 0) {
+            out << " (IPC " << std::setprecision(2) << static_cast<double>(instructions) / cycles << ")";
+        }
+        out << std::endl;
+    }
+
+    out.unsetf(std::ios::floatfield);
+    out << std::setprecision(6);
+}
+
+} // namespace aes67
@@ -0,0 +1,116 @@
+// PerfCounters.h
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <array>
+#include <ostream>
+#include <time.h>
+
+struct perf_event_mmap_page;
+
+namespace aes67 {
+
+// Hardware counters for the stages of one thread, from perf_event_open.
+//
+// The counters are a per-thread group of cycles, instructions, cache misses
+// and branch misses, read before and after each stage and summed per stage,
+// so the report shows what each packet costs in each kernel rather than
+// only how long it took. The group is opened on the measured thread at its
+// first measured call and read with read(). A realtime thread's group is
+// instead opened by openThread() before the thread runs and read from the
+// mapped counter pages with rdpmc, so its probes make no syscalls; where
+// user-space reads are not available, its stages are not counted.
+// Disabled, a probe costs one relaxed load.
+class PerfCounters {
+public:
+    enum Stage {
+        STAGE_PROCESS = 0,  // The whole JACK callback
+        STAGE_JITTER,       // RTP parse and merge into the jitter buffer
+        STAGE_DECODE,       // Network format to float
+        STAGE_ENCODE,       // Float to network format and RTP packet
+        STAGE_SEND,         // Transmit syscall
+        STAGE_COUNT
+    };
+
+    enum Event {
+        EVENT_CYCLES = 0,
+        EVENT_INSTRUCTIONS,
+        EVENT_CACHE_MISSES,
+        EVENT_BRANCH_MISSES,
+        EVENT_COUNT
+    };
+
+    struct Sample {
+        uint64_t values[EVENT_COUNT];
+    };
+
+    explicit PerfCounters(bool realtime = false);
+    ~PerfCounters();
+
+    // From the control thread, before the measured thread runs
+    void setEnabled(bool enable) { enabled = enable; }
+    bool isEnabled() const { return enabled; }
+
+    // On the measured thread before its first measured call; a realtime
+    // thread's counters open only here
+    void openThread();
+
+    // On the measured thread; end() only after a begin() that returned true
+    bool begin(Sample& start);
+    void end(Stage stage, const Sample& start);
+
+    // Totals per stage, per call, and the thread's CPU time
+    void print(std::ostream& out, const char* thread) const;
+
+    static const char* getStageName(Stage stage);
+
+private:
+    struct Totals {
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> values[EVENT_COUNT];
+    };
+
+    std::atomic<bool> enabled;
+    bool realtime;                  // Read from user space only
+    bool opened;                    // Open attempted, on the measured thread
+    bool available;                 // At least the cycle counter opened
+    int fds[EVENT_COUNT];           // Group members, fds[0] leads
+    int groupIndex[EVENT_COUNT];    // Position of each event in a group read
+    int groupSize;
+    perf_event_mmap_page* pages[EVENT_COUNT];   // Mapped counters, realtime only
+    size_t pageSize;
+
+    clockid_t cpuClock;
+    std::atomic<bool> cpuClockValid;
+
+    std::array<Totals, STAGE_COUNT> totals;
+
+    bool open();
+    bool mapPages();
+    bool read(Sample& sample) const;
+};
+
+// Counts one stage for the lifetime of the scope
+class PerfScope {
+public:
+    PerfScope(PerfCounters& counters, PerfCounters::Stage stage)
+        : counters(counters), stage(stage), active(counters.begin(start)) {}
+
+    ~PerfScope() {
+        if (active) {
+            counters.end(stage, start);
+        }
+    }
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+    PerfCounters& counters;
+    PerfCounters::Stage stage;
+    PerfCounters::Sample start;
+    bool active;
+};
+
+} // namespace aes67
@@ -0,0 +1,182 @@
+// PlayoutAdjuster.cpp
+#include "PlayoutAdjuster.h"
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+namespace aes67 {
+
+constexpr size_t PlayoutAdjuster::MAX_PERIOD;
+constexpr size_t PlayoutAdjuster::RESAMPLE_SPACING;
+constexpr float PlayoutAdjuster::QUIET_LEVEL;
+constexpr long PlayoutAdjuster::DEADBAND;
+
+PlayoutAdjuster::PlayoutAdjuster()
+    : channelCount(0), sampleRate(48000), window(0), hysteresis(0),
+      lowWater(SIZE_MAX), lastLowWater(0), windowFill(0),
+      pending(0), sinceResample(0), quiet(false),
+      droppedFrames(0), insertedFrames(0)
+{
+}
+
+PlayoutAdjuster::~PlayoutAdjuster() {
+    // Nothing specific to clean up
+}
+
+void PlayoutAdjuster::initialize(uint16_t channels, uint32_t rate) {
+    channelCount = channels;
+    sampleRate = rate;
+
+    // Half a second of low points, and half a millisecond of slack above the target
+    window = rate / 2;
+    hysteresis = rate / 2000;
+
+    scratch.assign(channelCount, std::vector<float>(MAX_PERIOD + 1, 0.0f));
+    scratchPtrs.resize(channelCount);
+    for (uint16_t ch = 0; ch < channelCount; ch++) {
+        scratchPtrs[ch] = scratch[ch].data();
+    }
+    offsetPtrs.assign(channelCount, nullptr);
+    lastFrame.assign(channelCount, 0.0f);
+
+    reset();
+}
+
+void PlayoutAdjuster::reset() {
+    lowWater = SIZE_MAX;
+    lastLowWater = 0;
+    windowFill = 0;
+    pending = 0;
+    sinceResample = 0;
+    quiet = false;
+    std::fill(lastFrame.begin(), lastFrame.end(), 0.0f);
+}
+
+size_t PlayoutAdjuster::read(AudioRing& ring, float* const* out, size_t frames, size_t targetFrames) {
+    measure(ring.readable(), frames, targetFrames);
+    return apply(ring, out, frames);
+}
+
+size_t PlayoutAdjuster::readCorrected(AudioRing& ring, float* const* out, size_t frames, long error) {
+    // Jitter in the measurement alone should not keep the stream slipping
+    pending = std::abs(error) > DEADBAND ? error : 0;
+
+    // A later switch back to depth steering starts a fresh window
+    lowWater = SIZE_MAX;
+    windowFill = 0;
+
+    return apply(ring, out, frames);
+}
+
+size_t PlayoutAdjuster::apply(AudioRing& ring, float* const* out, size_t frames) {
+    size_t queued = ring.readable();
+    sinceResample += frames;
+    bool adjustable = channelCount > 0 && frames > 1 && frames <= MAX_PERIOD;
+
+    // Drop a frame: take one more than the period from the ring
+    if (adjustable && pending > 0 && queued > frames) {
+        if (quiet) {
+            ring.read(out, frames);
+            ring.read(scratchPtrs.data(), 1);
+            pending--;
+            droppedFrames++;
+            finish(out, frames);
+            return frames;
+        }
+        if (sinceResample >= RESAMPLE_SPACING) {
+            ring.read(scratchPtrs.data(), frames + 1);
+            resample(out, frames + 1, frames);
+            sinceResample = 0;
+            pending--;
+            droppedFrames++;
+            finish(out, frames);
+            return frames;
+        }
+    }
+
+    // Insert a frame: take one less and stretch the period
+    if (adjustable && pending < 0 && queued >= frames) {
+        if (quiet) {
+            // Hold the previous sample for one frame
+            for (uint16_t ch = 0; ch < channelCount; ch++) {
+                out[ch][0] = lastFrame[ch];
+                offsetPtrs[ch] = out[ch] + 1;
+            }
+            ring.read(offsetPtrs.data(), frames - 1);
+            pending++;
+            insertedFrames++;
+            finish(out, frames);
+            return frames;
+        }
+        if (sinceResample >= RESAMPLE_SPACING) {
+            ring.read(scratchPtrs.data(), frames - 1);
+            resample(out, frames - 1, frames);
+            sinceResample = 0;
+            pending++;
+            insertedFrames++;
+            finish(out, frames);
+            return frames;
+        }
+    }
+
+    size_t available = ring.read(out, frames);
+    finish(out, available);
+    return available;
+}
+
+void PlayoutAdjuster::measure(size_t queued, size_t frames, size_t targetFrames) {
+    lowWater = std::min(lowWater, queued);
+    windowFill += frames;
+
+    if (windowFill < window) {
+        return;
+    }
+
+    // Replace the outstanding correction with the error just measured
+    lastLowWater = lowWater;
+    if (lowWater > targetFrames + hysteresis) {
+        pending = static_cast<long>(lowWater - targetFrames);
+    } else if (lowWater < targetFrames) {
+        pending = -static_cast<long>(targetFrames - lowWater);
+    } else {
+        pending = 0;
+    }
+
+    lowWater = SIZE_MAX;
+    windowFill = 0;
+}
+
+void PlayoutAdjuster::resample(float* const* out, size_t inFrames, size_t outFrames) {
+    // Linear interpolation with both ends aligned, so periods join smoothly
+    const double step = static_cast<double>(inFrames - 1) / static_cast<double>(outFrames - 1);
+
+    for (uint16_t ch = 0; ch < channelCount; ch++) {
+        const float* __restrict in = scratch[ch].data();
+        float* __restrict dst = out[ch];
+        for (size_t i = 0; i < outFrames; i++) {
+            double pos = static_cast<double>(i) * step;
+            size_t index = std::min(static_cast<size_t>(pos), inFrames - 2);
+            float frac = static_cast<float>(pos - static_cast<double>(index));
+            dst[i] = in[index] + frac * (in[index + 1] - in[index]);
+        }
+    }
+}
+
+void PlayoutAdjuster::finish(float* const* out, size_t frames) {
+    if (frames == 0) {
+        return;
+    }
+
+    // Judge the next period by this one; quiet passages last far longer
+    float peak = 0.0f;
+    for (uint16_t ch = 0; ch < channelCount; ch++) {
+        const float* __restrict data = out[ch];
+        for (size_t i = 0; i < frames; i++) {
+            peak = std::max(peak, std::fabs(data[i]));
+        }
+        lastFrame[ch] = data[frames - 1];
+    }
+    quiet = peak < QUIET_LEVEL;
+}
+
+} // namespace aes67
@@ -0,0 +1,83 @@
+// PlayoutAdjuster.h
+#pragma once
+
+#include "AudioRing.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace aes67 {
+
+// Holds the receive ring near a target depth on the JACK thread.
+//
+// The depth that matters is the ring's low point at the start of a period:
+// a late packet is only survived if that much audio is already queued. Each
+// window the low point is compared with the target and the difference is
+// worked off one frame at a time. In quiet passages a frame is dropped or
+// repeated outright; when the audio never goes quiet a period is resampled
+// by one frame instead, at most once per RESAMPLE_SPACING frames (about a
+// tenth of a percent, well under two cents). readCorrected() applies the
+// same corrections to an error measured by the caller, such as the offset
+// from PTP-scheduled playout. All buffers are allocated in initialize(),
+// so both reads are safe on the JACK thread.
+class PlayoutAdjuster {
+public:
+    PlayoutAdjuster();
+    ~PlayoutAdjuster();
+
+    // Configuration (not RT-safe, allocates)
+    void initialize(uint16_t channels, uint32_t sampleRate);
+    void reset();
+
+    // Read up to frames from the ring, steering its low point toward
+    // targetFrames. Returns the frames written to out.
+    size_t read(AudioRing& ring, float* const* out, size_t frames, size_t targetFrames);
+
+    // Read up to frames, working off an error measured elsewhere: positive
+    // when the ring is behind and frames must be dropped
+    size_t readCorrected(AudioRing& ring, float* const* out, size_t frames, long error);
+
+    // Status
+    size_t getLowWater() const { return lastLowWater; }
+    uint64_t getDroppedFrames() const { return droppedFrames; }
+    uint64_t getInsertedFrames() const { return insertedFrames; }
+
+private:
+    static constexpr size_t MAX_PERIOD = 8192;       // Longest period that is adjusted
+    static constexpr size_t RESAMPLE_SPACING = 1000; // Frames per resampled frame
+    static constexpr float QUIET_LEVEL = 0.001f;     // -60 dBFS
+    static constexpr long DEADBAND = 2;              // Error frames left alone
+
+    uint16_t channelCount;
+    uint32_t sampleRate;
+    size_t window;          // Frames per low-point measurement
+    size_t hysteresis;      // Excess tolerated before dropping frames
+
+    // Measurement
+    size_t lowWater;
+    size_t lastLowWater;
+    size_t windowFill;
+
+    // Frames still to remove (positive) or add (negative)
+    long pending;
+    size_t sinceResample;
+    bool quiet;             // The last period stayed below QUIET_LEVEL
+
+    std::vector<std::vector<float>> scratch;
+    std::vector<float*> scratchPtrs;
+    std::vector<float*> offsetPtrs;
+    std::vector<float> lastFrame;
+
+    // Statistics
+    uint64_t droppedFrames;
+    uint64_t insertedFrames;
+
+    // Helper functions
+    void measure(size_t queued, size_t frames, size_t targetFrames);
+    size_t apply(AudioRing& ring, float* const* out, size_t frames);
+    void resample(float* const* out, size_t inFrames, size_t outFrames);
+    void finish(float* const* out, size_t frames);
+};
+
+} // namespace aes67
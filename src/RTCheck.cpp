@@ -0,0 +1,351 @@
+// RTCheck.cpp
+#include "RTCheck.h"
+
+#ifdef AES67_RT_CHECK
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// glibc's own allocator entry points, so the hooks need no dlsym bootstrap
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace aes67 {
+namespace rtcheck {
+
+namespace {
+
+constexpr int MAX_RECORDS = 64;
+constexpr int MAX_FRAMES = 24;
+
+// One distinct violating call stack
+struct Record {
+    std::atomic<bool> ready;
+    Violation kind;
+    const char* call;
+    int depth;
+    void* frames[MAX_FRAMES];
+    std::atomic<uint64_t> count;
+};
+
+Record records[MAX_RECORDS];
+std::atomic<int> recordCount(0);
+std::atomic<uint64_t> counters[4];
+
+// Realtime nesting depth, and a guard so recording never checks itself
+thread_local int realtimeDepth = 0;
+thread_local bool inCheck = false;
+
+void record(Violation kind, const char* call) {
+    counters[static_cast<int>(kind)].fetch_add(1, std::memory_order_relaxed);
+
+    void* frames[MAX_FRAMES];
+    int depth = backtrace(frames, MAX_FRAMES);
+
+    // Count repeats of a known stack instead of storing them again
+    int count = std::min(recordCount.load(std::memory_order_acquire), MAX_RECORDS);
+    for (int i = 0; i < count; i++) {
+        Record& r = records[i];
+        if (r.ready.load(std::memory_order_acquire) && r.kind == kind && r.depth == depth &&
+            memcmp(r.frames, frames, depth * sizeof(void*)) == 0) {
+            r.count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    int slot = recordCount.fetch_add(1, std::memory_order_acq_rel);
+    if (slot >= MAX_RECORDS) {
+        return;
+    }
+
+    Record& r = records[slot];
+    r.kind = kind;
+    r.call = call;
+    r.depth = depth;
+    memcpy(r.frames, frames, depth * sizeof(void*));
+    r.count.store(1, std::memory_order_relaxed);
+    r.ready.store(true, std::memory_order_release);
+}
+
+inline void check(Violation kind, const char* call) {
+    if (realtimeDepth > 0 && !inCheck) {
+        inCheck = true;
+        record(kind, call);
+        inCheck = false;
+    }
+}
+
+// Look up the real implementation of an interposed function
+template<typename Fn>
+Fn next(Fn& cached, const char* name) {
+    if (!cached) {
+        cached = reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+    }
+    return cached;
+}
+
+const char* violationName(Violation kind) {
+    switch (kind) {
+        case Violation::Allocation: return "allocation";
+        case Violation::Free:       return "free";
+        case Violation::Lock:       return "lock";
+        case Violation::Blocking:   return "blocking call";
+    }
+    return "unknown";
+}
+
+// backtrace() loads libgcc on first use; do that before any realtime thread runs
+struct Primer {
+    Primer() {
+        void* frames[2];
+        backtrace(frames, 2);
+    }
+} primer;
+
+} // namespace
+
+void enterRealtime() {
+    realtimeDepth++;
+}
+
+void leaveRealtime() {
+    realtimeDepth--;
+}
+
+Report getReport() {
+    Report report;
+    report.allocations = counters[static_cast<int>(Violation::Allocation)].load();
+    report.frees = counters[static_cast<int>(Violation::Free)].load();
+    report.locks = counters[static_cast<int>(Violation::Lock)].load();
+    report.blocking = counters[static_cast<int>(Violation::Blocking)].load();
+    return report;
+}
+
+void resetReport() {
+    for (auto& counter : counters) {
+        counter.store(0);
+    }
+
+    // Stacks seen so far stay known, and are printed again only if they recur
+    int count = std::min(recordCount.load(std::memory_order_acquire), MAX_RECORDS);
+    for (int i = 0; i < count; i++) {
+        records[i].count.store(0, std::memory_order_relaxed);
+    }
+}
+
+void printReport(std::ostream& out) {
+    Report report = getReport();
+    out << "RT check: " << report.allocations << " allocations, " << report.frees << " frees, "
+        << report.locks << " locks, " << report.blocking << " blocking calls" << std::endl;
+
+    int count = std::min(recordCount.load(std::memory_order_acquire), MAX_RECORDS);
+    for (int i = 0; i < count; i++) {
+        const Record& r = records[i];
+        if (!r.ready.load(std::memory_order_acquire) || r.count.load() == 0) {
+            continue;
+        }
+
+        out << "\n" << violationName(r.kind) << " in " << r.call
+            << " (" << r.count.load() << "x):" << std::endl;
+
+        // Skip the recording frames themselves
+        char** symbols = backtrace_symbols(r.frames, r.depth);
+        for (int f = 2; f < r.depth; f++) {
+            out << "    " << (symbols ? symbols[f] : "?") << std::endl;
+        }
+        free(symbols);
+    }
+
+    if (recordCount.load() > MAX_RECORDS) {
+        out << "\n(" << (recordCount.load() - MAX_RECORDS) << " further call stacks not recorded)" << std::endl;
+    }
+}
+
+} // namespace rtcheck
+} // namespace aes67
+
+using aes67::rtcheck::Violation;
+using aes67::rtcheck::check;
+
+extern "C" {
+
+// Allocation
+
+void* malloc(size_t size) {
+    check(Violation::Allocation, "malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    check(Violation::Allocation, "calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    check(Violation::Allocation, "realloc");
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    check(Violation::Allocation, "posix_memalign");
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    check(Violation::Allocation, "aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+void free(void* ptr) {
+    if (ptr) {
+        check(Violation::Free, "free");
+    }
+    __libc_free(ptr);
+}
+
+// Locks and thread signalling
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    static int (*real)(pthread_mutex_t*) = nullptr;
+    check(Violation::Lock, "pthread_mutex_lock");
+    return aes67::rtcheck::next(real, "pthread_mutex_lock")(mutex);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* lock) {
+    static int (*real)(pthread_rwlock_t*) = nullptr;
+    check(Violation::Lock, "pthread_rwlock_rdlock");
+    return aes67::rtcheck::next(real, "pthread_rwlock_rdlock")(lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* lock) {
+    static int (*real)(pthread_rwlock_t*) = nullptr;
+    check(Violation::Lock, "pthread_rwlock_wrlock");
+    return aes67::rtcheck::next(real, "pthread_rwlock_wrlock")(lock);
+}
+
+int pthread_cond_signal(pthread_cond_t* cond) {
+    static int (*real)(pthread_cond_t*) = nullptr;
+    check(Violation::Lock, "pthread_cond_signal");
+    return aes67::rtcheck::next(real, "pthread_cond_signal")(cond);
+}
+
+int pthread_cond_broadcast(pthread_cond_t* cond) {
+    static int (*real)(pthread_cond_t*) = nullptr;
+    check(Violation::Lock, "pthread_cond_broadcast");
+    return aes67::rtcheck::next(real, "pthread_cond_broadcast")(cond);
+}
+
+int sem_wait(sem_t* sem) {
+    static int (*real)(sem_t*) = nullptr;
+    check(Violation::Lock, "sem_wait");
+    return aes67::rtcheck::next(real, "sem_wait")(sem);
+}
+
+// Blocking system calls
+
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+    static int (*real)(pthread_cond_t*, pthread_mutex_t*) = nullptr;
+    check(Violation::Blocking, "pthread_cond_wait");
+    return aes67::rtcheck::next(real, "pthread_cond_wait")(cond, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime) {
+    static int (*real)(pthread_cond_t*, pthread_mutex_t*, const struct timespec*) = nullptr;
+    check(Violation::Blocking, "pthread_cond_timedwait");
+    return aes67::rtcheck::next(real, "pthread_cond_timedwait")(cond, mutex, abstime);
+}
+
+int nanosleep(const struct timespec* req, struct timespec* rem) {
+    static int (*real)(const struct timespec*, struct timespec*) = nullptr;
+    check(Violation::Blocking, "nanosleep");
+    return aes67::rtcheck::next(real, "nanosleep")(req, rem);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec* req, struct timespec* rem) {
+    static int (*real)(clockid_t, int, const struct timespec*, struct timespec*) = nullptr;
+    check(Violation::Blocking, "clock_nanosleep");
+    return aes67::rtcheck::next(real, "clock_nanosleep")(clock, flags, req, rem);
+}
+
+int usleep(useconds_t usec) {
+    static int (*real)(useconds_t) = nullptr;
+    check(Violation::Blocking, "usleep");
+    return aes67::rtcheck::next(real, "usleep")(usec);
+}
+
+int poll(struct pollfd* fds, nfds_t nfds, int timeout) {
+    static int (*real)(struct pollfd*, nfds_t, int) = nullptr;
+    check(Violation::Blocking, "poll");
+    return aes67::rtcheck::next(real, "poll")(fds, nfds, timeout);
+}
+
+int select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds, struct timeval* timeout) {
+    static int (*real)(int, fd_set*, fd_set*, fd_set*, struct timeval*) = nullptr;
+    check(Violation::Blocking, "select");
+    return aes67::rtcheck::next(real, "select")(nfds, readfds, writefds, exceptfds, timeout);
+}
+
+ssize_t read(int fd, void* buf, size_t count) {
+    static ssize_t (*real)(int, void*, size_t) = nullptr;
+    check(Violation::Blocking, "read");
+    return aes67::rtcheck::next(real, "read")(fd, buf, count);
+}
+
+ssize_t write(int fd, const void* buf, size_t count) {
+    static ssize_t (*real)(int, const void*, size_t) = nullptr;
+    check(Violation::Blocking, "write");
+    return aes67::rtcheck::next(real, "write")(fd, buf, count);
+}
+
+ssize_t sendto(int fd, const void* buf, size_t len, int flags, const struct sockaddr* addr, socklen_t addrlen) {
+    static ssize_t (*real)(int, const void*, size_t, int, const struct sockaddr*, socklen_t) = nullptr;
+    check(Violation::Blocking, "sendto");
+    return aes67::rtcheck::next(real, "sendto")(fd, buf, len, flags, addr, addrlen);
+}
+
+ssize_t recvfrom(int fd, void* buf, size_t len, int flags, struct sockaddr* addr, socklen_t* addrlen) {
+    static ssize_t (*real)(int, void*, size_t, int, struct sockaddr*, socklen_t*) = nullptr;
+    check(Violation::Blocking, "recvfrom");
+    return aes67::rtcheck::next(real, "recvfrom")(fd, buf, len, flags, addr, addrlen);
+}
+
+} // extern "C"
+
+#else
+
+namespace aes67 {
+namespace rtcheck {
+
+Report getReport() {
+    return Report();
+}
+
+void resetReport() {
+}
+
+void printReport(std::ostream& out) {
+    (void)out;
+}
+
+} // namespace rtcheck
+} // namespace aes67
+
+#endif
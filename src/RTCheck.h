@@ -0,0 +1,68 @@
+// RTCheck.h
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+namespace aes67 {
+namespace rtcheck {
+
+// Debug builds configured with -DAES67_RT_CHECK=ON interpose malloc/free,
+// mutex and condition variable calls and blocking syscalls. Any of these
+// made inside a ScopedRealtime region (the JACK callback) is counted and
+// its call stack recorded. In normal builds every call here is a no-op.
+//
+// Only aes67_bridge's process() runs in such a region. The mai tool in
+// AES67-JACK is a separate C program; its jack_send(), jack_recv() and
+// mai_audio_write() are not checked.
+#ifdef AES67_RT_CHECK
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+// Kinds of call that are not allowed on a realtime thread
+enum class Violation {
+    Allocation,
+    Free,
+    Lock,
+    Blocking
+};
+
+struct Report {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t locks = 0;
+    uint64_t blocking = 0;
+
+    uint64_t total() const { return allocations + frees + locks + blocking; }
+};
+
+#ifdef AES67_RT_CHECK
+void enterRealtime();
+void leaveRealtime();
+#else
+inline void enterRealtime() {}
+inline void leaveRealtime() {}
+#endif
+
+// Counters since start or the last reset. Reset once the stream is primed,
+// so one-time setup in the first cycles is not counted as steady state.
+Report getReport();
+void resetReport();
+
+// Print every distinct violating call stack (not RT-safe)
+void printReport(std::ostream& out);
+
+// Marks the enclosing scope as realtime on the calling thread
+class ScopedRealtime {
+public:
+    ScopedRealtime() { enterRealtime(); }
+    ~ScopedRealtime() { leaveRealtime(); }
+
+    ScopedRealtime(const ScopedRealtime&) = delete;
+    ScopedRealtime& operator=(const ScopedRealtime&) = delete;
+};
+
+} // namespace rtcheck
+} // namespace aes67
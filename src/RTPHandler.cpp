@@ -19,8 +19,11 @@ struct RTPHeader {
 
 RTPHandler::RTPHandler()
     : ssrc(0), sequenceNumber(0), timestamp(0), 
-      sampleRate(48000), channelCount(2), payloadType(96),
-      expectedSequence(0), packetCount(0), droppedPackets(0), outOfOrderPackets(0)
+      sampleRate(48000), channelCount(2), payloadType(96), bytesPerSample(3),
+      expectedSequence(0), sequenceSynced(false), newestSequence(0), reorderDepth(4),
+      arrivalTimestamp(0),
+      packetCount(0), droppedPackets(0), outOfOrderPackets(0),
+      duplicatePackets(0), latePackets(0)
 {
     // Initialize random SSRC and sequence number
     std::random_device rd;
@@ -32,9 +35,24 @@ RTPHandler::RTPHandler()
     sequenceNumber = seqDist(gen);
     expectedSequence = sequenceNumber;
     
-    // Initialize packet buffer
+    // Initialize packet buffer, reserving storage so receiving never allocates
     for (auto& entry : packetBuffer) {
+        entry.data.reserve(MAX_PACKET_SIZE);
+        entry.payloadOffset = 0;
+        entry.payloadSize = 0;
+        entry.sequenceNumber = 0;
+        entry.timestamp = 0;
         entry.valid = false;
+        entry.delivered = false;
+    }
+    
+    for (auto& state : pathState) {
+        state.packets = 0;
+        state.firstArrivals = 0;
+        state.duplicates = 0;
+        state.lost = 0;
+        state.lastSequence = 0;
+        state.seen = false;
     }
 }
 
@@ -60,13 +78,25 @@ void RTPHandler::setPayloadType(uint16_t type) {
     payloadType = type;
 }
 
+void RTPHandler::setBytesPerSample(uint16_t bytes) {
+    bytesPerSample = bytes;
+}
+
+void RTPHandler::setTimestamp(uint32_t rtpTimestamp) {
+    timestamp = rtpTimestamp;
+}
+
 bool RTPHandler::createPacket(const AudioData& audio, std::vector<uint8_t>& packet) {
-    if (audio.samples.empty() || audio.channelCount == 0 || audio.frameCount == 0) {
+    if (!audio.payload || audio.channelCount == 0 || audio.frameCount == 0) {
         return false;
     }
     
-    // Calculate the packet size
-    size_t payloadSize = audio.frameCount * audio.channelCount * sizeof(int32_t);
+    // The payload is already L16, L24 or L32; one of another width would
+    // be misread by every receiver
+    size_t payloadSize = static_cast<size_t>(audio.frameCount) * audio.channelCount * bytesPerSample;
+    if (audio.payloadSize != payloadSize) {
+        return false;
+    }
     size_t packetSize = sizeof(RTPHeader) + payloadSize;
     
     // Resize the packet buffer
@@ -80,15 +110,12 @@ bool RTPHandler::createPacket(const AudioData& audio, std::vector<uint8_t>& pack
     header->timestamp = htonl(timestamp);
     header->ssrc = htonl(ssrc);
     
-    // Update timestamp for next packet (assumes 48kHz sample rate by default)
+    // Free-run to the next packet unless the media clock sets it
     timestamp += audio.frameCount;
     
-    // Copy audio samples to the payload
-    // Note: This is a simplified implementation that assumes the audio data
-    // is already in the correct format. A real implementation would need to
-    // convert from float to the appropriate format (e.g., L24).
+    // Copy the converted samples to the payload
     uint8_t* payload = packet.data() + sizeof(RTPHeader);
-    memcpy(payload, audio.samples.data(), payloadSize);
+    memcpy(payload, audio.payload, payloadSize);
     
     // Update statistics
     packetCount++;
@@ -125,14 +152,16 @@ bool RTPHandler::parsePacket(const uint8_t* data, size_t size, AudioData& audio)
     expectedSequence = seq + 1;
     
     // Calculate frames based on payload size and channel count
-    // This assumes L24 (24-bit) format by default
-    size_t bytesPerSample = 3;  // 24-bit = 3 bytes
-    size_t frameCount = payloadSize / (channelCount * bytesPerSample);
+    size_t frameCount = framesInPayload(payloadSize);
     
     // Prepare the audio data structure
     audio.channelCount = channelCount;
     audio.sampleRate = sampleRate;
     audio.frameCount = frameCount;
+    audio.payload = payload;
+    audio.payloadSize = payloadSize;
+    audio.sequence = seq;
+    audio.timestamp = ts;
     audio.samples.resize(frameCount * channelCount);
     
     // Copy and convert payload to audio samples
@@ -151,91 +180,261 @@ bool RTPHandler::parsePacket(const uint8_t* data, size_t size, AudioData& audio)
     return true;
 }
 
-void RTPHandler::addPacketToBuffer(const uint8_t* data, size_t size) {
-    if (size < sizeof(RTPHeader)) {
-        return;
+bool RTPHandler::addPacketToBuffer(const uint8_t* data, size_t size, int path) {
+    uint16_t seq;
+    uint32_t ts;
+    size_t payloadOffset;
+    size_t payloadSize;
+    
+    if (size > MAX_PACKET_SIZE || !parseHeader(data, size, seq, ts, payloadOffset, payloadSize)) {
+        return false;
     }
     
-    // Parse the RTP header
-    const RTPHeader* header = reinterpret_cast<const RTPHeader*>(data);
-    uint16_t seq = ntohs(header->seq);
+    if (path < 0 || path >= MAX_PATHS) {
+        path = 0;
+    }
+    
+    // Lock the buffer
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    
+    packetCount++;
+    updatePathStats(path, seq);
+    
+    if (!sequenceSynced) {
+        expectedSequence = seq;
+        newestSequence = seq;
+        sequenceSynced = true;
+    }
     
     // Calculate sequence difference
     int16_t seqDiff = seq - expectedSequence;
+    uint16_t idx = getBufferIndex(seq);
+    PacketEntry& entry = packetBuffer[idx];
     
-    // If packet is too old, drop it
-    if (seqDiff < -MAX_BUFFER_PACKETS/2) {
-        droppedPackets++;
-        return;
+    // A copy carries the same sequence number and RTP timestamp; the same
+    // sequence with another timestamp is a sender that restarted
+    bool sameSequence = seqDiff < 0 && seqDiff >= -static_cast<int16_t>(MAX_BUFFER_PACKETS) &&
+                        entry.delivered && entry.sequenceNumber == seq;
+    bool restarted = sameSequence && entry.timestamp != ts;
+    
+    if (seqDiff < 0 && !restarted) {
+        if (sameSequence) {
+            // The other path already delivered this one
+            duplicatePackets++;
+            pathState[path].duplicates++;
+        } else {
+            // Arrived after we gave up waiting for it
+            latePackets++;
+        }
+        return false;
     }
     
     // If packet is too far in the future, we might have missed many packets
-    if (seqDiff > MAX_BUFFER_PACKETS/2) {
+    if (restarted || seqDiff >= static_cast<int16_t>(MAX_BUFFER_PACKETS)) {
         // Reset our expected sequence
-        expectedSequence = seq;
         droppedPackets++;
+        expectedSequence = seq;
+        newestSequence = seq;
         // Clear the buffer in this case
-        for (auto& entry : packetBuffer) {
-            entry.valid = false;
+        for (auto& e : packetBuffer) {
+            e.valid = false;
+            e.delivered = false;
         }
     }
     
-    // Get buffer index for this sequence number
-    uint16_t idx = getBufferIndex(seq);
-    
-    // Lock the buffer
-    std::lock_guard<std::mutex> lock(bufferMutex);
+    // First arrival wins, later copies of a waiting packet are dropped
+    if (entry.valid && entry.sequenceNumber == seq && entry.timestamp == ts) {
+        duplicatePackets++;
+        pathState[path].duplicates++;
+        return false;
+    }
     
     // Store packet in buffer
-    packetBuffer[idx].data.resize(size);
-    memcpy(packetBuffer[idx].data.data(), data, size);
-    packetBuffer[idx].sequenceNumber = seq;
-    packetBuffer[idx].valid = true;
+    entry.data.assign(data, data + size);
+    entry.payloadOffset = payloadOffset;
+    entry.payloadSize = payloadSize;
+    entry.sequenceNumber = seq;
+    entry.timestamp = ts;
+    entry.valid = true;
+    entry.delivered = false;
+    arrivalTimestamp = ts;
+    pathState[path].firstArrivals++;
     
     // If this is an out of order packet
-    if (seq != expectedSequence && seqDiff > 0) {
-        outOfOrderPackets++;
+    if (static_cast<int16_t>(seq - newestSequence) > 0) {
+        if (static_cast<int16_t>(seq - newestSequence) > 1) {
+            outOfOrderPackets++;
+        }
+        newestSequence = seq;
     }
     
-    // Process the buffer to handle any contiguous packets
-    processBuffer();
+    return true;
 }
 
 bool RTPHandler::getNextAudioFrame(AudioData& audio) {
-    // This would normally retrieve the next frame from the processed buffer
-    // In a real implementation, we would maintain a queue of processed frames
-    // For simplicity, we're just doing a placeholder here
-    return false;
+    return takeNextFrame(audio, false, 0);
 }
 
-uint16_t RTPHandler::getBufferIndex(uint16_t sequence) const {
-    return sequence % MAX_BUFFER_PACKETS;
+bool RTPHandler::getNextAudioFrame(AudioData& audio, uint32_t deadline) {
+    return takeNextFrame(audio, true, deadline);
 }
 
-void RTPHandler::processBuffer() {
-    // This method would process the buffer to handle any contiguous packets
-    // It would extract audio data from packets in sequence and make it available
-    // for getNextAudioFrame()
+bool RTPHandler::takeNextFrame(AudioData& audio, bool scheduled, uint32_t deadline) {
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    
+    if (!sequenceSynced) {
+        return false;
+    }
     
-    // Check if we have the next expected packet
     uint16_t idx = getBufferIndex(expectedSequence);
     
-    while (packetBuffer[idx].valid && packetBuffer[idx].sequenceNumber == expectedSequence) {
-        // Process this packet
-        // In a real implementation, we would extract the audio data and
-        // add it to our processed frame queue
-        
-        // Mark as processed
-        packetBuffer[idx].valid = false;
+    // Give up on a missing packet once enough later packets are waiting,
+    // or with a deadline once they are due; a full buffer gives up either
+    // way, before the next packet would overrun it
+    while (!(packetBuffer[idx].valid && packetBuffer[idx].sequenceNumber == expectedSequence)) {
+        int16_t ahead = newestSequence - expectedSequence;
+        if (ahead <= 0) {
+            return false;
+        }
+        if (scheduled) {
+            if (ahead < static_cast<int16_t>(MAX_BUFFER_PACKETS - 1) &&
+                static_cast<int32_t>(waitingTimestamp() - deadline) > 0) {
+                return false;
+            }
+        } else if (ahead < static_cast<int16_t>(reorderDepth)) {
+            return false;
+        }
         
-        // Move to next packet
+        droppedPackets++;
         expectedSequence++;
         idx = getBufferIndex(expectedSequence);
     }
     
-    // If we don't have the next expected packet but we've waited long enough,
-    // we might need to skip ahead to avoid excessive delay
-    // This would be implemented in a real system
+    PacketEntry& entry = packetBuffer[idx];
+    
+    audio.channelCount = channelCount;
+    audio.sampleRate = sampleRate;
+    audio.payload = entry.data.data() + entry.payloadOffset;
+    audio.payloadSize = entry.payloadSize;
+    audio.frameCount = framesInPayload(audio.payloadSize);
+    audio.sequence = entry.sequenceNumber;
+    audio.timestamp = entry.timestamp;
+    
+    // Mark as delivered so copies from another path are recognised
+    entry.valid = false;
+    entry.delivered = true;
+    expectedSequence++;
+    
+    return true;
+}
+
+void RTPHandler::setReorderDepth(uint16_t packets) {
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    reorderDepth = std::max<uint16_t>(1, std::min<uint16_t>(packets, MAX_BUFFER_PACKETS / 2));
+}
+
+void RTPHandler::resetBuffer() {
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    
+    for (auto& entry : packetBuffer) {
+        entry.valid = false;
+        entry.delivered = false;
+    }
+    
+    sequenceSynced = false;
+    
+    for (auto& state : pathState) {
+        state.seen = false;
+    }
+}
+
+RTPHandler::PathStats RTPHandler::getPathStats(int path) const {
+    PathStats stats = {};
+    
+    if (path >= 0 && path < MAX_PATHS) {
+        stats.packets = pathState[path].packets;
+        stats.firstArrivals = pathState[path].firstArrivals;
+        stats.duplicates = pathState[path].duplicates;
+        stats.lost = pathState[path].lost;
+    }
+    
+    return stats;
+}
+
+uint32_t RTPHandler::waitingTimestamp() const {
+    // RTP timestamp of the first packet waiting after the expected one
+    for (uint16_t seq = expectedSequence + 1; seq != static_cast<uint16_t>(newestSequence + 1); seq++) {
+        const PacketEntry& entry = packetBuffer[getBufferIndex(seq)];
+        if (entry.valid && entry.sequenceNumber == seq) {
+            return entry.timestamp;
+        }
+    }
+    return packetBuffer[getBufferIndex(newestSequence)].timestamp;
+}
+
+uint16_t RTPHandler::getBufferIndex(uint16_t sequence) const {
+    return sequence % MAX_BUFFER_PACKETS;
+}
+
+bool RTPHandler::parseHeader(const uint8_t* data, size_t size, uint16_t& seq, uint32_t& ts,
+                             size_t& payloadOffset, size_t& payloadSize) const {
+    if (size < sizeof(RTPHeader)) {
+        return false;
+    }
+    
+    const RTPHeader* header = reinterpret_cast<const RTPHeader*>(data);
+    
+    // Check version (must be 2)
+    if ((header->vpxcc & 0xC0) != 0x80) {
+        return false;
+    }
+    
+    seq = ntohs(header->seq);
+    ts = ntohl(header->timestamp);
+    
+    // Skip any CSRCs and header extension
+    payloadOffset = sizeof(RTPHeader) + (header->vpxcc & 0x0F) * sizeof(uint32_t);
+    
+    if (header->vpxcc & 0x10) {
+        if (size < payloadOffset + 4) {
+            return false;
+        }
+        uint16_t words = (data[payloadOffset + 2] << 8) | data[payloadOffset + 3];
+        payloadOffset += (1 + words) * sizeof(uint32_t);
+    }
+    
+    // Drop any padding
+    size_t padding = (header->vpxcc & 0x20) ? data[size - 1] : 0;
+    
+    if (payloadOffset + padding >= size) {
+        return false;
+    }
+    
+    payloadSize = size - payloadOffset - padding;
+    return true;
+}
+
+size_t RTPHandler::framesInPayload(size_t payloadSize) const {
+    return payloadSize / (channelCount * bytesPerSample);
+}
+
+void RTPHandler::updatePathStats(int path, uint16_t seq) {
+    PathState& state = pathState[path];
+    state.packets++;
+    
+    // A forward jump on one path is loss on that network
+    if (state.seen) {
+        int16_t gap = seq - state.lastSequence;
+        if (gap > 1) {
+            state.lost += gap - 1;
+        }
+        if (gap <= 0) {
+            return;
+        }
+    }
+    
+    state.lastSequence = seq;
+    state.seen = true;
 }
 
 } // namespace aes67
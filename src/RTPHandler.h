@@ -20,26 +20,62 @@ public:
         uint32_t channelCount;       // Number of channels
         uint32_t sampleRate;         // Sample rate
         uint32_t frameCount;         // Number of frames
+        
+        // Network payload in the stream's sample format: what a received
+        // packet carried, valid until the next buffer call, or what a packet
+        // to send will carry
+        const uint8_t* payload;
+        size_t payloadSize;
+        
+        // Received packets only: RTP position
+        uint16_t sequence;
+        uint32_t timestamp;
     };
     
+    // Receive statistics for one network path (SMPTE ST 2022-7)
+    struct PathStats {
+        uint64_t packets;        // Packets received on this path
+        uint64_t firstArrivals;  // Packets this path delivered first
+        uint64_t duplicates;     // Packets the other path had already delivered
+        uint64_t lost;           // Sequence gaps seen on this path alone
+    };
+    
+    static constexpr int MAX_PATHS = 2;
+    
     // Configuration
     void initialize(uint32_t sampleRate, uint16_t channels, uint16_t payloadType = 96);
     void setSampleRate(uint32_t rate);
     void setChannelCount(uint16_t channels);
     void setPayloadType(uint16_t type);
+    void setBytesPerSample(uint16_t bytes);
+    void setTimestamp(uint32_t rtpTimestamp);  // Next packet created, from the media clock
     
-    // Packet operations
+    // Packet operations; a payload that is not frameCount frames at the
+    // configured width is refused
     bool createPacket(const AudioData& audio, std::vector<uint8_t>& packet);
     bool parsePacket(const uint8_t* data, size_t size, AudioData& audio);
     
-    // Buffer management for handling packet reordering and jitter
-    void addPacketToBuffer(const uint8_t* data, size_t size);
+    // Buffer management for handling packet reordering and jitter.
+    // Identical packets (sequence number and RTP timestamp) from several
+    // paths merge here, first arrival wins; a sequence number seen again
+    // with a new timestamp restarts the buffer at it.
+    // A missing packet is waited for until the reorder depth of later
+    // packets is waiting or, given a deadline, until the next packet
+    // waiting has an RTP timestamp at or before it.
+    bool addPacketToBuffer(const uint8_t* data, size_t size, int path = 0);
     bool getNextAudioFrame(AudioData& audio);
+    bool getNextAudioFrame(AudioData& audio, uint32_t deadline);
+    void setReorderDepth(uint16_t packets);
+    void resetBuffer();
     
     // Status
     uint32_t getPacketCount() const { return packetCount; }
     uint32_t getDroppedPackets() const { return droppedPackets; }
     uint32_t getOutOfOrderPackets() const { return outOfOrderPackets; }
+    uint32_t getDuplicatePackets() const { return duplicatePackets; }
+    uint32_t getLatePackets() const { return latePackets; }
+    uint32_t getArrivalTimestamp() const { return arrivalTimestamp; } // Last packet accepted
+    PathStats getPathStats(int path) const;
     
 private:
     // RTP session data
@@ -51,30 +87,58 @@ private:
     uint32_t sampleRate;
     uint16_t channelCount;
     uint16_t payloadType;
+    uint16_t bytesPerSample;
     
     // Packet buffer for reordering and jitter management
     static constexpr size_t MAX_BUFFER_PACKETS = 32;
+    static constexpr size_t MAX_PACKET_SIZE = 2048;
     struct PacketEntry {
         std::vector<uint8_t> data;
+        size_t payloadOffset;
+        size_t payloadSize;
         uint16_t sequenceNumber;
-        bool valid;
+        uint32_t timestamp;
+        bool valid;       // Waiting to be delivered
+        bool delivered;   // Already handed out, later copies are duplicates
     };
     std::array<PacketEntry, MAX_BUFFER_PACKETS> packetBuffer;
     
     // Expected next sequence number
     uint16_t expectedSequence;
+    bool sequenceSynced;
+    uint16_t newestSequence;
+    uint16_t reorderDepth;   // Packets to wait for a missing sequence
+    uint32_t arrivalTimestamp;
     
     // Statistics
     std::atomic<uint32_t> packetCount;
     std::atomic<uint32_t> droppedPackets;
     std::atomic<uint32_t> outOfOrderPackets;
+    std::atomic<uint32_t> duplicatePackets;
+    std::atomic<uint32_t> latePackets;
+    
+    // Per-path statistics
+    struct PathState {
+        std::atomic<uint64_t> packets;
+        std::atomic<uint64_t> firstArrivals;
+        std::atomic<uint64_t> duplicates;
+        std::atomic<uint64_t> lost;
+        uint16_t lastSequence;
+        bool seen;
+    };
+    std::array<PathState, MAX_PATHS> pathState;
     
     // Synchronization
     std::mutex bufferMutex;
     
     // Helper functions
     uint16_t getBufferIndex(uint16_t sequence) const;
-    void processBuffer();
+    bool parseHeader(const uint8_t* data, size_t size, uint16_t& seq, uint32_t& ts,
+                     size_t& payloadOffset, size_t& payloadSize) const;
+    size_t framesInPayload(size_t payloadSize) const;
+    bool takeNextFrame(AudioData& audio, bool scheduled, uint32_t deadline);
+    uint32_t waitingTimestamp() const;
+    void updatePathStats(int path, uint16_t seq);
 };
 
 } // namespace aes67
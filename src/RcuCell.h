@@ -0,0 +1,86 @@
+// RcuCell.h
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace aes67 {
+
+// Publishes immutable values from one writer thread to a fixed set of reader
+// threads, read-copy-update style.
+//
+// Each reader calls read() once per cycle (a JACK period, a packet) and may
+// use the value until its next read(); reading never locks, allocates or
+// waits. publish() swaps in a new value and frees the old one once every
+// online reader has read again, so no reader is ever left holding it.
+template<typename T, int Readers>
+class RcuCell {
+public:
+    RcuCell() : current(new T()), generation(1) {
+        for (auto& seen : readerGeneration) {
+            seen.store(OFFLINE);
+        }
+    }
+
+    ~RcuCell() {
+        delete current.load();
+        for (const T* value : retired) {
+            delete value;
+        }
+    }
+
+    RcuCell(const RcuCell&) = delete;
+    RcuCell& operator=(const RcuCell&) = delete;
+
+    // Reader side (RT-safe)
+    const T* read(int reader) {
+        // Announce the generation first; the pointer loaded after it is at least that new
+        readerGeneration[reader].store(generation.load());
+        return current.load();
+    }
+
+    // A reader that stops reading must go offline or publish() waits for it
+    void goOffline(int reader) {
+        readerGeneration[reader].store(OFFLINE);
+    }
+
+    // Writer side, one thread only
+    const T& get() const {
+        return *current.load();
+    }
+
+    void publish(T* value) {
+        const T* old = current.exchange(value);
+        uint64_t next = generation.fetch_add(1) + 1;
+
+        // Readers normally pass within a JACK period or a packet; one that
+        // has stalled leaves its value retired rather than freed under it
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(GRACE_MS);
+        for (auto& seen : readerGeneration) {
+            while (seen.load() < next) {
+                if (std::chrono::steady_clock::now() >= deadline) {
+                    retired.push_back(old);
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+
+        delete old;
+    }
+
+private:
+    static constexpr uint64_t OFFLINE = UINT64_MAX;
+    static constexpr int GRACE_MS = 500;
+
+    std::atomic<const T*> current;
+    std::atomic<uint64_t> generation;
+    std::array<std::atomic<uint64_t>, Readers> readerGeneration;
+    std::vector<const T*> retired;
+};
+
+} // namespace aes67
@@ -0,0 +1,300 @@
+// Reactor.cpp
+#include "Reactor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace aes67 {
+
+constexpr size_t Reactor::MAX_BATCH;
+constexpr int64_t Reactor::IDLE_TIMEOUT_US;
+
+Reactor::Reactor()
+    : io(IOEngine::create()), dispatching(false),
+      storage(MAX_BATCH * IOEngine::BUFFER_SIZE), callsPending(false),
+      threadId(std::thread::id()), running(false), wakeups(0), packets(0)
+{
+    for (auto& queue : queues) {
+        queue.reserve(MAX_BATCH);
+    }
+    calls.reserve(8);
+
+    // Other threads wake the reactor with a datagram to itself
+    wakeFds[0] = wakeFds[1] = -1;
+    if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, wakeFds) < 0) {
+        std::cerr << "Failed to create reactor wakeup socket: " << strerror(errno) << std::endl;
+    } else {
+        addSocket(wakeFds[0], PRIORITY_BACKGROUND, nullptr);
+    }
+}
+
+Reactor::~Reactor() {
+    stop();
+
+    if (wakeFds[0] >= 0) {
+        removeSocket(wakeFds[0]);
+        close(wakeFds[0]);
+        close(wakeFds[1]);
+    }
+}
+
+uint64_t Reactor::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Reactor::start(const ThreadSettings& settings) {
+    if (running) {
+        return true;
+    }
+
+    running = true;
+    thread = std::thread(&Reactor::loop, this, settings);
+    return true;
+}
+
+void Reactor::stop() {
+    {
+        // No call is queued after this, so none is left waiting
+        std::lock_guard<std::mutex> lock(callMutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+
+    wake();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    threadId = std::thread::id();
+
+    runCalls();
+}
+
+bool Reactor::onThread() const {
+    return threadId.load() == std::this_thread::get_id();
+}
+
+void Reactor::run(const std::function<void()>& function) {
+    if (onThread()) {
+        function();
+        return;
+    }
+
+    Call call = { &function, false };
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(callMutex);
+        if (running) {
+            calls.push_back(&call);
+            callsPending = true;
+            queued = true;
+        }
+    }
+
+    // Stopped: nothing else touches the tables
+    if (!queued) {
+        function();
+        return;
+    }
+
+    wake();
+
+    std::unique_lock<std::mutex> lock(callMutex);
+    callDone.wait(lock, [&call] { return call.done; });
+}
+
+void Reactor::runCalls() {
+    if (!callsPending.exchange(false)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(callMutex);
+    for (Call* call : calls) {
+        (*call->function)();
+        call->done = true;
+    }
+    calls.clear();
+    callDone.notify_all();
+}
+
+void Reactor::wake() {
+    char byte = 0;
+    if (wakeFds[1] >= 0) {
+        send(wakeFds[1], &byte, sizeof(byte), MSG_DONTWAIT);
+    }
+}
+
+bool Reactor::addSocket(int fd, Priority priority, PacketHandler handler) {
+    bool ok = false;
+
+    run([&] {
+        // Entries are only reused between passes, never under a running handler
+        size_t index = sockets.size();
+        if (!dispatching) {
+            for (size_t i = 0; i < sockets.size(); i++) {
+                if (!sockets[i]->active) {
+                    index = i;
+                    break;
+                }
+            }
+        }
+        if (index == sockets.size()) {
+            sockets.emplace_back(new Socket());
+        }
+
+        Socket& socket = *sockets[index];
+        socket.fd = fd;
+        socket.priority = priority;
+        socket.handler = std::move(handler);
+        socket.active = io->addSocket(fd, static_cast<int>(index));
+        ok = socket.active;
+    });
+
+    return ok;
+}
+
+void Reactor::removeSocket(int fd) {
+    run([&] {
+        for (auto& socket : sockets) {
+            if (socket->active && socket->fd == fd) {
+                io->removeSocket(fd);
+                socket->active = false;
+            }
+        }
+    });
+}
+
+int Reactor::addTimer(Priority priority, uint64_t deadlineNs, TimerHandler handler) {
+    int id = -1;
+
+    run([&] {
+        size_t index = timers.size();
+        if (!dispatching) {
+            for (size_t i = 0; i < timers.size(); i++) {
+                if (!timers[i]->active) {
+                    index = i;
+                    break;
+                }
+            }
+        }
+        if (index == timers.size()) {
+            timers.emplace_back(new Timer());
+        }
+
+        Timer& timer = *timers[index];
+        timer.priority = priority;
+        timer.deadline = deadlineNs;
+        timer.handler = std::move(handler);
+        timer.active = true;
+        id = static_cast<int>(index);
+    });
+
+    return id;
+}
+
+void Reactor::scheduleTimer(int id, uint64_t deadlineNs) {
+    run([&] {
+        if (id < 0 || static_cast<size_t>(id) >= timers.size()) {
+            return;
+        }
+        Timer& timer = *timers[id];
+        if (timer.active && (timer.deadline == 0 || deadlineNs < timer.deadline)) {
+            timer.deadline = deadlineNs;
+        }
+    });
+}
+
+void Reactor::removeTimer(int id) {
+    run([&] {
+        if (id >= 0 && static_cast<size_t>(id) < timers.size()) {
+            timers[id]->active = false;
+            timers[id]->deadline = 0;
+        }
+    });
+}
+
+void Reactor::loop(ThreadSettings settings) {
+    threadId = std::this_thread::get_id();
+    realtime::configureCurrentThread(settings, "aes67-net");
+
+    while (running) {
+        runCalls();
+
+        io->wait(nextTimeout(nowNs()));
+        wakeups++;
+
+        dispatch(nowNs());
+    }
+
+    runCalls();
+}
+
+int64_t Reactor::nextTimeout(uint64_t now) const {
+    uint64_t earliest = UINT64_MAX;
+    for (const auto& timer : timers) {
+        if (timer->active && timer->deadline != 0) {
+            earliest = std::min(earliest, timer->deadline);
+        }
+    }
+
+    if (earliest <= now) {
+        return 0;
+    }
+    if (earliest == UINT64_MAX) {
+        return IDLE_TIMEOUT_US;
+    }
+
+    // Round up so a timer is never woken for early
+    return std::min<int64_t>(IDLE_TIMEOUT_US, (earliest - now + 999) / 1000);
+}
+
+void Reactor::dispatch(uint64_t arrivalNs) {
+    // Reap everything ready first, so priority decides the order below
+    size_t count = 0;
+    IOEngine::Packet packet;
+    while (count < MAX_BATCH && io->next(packet)) {
+        size_t index = static_cast<size_t>(packet.tag);
+        if (index < sockets.size() && sockets[index]->active && sockets[index]->handler) {
+            size_t size = std::min(packet.size, IOEngine::BUFFER_SIZE);
+            memcpy(storage.data() + count * IOEngine::BUFFER_SIZE, packet.data, size);
+            queues[sockets[index]->priority].push_back(Pending{ index, count, size });
+            count++;
+        }
+        io->release(packet);
+    }
+    packets += count;
+
+    dispatching = true;
+    const uint64_t now = nowNs();
+
+    for (int level = 0; level < PRIORITY_LEVELS; level++) {
+        for (const Pending& pending : queues[level]) {
+            Socket& socket = *sockets[pending.socket];
+            if (socket.active) {
+                socket.handler(storage.data() + pending.slot * IOEngine::BUFFER_SIZE, pending.size, arrivalNs);
+            }
+        }
+        queues[level].clear();
+
+        // Handlers may add timers; entries never move, so indexing stays valid
+        for (size_t i = 0; i < timers.size(); i++) {
+            Timer& timer = *timers[i];
+            if (timer.active && timer.priority == level && timer.deadline != 0 && timer.deadline <= now) {
+                uint64_t next = timer.handler(now);
+                if (timer.active) {
+                    timer.deadline = next;
+                }
+            }
+        }
+    }
+
+    dispatching = false;
+}
+
+} // namespace aes67
@@ -0,0 +1,140 @@
+// Reactor.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <array>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "IOEngine.h"
+#include "Realtime.h"
+
+namespace aes67 {
+
+// One thread for every socket and timer of the bridge: PTP, the RTP stream
+// and session discovery.
+//
+// Each wakeup reaps every packet the engine has ready, stamps them all with
+// the time of the wakeup, and then dispatches by priority, so a PTP event
+// message is timestamped and handled before any audio queued with it.
+// Timers run at their own priority in the same pass. Registration from
+// another thread is carried out on the reactor thread, so handlers never
+// race with it.
+class Reactor {
+public:
+    enum Priority {
+        PRIORITY_TIMING = 0,    // PTP event messages
+        PRIORITY_AUDIO,         // RTP receive and transmit
+        PRIORITY_CONTROL,       // PTP general messages
+        PRIORITY_BACKGROUND,    // Session discovery
+        PRIORITY_LEVELS
+    };
+
+    // A received datagram and the steady_clock time it was reaped, in nanoseconds
+    using PacketHandler = std::function<void(const uint8_t* data, size_t size, uint64_t arrivalNs)>;
+
+    // Runs at its deadline and returns the next one, or 0 to go idle.
+    // Deadlines are steady_clock nanoseconds.
+    using TimerHandler = std::function<uint64_t(uint64_t nowNs)>;
+
+    Reactor();
+    ~Reactor();
+
+    // Control
+    bool start(const ThreadSettings& settings);
+    void stop();
+    bool isRunning() const { return running; }
+
+    // Registration, from any thread
+    bool addSocket(int fd, Priority priority, PacketHandler handler);
+    void removeSocket(int fd);
+    int addTimer(Priority priority, uint64_t deadlineNs, TimerHandler handler);
+    void scheduleTimer(int id, uint64_t deadlineNs);   // Bring forward if due later
+    void removeTimer(int id);
+
+    // Run a function on the reactor thread and wait for it to finish. Runs
+    // at once when called from the reactor thread or while stopped.
+    void run(const std::function<void()>& function);
+
+    static uint64_t nowNs();
+
+    // Statistics
+    uint64_t getWakeups() const { return wakeups; }
+    uint64_t getPackets() const { return packets; }
+
+private:
+    // Packets taken per wakeup before dispatching
+    static constexpr size_t MAX_BATCH = 64;
+
+    // Longest sleep with nothing scheduled
+    static constexpr int64_t IDLE_TIMEOUT_US = 1000000;
+
+    struct Socket {
+        int fd;
+        Priority priority;
+        PacketHandler handler;
+        bool active;
+    };
+
+    struct Timer {
+        Priority priority;
+        uint64_t deadline;      // 0 when idle
+        TimerHandler handler;
+        bool active;
+    };
+
+    // A reaped packet waiting for dispatch
+    struct Pending {
+        size_t socket;
+        size_t slot;        // Position in the batch storage
+        size_t size;
+    };
+
+    // A function queued by run() from another thread
+    struct Call {
+        const std::function<void()>* function;
+        bool done;
+    };
+
+    std::unique_ptr<IOEngine> io;
+    int wakeFds[2];     // Datagram pair that interrupts the wait
+
+    // Entries stay put while handlers run; sockets are tagged by index
+    std::vector<std::unique_ptr<Socket>> sockets;
+    std::vector<std::unique_ptr<Timer>> timers;
+    bool dispatching;
+
+    // Batch storage and per-priority dispatch order
+    std::vector<uint8_t> storage;
+    std::array<std::vector<Pending>, PRIORITY_LEVELS> queues;
+
+    // Calls from other threads
+    std::mutex callMutex;
+    std::condition_variable callDone;
+    std::vector<Call*> calls;
+    std::atomic<bool> callsPending;
+
+    std::thread thread;
+    std::atomic<std::thread::id> threadId;
+    std::atomic<bool> running;
+
+    // Statistics
+    std::atomic<uint64_t> wakeups;
+    std::atomic<uint64_t> packets;
+
+    // Helper functions
+    void loop(ThreadSettings settings);
+    bool onThread() const;
+    int64_t nextTimeout(uint64_t now) const;
+    void dispatch(uint64_t arrivalNs);
+    void runCalls();
+    void wake();
+};
+
+} // namespace aes67
@@ -0,0 +1,97 @@
+// Realtime.cpp
+#include "Realtime.h"
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace aes67 {
+namespace realtime {
+
+// Stack touched for every configured worker thread
+static constexpr size_t THREAD_STACK_PREFAULT = 64 * 1024;
+
+bool configureCurrentThread(const ThreadSettings& settings, const char* name) {
+    bool ok = true;
+    pthread_t self = pthread_self();
+
+    if (name) {
+        // Linux limits thread names to 15 characters
+        char shortName[16];
+        strncpy(shortName, name, sizeof(shortName) - 1);
+        shortName[sizeof(shortName) - 1] = '\0';
+        pthread_setname_np(self, shortName);
+    }
+
+    if (settings.cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(settings.cpu, &cpus);
+
+        int err = pthread_setaffinity_np(self, sizeof(cpus), &cpus);
+        if (err != 0) {
+            std::cerr << "Failed to pin " << (name ? name : "thread") << " to CPU "
+                      << settings.cpu << ": " << strerror(err) << std::endl;
+            ok = false;
+        }
+    }
+
+    if (settings.priority > 0) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = settings.priority;
+
+        int err = pthread_setschedparam(self, SCHED_FIFO, &param);
+        if (err != 0) {
+            std::cerr << "Failed to set SCHED_FIFO priority " << settings.priority << " for "
+                      << (name ? name : "thread") << ": " << strerror(err) << std::endl;
+            ok = false;
+        }
+    }
+
+    prefaultStack(THREAD_STACK_PREFAULT);
+    return ok;
+}
+
+bool configureBackgroundThread(const char* name, int niceLevel) {
+    char shortName[16];
+    strncpy(shortName, name, sizeof(shortName) - 1);
+    shortName[sizeof(shortName) - 1] = '\0';
+    pthread_setname_np(pthread_self(), shortName);
+
+    // On Linux the nice value is per thread when given the thread id
+    pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    if (setpriority(PRIO_PROCESS, tid, niceLevel) != 0) {
+        std::cerr << "Failed to lower priority of " << name << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool lockMemory(size_t stackBytes) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        std::cerr << "Failed to lock memory: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    prefaultStack(stackBytes);
+    return true;
+}
+
+void prefaultStack(size_t bytes) {
+    // Volatile so the compiler keeps the writes
+    volatile unsigned char* stack = static_cast<volatile unsigned char*>(alloca(bytes));
+    for (size_t i = 0; i < bytes; i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+} // namespace realtime
+} // namespace aes67
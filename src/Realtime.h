@@ -0,0 +1,32 @@
+// Realtime.h
+#pragma once
+
+#include <cstddef>
+
+namespace aes67 {
+
+// Scheduling for a worker thread. A priority of 0 leaves the thread on the
+// normal scheduler; a cpu of -1 leaves it free to run on any core.
+struct ThreadSettings {
+    int priority = 0;  // SCHED_FIFO priority, 1..99
+    int cpu = -1;      // Core to pin to
+};
+
+namespace realtime {
+
+// Apply settings to the calling thread, name it and prefault its stack
+bool configureCurrentThread(const ThreadSettings& settings, const char* name);
+
+// Name the calling thread and drop it below normal priority, for control
+// work that must never compete with audio
+bool configureBackgroundThread(const char* name, int niceLevel = 10);
+
+// Lock current and future pages and prefault the calling thread's stack
+bool lockMemory(size_t stackBytes = 256 * 1024);
+
+// Touch stack pages so later use does not page fault
+void prefaultStack(size_t bytes);
+
+} // namespace realtime
+
+} // namespace aes67
@@ -0,0 +1,405 @@
+// SAPListener.cpp
+#include "SAPListener.h"
+#include "Logger.h"
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <net/if.h>
+#include <unistd.h>
+
+namespace aes67 {
+
+// SAP header (RFC 2974 section 3), followed by the source address
+struct SAPHeader {
+    uint8_t  flags;        // Version(3) Addr(1) Reserved(1) Type(1) Encrypted(1) Compressed(1)
+    uint8_t  authLength;   // Authentication data length in 32-bit words
+    uint16_t msgIdHash;    // Message identifier hash
+} __attribute__((__packed__));
+
+static constexpr uint8_t SAP_VERSION_MASK = 0xE0;
+static constexpr uint8_t SAP_VERSION_1 = 0x20;
+static constexpr uint8_t SAP_FLAG_IPV6 = 0x10;
+static constexpr uint8_t SAP_FLAG_DELETE = 0x04;
+static constexpr uint8_t SAP_FLAG_ENCRYPTED = 0x02;
+static constexpr uint8_t SAP_FLAG_COMPRESSED = 0x01;
+
+constexpr const char* SAPListener::SAP_ADDRESS;
+constexpr uint16_t SAPListener::SAP_PORT;
+constexpr uint64_t SAPListener::MIN_TIMEOUT;
+constexpr size_t SAPListener::WHEEL_SLOTS;
+
+// How often the expiry wheel is advanced
+static constexpr uint64_t WHEEL_INTERVAL_NS = 250000000;
+
+SAPListener::SAPListener(Reactor& reactor)
+    : reactor(reactor), socketFd(-1), wheelTimer(-1), active(false), wheelTime(0), startTime(0),
+      announcements(0), deletions(0), expired(0)
+{
+}
+
+SAPListener::~SAPListener() {
+    stop();
+}
+
+bool SAPListener::start(const std::string& interfaceName) {
+    if (active) {
+        return true;
+    }
+
+    socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socketFd < 0) {
+        std::cerr << "Failed to create SAP socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Other SAP tools on this host listen on the same port
+    int optval = 1;
+    if (setsockopt(socketFd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) < 0) {
+        std::cerr << "Failed to set SO_REUSEADDR on SAP socket: " << strerror(errno) << std::endl;
+        close(socketFd);
+        socketFd = -1;
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SAP_PORT);
+    addr.sin_addr.s_addr = inet_addr(SAP_ADDRESS);
+
+    if (bind(socketFd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "Failed to bind SAP socket: " << strerror(errno) << std::endl;
+        close(socketFd);
+        socketFd = -1;
+        return false;
+    }
+
+    // Join the administratively scoped SAP group on the chosen interface
+    struct ip_mreqn mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.imr_multiaddr.s_addr = inet_addr(SAP_ADDRESS);
+    mreq.imr_ifindex = interfaceName.empty() ? 0 : if_nametoindex(interfaceName.c_str());
+
+    if (setsockopt(socketFd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        std::cerr << "Failed to join SAP multicast group: " << strerror(errno) << std::endl;
+        close(socketFd);
+        socketFd = -1;
+        return false;
+    }
+
+    startTime = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    wheelTime = 0;
+
+    active = true;
+
+    // Announcements are the least urgent traffic on the reactor
+    reactor.addSocket(socketFd, Reactor::PRIORITY_BACKGROUND,
+                      [this](const uint8_t* data, size_t size, uint64_t) {
+                          handlePacket(data, size, nowSeconds());
+                      });
+    wheelTimer = reactor.addTimer(Reactor::PRIORITY_BACKGROUND, Reactor::nowNs() + WHEEL_INTERVAL_NS,
+                                  [this](uint64_t nowNs) { return tick(nowNs); });
+
+    std::cout << "SAP listener: " << SAP_ADDRESS << ":" << SAP_PORT
+              << (interfaceName.empty() ? "" : " (" + interfaceName + ")") << std::endl;
+    return true;
+}
+
+void SAPListener::stop() {
+    if (!active) {
+        return;
+    }
+
+    active = false;
+
+    reactor.removeTimer(wheelTimer);
+    wheelTimer = -1;
+
+    if (socketFd >= 0) {
+        reactor.removeSocket(socketFd);
+        close(socketFd);
+        socketFd = -1;
+    }
+
+    std::lock_guard<std::mutex> lock(directoryMutex);
+    sessions.clear();
+    byName.clear();
+    byGroup.clear();
+    for (auto& slot : wheel) {
+        slot.clear();
+    }
+}
+
+bool SAPListener::findByName(const std::string& name, Session& session) const {
+    std::lock_guard<std::mutex> lock(directoryMutex);
+
+    auto it = byName.find(name);
+    if (it == byName.end()) {
+        return false;
+    }
+
+    session = sessions.at(it->second);
+    return true;
+}
+
+bool SAPListener::findByGroup(const std::string& group, Session& session) const {
+    std::lock_guard<std::mutex> lock(directoryMutex);
+
+    auto it = byGroup.find(group);
+    if (it == byGroup.end()) {
+        return false;
+    }
+
+    session = sessions.at(it->second);
+    return true;
+}
+
+std::vector<SAPListener::Session> SAPListener::getSessions() const {
+    std::lock_guard<std::mutex> lock(directoryMutex);
+
+    std::vector<Session> result;
+    result.reserve(sessions.size());
+    for (const auto& entry : sessions) {
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+size_t SAPListener::getSessionCount() const {
+    std::lock_guard<std::mutex> lock(directoryMutex);
+    return sessions.size();
+}
+
+uint64_t SAPListener::tick(uint64_t nowNs) {
+    std::lock_guard<std::mutex> lock(directoryMutex);
+    advanceWheel(nowSeconds());
+    return nowNs + WHEEL_INTERVAL_NS;
+}
+
+void SAPListener::handlePacket(const uint8_t* data, size_t size, uint64_t now) {
+    if (size < sizeof(SAPHeader)) {
+        return;
+    }
+
+    const SAPHeader* header = reinterpret_cast<const SAPHeader*>(data);
+
+    // Only SAPv1, and nothing we would have to decrypt or inflate
+    if ((header->flags & SAP_VERSION_MASK) != SAP_VERSION_1 ||
+        (header->flags & (SAP_FLAG_ENCRYPTED | SAP_FLAG_COMPRESSED))) {
+        return;
+    }
+
+    size_t sourceLength = (header->flags & SAP_FLAG_IPV6) ? 16 : 4;
+    size_t offset = sizeof(SAPHeader) + sourceLength + header->authLength * 4;
+    if (offset >= size) {
+        return;
+    }
+
+    const uint8_t* source = data + sizeof(SAPHeader);
+    Session update;
+    update.msgIdHash = ntohs(header->msgIdHash);
+
+    char originText[INET6_ADDRSTRLEN];
+    inet_ntop(sourceLength == 16 ? AF_INET6 : AF_INET, source, originText, sizeof(originText));
+    update.origin = originText;
+
+    // Key on source and hash; fold IPv6 sources down to 48 bits with FNV-1a
+    uint64_t originKey = 0;
+    if (sourceLength == 4) {
+        uint32_t addr;
+        memcpy(&addr, source, sizeof(addr));
+        originKey = ntohl(addr);
+    } else {
+        originKey = 1469598103934665603ULL;
+        for (size_t i = 0; i < sourceLength; i++) {
+            originKey = (originKey ^ source[i]) * 1099511628211ULL;
+        }
+        originKey &= 0xFFFFFFFFFFFFULL;
+    }
+    uint64_t key = (originKey << 16) | update.msgIdHash;
+
+    // An optional payload type precedes the SDP; without one it is SDP
+    const char* payload = reinterpret_cast<const char*>(data + offset);
+    size_t payloadSize = size - offset;
+    if (payloadSize < 2 || strncmp(payload, "v=", 2) != 0) {
+        const char* end = static_cast<const char*>(memchr(payload, '\0', payloadSize));
+        if (!end || strcmp(payload, "application/sdp") != 0) {
+            return;
+        }
+        payloadSize -= (end + 1) - payload;
+        payload = end + 1;
+    }
+
+    std::lock_guard<std::mutex> lock(directoryMutex);
+
+    if (header->flags & SAP_FLAG_DELETE) {
+        if (sessions.count(key)) {
+            AES67_LOG_INFO("SAP: session '%s' deleted", sessions[key].name.c_str());
+            remove(key);
+            deletions++;
+        }
+        return;
+    }
+
+    update.sdp.assign(payload, payloadSize);
+    if (!parseSDP(update.sdp, update)) {
+        return;
+    }
+
+    announcements++;
+    announce(key, update, now);
+}
+
+void SAPListener::announce(uint64_t key, Session& update, uint64_t now) {
+    auto it = sessions.find(key);
+
+    if (it == sessions.end()) {
+        update.lastSeen = now;
+        update.interval = 0;
+        update.expiry = now + MIN_TIMEOUT;
+
+        Session& session = sessions.emplace(key, std::move(update)).first->second;
+        byName[session.name] = key;
+        byGroup[session.group] = key;
+        wheel[session.expiry % WHEEL_SLOTS].push_back(key);
+
+        AES67_LOG_INFO("SAP: discovered session '%s' at %s:%u from %s", session.name.c_str(),
+                       session.group.c_str(), static_cast<unsigned>(session.port), session.origin.c_str());
+        return;
+    }
+
+    Session& session = it->second;
+
+    // Time out after ten announcement intervals or an hour, whichever is longer
+    if (now > session.lastSeen) {
+        session.interval = now - session.lastSeen;
+    }
+    session.lastSeen = now;
+    session.expiry = now + std::max(MIN_TIMEOUT, session.interval * 10);
+
+    if (session.sdp == update.sdp) {
+        return;
+    }
+
+    // Description changed, keep the indices pointing at this session
+    if (session.name != update.name) {
+        auto old = byName.find(session.name);
+        if (old != byName.end() && old->second == key) {
+            byName.erase(old);
+        }
+        byName[update.name] = key;
+    }
+    if (session.group != update.group) {
+        auto old = byGroup.find(session.group);
+        if (old != byGroup.end() && old->second == key) {
+            byGroup.erase(old);
+        }
+        byGroup[update.group] = key;
+    }
+
+    session.name = std::move(update.name);
+    session.group = std::move(update.group);
+    session.port = update.port;
+    session.sdp = std::move(update.sdp);
+}
+
+void SAPListener::remove(uint64_t key) {
+    auto it = sessions.find(key);
+    if (it == sessions.end()) {
+        return;
+    }
+
+    // Only drop index entries that still refer to this session
+    auto name = byName.find(it->second.name);
+    if (name != byName.end() && name->second == key) {
+        byName.erase(name);
+    }
+    auto group = byGroup.find(it->second.group);
+    if (group != byGroup.end() && group->second == key) {
+        byGroup.erase(group);
+    }
+
+    // The wheel entry is dropped lazily when its slot next fires
+    sessions.erase(it);
+}
+
+void SAPListener::advanceWheel(uint64_t now) {
+    // After a long stall every slot is visited once
+    uint64_t steps = std::min<uint64_t>(now - wheelTime, WHEEL_SLOTS);
+    std::vector<uint64_t> due;
+
+    for (uint64_t i = 1; i <= steps; i++) {
+        due.clear();
+        due.swap(wheel[(wheelTime + i) % WHEEL_SLOTS]);
+
+        for (uint64_t key : due) {
+            auto it = sessions.find(key);
+            if (it == sessions.end()) {
+                continue; // Deleted by announcement
+            }
+
+            if (it->second.expiry <= now) {
+                AES67_LOG_INFO("SAP: session '%s' timed out", it->second.name.c_str());
+                remove(key);
+                expired++;
+            } else {
+                // Refreshed since it was filed, re-file at its new expiry
+                wheel[it->second.expiry % WHEEL_SLOTS].push_back(key);
+            }
+        }
+    }
+
+    wheelTime = now;
+}
+
+uint64_t SAPListener::nowSeconds() const {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count() - startTime;
+}
+
+bool SAPListener::parseSDP(const std::string& sdp, Session& session) {
+    std::istringstream stream(sdp);
+    std::string line;
+
+    session.port = 0;
+
+    while (std::getline(stream, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.size() < 2 || line[1] != '=') {
+            continue;
+        }
+
+        std::string value = line.substr(2);
+
+        switch (line[0]) {
+            case 's':
+                session.name = value;
+                break;
+            case 'c':
+                // c=IN IP4 <group>/<ttl>, the first one applies
+                if (session.group.empty() && value.compare(0, 7, "IN IP4 ") == 0) {
+                    session.group = value.substr(7, value.find('/', 7) - 7);
+                }
+                break;
+            case 'm':
+                // m=audio <port> RTP/AVP <fmt>
+                if (session.port == 0 && value.compare(0, 6, "audio ") == 0) {
+                    session.port = static_cast<uint16_t>(std::atoi(value.c_str() + 6));
+                }
+                break;
+        }
+    }
+
+    return !session.group.empty() && session.port != 0;
+}
+
+} // namespace aes67
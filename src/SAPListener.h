@@ -0,0 +1,96 @@
+// SAPListener.h
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <unordered_map>
+
+#include "Reactor.h"
+
+namespace aes67 {
+
+// Listens for SAP (RFC 2974) announcements and keeps a directory of the
+// sessions currently on the network.
+//
+// Sessions are keyed by originating source and message id hash. Name and
+// multicast group indices make lookups O(1), and expiry runs on a timer
+// wheel so hundreds of sessions never need rescanning.
+class SAPListener {
+public:
+    // One announced session
+    struct Session {
+        std::string origin;     // Originating source address
+        uint16_t msgIdHash;
+        std::string name;       // SDP s= line
+        std::string group;      // Multicast group from the c= line
+        uint16_t port;          // Port from the m=audio line
+        std::string sdp;        // Full session description
+        uint64_t lastSeen;      // Seconds on the listener clock
+        uint64_t interval;      // Measured announcement interval, seconds
+        uint64_t expiry;        // Second at which the session times out
+    };
+
+    explicit SAPListener(Reactor& reactor);
+    ~SAPListener();
+
+    // Control
+    bool start(const std::string& interfaceName = "");
+    void stop();
+
+    // Directory lookups, copy the session out under the lock
+    bool findByName(const std::string& name, Session& session) const;
+    bool findByGroup(const std::string& group, Session& session) const;
+    std::vector<Session> getSessions() const;
+    size_t getSessionCount() const;
+
+    // Status
+    bool isActive() const { return active; }
+    uint64_t getAnnouncements() const { return announcements; }
+    uint64_t getDeletions() const { return deletions; }
+    uint64_t getExpired() const { return expired; }
+
+private:
+    // SAP addresses and timeouts
+    static constexpr const char* SAP_ADDRESS = "239.255.255.255";
+    static constexpr uint16_t SAP_PORT = 9875;
+    static constexpr uint64_t MIN_TIMEOUT = 3600;   // RFC 2974: at least one hour
+    static constexpr size_t WHEEL_SLOTS = 512;      // One-second slots
+
+    // Receives the announcements and runs the expiry wheel
+    Reactor& reactor;
+    int socketFd;
+    int wheelTimer;
+    std::atomic<bool> active;
+
+    // Session directory and indices, protected by directoryMutex
+    mutable std::mutex directoryMutex;
+    std::unordered_map<uint64_t, Session> sessions;
+    std::unordered_map<std::string, uint64_t> byName;
+    std::unordered_map<std::string, uint64_t> byGroup;
+
+    // Expiry wheel: each session key sits in exactly one slot. Refreshing a
+    // session only moves its expiry; the old slot re-files it when it fires.
+    std::array<std::vector<uint64_t>, WHEEL_SLOTS> wheel;
+    uint64_t wheelTime;     // Last second the wheel was advanced to
+    uint64_t startTime;
+
+    // Statistics
+    std::atomic<uint64_t> announcements;
+    std::atomic<uint64_t> deletions;
+    std::atomic<uint64_t> expired;
+
+    // Helper functions
+    uint64_t tick(uint64_t nowNs);
+    void handlePacket(const uint8_t* data, size_t size, uint64_t now);
+    void announce(uint64_t key, Session& update, uint64_t now);
+    void remove(uint64_t key);
+    void advanceWheel(uint64_t now);
+    uint64_t nowSeconds() const;
+    static bool parseSDP(const std::string& sdp, Session& session);
+};
+
+} // namespace aes67
@@ -0,0 +1,61 @@
+// SPSCQueue.h
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace aes67 {
+
+// Bounded single-producer, single-consumer queue.
+//
+// push() and pop() are wait-free: each is a couple of atomic loads and one
+// store, never locks, allocates or spins. A full queue rejects the push and
+// leaves the decision to the producer.
+template<typename T, size_t Capacity>
+class SPSCQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    SPSCQueue() : head(0), padding(), tail(0) {}
+
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    // Producer side
+    bool push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = slots[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, Capacity> slots;
+
+    // Padded apart so producer and consumer do not share a cache line
+    // (alignas would need C++17 aligned new for heap-allocated owners)
+    std::atomic<size_t> head;
+    char padding[64];
+    std::atomic<size_t> tail;
+};
+
+} // namespace aes67
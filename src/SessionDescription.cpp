@@ -0,0 +1,169 @@
+// SessionDescription.cpp
+#include "SessionDescription.h"
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+namespace aes67 {
+
+namespace {
+
+// Split "a/b/c" style values
+std::string nextField(const std::string& value, size_t& pos, char separator) {
+    size_t end = value.find(separator, pos);
+    std::string field = value.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+    pos = end == std::string::npos ? value.size() : end + 1;
+    return field;
+}
+
+// AES67 packet times, as announced with rounded ms values (e.g. 0.33 or 1.09 at 44.1 kHz)
+uint32_t packetTimeFromMs(double ms) {
+    static const uint32_t times[] = { 125, 250, 333, 1000, 4000 };
+    uint32_t best = 1000;
+    double bestError = 1e9;
+
+    for (uint32_t t : times) {
+        double error = std::fabs(ms * 1000.0 - t) / t;
+        if (error < bestError) {
+            bestError = error;
+            best = t;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+bool SessionDescription::parse(const std::string& sdp, SessionDescription& description) {
+    std::istringstream stream(sdp);
+    std::string line;
+    bool inAudio = false;
+    bool haveAudio = false;
+    bool haveRtpmap = false;
+
+    while (std::getline(stream, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.size() < 2 || line[1] != '=') {
+            continue;
+        }
+
+        const char type = line[0];
+        const std::string value = line.substr(2);
+
+        // Only the first audio media section is used
+        if (type == 'm') {
+            if (haveAudio) {
+                break;
+            }
+            std::istringstream media(value);
+            std::string kind, transport;
+            uint32_t port = 0;
+            media >> kind >> port >> transport >> description.payloadType;
+            inAudio = kind == "audio";
+            haveAudio = inAudio;
+            description.port = static_cast<uint16_t>(port);
+            continue;
+        }
+
+        switch (type) {
+            case 's':
+                description.name = value;
+                break;
+            case 'o': {
+                // o=<user> <id> <version> IN IP4 <address>
+                size_t at = value.rfind(' ');
+                if (at != std::string::npos) {
+                    description.origin = value.substr(at + 1);
+                }
+                break;
+            }
+            case 'c':
+                // c=IN IP4 <group>/<ttl>, a media-level line overrides the session one
+                if (value.compare(0, 7, "IN IP4 ") == 0 && (description.group.empty() || inAudio)) {
+                    size_t pos = 7;
+                    description.group = nextField(value, pos, '/');
+                    std::string ttl = nextField(value, pos, '/');
+                    description.ttl = static_cast<uint16_t>(std::atoi(ttl.c_str()));
+                }
+                break;
+            case 'a': {
+                size_t colon = value.find(':');
+                std::string attribute = value.substr(0, colon);
+                std::string arg = colon == std::string::npos ? "" : value.substr(colon + 1);
+
+                if (attribute == "rtpmap" && inAudio) {
+                    // rtpmap:<pt> <encoding>/<rate>[/<channels>]
+                    size_t space = arg.find(' ');
+                    if (space == std::string::npos ||
+                        std::atoi(arg.c_str()) != description.payloadType) {
+                        break;
+                    }
+                    size_t pos = space + 1;
+                    description.encoding = nextField(arg, pos, '/');
+                    description.sampleRate = std::strtoul(nextField(arg, pos, '/').c_str(), nullptr, 10);
+                    std::string channels = nextField(arg, pos, '/');
+                    description.channels = channels.empty() ? 1 : static_cast<uint16_t>(std::atoi(channels.c_str()));
+                    haveRtpmap = true;
+                } else if (attribute == "ptime") {
+                    description.packetTime = packetTimeFromMs(std::atof(arg.c_str()));
+                } else if (attribute == "ts-refclk") {
+                    description.refClock = arg;
+                    // ptp=IEEE1588-2008:<grandmaster>[:<domain>]
+                    if (arg.compare(0, 4, "ptp=") == 0) {
+                        size_t pos = 4;
+                        nextField(arg, pos, ':');
+                        description.ptpGrandmaster = nextField(arg, pos, ':');
+                        description.ptpDomain = std::atoi(nextField(arg, pos, ':').c_str());
+                    }
+                } else if (attribute == "mediaclk") {
+                    // mediaclk:direct=<offset>
+                    if (arg.compare(0, 7, "direct=") == 0) {
+                        description.mediaClockDirect = true;
+                        description.mediaClockOffset = std::strtoul(arg.c_str() + 7, nullptr, 10);
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    if (!haveAudio || !haveRtpmap || description.group.empty() || description.port == 0) {
+        return false;
+    }
+
+    if (description.encoding == "L16") {
+        description.bitDepth = 16;
+    } else if (description.encoding == "L24") {
+        description.bitDepth = 24;
+    } else if (description.encoding == "L32") {
+        description.bitDepth = 32;
+    } else {
+        std::cerr << "Unsupported SDP encoding: " << description.encoding << std::endl;
+        return false;
+    }
+
+    return description.sampleRate != 0 && description.channels != 0;
+}
+
+bool SessionDescription::loadFile(const std::string& path, SessionDescription& description) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open SDP file: " << path << std::endl;
+        return false;
+    }
+
+    std::stringstream contents;
+    contents << file.rdbuf();
+
+    if (!parse(contents.str(), description)) {
+        std::cerr << "No usable audio stream in SDP file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace aes67
@@ -0,0 +1,41 @@
+// SessionDescription.h
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace aes67 {
+
+// The parts of an AES67 / ST 2110-30 SDP (RFC 4566) that configure a receiver
+struct SessionDescription {
+    std::string name;           // s=
+    std::string origin;         // o= unicast address
+    std::string group;          // c= multicast group
+    uint16_t ttl = 0;
+    uint16_t port = 0;          // m=audio port
+    uint16_t payloadType = 96;
+
+    // a=rtpmap:<pt> <encoding>/<rate>/<channels>
+    std::string encoding;       // L16, L24 or L32
+    uint32_t sampleRate = 0;
+    uint16_t channels = 1;      // RFC 3551: one channel when omitted
+    uint16_t bitDepth = 0;      // Derived from the encoding
+
+    // a=ptime, in microseconds
+    uint32_t packetTime = 1000;
+
+    // a=ts-refclk:ptp=IEEE1588-2008:<grandmaster>[:<domain>]
+    std::string refClock;
+    std::string ptpGrandmaster;
+    int ptpDomain = 0;
+
+    // a=mediaclk:direct=<offset>
+    bool mediaClockDirect = false;
+    uint32_t mediaClockOffset = 0;
+
+    // Parse SDP text; false if it does not describe a usable audio stream
+    static bool parse(const std::string& sdp, SessionDescription& description);
+    static bool loadFile(const std::string& path, SessionDescription& description);
+};
+
+} // namespace aes67
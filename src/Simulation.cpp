@@ -0,0 +1,442 @@
+// Simulation.cpp
+#include "Simulation.h"
+#include "PTPMessage.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <arpa/inet.h>
+
+namespace aes67 {
+
+namespace {
+
+// Where the local steady clock and the first grandmaster start, about
+// 2024 on the PTP timescale
+constexpr uint64_t LOCAL_BASE_NS = 1000000000ULL * 1000ULL;
+constexpr uint64_t MASTER_BASE_NS = 1700000000ULL * 1000000000ULL;
+
+// The ring the bridge allocates: 20 of the longest packets
+constexpr int MAX_PACKET_TIME = 4000;
+
+// The sender's tone: 997 Hz at -6 dBFS, a whole number of cycles a second
+constexpr double TONE_HZ = 997.0;
+constexpr double TONE_LEVEL = 0.5;
+
+// Clock identity "SIMGM" plus the master's number
+const uint8_t MASTER_IDENTITY[8] = { 'S', 'I', 'M', 'G', 'M', 0, 0, 0 };
+
+} // namespace
+
+Simulation::Simulation(const Config& cfg)
+    : config(cfg), now(0), nextOrder(0), nextMasterChange(0),
+      packetSamples(0), lastSentSample(0), rtpSequence(0),
+      ptp(reactor), receiver(rtp, converter, jitter, ring, playout, concealer, ptp, receivePerf),
+      linkOffset(static_cast<int>(std::lround(cfg.linkOffset * 1000.0))), cycleCount(0),
+      played(false), worstPtpError(0.0)
+{
+    const uint32_t rate = config.sampleRate;
+
+    // The PTP messages cross the network both ways, audio only one; the
+    // grandmasters hear each other on a clean link
+    for (size_t i = 0; i < LINK_COUNT; i++) {
+        NetworkImpairment::Config network = i == LINK_AUDIO ? config.audioNetwork :
+                                            i == LINK_MASTERS ? NetworkImpairment::Config() : config.ptpNetwork;
+        network.enabled = true;
+        network.seed += i;
+        links[i].network.configure(network);
+        links[i].pollAt = UINT64_MAX;
+    }
+    links[LINK_TO_SLAVE].deliver = [this](const uint8_t* data, size_t size) { slaveReceive(data, size); };
+    links[LINK_TO_MASTER].deliver = [this](const uint8_t* data, size_t size) { masterReceive(data, size); };
+    links[LINK_MASTERS].deliver = [this](const uint8_t* data, size_t size) { masterReceive(data, size); };
+    links[LINK_AUDIO].deliver = [this](const uint8_t* data, size_t size) { receiveRtp(data, size); };
+
+    // PTPSync on the local clock, its delay requests onto the network
+    PTPSync::Transport transport;
+    transport.send = [this](const uint8_t* data, size_t size) {
+        submit(LINK_TO_MASTER, data, size);
+        return true;
+    };
+    transport.nowNs = [this]() { return localNanos(now); };
+    ptp.setSampleRate(rate);
+    ptp.setTransport(transport);
+    timeBase.setSampleRate(rate);
+
+    // Sender: stereo L24 at the configured packet time
+    packetSamples = static_cast<uint32_t>((config.packetTime * rate + 500000) / 1000000);
+
+    // One second of the tone, whole cycles of it at any rate, encoded once
+    // without dither so every run sends the same bytes
+    tone.assign(rate * 2 * 3, 0);
+    for (uint32_t i = 0; !config.silence && i < rate; i++) {
+        int32_t value = static_cast<int32_t>(std::lrint(TONE_LEVEL * 8388607.0 *
+                                                        std::sin(2.0 * M_PI * TONE_HZ * i / rate)));
+        for (int channel = 0; channel < 2; channel++) {
+            uint8_t* bytes = &tone[(i * 2 + channel) * 3];
+            bytes[0] = static_cast<uint8_t>(value >> 16);
+            bytes[1] = static_cast<uint8_t>(value >> 8);
+            bytes[2] = static_cast<uint8_t>(value);
+        }
+    }
+
+    // Receiver, configured as AES67Bridge::configureComponents() does
+    rtp.initialize(rate, 2, 96);
+    rtp.setBytesPerSample(3);
+    rtp.setReorderDepth(static_cast<uint16_t>(std::max(2, std::min(16, 4000 / config.packetTime))));
+    converter.initialize(rate, 2, 24);
+    converter.setStreamFormat(2, 24, { 0, 1 });
+    jitter.setSampleRate(rate);
+    playout.initialize(2, rate);
+    concealer.initialize(2, rate);
+    receiver.setSampleRate(rate);
+
+    ring.resize(static_cast<size_t>(MAX_PACKET_TIME) * rate / 1000000 * 20, 2);
+    float milliseconds = std::max(config.maxLatency, config.linkOffset);
+    receiver.setBufferSize(static_cast<size_t>(milliseconds * rate / 1000.0f) + packetSamples * 2);
+
+    left.resize(config.period);
+    right.resize(config.period);
+}
+
+Simulation::~Simulation() {
+}
+
+bool Simulation::parseMasterChange(const std::string& spec, MasterChange& change) {
+    std::istringstream stream(spec);
+    char colon1 = 0, colon2 = 0;
+    if (!(stream >> change.at >> colon1 >> change.stepUs >> colon2 >> change.ppm) ||
+        colon1 != ':' || colon2 != ':' || change.at < 0.0 || !stream.eof()) {
+        std::cerr << "Invalid master change: " << spec << ". Use <seconds>:<step us>:<ppm>." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+uint64_t Simulation::localNanos(uint64_t trueNs) const {
+    return LOCAL_BASE_NS + static_cast<uint64_t>(std::llround(trueNs * (1.0 + config.localPpm * 1e-6)));
+}
+
+uint64_t Simulation::masterNanos(const MasterClock& clock, uint64_t trueNs) const {
+    return clock.masterStart + static_cast<uint64_t>(std::llround((trueNs - clock.trueStart) * clock.rate));
+}
+
+uint64_t Simulation::trueTimeOfMaster(const MasterClock& clock, uint64_t masterNs) const {
+    if (masterNs <= clock.masterStart) {
+        return clock.trueStart;
+    }
+    return clock.trueStart + static_cast<uint64_t>(std::ceil((masterNs - clock.masterStart) / clock.rate));
+}
+
+const Simulation::MasterClock& Simulation::activeClock() const {
+    // The newest master is the best, once it has taken over
+    for (size_t i = masters.size(); i-- > 1; ) {
+        if (masters[i]->ptp.isMaster()) {
+            return masters[i]->clock;
+        }
+    }
+    return masters[0]->clock;
+}
+
+FixedTime Simulation::masterSamples(uint64_t trueNs) const {
+    return timeBase.samples(static_cast<int64_t>(masterNanos(activeClock(), trueNs)));
+}
+
+void Simulation::schedule(uint64_t time, EventType type, size_t index) {
+    events.push(Event{ std::max(time, now), nextOrder++, type, index });
+}
+
+void Simulation::submit(size_t link, const uint8_t* data, size_t size, uint64_t delayNs) {
+    Link& target = links[link];
+    target.network.submit(data, size, now + delayNs);
+
+    // Only a release earlier than the poll already queued needs another
+    uint64_t release = target.network.nextReleaseTime();
+    if (release != UINT64_MAX && release < target.pollAt) {
+        target.pollAt = release;
+        schedule(target.pollAt, EVENT_NETWORK, link);
+    }
+}
+
+void Simulation::pollLink(size_t link) {
+    Link& source = links[link];
+    if (now < source.pollAt) {
+        return;     // Superseded by an earlier poll
+    }
+    source.pollAt = UINT64_MAX;
+
+    uint8_t buffer[2048];
+    size_t size;
+    while (source.network.poll(buffer, sizeof(buffer), size, now)) {
+        source.deliver(buffer, size);
+    }
+
+    uint64_t release = source.network.nextReleaseTime();
+    if (release != UINT64_MAX) {
+        source.pollAt = release;
+        schedule(source.pollAt, EVENT_NETWORK, link);
+    }
+}
+
+void Simulation::addMaster(const MasterClock& clock) {
+    const size_t index = masters.size();
+    masters.push_back(std::make_unique<Grandmaster>(reactor));
+    Grandmaster& master = *masters.back();
+    master.clock = clock;
+
+    // Each better than the ones before it
+    PTPMaster::Config masterConfig;
+    masterConfig.priority1 = static_cast<uint8_t>(128 - std::min<size_t>(index, 128));
+    masterConfig.logSyncInterval = static_cast<int8_t>(std::lround(std::log2(config.syncInterval)));
+    master.ptp.setConfig(masterConfig);
+
+    uint8_t identity[8];
+    memcpy(identity, MASTER_IDENTITY, sizeof(identity));
+    identity[7] = static_cast<uint8_t>(index + 1);
+    master.ptp.setIdentity(identity);
+
+    // Everything it sends reaches the bridge and the other masters
+    PTPMaster::Transport transport;
+    transport.sendEvent = [this](const uint8_t* data, size_t size) {
+        submit(LINK_TO_SLAVE, data, size);
+        submit(LINK_MASTERS, data, size);
+        return true;
+    };
+    transport.sendGeneral = transport.sendEvent;
+    transport.nowNs = [this, index]() { return masterNanos(masters[index]->clock, now); };
+    master.ptp.setTransport(transport);
+
+    master.ptp.start(masterNanos(clock, now));
+    pollMaster(index);
+}
+
+void Simulation::pollMaster(size_t index) {
+    Grandmaster& master = *masters[index];
+    if (master.pollAt <= now) {
+        master.pollAt = UINT64_MAX;
+    }
+
+    // Only a deadline earlier than the poll already queued needs another
+    uint64_t deadline = master.ptp.poll(masterNanos(master.clock, now));
+    if (deadline != 0) {
+        uint64_t at = std::max(trueTimeOfMaster(master.clock, deadline), now + 1);
+        if (at < master.pollAt) {
+            master.pollAt = at;
+            schedule(at, EVENT_MASTER, index);
+        }
+    }
+}
+
+void Simulation::masterReceive(const uint8_t* data, size_t size) {
+    // Delay requests on the event port, the rest on the general port
+    bool event = size > 0 && ((data[0] & 0x0F) == PTP_SYNC || (data[0] & 0x0F) == PTP_DELAY_REQ);
+    for (size_t i = 0; i < masters.size(); i++) {
+        uint64_t arrival = masterNanos(masters[i]->clock, now);
+        if (event) {
+            masters[i]->ptp.handleEventMessage(data, size, arrival);
+        } else {
+            masters[i]->ptp.handleGeneralMessage(data, size, arrival);
+        }
+        pollMaster(i);
+    }
+}
+
+void Simulation::slaveReceive(const uint8_t* data, size_t size) {
+    // Sync arrives on the event port, the rest on the general port
+    if ((data[0] & 0x0F) == PTP_SYNC) {
+        ptp.handleEventMessage(data, size, localNanos(now));
+    } else {
+        ptp.handleGeneralMessage(data, size, localNanos(now));
+    }
+}
+
+void Simulation::changeMaster() {
+    const MasterChange& change = config.masterChanges[nextMasterChange++];
+
+    // The new master starts from the grandmaster's time plus its step
+    MasterClock clock;
+    clock.trueStart = now;
+    clock.masterStart = static_cast<uint64_t>(static_cast<int64_t>(masterNanos(activeClock(), now)) +
+                                              static_cast<int64_t>(change.stepUs * 1000.0));
+    clock.rate = 1.0 + change.ppm * 1e-6;
+    addMaster(clock);
+
+    if (nextMasterChange < config.masterChanges.size()) {
+        schedule(static_cast<uint64_t>(config.masterChanges[nextMasterChange].at * 1e9), EVENT_MASTER_CHANGE);
+    }
+}
+
+void Simulation::sendRtp() {
+    // The packet whose first frame is due now on the master's media clock
+    uint64_t sample = (static_cast<uint64_t>(masterSamples(now).whole) + packetSamples / 2) / packetSamples * packetSamples;
+    if (sample == lastSentSample) {
+        sample += packetSamples;
+    }
+    lastSentSample = sample;
+
+    // RTP header, then L24 payload
+    packet.resize(12 + packetSamples * 2 * 3);
+    packet[0] = 0x80;
+    packet[1] = 96;
+    uint16_t sequence = htons(rtpSequence++);
+    uint32_t timestamp = htonl(static_cast<uint32_t>(sample));
+    uint32_t ssrc = htonl(0x53494D31);
+    memcpy(&packet[2], &sequence, 2);
+    memcpy(&packet[4], &timestamp, 4);
+    memcpy(&packet[8], &ssrc, 4);
+    size_t frameBytes = 2 * 3;
+    size_t first = static_cast<size_t>(sample % config.sampleRate);
+    for (size_t copied = 0; copied < packetSamples; ) {
+        size_t count = std::min<size_t>(packetSamples - copied, config.sampleRate - first);
+        memcpy(&packet[12 + copied * frameBytes], &tone[first * frameBytes], count * frameBytes);
+        copied += count;
+        first = 0;
+    }
+    submit(LINK_AUDIO, packet.data(), packet.size());
+
+    // Next packet when the master's clock reaches it
+    uint64_t nextNs = (sample + packetSamples) / config.sampleRate * 1000000000ULL +
+                      (sample + packetSamples) % config.sampleRate * 1000000000ULL / config.sampleRate;
+    schedule(trueTimeOfMaster(activeClock(), nextNs), EVENT_RTP_SEND);
+}
+
+void Simulation::receiveRtp(const uint8_t* data, size_t size) {
+    receiver.receive(data, size, 0, localNanos(now), linkOffset, 0);
+}
+
+size_t Simulation::playoutTarget() const {
+    return receiver.playoutTarget(config.period, 0, config.minLatency, config.maxLatency);
+}
+
+void Simulation::jackCycle() {
+    const size_t numFrames = config.period;
+    const uint64_t cycleNs = localNanos(now);
+    float* sink[2] = { left.data(), right.data() };
+
+    // How far PTPSync's idea of master time is from the truth
+    if (ptp.hasOffset()) {
+        double error = (ptp.toMasterTime(cycleNs) - masterSamples(now)).toDouble() * 1e6 / config.sampleRate;
+        window.ptpErrorSum += std::fabs(error);
+        window.ptpErrorMax = std::max(window.ptpErrorMax, std::fabs(error));
+        window.ptpSamples++;
+        worstPtpError = std::max(worstPtpError, std::fabs(error));
+    }
+
+    const size_t depth = ring.readable();
+    window.depthMin = std::min(window.depthMin, depth);
+    window.depthMax = std::max(window.depthMax, depth);
+    window.cycles++;
+
+    // Play the period as AES67Bridge::process() does; the sim never splices
+    const size_t target = playoutTarget();
+    long error = 0;
+    bool aligned = receiver.playoutError(cycleNs, linkOffset, 0, error);
+    if (aligned) {
+        window.alignedCycles++;
+    }
+
+    played = receiver.play(sink, numFrames, target, aligned, error) > 0 || played;
+
+    // The audio clock runs off the local oscillator
+    cycleCount++;
+    double periodNs = numFrames * 1e9 / config.sampleRate / (1.0 + config.localPpm * 1e-6);
+    schedule(static_cast<uint64_t>(cycleCount * periodNs), EVENT_JACK_CYCLE);
+}
+
+void Simulation::resetWindow() {
+    window.ptpErrorSum = 0.0;
+    window.ptpErrorMax = 0.0;
+    window.ptpSamples = 0;
+    window.depthMin = SIZE_MAX;
+    window.depthMax = 0;
+    window.cycles = 0;
+    window.alignedCycles = 0;
+    window.concealed = concealer.getConcealedFrames();
+    window.slipped = playout.getDroppedFrames() + playout.getInsertedFrames();
+    window.lost = links[LINK_AUDIO].network.getStats().lost;
+}
+
+void Simulation::report(std::ostream& out) {
+    char line[160];
+    double meanError = window.ptpSamples > 0 ? window.ptpErrorSum / window.ptpSamples : 0.0;
+    snprintf(line, sizeof(line), "%8.0f %10.1f %10.1f %8.2f %7zu %6zu %6zu %9llu %8llu %6llu %6.0f%%",
+             now / 1e9, meanError, window.ptpErrorMax,
+             jitter.getJitterMicros() / 1000.0, playoutTarget(),
+             window.depthMin == SIZE_MAX ? 0 : window.depthMin, window.depthMax,
+             static_cast<unsigned long long>(concealer.getConcealedFrames() - window.concealed),
+             static_cast<unsigned long long>(playout.getDroppedFrames() + playout.getInsertedFrames() - window.slipped),
+             static_cast<unsigned long long>(links[LINK_AUDIO].network.getStats().lost - window.lost),
+             window.cycles > 0 ? 100.0 * window.alignedCycles / window.cycles : 0.0);
+    out << line << std::endl;
+    resetWindow();
+}
+
+bool Simulation::run(std::ostream& out) {
+    const auto wallStart = std::chrono::steady_clock::now();
+    const uint64_t end = static_cast<uint64_t>(config.duration * 1e9);
+
+    std::sort(config.masterChanges.begin(), config.masterChanges.end(),
+              [](const MasterChange& a, const MasterChange& b) { return a.at < b.at; });
+
+    MasterClock first;
+    first.trueStart = 0;
+    first.masterStart = MASTER_BASE_NS;
+    first.rate = 1.0 + config.masterPpm * 1e-6;
+    addMaster(first);
+
+    schedule(0, EVENT_RTP_SEND);
+    schedule(0, EVENT_JACK_CYCLE);
+    if (!config.masterChanges.empty()) {
+        schedule(static_cast<uint64_t>(config.masterChanges[0].at * 1e9), EVENT_MASTER_CHANGE);
+    }
+    schedule(static_cast<uint64_t>(config.reportInterval * 1e9), EVENT_REPORT);
+    resetWindow();
+
+    out << "    time   ptp err us   (max)  jitter ms  target  depth   (max)  concealed  slipped   lost aligned" << std::endl;
+
+    while (!events.empty() && events.top().time <= end) {
+        Event event = events.top();
+        events.pop();
+        now = event.time;
+
+        switch (event.type) {
+            case EVENT_MASTER:
+                if (now >= masters[event.index]->pollAt) {
+                    pollMaster(event.index);
+                }
+                break;
+            case EVENT_RTP_SEND:
+                sendRtp();
+                break;
+            case EVENT_JACK_CYCLE:
+                jackCycle();
+                break;
+            case EVENT_NETWORK:
+                pollLink(event.index);
+                break;
+            case EVENT_MASTER_CHANGE:
+                changeMaster();
+                break;
+            case EVENT_REPORT:
+                report(out);
+                schedule(now + static_cast<uint64_t>(config.reportInterval * 1e9), EVENT_REPORT);
+                break;
+        }
+    }
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    out << "Simulated " << config.duration << " s in " << wallSeconds << " s ("
+        << static_cast<uint64_t>(config.duration / std::max(wallSeconds, 1e-9)) << "x real time)\n"
+        << "Worst PTP error: " << worstPtpError << " us, underruns: " << receiver.getUnderruns()
+        << ", concealed frames: " << concealer.getConcealedFrames()
+        << ", slipped frames: " << (playout.getDroppedFrames() + playout.getInsertedFrames())
+        << ", packets lost: " << links[LINK_AUDIO].network.getStats().lost << std::endl;
+
+    return played;
+}
+
+} // namespace aes67
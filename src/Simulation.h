@@ -0,0 +1,207 @@
+// Simulation.h
+#pragma once
+
+#include "Reactor.h"
+#include "PTPSync.h"
+#include "PTPMaster.h"
+#include "RTPHandler.h"
+#include "AudioConverter.h"
+#include "AudioRing.h"
+#include "JitterEstimator.h"
+#include "PlayoutAdjuster.h"
+#include "LossConcealer.h"
+#include "PerfCounters.h"
+#include "StreamReceiver.h"
+#include "NetworkImpairment.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <vector>
+
+namespace aes67 {
+
+// Deterministic, faster than real time run of a received stream.
+//
+// A PTP grandmaster and an RTP sender locked to it talk across a simulated
+// network to the bridge's receive side, whose JACK cycle runs off a local
+// oscillator. Everything happens on one virtual clock driven from an event
+// queue, so an hour of stream takes seconds and the same config and seeds
+// always give the same run. The real PTPMaster and PTPSync exchange the
+// messages through their transport hooks, and packets and JACK cycles go
+// through the same StreamReceiver AES67Bridge plays its stream with. The oscillators drift by a configured
+// amount, network delays come from NetworkImpairment, and a better
+// grandmaster can join mid-run and take over through the BMCA.
+class Simulation {
+public:
+    // A better grandmaster from a point in the run, with its own time and rate
+    struct MasterChange {
+        double at = 0.0;        // Seconds into the run
+        double stepUs = 0.0;    // Its time against the old master's
+        double ppm = 0.0;       // Its rate against true time
+    };
+
+    struct Config {
+        double duration = 3600.0;           // Simulated seconds
+        uint32_t sampleRate = 48000;
+        uint32_t period = 128;              // Frames per JACK cycle
+        int packetTime = 1000;              // Microseconds
+        double localPpm = 0.0;              // Local oscillator, system and audio clock
+        double masterPpm = 0.0;
+        double syncInterval = 0.125;        // Seconds between Sync messages, a power of two
+        float linkOffset = 0.0f;            // Milliseconds, 0 plays on arrival
+        float minLatency = 0.0f;            // Adaptive playout bounds, milliseconds
+        float maxLatency = 20.0f;
+        bool silence = false;               // Send silence instead of a tone
+        NetworkImpairment::Config ptpNetwork;   // Used in each direction
+        NetworkImpairment::Config audioNetwork;
+        std::vector<MasterChange> masterChanges;
+        double reportInterval = 60.0;       // Simulated seconds between report lines
+    };
+
+    explicit Simulation(const Config& config);
+    ~Simulation();
+
+    // Runs to the end, reporting as it goes; false if no audio ever played
+    bool run(std::ostream& out);
+
+    // "<seconds>:<step us>:<ppm>"
+    static bool parseMasterChange(const std::string& spec, MasterChange& change);
+
+private:
+    enum EventType {
+        EVENT_MASTER = 0,       // A grandmaster has work due
+        EVENT_RTP_SEND,         // Sender emits the next packet
+        EVENT_JACK_CYCLE,       // Bridge JACK period
+        EVENT_NETWORK,          // A network may have packets to deliver
+        EVENT_MASTER_CHANGE,
+        EVENT_REPORT
+    };
+
+    // Ordered by time, then by when it was scheduled, so runs repeat exactly
+    struct Event {
+        uint64_t time;          // True nanoseconds
+        uint64_t order;
+        EventType type;
+        size_t index;
+
+        bool operator>(const Event& other) const {
+            return time != other.time ? time > other.time : order > other.order;
+        }
+    };
+
+    // A one-way network link and where its packets go
+    struct Link {
+        NetworkImpairment network;
+        uint64_t pollAt;        // Earliest poll queued, UINT64_MAX for none
+        std::function<void(const uint8_t* data, size_t size)> deliver;
+    };
+
+    enum { LINK_TO_SLAVE = 0, LINK_TO_MASTER, LINK_MASTERS, LINK_AUDIO, LINK_COUNT };
+
+    // A grandmaster's oscillator against true time
+    struct MasterClock {
+        uint64_t trueStart;     // True time it started
+        uint64_t masterStart;   // Its time then, nanoseconds
+        double rate;            // Its nanoseconds per true nanosecond
+    };
+
+    struct Grandmaster {
+        MasterClock clock;
+        PTPMaster ptp;
+        uint64_t pollAt;        // Earliest poll queued, UINT64_MAX for none
+
+        Grandmaster(Reactor& reactor) : ptp(reactor, nullptr), pollAt(UINT64_MAX) {}
+    };
+
+    // Interval statistics
+    struct Window {
+        double ptpErrorSum;
+        double ptpErrorMax;
+        uint64_t ptpSamples;
+        size_t depthMin;
+        size_t depthMax;
+        uint64_t cycles;
+        uint64_t alignedCycles;
+        uint64_t concealed;     // Frames, at the window start
+        uint64_t slipped;
+        uint64_t lost;
+    };
+
+    Config config;
+
+    // Virtual time
+    uint64_t now;
+    uint64_t nextOrder;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+
+    Reactor reactor;            // Unused, PTPMaster and PTPSync want one
+
+    // Grandmasters in order of joining, each better than the last
+    std::vector<std::unique_ptr<Grandmaster>> masters;
+    size_t nextMasterChange;
+
+    Link links[LINK_COUNT];
+    std::vector<uint8_t> packet;
+
+    // Sender
+    uint32_t packetSamples;
+    uint64_t lastSentSample;
+    uint16_t rtpSequence;
+    std::vector<uint8_t> tone;  // One second of L24 payload
+
+    // Bridge receive side, as AES67Bridge holds it
+    PTPSync ptp;
+    TimeBase timeBase;
+    RTPHandler rtp;
+    AudioConverter converter;
+    JitterEstimator jitter;
+    PlayoutAdjuster playout;
+    LossConcealer concealer;
+    AudioRing ring;
+    PerfCounters receivePerf;   // Left disabled
+    StreamReceiver receiver;
+    int linkOffset;             // Microseconds, as StreamConfig holds it
+
+    // JACK cycle
+    uint64_t cycleCount;
+    std::vector<float> left;
+    std::vector<float> right;
+
+    // Results
+    Window window;
+    bool played;
+    double worstPtpError;       // Microseconds, once locked
+
+    // Clocks
+    uint64_t localNanos(uint64_t trueNs) const;
+    uint64_t masterNanos(const MasterClock& clock, uint64_t trueNs) const;
+    uint64_t trueTimeOfMaster(const MasterClock& clock, uint64_t masterNs) const;
+    const MasterClock& activeClock() const;     // The grandmaster's, or the first one's
+    FixedTime masterSamples(uint64_t trueNs) const;
+
+    // Event queue
+    void schedule(uint64_t time, EventType type, size_t index = 0);
+    void submit(size_t link, const uint8_t* data, size_t size, uint64_t delayNs = 0);
+    void pollLink(size_t link);
+
+    // Participants
+    void addMaster(const MasterClock& clock);
+    void pollMaster(size_t index);
+    void masterReceive(const uint8_t* data, size_t size);
+    void slaveReceive(const uint8_t* data, size_t size);
+    void changeMaster();
+    void sendRtp();
+    void receiveRtp(const uint8_t* data, size_t size);
+    void jackCycle();
+    size_t playoutTarget() const;
+
+    // Reporting
+    void resetWindow();
+    void report(std::ostream& out);
+};
+
+} // namespace aes67
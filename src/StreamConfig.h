@@ -0,0 +1,47 @@
+// StreamConfig.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace aes67 {
+
+// Stream parameters shared by the control, JACK and network threads.
+// A published config is never modified; changes are made on a copy and
+// published as a new config through an RcuCell.
+struct StreamConfig {
+    enum class Mode {
+        Receive,    // Receive AES67 audio and output to JACK
+        Transmit,   // Take JACK input and transmit as AES67
+        Inactive    // Not sending or receiving
+    };
+
+    Mode mode = Mode::Inactive;
+    int bitDepth = 24;
+    int packetTime = 1000;                         // in microseconds
+    std::string multicastAddress = "239.69.83.133"; // Example AES67 multicast address
+    int networkPort = 5004;                        // Default AES67 port
+
+    // Receive stream format
+    uint16_t streamChannels = 2;
+    uint16_t payloadType = 96;
+    std::vector<uint16_t> channelMap{0, 1};        // Stream channel for each output
+    uint32_t mediaClockOffset = 0;                 // RTP timestamp at the PTP epoch
+    int linkOffset = 0;                            // Playout after the RTP timestamp in
+                                                   // microseconds, 0 plays on arrival
+
+    uint64_t version = 0;                          // Bumped on every publish
+
+    bool sameDestination(const StreamConfig& other) const {
+        return multicastAddress == other.multicastAddress && networkPort == other.networkPort;
+    }
+
+    bool sameFormat(const StreamConfig& other) const {
+        return bitDepth == other.bitDepth && packetTime == other.packetTime &&
+               streamChannels == other.streamChannels && payloadType == other.payloadType &&
+               channelMap == other.channelMap;
+    }
+};
+
+} // namespace aes67
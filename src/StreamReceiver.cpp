@@ -0,0 +1,332 @@
+// StreamReceiver.cpp
+#include "StreamReceiver.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace aes67 {
+
+StreamReceiver::StreamReceiver(RTPHandler& rtp, AudioConverter& converter, JitterEstimator& jitter,
+                               AudioRing& ring, PlayoutAdjuster& playout, LossConcealer& concealer,
+                               const PTPSync& ptp, PerfCounters& networkPerf)
+    : rtp(rtp), converter(converter), jitter(jitter), ring(ring), playout(playout),
+      concealer(concealer), ptp(ptp), networkPerf(networkPerf),
+      bufferSize(0),
+      nextTimestamp(0),
+      timestampKnown(false),
+      packetFrames(0),
+      anchor(0),
+      anchorValid(false),
+      splicePending(false),
+      spliceFrame(0),
+      lost{ 0, 0 },
+      lostPending(false),
+      priming(true),
+      underruns(0),
+      period(0),
+      owed(0)
+{
+}
+
+StreamReceiver::~StreamReceiver() {
+}
+
+void StreamReceiver::setSampleRate(uint32_t rate) {
+    timeBase.setSampleRate(rate);
+}
+
+void StreamReceiver::reset() {
+    LostSpan span;
+    while (lostSpans.pop(span)) {
+    }
+    lostPending = false;
+    anchorValid = false;
+    splicePending = false;
+    timestampKnown = false;
+    priming = true;
+    owed = 0;
+}
+
+void StreamReceiver::restart() {
+    timestampKnown = false;
+}
+
+void StreamReceiver::splice() {
+    spliceFrame.store(ring.getWritePosition(), std::memory_order_release);
+    splicePending.store(true, std::memory_order_release);
+}
+
+void StreamReceiver::receive(const uint8_t* data, size_t size, int path, uint64_t arrivalNs, int linkOffsetUs,
+                             uint32_t mediaClockOffset) {
+    // Merge into the jitter buffer, duplicates from the other path stop here
+    bool added;
+    {
+        PerfScope probe(networkPerf, PerfCounters::STAGE_JITTER);
+        added = rtp.addPacketToBuffer(data, size, path);
+    }
+    if (!added) {
+        return;
+    }
+    jitter.addArrival(rtp.getArrivalTimestamp(), arrivalNs);
+
+    // On schedule, a missing packet is worth waiting for until the JACK
+    // cycle that plays it may start before the next packet arrives: the
+    // packet after it is then within a period and two packets of due
+    uint32_t deadline = 0;
+    bool scheduled = dueTimestamp(arrivalNs, linkOffsetUs, mediaClockOffset, deadline);
+    deadline += static_cast<uint32_t>(period.load(std::memory_order_relaxed)) +
+                packetFrames.load(std::memory_order_relaxed) * 2;
+
+    // Process every packet that is now in order
+    RTPHandler::AudioData audio;
+    while (scheduled ? rtp.getNextAudioFrame(audio, deadline) : rtp.getNextAudioFrame(audio)) {
+        const size_t channels = converter.getOutputChannels();
+        packetFrames.store(audio.frameCount, std::memory_order_relaxed);
+
+        // Scheduled playout needs ring positions contiguous in RTP time, so
+        // packets given up as lost hold their place for the JACK thread to
+        // conceal
+        if (linkOffsetUs > 0 && timestampKnown) {
+            int32_t gap = static_cast<int32_t>(audio.timestamp - nextTimestamp);
+            size_t queued = ring.readable();
+            size_t room = bufferSize > queued ? bufferSize - queued : 0;
+            if (gap > 0 && static_cast<size_t>(gap) <= room) {
+                LostSpan span = { ring.getWritePosition(), 0 };
+                span.length = ring.writeSilence(static_cast<size_t>(gap));
+                if (span.length > 0) {
+                    lostSpans.push(span);
+                }
+            }
+        }
+        nextTimestamp = audio.timestamp + audio.frameCount;
+        timestampKnown = true;
+
+        // Convert audio from network format to float
+        decoded.resize(audio.frameCount * channels);
+        {
+            PerfScope probe(networkPerf, PerfCounters::STAGE_DECODE);
+            converter.intToFloat(audio.payload, decoded.data(), audio.frameCount);
+        }
+
+        // Add to playback buffer, anything beyond the max latency is dropped
+        size_t queued = ring.readable();
+        size_t room = bufferSize > queued ? bufferSize - queued : 0;
+        size_t position = ring.getWritePosition();
+        ring.writeInterleaved(decoded.data(), std::min<size_t>(audio.frameCount, room));
+
+        // Where this packet's first frame sits in the ring, for scheduled playout
+        anchor.store((static_cast<uint64_t>(static_cast<uint32_t>(position)) << 32) | audio.timestamp,
+                     std::memory_order_release);
+        anchorValid.store(true, std::memory_order_release);
+    }
+}
+
+size_t StreamReceiver::playoutTarget(size_t numFrames, size_t fixedTarget, float minLatency, float maxLatency) const {
+    const uint32_t rate = timeBase.getSampleRate();
+    size_t target;
+    if (fixedTarget > 0) {
+        target = fixedTarget;
+    } else {
+        // A late packet is survived if a period plus its lateness is queued.
+        // Depth falls by up to a packet between arrivals, and drift is only
+        // slipped out once it shows, so one packet more keeps the low point
+        // clear of the period.
+        size_t lower = static_cast<size_t>(minLatency * rate / 1000.0f);
+        size_t upper = static_cast<size_t>(maxLatency * rate / 1000.0f);
+        target = numFrames + packetFrames.load(std::memory_order_relaxed) + jitter.getJitterFrames();
+        target = std::min(std::max(target, lower), upper);
+    }
+
+    return std::min<size_t>(target, bufferSize);
+}
+
+bool StreamReceiver::playoutError(uint64_t cycleNs, int linkOffsetUs, uint32_t mediaClockOffset, long& error) const {
+    // RTP timestamp due at the first frame of this period
+    uint32_t due;
+    if (!anchorValid.load(std::memory_order_acquire) || !dueTimestamp(cycleNs, linkOffsetUs, mediaClockOffset, due)) {
+        return false;
+    }
+
+    // RTP timestamp of the next frame in the ring
+    uint64_t packed = anchor.load(std::memory_order_acquire);
+    uint32_t anchorPosition = static_cast<uint32_t>(packed >> 32);
+    uint32_t anchorTimestamp = static_cast<uint32_t>(packed);
+    uint32_t readPosition = static_cast<uint32_t>(ring.getReadPosition());
+    uint32_t next = anchorTimestamp - (anchorPosition - readPosition);
+
+    // Over a second out means the stream is not on this PTP timescale
+    int32_t diff = static_cast<int32_t>(due - next);
+    if (std::abs(diff) > static_cast<int32_t>(timeBase.getSampleRate())) {
+        return false;
+    }
+
+    error = diff;
+    return true;
+}
+
+size_t StreamReceiver::play(float* const* out, size_t numFrames, size_t target, bool aligned, long error) {
+    period.store(numFrames, std::memory_order_relaxed);
+
+    // After an underrun, conceal until the buffer is back at its target
+    if (priming && (aligned || ring.readable() >= target)) {
+        priming = false;
+    }
+    if (priming) {
+        concealer.conceal(out, numFrames);
+        return 0;
+    }
+
+    // Stop at the point where the stream switched source, if it is in this period
+    size_t limit = numFrames;
+    size_t toSplice = SIZE_MAX;
+    bool splicing = false;
+    if (splicePending.load(std::memory_order_acquire)) {
+        toSplice = spliceFrame.load(std::memory_order_acquire) - ring.getReadPosition();
+        if (toSplice < numFrames) {
+            limit = toSplice;
+            splicing = true;
+            aligned = false;
+        }
+    }
+
+    // Frames concealed on schedule are skipped as they arrive, so the
+    // audio that was on time plays at its own time. Those still to come
+    // are not an error now.
+    if (!aligned) {
+        owed = 0;
+    } else if (owed > 0) {
+        error -= static_cast<long>(owed);
+        size_t skipped = ring.skip(std::min(owed, toSplice));
+        owed -= skipped;
+        if (toSplice != SIZE_MAX) {
+            toSplice -= skipped;
+        }
+    }
+
+    // A dropped frame must not carry the read past the splice point or
+    // into a lost span
+    bool steer = std::min(toSplice, nextLost()) > numFrames + 1;
+
+    // Far off schedule: jump to the frame due now, or wait for it behind
+    // concealment. Small errors are slipped out like depth errors.
+    const long snap = static_cast<long>(timeBase.getSampleRate() / 1000);
+    size_t lead = 0;
+    long correction = 0;
+    if (aligned && error > snap) {
+        ring.skip(std::min(static_cast<size_t>(error), toSplice));
+        concealer.splice();
+    } else if (aligned && error < -snap) {
+        lead = std::min<size_t>(numFrames, static_cast<size_t>(-error));
+        concealer.conceal(out, lead);
+    } else {
+        correction = error;
+    }
+
+    // Play whatever real audio we have, slipping toward the target depth
+    // except near a splice, which must land on its frame, or a lost span
+    float* rest[2] = { out[0] + lead, out[1] + lead };
+    size_t available;
+    if (splicing || !steer) {
+        available = readAround(rest, limit - lead);
+    } else {
+        if (aligned) {
+            available = playout.readCorrected(ring, rest, numFrames - lead, correction);
+        } else {
+            available = playout.read(ring, rest, limit, target);
+        }
+
+        // Record history and crossfade back in after a gap
+        concealer.process(rest, available);
+    }
+    size_t played = available;
+    available += lead;
+
+    // Crossfade from a continuation of the old stream into the new one
+    if (splicing && available == limit) {
+        splicePending.store(false, std::memory_order_release);
+        concealer.splice();
+
+        float* after[2] = { out[0] + available, out[1] + available };
+        size_t more = readAround(after, numFrames - available);
+        available += more;
+        played += more;
+    }
+
+    // Fill the rest of the period instead of dropping it to silence
+    if (available < numFrames) {
+        AES67_TRACE_INSTANT("underrun", static_cast<int64_t>(numFrames - available));
+        float* gap[2] = { out[0] + available, out[1] + available };
+        concealer.conceal(gap, numFrames - available);
+        if (aligned) {
+            owed += numFrames - available;
+        }
+        priming = !aligned;
+        underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return played;
+}
+
+bool StreamReceiver::dueTimestamp(uint64_t localNs, int linkOffsetUs, uint32_t mediaClockOffset,
+                                  uint32_t& due) const {
+    if (linkOffsetUs <= 0 || !ptp.hasOffset()) {
+        return false;
+    }
+
+    // Master time less the link offset, rounded once
+    FixedTime link = timeBase.samples(static_cast<int64_t>(linkOffsetUs) * 1000);
+    due = static_cast<uint32_t>((ptp.toMasterTime(localNs) - link).rounded()) + mediaClockOffset;
+    return true;
+}
+
+size_t StreamReceiver::nextLost() {
+    // Frames from the read position to the next lost span, dropping spans
+    // the read has already passed by skipping or slipping
+    const size_t readPosition = ring.getReadPosition();
+    for (;;) {
+        if (!lostPending && !lostSpans.pop(lost)) {
+            return SIZE_MAX;
+        }
+        lostPending = true;
+
+        size_t ahead = lost.position - readPosition;
+        if (ahead <= ring.getCapacity()) {
+            return ahead;
+        }
+        size_t passed = readPosition - lost.position;
+        if (passed < lost.length) {
+            lost.position += passed;
+            lost.length -= passed;
+            return 0;
+        }
+        lostPending = false;
+    }
+}
+
+size_t StreamReceiver::readAround(float* const* out, size_t frames) {
+    // Real audio goes through the concealer's history and return crossfade;
+    // lost spans are concealed in its place, fading to silence when long
+    size_t done = 0;
+    while (done < frames) {
+        float* at[2] = { out[0] + done, out[1] + done };
+        size_t toLost = nextLost();
+        size_t n;
+        if (toLost == 0) {
+            n = ring.skip(std::min(frames - done, lost.length));
+            concealer.conceal(at, n);
+            lost.position += n;
+            lost.length -= n;
+            lostPending = lost.length > 0;
+        } else {
+            n = ring.read(at, std::min(frames - done, toLost));
+            concealer.process(at, n);
+        }
+        if (n == 0) {
+            break;
+        }
+        done += n;
+    }
+    return done;
+}
+
+} // namespace aes67
@@ -0,0 +1,124 @@
+// StreamReceiver.h
+#pragma once
+
+#include "RTPHandler.h"
+#include "AudioConverter.h"
+#include "AudioRing.h"
+#include "JitterEstimator.h"
+#include "PlayoutAdjuster.h"
+#include "LossConcealer.h"
+#include "PerfCounters.h"
+#include "PTPSync.h"
+#include "TimeBase.h"
+#include "SPSCQueue.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <vector>
+
+namespace aes67 {
+
+// The two halves of a received stream: packets into the audio ring on the
+// network thread, and the ring out to a JACK period on the JACK thread.
+//
+// The network side merges packets through the RTP jitter buffer, decodes
+// them and writes them to the ring, recording which RTP timestamp sits at
+// which ring position. The JACK side plays the ring either at a depth
+// steered from the measured jitter or, with a link offset and PTP lock, at
+// the RTP timestamps themselves: far off schedule it jumps or waits, and
+// small errors are slipped out. Packets lost under scheduled playout keep
+// their place in the ring as a span the JACK side conceals when it reaches
+// it. Splices at a source switch and underruns are covered by the
+// concealer too. AES67Bridge and the simulator both run their receive
+// streams through this, on components they own.
+class StreamReceiver {
+public:
+    StreamReceiver(RTPHandler& rtp, AudioConverter& converter, JitterEstimator& jitter, AudioRing& ring,
+                   PlayoutAdjuster& playout, LossConcealer& concealer, const PTPSync& ptp,
+                   PerfCounters& networkPerf);
+    ~StreamReceiver();
+
+    // Configuration
+    void setSampleRate(uint32_t rate);
+    void setBufferSize(size_t frames) { bufferSize = frames; }  // Frames the ring may hold at most
+    void reset();   // While neither thread uses the ring
+
+    // Network thread. A link offset keeps ring positions contiguous in RTP
+    // time and, with PTP lock, waits for a missing packet until the packets
+    // after it are due.
+    void receive(const uint8_t* data, size_t size, int path, uint64_t arrivalNs, int linkOffsetUs,
+                 uint32_t mediaClockOffset);
+    void restart();     // A new sender, with its own timeline
+    void splice();      // Everything written from here on is a new source
+
+    // JACK thread. The target is a fixed depth, or the jitter plus a period
+    // and a packet within the latency bounds, and never more than the ring
+    // may hold.
+    size_t playoutTarget(size_t numFrames, size_t fixedTarget, float minLatency, float maxLatency) const;
+
+    // Frames the ring's next frame is behind the RTP timestamp due at cycleNs
+    // on the local clock, when there is a link offset and PTP lock
+    bool playoutError(uint64_t cycleNs, int linkOffsetUs, uint32_t mediaClockOffset, long& error) const;
+
+    // Fill one period, concealing what the ring cannot supply. Returns the
+    // frames of received audio played.
+    size_t play(float* const* out, size_t numFrames, size_t target, bool aligned, long error);
+
+    // Status
+    size_t getBufferSize() const { return bufferSize; }
+    uint64_t getUnderruns() const { return underruns.load(std::memory_order_relaxed); }
+    bool isPriming() const { return priming.load(std::memory_order_relaxed); }
+
+private:
+    RTPHandler& rtp;
+    AudioConverter& converter;
+    JitterEstimator& jitter;
+    AudioRing& ring;
+    PlayoutAdjuster& playout;
+    LossConcealer& concealer;
+    const PTPSync& ptp;
+    PerfCounters& networkPerf;
+
+    TimeBase timeBase;
+    std::atomic<size_t> bufferSize;
+
+    // Network thread
+    std::vector<float> decoded;
+    uint32_t nextTimestamp;     // Expected RTP timestamp
+    bool timestampKnown;
+    std::atomic<uint32_t> packetFrames;     // Of the latest packet
+
+    // RTP time of the ring: the timestamp of the latest packet written and
+    // the position it went to, packed as (position << 32) | timestamp
+    std::atomic<uint64_t> anchor;
+    std::atomic<bool> anchorValid;
+
+    // Where the stream switched source, for the crossfade
+    std::atomic<bool> splicePending;
+    std::atomic<size_t> spliceFrame;
+
+    // Ring frames of packets given up as lost, held as silence until the
+    // JACK thread conceals over them; a span the queue has no room for is
+    // played as the silence
+    struct LostSpan {
+        size_t position;
+        size_t length;
+    };
+    SPSCQueue<LostSpan, 64> lostSpans;
+    LostSpan lost;              // JACK thread: the next span, when lostPending
+    bool lostPending;
+
+    // JACK thread: concealing until the ring is back at its target, and
+    // frames concealed on schedule that are skipped when they arrive
+    std::atomic<bool> priming;
+    std::atomic<uint64_t> underruns;
+    std::atomic<size_t> period;
+    size_t owed;
+
+    bool dueTimestamp(uint64_t localNs, int linkOffsetUs, uint32_t mediaClockOffset, uint32_t& due) const;
+    size_t nextLost();
+    size_t readAround(float* const* out, size_t frames);
+};
+
+} // namespace aes67
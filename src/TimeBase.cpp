@@ -0,0 +1,119 @@
+// TimeBase.cpp
+#include "TimeBase.h"
+#include <time.h>
+
+namespace aes67 {
+
+namespace {
+
+constexpr uint64_t NS_PER_SECOND = 1000000000ULL;
+
+// 128-bit unsigned value, for the products of 64-bit operands
+struct Wide {
+    uint64_t high;
+    uint64_t low;
+};
+
+Wide multiply(uint64_t a, uint64_t b) {
+    // Four 32x32-bit partial products, which 32-bit cores have instructions for
+    uint64_t aLow = a & 0xFFFFFFFFu;
+    uint64_t aHigh = a >> 32;
+    uint64_t bLow = b & 0xFFFFFFFFu;
+    uint64_t bHigh = b >> 32;
+
+    uint64_t lowLow = aLow * bLow;
+    uint64_t lowHigh = aLow * bHigh;
+    uint64_t highLow = aHigh * bLow;
+    uint64_t middle = (lowLow >> 32) + (lowHigh & 0xFFFFFFFFu) + (highLow & 0xFFFFFFFFu);
+
+    return Wide{ aHigh * bHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32),
+                 (middle << 32) | (lowLow & 0xFFFFFFFFu) };
+}
+
+void add(Wide& sum, const Wide& term) {
+    sum.low += term.low;
+    sum.high += term.high + (sum.low < term.low);
+}
+
+// A product in units of 2^-96 brought to units of 2^-64
+Wide shiftDown(const Wide& value) {
+    return Wide{ value.high >> 32, (value.high << 32) | (value.low >> 32) };
+}
+
+// A value in units of 2^-64, rounded to the nearest 2^-32
+FixedTime toFixed(Wide value) {
+    add(value, Wide{ 0, 1ULL << 31 });
+    return FixedTime(static_cast<int64_t>(value.high), static_cast<uint32_t>(value.low >> 32));
+}
+
+} // namespace
+
+TimeBase::TimeBase(uint32_t rate)
+    : sampleRate(0), samplesPerNsHigh(0), samplesPerNsLow(0), nsPerSample(0), nsPerSampleFraction(0)
+{
+    setSampleRate(rate);
+}
+
+void TimeBase::setSampleRate(uint32_t rate) {
+    if (rate == 0 || rate >= NS_PER_SECOND) {
+        return;
+    }
+    sampleRate = rate;
+
+    // rate / 10^9 by long division, a 32-bit digit at a time
+    uint64_t digits[3];
+    uint64_t remainder = rate;
+    for (uint64_t& digit : digits) {
+        remainder <<= 32;
+        digit = remainder / NS_PER_SECOND;
+        remainder %= NS_PER_SECOND;
+    }
+    samplesPerNsHigh = (digits[0] << 32) | digits[1];
+    samplesPerNsLow = static_cast<uint32_t>(digits[2]);
+
+    // And 10^9 / rate
+    nsPerSample = NS_PER_SECOND / rate;
+    remainder = NS_PER_SECOND % rate;
+    for (int i = 0; i < 2; i++) {
+        remainder <<= 32;
+        digits[i] = remainder / rate;
+        remainder %= rate;
+    }
+    nsPerSampleFraction = (digits[0] << 32) | digits[1];
+}
+
+FixedTime TimeBase::samples(int64_t ns) const {
+    // On the magnitude; the sign goes back on at the end
+    uint64_t magnitude = ns < 0 ? 0 - static_cast<uint64_t>(ns) : static_cast<uint64_t>(ns);
+
+    // In units of 2^-64 samples
+    Wide product = multiply(magnitude, samplesPerNsHigh);
+    add(product, shiftDown(multiply(magnitude, samplesPerNsLow)));
+
+    FixedTime result = toFixed(product);
+    return ns < 0 ? -result : result;
+}
+
+FixedTime TimeBase::nanoseconds(const FixedTime& samples) const {
+    FixedTime magnitude = samples.whole < 0 ? -samples : samples;
+    uint64_t whole = static_cast<uint64_t>(magnitude.whole);
+
+    // In units of 2^-64 nanoseconds: each part of the samples times each
+    // part of the nanoseconds per sample
+    Wide product = multiply(whole, nsPerSampleFraction);
+    product.high += whole * nsPerSample;
+    uint64_t fraction = magnitude.fraction * nsPerSample;
+    add(product, Wide{ fraction >> 32, fraction << 32 });
+    add(product, shiftDown(multiply(magnitude.fraction, nsPerSampleFraction)));
+
+    FixedTime result = toFixed(product);
+    return samples.whole < 0 ? -result : result;
+}
+
+uint64_t TimeBase::nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * NS_PER_SECOND + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+} // namespace aes67
@@ -0,0 +1,81 @@
+// TimeBase.h
+#pragma once
+
+#include <cstdint>
+
+namespace aes67 {
+
+// A count of samples or nanoseconds in 64.32 fixed point: a signed whole
+// part and a 32-bit fraction, so positions keep their sub-sample phase and
+// repeated steps add up exactly.
+struct FixedTime {
+    int64_t whole;
+    uint32_t fraction;      // In units of 2^-32
+
+    FixedTime() : whole(0), fraction(0) {}
+    explicit FixedTime(int64_t whole, uint32_t fraction = 0) : whole(whole), fraction(fraction) {}
+
+    int64_t rounded() const { return whole + (fraction >> 31); }
+    int64_t ceiling() const { return whole + (fraction != 0); }
+    double toDouble() const { return static_cast<double>(whole) + fraction / 4294967296.0; }
+
+    FixedTime& operator+=(const FixedTime& other) {
+        uint32_t sum = fraction + other.fraction;
+        whole += other.whole + (sum < fraction);
+        fraction = sum;
+        return *this;
+    }
+    FixedTime& operator-=(const FixedTime& other) {
+        whole -= other.whole + (fraction < other.fraction);
+        fraction -= other.fraction;
+        return *this;
+    }
+    FixedTime operator-() const { return FixedTime() - *this; }
+
+    friend FixedTime operator+(FixedTime a, const FixedTime& b) { return a += b; }
+    friend FixedTime operator-(FixedTime a, const FixedTime& b) { return a -= b; }
+    friend bool operator<(const FixedTime& a, const FixedTime& b) {
+        return a.whole < b.whole || (a.whole == b.whole && a.fraction < b.fraction);
+    }
+    friend bool operator==(const FixedTime& a, const FixedTime& b) {
+        return a.whole == b.whole && a.fraction == b.fraction;
+    }
+};
+
+// Converts between nanoseconds and samples at one rate.
+//
+// The rate and its inverse are held as fixed-point reciprocals, 96 and 64
+// fractional bits, worked out once when the rate is set. A conversion is
+// then a few 32x32-bit multiplies and no division, exact to well under a
+// nanosecond and a millionth of a sample across the whole PTP epoch, and
+// just as fast on the 32-bit ARM norns runs on.
+//
+// Local time is CLOCK_MONOTONIC in nanoseconds everywhere: the reactor,
+// JACK's cycle times and PTPSync all use it, so times from any of them can
+// be compared and converted without mixing clocks.
+class TimeBase {
+public:
+    explicit TimeBase(uint32_t sampleRate = 48000);
+
+    void setSampleRate(uint32_t rate);
+    uint32_t getSampleRate() const { return sampleRate; }
+
+    // Samples in ns nanoseconds
+    FixedTime samples(int64_t ns) const;
+
+    // Nanoseconds in a number of samples
+    FixedTime nanoseconds(const FixedTime& samples) const;
+    FixedTime nanoseconds(int64_t samples) const { return nanoseconds(FixedTime(samples)); }
+
+    // CLOCK_MONOTONIC now
+    static uint64_t nowNs();
+
+private:
+    uint32_t sampleRate;
+    uint64_t samplesPerNsHigh;  // rate / 10^9, bits 2^-1 to 2^-64
+    uint32_t samplesPerNsLow;   // Bits 2^-65 to 2^-96
+    uint64_t nsPerSample;       // 10^9 / rate, whole part
+    uint64_t nsPerSampleFraction;   // Bits 2^-1 to 2^-64
+};
+
+} // namespace aes67
@@ -0,0 +1,378 @@
+// Tracer.cpp
+#include "Tracer.h"
+#include "Logger.h"
+#include "Realtime.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/prctl.h>
+
+namespace aes67 {
+
+constexpr bool Tracer::enabled;
+constexpr size_t Tracer::RING_EVENTS;
+constexpr size_t Tracer::MAX_THREADS;
+
+namespace {
+
+// How often the dump thread checks for a request
+constexpr auto POLL_INTERVAL = std::chrono::milliseconds(100);
+
+enum EventType : uint32_t {
+    EVENT_COMPLETE = 0,     // value is the duration in ticks
+    EVENT_INSTANT,
+    EVENT_COUNTER
+};
+
+// Each field is written by the owning thread only. seq is the event's ring
+// position plus one once it is complete, and 0 while it is being rewritten,
+// so the dump thread can tell a whole event from one being overwritten.
+struct Event {
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> time;
+    std::atomic<int64_t> value;
+    std::atomic<const char*> name;
+    std::atomic<uint32_t> type;
+};
+
+struct Ring {
+    std::atomic<bool> claimed;
+    std::atomic<size_t> head;           // Events written so far
+    std::atomic<bool> named;            // name holds the owner's thread name
+    char name[16];
+    Event events[Tracer::RING_EVENTS];
+};
+
+// Allocated once by start() and never freed: threads may still be writing
+std::atomic<Ring*> rings{nullptr};
+std::atomic<uint64_t> unclaimed{0};     // Events from threads with no ring
+
+std::atomic<bool> running{false};
+std::atomic<bool> dumpRequested{false};
+std::thread dumper;
+std::mutex dumperMutex;
+std::condition_variable dumperWake;
+std::mutex controlMutex;
+
+// Dump thread settings
+std::string dumpPrefix;
+uint64_t windowNs = 0;
+unsigned dumpCount = 0;
+
+// Ticks and nanoseconds at start(), for converting event times
+uint64_t startTicks = 0;
+uint64_t startNs = 0;
+
+// The calling thread's ring; threads keep their ring for the life of the
+// process so the trace of a thread that exited still shows
+struct RingHandle {
+    Ring* ring = nullptr;
+    bool attached = false;
+};
+
+thread_local RingHandle handle;
+
+Ring* threadRing() {
+    if (!handle.attached) {
+        Ring* all = rings.load(std::memory_order_acquire);
+        if (!all) {
+            return nullptr;
+        }
+        handle.attached = true;
+
+        for (size_t i = 0; i < Tracer::MAX_THREADS; i++) {
+            bool expected = false;
+            if (all[i].claimed.compare_exchange_strong(expected, true)) {
+                // Copied now, the thread may be gone by the dump
+                if (prctl(PR_GET_NAME, all[i].name, 0, 0, 0) == 0) {
+                    all[i].name[sizeof(all[i].name) - 1] = '\0';
+                    all[i].named.store(true, std::memory_order_release);
+                }
+                handle.ring = &all[i];
+                break;
+            }
+        }
+    }
+    return handle.ring;
+}
+
+void record(EventType type, const char* name, uint64_t time, int64_t value) {
+    if (!running.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    Ring* ring = threadRing();
+    if (!ring) {
+        unclaimed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Mark the slot as being rewritten before touching its fields
+    const size_t head = ring->head.load(std::memory_order_relaxed);
+    Event& event = ring->events[head % Tracer::RING_EVENTS];
+    event.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    event.time.store(time, std::memory_order_relaxed);
+    event.value.store(value, std::memory_order_relaxed);
+    event.name.store(name, std::memory_order_relaxed);
+    event.type.store(type, std::memory_order_relaxed);
+
+    event.seq.store(head + 1, std::memory_order_release);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+// A copy of one event taken by the dump thread, times in nanoseconds
+struct Snapshot {
+    uint64_t time;
+    int64_t value;
+    const char* name;
+    uint32_t type;
+    int thread;
+};
+
+// Maps ticks to monotonic nanoseconds by the rate measured since start()
+struct Timebase {
+    uint64_t ticks;
+    uint64_t ns;
+    double nsPerTick;
+
+    uint64_t toNs(uint64_t at) const {
+        return ns + static_cast<uint64_t>(static_cast<double>(static_cast<int64_t>(at - ticks)) * nsPerTick);
+    }
+};
+
+void collect(Ring& ring, int thread, const Timebase& timebase, uint64_t since, std::vector<Snapshot>& out) {
+    const size_t head = ring.head.load(std::memory_order_acquire);
+    const size_t first = head > Tracer::RING_EVENTS ? head - Tracer::RING_EVENTS : 0;
+
+    for (size_t position = first; position < head; position++) {
+        const Event& event = ring.events[position % Tracer::RING_EVENTS];
+        if (event.seq.load(std::memory_order_acquire) != position + 1) {
+            continue;   // Already overwritten
+        }
+
+        Snapshot copy;
+        copy.time = event.time.load(std::memory_order_relaxed);
+        copy.value = event.value.load(std::memory_order_relaxed);
+        copy.name = event.name.load(std::memory_order_relaxed);
+        copy.type = event.type.load(std::memory_order_relaxed);
+        copy.thread = thread;
+
+        // Overwritten while we copied it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (event.seq.load(std::memory_order_relaxed) != position + 1) {
+            continue;
+        }
+
+        uint64_t end = copy.time;
+        if (copy.type == EVENT_COMPLETE) {
+            end += copy.value;
+            copy.value = static_cast<int64_t>(copy.value * timebase.nsPerTick);
+        }
+        copy.time = timebase.toNs(copy.time);
+        if (timebase.toNs(end) >= since) {
+            out.push_back(copy);
+        }
+    }
+}
+
+// Names come from the source and from thread names; quote what JSON needs
+void writeString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+            fputc(*c, file);
+        } else if (static_cast<unsigned char>(*c) >= 0x20) {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+void dump() {
+    Ring* all = rings.load(std::memory_order_acquire);
+    const uint64_t now = Tracer::now();
+    const uint64_t nowTicks = Tracer::ticks();
+    const uint64_t since = now > windowNs ? now - windowNs : 0;
+
+    Timebase timebase;
+    timebase.ticks = startTicks;
+    timebase.ns = startNs;
+    timebase.nsPerTick = nowTicks > startTicks
+        ? static_cast<double>(now - startNs) / static_cast<double>(nowTicks - startTicks) : 1.0;
+
+    std::vector<Snapshot> events;
+    events.reserve(Tracer::RING_EVENTS);
+    for (size_t i = 0; i < Tracer::MAX_THREADS; i++) {
+        if (all[i].claimed.load(std::memory_order_acquire)) {
+            collect(all[i], static_cast<int>(i + 1), timebase, since, events);
+        }
+    }
+    std::sort(events.begin(), events.end(), [](const Snapshot& a, const Snapshot& b) {
+        return a.time < b.time;
+    });
+
+    const std::string path = dumpPrefix + "-" + std::to_string(++dumpCount) + ".json";
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        AES67_LOG_ERROR("Failed to write trace %s: %m", path.c_str());
+        return;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+
+    // Thread names as they were when each thread first traced
+    bool first = true;
+    for (size_t i = 0; i < Tracer::MAX_THREADS; i++) {
+        if (!all[i].claimed.load(std::memory_order_acquire)) {
+            continue;
+        }
+        char name[16];
+        if (all[i].named.load(std::memory_order_acquire)) {
+            memcpy(name, all[i].name, sizeof(name));
+        } else {
+            snprintf(name, sizeof(name), "thread %zu", i + 1);
+        }
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":",
+                first ? "" : ",\n", i + 1);
+        writeString(file, name);
+        fputs("}}", file);
+        first = false;
+    }
+
+    // Microseconds from the start of the window
+    for (const Snapshot& event : events) {
+        fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+        writeString(file, event.name);
+        const double ts = (static_cast<double>(event.time) - static_cast<double>(since)) / 1000.0;
+
+        switch (event.type) {
+            case EVENT_COMPLETE:
+                fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f", ts, event.value / 1000.0);
+                break;
+            case EVENT_INSTANT:
+                fprintf(file, ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"args\":{\"value\":%lld}",
+                        ts, static_cast<long long>(event.value));
+                break;
+            default:
+                fprintf(file, ",\"ph\":\"C\",\"ts\":%.3f,\"args\":{\"value\":%lld}",
+                        ts, static_cast<long long>(event.value));
+                break;
+        }
+        fprintf(file, ",\"pid\":1,\"tid\":%d}", event.thread);
+        first = false;
+    }
+
+    fputs("\n]}\n", file);
+    if (fclose(file) != 0) {
+        AES67_LOG_ERROR("Failed to write trace %s: %m", path.c_str());
+        return;
+    }
+
+    uint64_t lost = unclaimed.load(std::memory_order_relaxed);
+    if (lost > 0) {
+        AES67_LOG_WARN("Trace: %llu events dropped, no ring free", static_cast<unsigned long long>(lost));
+    }
+    AES67_LOG_INFO("Trace written to %s (%zu events)", path.c_str(), events.size());
+}
+
+void dumpLoop() {
+    realtime::configureBackgroundThread("aes67-trace");
+
+    std::unique_lock<std::mutex> lock(dumperMutex);
+    while (running) {
+        dumperWake.wait_for(lock, POLL_INTERVAL);
+        if (dumpRequested.exchange(false)) {
+            dump();
+        }
+    }
+}
+
+} // namespace
+
+bool Tracer::start(const std::string& prefix, double windowSeconds) {
+    std::lock_guard<std::mutex> lock(controlMutex);
+    if (running) {
+        return true;
+    }
+    if (windowSeconds <= 0.0) {
+        std::cerr << "Invalid trace window: " << windowSeconds << " seconds" << std::endl;
+        return false;
+    }
+
+    // Value-initialized: every ring unclaimed and every event empty
+    if (!rings.load(std::memory_order_relaxed)) {
+        rings.store(new Ring[MAX_THREADS](), std::memory_order_release);
+    }
+
+    dumpPrefix = prefix;
+    windowNs = static_cast<uint64_t>(windowSeconds * 1e9);
+    startNs = now();
+    startTicks = ticks();
+    running = true;
+    dumper = std::thread(dumpLoop);
+
+    static bool registered = false;
+    if (!registered) {
+        registered = true;
+        std::atexit([] { Tracer::stop(); });
+    }
+    return true;
+}
+
+void Tracer::stop() {
+    std::lock_guard<std::mutex> lock(controlMutex);
+    {
+        std::lock_guard<std::mutex> dumperLock(dumperMutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+
+    dumperWake.notify_all();
+    if (dumper.joinable()) {
+        dumper.join();
+    }
+}
+
+bool Tracer::isRunning() {
+    return running.load(std::memory_order_relaxed);
+}
+
+void Tracer::requestDump() {
+    // Only an atomic store: the dump thread notices within POLL_INTERVAL
+    dumpRequested.store(true, std::memory_order_relaxed);
+}
+
+uint64_t Tracer::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void Tracer::complete(const char* name, uint64_t startTicks) {
+    const uint64_t end = ticks();
+    record(EVENT_COMPLETE, name, startTicks, static_cast<int64_t>(end - startTicks));
+}
+
+void Tracer::instant(const char* name, int64_t value) {
+    record(EVENT_INSTANT, name, ticks(), value);
+}
+
+void Tracer::counter(const char* name, int64_t value) {
+    record(EVENT_COUNTER, name, ticks(), value);
+}
+
+} // namespace aes67
@@ -0,0 +1,98 @@
+// Tracer.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace aes67 {
+
+// Event tracing for glitch diagnosis, exported in the Chrome trace format
+// that Perfetto and chrome://tracing load.
+//
+// Builds configured with -DAES67_TRACE=ON record fixed-size binary events
+// into a ring per thread: a timestamp, a static name and one value, with no
+// lock, allocation or syscall. Timestamps are CPU counter ticks, converted
+// to CLOCK_MONOTONIC when dumped. The rings hold the recent past of each
+// thread; a dump, on request or after an xrun, writes the last few seconds
+// of all of them on one timeline from a background thread. In other builds
+// the trace macros compile to nothing.
+class Tracer {
+public:
+#ifdef AES67_TRACE
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    // Events per thread ring, a few seconds of a busy thread
+    static constexpr size_t RING_EVENTS = 32768;
+
+    // Threads that can trace at once, each with its own ring
+    static constexpr size_t MAX_THREADS = 8;
+
+    // Allocate the rings and start the dump thread. Each dump writes the
+    // last windowSeconds to <prefix>-<n>.json.
+    static bool start(const std::string& prefix, double windowSeconds);
+    static void stop();
+    static bool isRunning();
+
+    // Ask the dump thread for a dump; safe from signal handlers and
+    // realtime threads. Requests made while one is pending are merged.
+    static void requestDump();
+
+    // Monotonic nanoseconds, what the trace is dumped in
+    static uint64_t now();
+
+    // The event timebase: a constant-rate counter read without a syscall
+    // where the CPU has one, else now()
+    static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t value;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+        return value;
+#else
+        return now();
+#endif
+    }
+
+    // Names must be string literals or otherwise outlive the tracer
+    static void complete(const char* name, uint64_t startTicks);   // Span from startTicks to now
+    static void instant(const char* name, int64_t value);
+    static void counter(const char* name, int64_t value);
+};
+
+// Records the enclosing scope as one complete event
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name(name), start(Tracer::ticks()) {}
+    ~TraceScope() { Tracer::complete(name, start); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+} // namespace aes67
+
+#define AES67_TRACE_JOIN2(a, b) a##b
+#define AES67_TRACE_JOIN(a, b) AES67_TRACE_JOIN2(a, b)
+
+// Without AES67_TRACE the arguments are not evaluated
+#ifdef AES67_TRACE
+#define AES67_TRACE_SCOPE(name)          ::aes67::TraceScope AES67_TRACE_JOIN(aes67TraceScope, __LINE__)(name)
+#define AES67_TRACE_INSTANT(name, value) ::aes67::Tracer::instant(name, value)
+#define AES67_TRACE_COUNTER(name, value) ::aes67::Tracer::counter(name, value)
+#else
+#define AES67_TRACE_SCOPE(name)          do {} while (0)
+#define AES67_TRACE_INSTANT(name, value) do {} while (0)
+#define AES67_TRACE_COUNTER(name, value) do {} while (0)
+#endif
@@ -0,0 +1,478 @@
+// UringEngine.cpp
+#include "UringEngine.h"
+#include "Logger.h"
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+
+// Multishot receive and fixed-buffer SEND_ZC both arrived in Linux 6.0
+#if defined(__NR_io_uring_setup) && defined(IORING_RECV_MULTISHOT) && defined(IORING_RECVSEND_FIXED_BUF)
+
+namespace aes67 {
+
+constexpr unsigned UringEngine::SQ_ENTRIES;
+constexpr unsigned UringEngine::CQ_ENTRIES;
+constexpr unsigned UringEngine::RECV_BUFFERS;
+constexpr unsigned UringEngine::SEND_BUFFERS;
+
+// What a completion belongs to, in the top byte of its user data
+static constexpr uint64_t OP_RECV = 1ULL << 56;
+static constexpr uint64_t OP_SEND = 2ULL << 56;
+static constexpr uint64_t OP_CANCEL = 3ULL << 56;
+static constexpr uint64_t OP_MASK = 0xFFULL << 56;
+
+// Receive buffers come from group 0
+static constexpr uint16_t BUFFER_GROUP = 0;
+
+static int uringSetup(unsigned entries, struct io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags,
+                      const void* arg, size_t argSize) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+static int uringRegister(int fd, unsigned opcode, const void* arg, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+std::unique_ptr<IOEngine> UringEngine::create() {
+    std::unique_ptr<UringEngine> engine(new UringEngine());
+    if (!engine->setup()) {
+        return nullptr;
+    }
+    return std::unique_ptr<IOEngine>(engine.release());
+}
+
+UringEngine::UringEngine()
+    : ringFd(-1), ringMem(MAP_FAILED), ringSize(0),
+      sqHead(nullptr), sqTail(nullptr), sqArray(nullptr), sqMask(0),
+      sqes(static_cast<struct io_uring_sqe*>(MAP_FAILED)), sqesSize(0),
+      sqLocalTail(0), sqSubmitted(0),
+      cqHead(nullptr), cqTail(nullptr), cqMask(0), cqes(nullptr),
+      bufRing(static_cast<struct io_uring_buf*>(MAP_FAILED)), bufRingSize(0), bufTail(0),
+      recvStorage(RECV_BUFFERS * BUFFER_SIZE),
+      sendStorage(SEND_BUFFERS * BUFFER_SIZE), sendDest(SEND_BUFFERS),
+      rearm(false), sendErrors(0), overruns(0)
+{
+    sendFree.reserve(SEND_BUFFERS);
+    for (uint32_t i = SEND_BUFFERS; i > 0; i--) {
+        sendFree.push_back(i - 1);
+    }
+    sockets.reserve(8);
+}
+
+UringEngine::~UringEngine() {
+    // Closing the ring cancels outstanding requests and drops registrations
+    if (ringFd >= 0) {
+        close(ringFd);
+    }
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, sqesSize);
+    }
+    if (ringMem != MAP_FAILED) {
+        munmap(ringMem, ringSize);
+    }
+    if (bufRing != MAP_FAILED) {
+        munmap(bufRing, bufRingSize);
+    }
+}
+
+bool UringEngine::setup() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = CQ_ENTRIES;
+
+    // Fails on kernels without io_uring or where it is disabled by sysctl
+    ringFd = uringSetup(SQ_ENTRIES, &params);
+    if (ringFd < 0) {
+        return false;
+    }
+
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        return false;
+    }
+
+    // Only the opcodes are probed; multishot receive came in the same release
+    std::vector<uint8_t> probeStorage(sizeof(struct io_uring_probe) +
+                                      IORING_OP_LAST * sizeof(struct io_uring_probe_op), 0);
+    struct io_uring_probe* probe = reinterpret_cast<struct io_uring_probe*>(probeStorage.data());
+    if (uringRegister(ringFd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0 ||
+        probe->last_op < IORING_OP_SEND_ZC ||
+        !(probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED) ||
+        !(probe->ops[IORING_OP_RECV].flags & IO_URING_OP_SUPPORTED)) {
+        return false;
+    }
+
+    // Submission and completion rings share one mapping
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ringSize = sqSize > cqSize ? sqSize : cqSize;
+    ringMem = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ringFd, IORING_OFF_SQ_RING);
+    if (ringMem == MAP_FAILED) {
+        std::cerr << "Failed to map io_uring rings: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    uint8_t* ring = static_cast<uint8_t*>(ringMem);
+    sqHead = reinterpret_cast<unsigned*>(ring + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(ring + params.sq_off.tail);
+    sqArray = reinterpret_cast<unsigned*>(ring + params.sq_off.array);
+    sqMask = *reinterpret_cast<unsigned*>(ring + params.sq_off.ring_mask);
+    cqHead = reinterpret_cast<unsigned*>(ring + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(ring + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(ring + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(ring + params.cq_off.cqes);
+
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = static_cast<struct io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED) {
+        std::cerr << "Failed to map io_uring entries: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Slots map one to one onto entries
+    for (unsigned i = 0; i < params.sq_entries; i++) {
+        sqArray[i] = i;
+    }
+    sqLocalTail = sqSubmitted = *sqTail;
+
+    // Provided-buffer ring: the kernel takes a buffer per received packet
+    bufRingSize = RECV_BUFFERS * sizeof(struct io_uring_buf);
+    bufRing = static_cast<struct io_uring_buf*>(mmap(nullptr, bufRingSize, PROT_READ | PROT_WRITE,
+                                                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (bufRing == MAP_FAILED) {
+        std::cerr << "Failed to allocate receive buffer ring: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufRing);
+    reg.ring_entries = RECV_BUFFERS;
+    reg.bgid = BUFFER_GROUP;
+    if (uringRegister(ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return false;
+    }
+
+    bufTail = 0;
+    for (uint32_t i = 0; i < RECV_BUFFERS; i++) {
+        provideBuffer(i);
+    }
+
+    // Transmit buffers, pinned once instead of on every send
+    struct iovec iov;
+    iov.iov_base = sendStorage.data();
+    iov.iov_len = sendStorage.size();
+    if (uringRegister(ringFd, IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+        std::cerr << "Failed to register transmit buffers: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool UringEngine::addSocket(int fd, int tag) {
+    size_t index = sockets.size();
+    for (size_t i = 0; i < sockets.size(); i++) {
+        if (!sockets[i].active) {
+            index = i;
+            break;
+        }
+    }
+    if (index == sockets.size()) {
+        sockets.push_back(Socket{-1, 0, 0, false, false});
+    }
+
+    Socket& socket = sockets[index];
+    socket.fd = fd;
+    socket.tag = tag;
+    socket.generation = (socket.generation + 1) & 0xFFFFFF;
+    socket.active = true;
+    socket.armed = false;
+
+    armReceive(index);
+    return submit(0, 0);
+}
+
+void UringEngine::removeSocket(int fd) {
+    for (size_t i = 0; i < sockets.size(); i++) {
+        Socket& socket = sockets[i];
+        if (!socket.active || socket.fd != fd) {
+            continue;
+        }
+
+        // Stop the receive; completions still queued for it are dropped
+        if (socket.armed) {
+            struct io_uring_sqe* sqe = getSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = OP_RECV | (static_cast<uint64_t>(socket.generation) << 32) | i;
+            sqe->user_data = OP_CANCEL;
+        }
+
+        socket.active = false;
+        socket.armed = false;
+        socket.fd = -1;
+    }
+
+    submit(0, 0);
+}
+
+void UringEngine::armReceive(size_t index) {
+    Socket& socket = sockets[index];
+
+    // One request keeps completing a packet per provided buffer
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = socket.fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = OP_RECV | (static_cast<uint64_t>(socket.generation) << 32) | index;
+
+    socket.armed = true;
+}
+
+bool UringEngine::completionsReady() const {
+    return *cqHead != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+}
+
+bool UringEngine::wait(int64_t timeoutUs) {
+    if (completionsReady()) {
+        return true;
+    }
+
+    // Buffers have all come back by now, so a stopped receive can restart
+    if (rearm) {
+        rearm = false;
+        for (size_t i = 0; i < sockets.size(); i++) {
+            if (sockets[i].active && !sockets[i].armed) {
+                armReceive(i);
+            }
+        }
+    }
+
+    submit(1, timeoutUs);
+    return completionsReady();
+}
+
+bool UringEngine::next(Packet& packet) {
+    while (completionsReady()) {
+        unsigned head = *cqHead;
+        const struct io_uring_cqe* cqe = &cqes[head & cqMask];
+        const uint64_t data = cqe->user_data;
+        const int result = cqe->res;
+        const unsigned flags = cqe->flags;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+        const uint64_t op = data & OP_MASK;
+        if (op == OP_SEND) {
+            completeSend(data, result, flags);
+            continue;
+        }
+        if (op != OP_RECV) {
+            continue;
+        }
+
+        const size_t index = data & 0xFFFFFFFF;
+        const uint32_t generation = (data >> 32) & 0xFFFFFF;
+        const bool current = index < sockets.size() && sockets[index].active &&
+                             sockets[index].generation == generation;
+
+        // The kernel ended the multishot receive (out of buffers, or an error)
+        if (!(flags & IORING_CQE_F_MORE) && current) {
+            sockets[index].armed = false;
+            rearm = true;
+            if (result == -ENOBUFS) {
+                overruns++;
+            } else if (result < 0 && result != -ECANCELED) {
+                AES67_LOG_ERROR("Receive failed: %s", strerror(-result));
+            }
+        }
+
+        if (!(flags & IORING_CQE_F_BUFFER)) {
+            continue;
+        }
+
+        const uint32_t id = flags >> IORING_CQE_BUFFER_SHIFT;
+        if (result <= 0 || !current) {
+            provideBuffer(id);
+            continue;
+        }
+
+        packet.tag = sockets[index].tag;
+        packet.data = recvStorage.data() + id * BUFFER_SIZE;
+        packet.size = static_cast<size_t>(result);
+        packet.buffer = id;
+        return true;
+    }
+
+    return false;
+}
+
+void UringEngine::release(const Packet& packet) {
+    provideBuffer(packet.buffer);
+}
+
+void UringEngine::provideBuffer(uint32_t id) {
+    struct io_uring_buf* buf = &bufRing[bufTail & (RECV_BUFFERS - 1)];
+    buf->addr = reinterpret_cast<uint64_t>(recvStorage.data() + id * BUFFER_SIZE);
+    buf->len = BUFFER_SIZE;
+    buf->bid = static_cast<uint16_t>(id);
+    bufTail++;
+
+    // The ring tail overlays the first entry's reserved field. The header's
+    // io_uring_buf_ring cannot be used from C++, where its empty
+    // flexible-array wrapper shifts bufs by a word.
+    __atomic_store_n(&bufRing[0].resv, bufTail, __ATOMIC_RELEASE);
+}
+
+bool UringEngine::send(int fd, const void* data, size_t size, const struct sockaddr_in* dest) {
+    if (size > BUFFER_SIZE) {
+        return false;
+    }
+
+    reapSends();
+
+    // Every buffer still waiting on the kernel: send directly rather than wait
+    if (sendFree.empty()) {
+        ssize_t sent = sendto(fd, data, size, MSG_DONTWAIT,
+                              reinterpret_cast<const struct sockaddr*>(dest), dest ? sizeof(*dest) : 0);
+        return sent == static_cast<ssize_t>(size);
+    }
+
+    uint32_t slot = sendFree.back();
+    sendFree.pop_back();
+
+    uint8_t* buffer = sendStorage.data() + slot * BUFFER_SIZE;
+    memcpy(buffer, data, size);
+
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_SEND_ZC;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = static_cast<uint32_t>(size);
+    sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+    sqe->buf_index = 0;
+    sqe->user_data = OP_SEND | slot;
+
+    // The address must outlive the request, so it is kept with the buffer
+    if (dest) {
+        sendDest[slot] = *dest;
+        sqe->addr2 = reinterpret_cast<uint64_t>(&sendDest[slot]);
+        sqe->addr_len = sizeof(struct sockaddr_in);
+    }
+
+    return submit(0, 0);
+}
+
+void UringEngine::reapSends() {
+    // Completions are in order; stop at the first one next() has to hand out
+    while (completionsReady()) {
+        unsigned head = *cqHead;
+        const struct io_uring_cqe* cqe = &cqes[head & cqMask];
+        if ((cqe->user_data & OP_MASK) == OP_RECV) {
+            break;
+        }
+
+        const uint64_t data = cqe->user_data;
+        const int result = cqe->res;
+        const unsigned flags = cqe->flags;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+        if ((data & OP_MASK) == OP_SEND) {
+            completeSend(data, result, flags);
+        }
+    }
+}
+
+void UringEngine::completeSend(uint64_t data, int result, unsigned flags) {
+    if (!(flags & IORING_CQE_F_NOTIF) && result < 0) {
+        sendErrors++;
+    }
+
+    // A zero-copy send completes twice; the buffer is free after the last
+    if (!(flags & IORING_CQE_F_MORE)) {
+        sendFree.push_back(static_cast<uint32_t>(data & 0xFFFFFFFF));
+    }
+}
+
+struct io_uring_sqe* UringEngine::getSqe() {
+    if (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) > sqMask) {
+        submit(0, 0);
+    }
+
+    struct io_uring_sqe* sqe = &sqes[sqLocalTail & sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqLocalTail++;
+    return sqe;
+}
+
+bool UringEngine::submit(unsigned waitFor, int64_t timeoutUs) {
+    unsigned toSubmit = sqLocalTail - sqSubmitted;
+    if (toSubmit == 0 && waitFor == 0) {
+        return true;
+    }
+
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+
+    unsigned flags = 0;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec timeout;
+    const void* argp = nullptr;
+    size_t argSize = 0;
+
+    if (waitFor > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeoutUs >= 0) {
+            timeout.tv_sec = timeoutUs / 1000000;
+            timeout.tv_nsec = (timeoutUs % 1000000) * 1000;
+            memset(&arg, 0, sizeof(arg));
+            arg.ts = reinterpret_cast<uint64_t>(&timeout);
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            argSize = sizeof(arg);
+        }
+    }
+
+    int result = uringEnter(ringFd, toSubmit, waitFor, flags, argp, argSize);
+    if (result < 0) {
+        if (errno != ETIME && errno != EINTR && errno != EBUSY) {
+            AES67_LOG_ERROR("io_uring_enter failed: %s", strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    sqSubmitted += static_cast<unsigned>(result);
+    return true;
+}
+
+} // namespace aes67
+
+#else
+
+namespace aes67 {
+
+std::unique_ptr<IOEngine> UringEngine::create() {
+    // Built against kernel headers older than 6.0
+    return nullptr;
+}
+
+} // namespace aes67
+
+#endif
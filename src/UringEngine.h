@@ -0,0 +1,109 @@
+// UringEngine.h
+#pragma once
+
+#include "IOEngine.h"
+#include <vector>
+#include <atomic>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf;
+
+namespace aes67 {
+
+// IOEngine backend on io_uring, driven through the raw syscalls.
+//
+// Every socket has a multishot receive armed that picks buffers from a
+// shared provided-buffer ring, so the kernel completes packets into the
+// completion queue with no syscall per packet and wait() only enters the
+// kernel once the queue is empty. Transmit copies into buffers registered
+// with the ring and sends them with SEND_ZC, which skips pinning the pages
+// on every send.
+class UringEngine : public IOEngine {
+public:
+    // Null if the kernel lacks what this backend needs
+    static std::unique_ptr<IOEngine> create();
+
+    ~UringEngine() override;
+
+    bool addSocket(int fd, int tag) override;
+    void removeSocket(int fd) override;
+
+    bool wait(int64_t timeoutUs) override;
+    bool next(Packet& packet) override;
+    void release(const Packet& packet) override;
+
+    bool send(int fd, const void* data, size_t size, const struct sockaddr_in* dest = nullptr) override;
+
+    const char* getName() const override { return "io_uring"; }
+    uint64_t getSendErrors() const override { return sendErrors; }
+    uint64_t getOverruns() const override { return overruns; }
+
+private:
+    static constexpr unsigned SQ_ENTRIES = 64;
+    static constexpr unsigned CQ_ENTRIES = 1024;
+    static constexpr unsigned RECV_BUFFERS = 256;   // Power of two
+    static constexpr unsigned SEND_BUFFERS = 64;
+
+    struct Socket {
+        int fd;
+        int tag;
+        uint32_t generation;    // Tells completions of a reused slot apart
+        bool active;
+        bool armed;             // Multishot receive in flight
+    };
+
+    UringEngine();
+    bool setup();
+
+    int ringFd;
+
+    // Rings shared with the kernel
+    void* ringMem;
+    size_t ringSize;
+
+    // Submission queue
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqArray;
+    unsigned sqMask;
+    struct io_uring_sqe* sqes;
+    size_t sqesSize;
+    unsigned sqLocalTail;
+    unsigned sqSubmitted;
+
+    // Completion queue
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe* cqes;
+
+    // Provided receive buffers
+    struct io_uring_buf* bufRing;
+    size_t bufRingSize;
+    uint16_t bufTail;
+    std::vector<uint8_t> recvStorage;
+
+    // Registered transmit buffers
+    std::vector<uint8_t> sendStorage;
+    std::vector<struct sockaddr_in> sendDest;
+    std::vector<uint32_t> sendFree;
+
+    std::vector<Socket> sockets;
+    bool rearm;                 // A receive stopped and needs arming again
+
+    // Statistics
+    std::atomic<uint64_t> sendErrors;
+    std::atomic<uint64_t> overruns;
+
+    // Helper functions
+    struct io_uring_sqe* getSqe();
+    bool submit(unsigned waitFor, int64_t timeoutUs);
+    void armReceive(size_t index);
+    void provideBuffer(uint32_t id);
+    void completeSend(uint64_t data, int result, unsigned flags);
+    void reapSends();
+    bool completionsReady() const;
+};
+
+} // namespace aes67
@@ -1,17 +1,53 @@
 // main.cpp Phase 2
 #include "AES67Bridge.h"
+#include "OSCServer.h"
+#include "IOEngine.h"
+#include "Logger.h"
+#include "Tracer.h"
 #include <iostream>
 #include <csignal>
 #include <unistd.h>
 #include <getopt.h>
+#include <cstdio>
+
+// Long-only options
+enum {
+    OPT_NET_PRIORITY = 256,
+    OPT_NET_CPU,
+    OPT_PTP_PRIORITY,
+    OPT_PTP_CPU,
+    OPT_MLOCK,
+    OPT_SESSION,
+    OPT_SESSION_TIMEOUT,
+    OPT_SDP,
+    OPT_CHANNELS,
+    OPT_OSC_PORT,
+    OPT_MIN_LATENCY,
+    OPT_MAX_LATENCY,
+    OPT_LINK_OFFSET,
+    OPT_IO_BACKEND,
+    OPT_PERF,
+    OPT_TRACE,
+    OPT_TRACE_WINDOW,
+    OPT_PTP_MASTER,
+    OPT_PTP_MASTER_PRIORITY,
+    OPT_PTP_DOMAIN,
+    OPT_PTP_TRANSPORT,
+    OPT_PTP_STATE
+};
 
 // Global bridge instance for signal handling
 aes67::AES67Bridge* bridge = nullptr;
+aes67::OSCServer* oscServer = nullptr;
 
 // Signal handler
 void signalHandler(int signum) {
     std::cout << "\nInterrupt signal (" << signum << ") received.\n";
     
+    if (oscServer) {
+        oscServer->stop();
+    }
+    
     if (bridge) {
         std::cout << "Stopping AES67 bridge...\n";
         bridge->stopNetworking();
@@ -19,9 +55,22 @@ void signalHandler(int signum) {
         bridge->cleanup();
     }
     
+    // In RT check builds any violation in the JACK callback after warm-up fails the run
+    if (aes67::rtcheck::enabled) {
+        aes67::rtcheck::printReport(std::cerr);
+        if (aes67::rtcheck::getReport().total() > 0) {
+            exit(3);
+        }
+    }
+    
     exit(signum);
 }
 
+// SIGUSR1 asks for a trace dump
+void traceSignalHandler(int) {
+    aes67::Tracer::requestDump();
+}
+
 void printUsage(const char* programName) {
     std::cout << "Usage: " << programName << " [options]\n"
               << "Options:\n"
@@ -30,10 +79,48 @@ void printUsage(const char* programName) {
               << "  -a, --address <address>    Set multicast address\n"
               << "  -p, --port <port>          Set port number\n"
               << "  -i, --interface <name>     Set network interface\n"
+              << "  -A, --secondary-address <address>\n"
+              << "                             Multicast address on the secondary network\n"
+              << "                             (ST 2022-7, defaults to the primary address)\n"
+              << "  -J, --secondary-interface <name>\n"
+              << "                             Interface of the secondary network (ST 2022-7)\n"
               << "  -b, --bit-depth <bits>     Set bit depth (16, 24, or 32)\n"
               << "  -t, --packet-time <us>     Set packet time in microseconds\n"
               << "                             (125, 250, 333, 1000, or 4000)\n"
               << "  -s, --start                Start networking after initialization\n"
+              << "  --session <name>           Receive the SAP-announced session with this name\n"
+              << "  --session-timeout <ms>     How long to wait for the announcement (default 35000)\n"
+              << "  --sdp <file>               Receive the stream described by an SDP file\n"
+              << "  --channels <l>,<r>         Stream channels to play on the outputs (default 1,2)\n"
+              << "  --osc-port <port>          Accept OSC control on 127.0.0.1:<port>\n"
+              << "  --min-latency <ms>         Lowest adaptive playout latency (default 0)\n"
+              << "  --max-latency <ms>         Highest adaptive playout latency (default 20, up to 70)\n"
+              << "  --link-offset <ms>         Play received audio this long after its RTP timestamp\n"
+              << "                             on the PTP timescale (default 0, play on arrival)\n"
+              << "  --net-priority <1-99>      SCHED_FIFO priority of the network thread\n"
+              << "  --net-cpu <n>              Pin the network thread to a CPU core\n"
+              << "  --ptp-priority <1-99>      PTP priority; the network thread runs at the higher one\n"
+              << "  --ptp-cpu <n>              CPU for the network thread if --net-cpu is not given\n"
+              << "  --ptp-master               Act as PTP grandmaster while no better master is present\n"
+              << "  --ptp-master-priority <0-255>\n"
+              << "                             BMCA priority1 of the grandmaster (default 128, lower wins)\n"
+              << "  --ptp-domain <0-127>       PTP domain to follow and serve (default 0)\n"
+              << "  --ptp-transport <name>     PTP over udp (IPv4, default), l2 (Ethernet) or\n"
+              << "                             gptp (802.1AS with peer delay); l2 and gptp need -i\n"
+              << "  --ptp-state <file>         Keep the PTP master and path delay in <file>, so a\n"
+              << "                             restart locks from the first Sync\n"
+              << "  --mlock                    Lock memory and prefault the stack at startup\n"
+              << "  --io-backend <name>        Network I/O: auto, io_uring or epoll (default auto)\n"
+              << "  --perf                     Count cycles, instructions and cache and branch misses\n"
+              << "                             per stage, reported when networking stops\n"
+              << "  --trace <prefix>           Record an event trace and write the recent part to\n"
+              << "                             <prefix>-<n>.json on SIGUSR1, /aes67/trace/dump or an\n"
+              << "                             xrun (builds with -DAES67_TRACE=ON)\n"
+              << "  --trace-window <s>         Seconds of trace each dump covers (default 5)\n"
+              << "  -I, --impair <spec>        Impair received packets for buffer tuning, e.g.\n"
+              << "                             seed=1,loss=0.01,ge-p=0.001,ge-r=0.3,delay=200,\n"
+              << "                             jitter=100,jitter-shape=2.5,reorder=0.01,dup=0.001,\n"
+              << "                             burst-every=5000,burst-len=3\n"
               << std::endl;
 }
 
@@ -45,14 +132,39 @@ int main(int argc, char** argv) {
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
     
+    // Network and PTP threads log through the background writer
+    aes67::Logger::start();
+    
     // Default values
     bool transmitMode = false;
     std::string address = "239.69.83.133";
     int port = 5004;
     std::string interface = "";
+    std::string secondaryAddress = "";
+    std::string secondaryInterface = "";
     int bitDepth = 24;
     int packetTime = 1000;
     bool startNetworking = false;
+    aes67::NetworkImpairment::Config impairment;
+    aes67::ThreadSettings networkThread;
+    aes67::ThreadSettings ptpThread;
+    bool lockMemory = false;
+    bool perfCounters = false;
+    bool ptpMaster = false;
+    int ptpMasterPriority = 128;
+    int ptpDomain = 0;
+    aes67::PTPProfile ptpProfile = aes67::PTP_PROFILE_UDP;
+    std::string ptpStateFile;
+    std::string tracePrefix = "";
+    double traceWindow = 5.0;
+    std::string sessionName = "";
+    int sessionTimeout = 35000;
+    std::string sdpFile = "";
+    std::vector<uint16_t> channelMap;
+    int oscPort = 0;
+    float minLatency = 0.0f;
+    float maxLatency = 20.0f;
+    float linkOffset = 0.0f;
     
     // Parse command line options
     static struct option long_options[] = {
@@ -61,16 +173,41 @@ int main(int argc, char** argv) {
         {"address",     required_argument, 0, 'a'},
         {"port",        required_argument, 0, 'p'},
         {"interface",   required_argument, 0, 'i'},
+        {"secondary-address",   required_argument, 0, 'A'},
+        {"secondary-interface", required_argument, 0, 'J'},
         {"bit-depth",   required_argument, 0, 'b'},
         {"packet-time", required_argument, 0, 't'},
         {"start",       no_argument,       0, 's'},
+        {"impair",      required_argument, 0, 'I'},
+        {"net-priority", required_argument, 0, OPT_NET_PRIORITY},
+        {"net-cpu",      required_argument, 0, OPT_NET_CPU},
+        {"ptp-priority", required_argument, 0, OPT_PTP_PRIORITY},
+        {"ptp-cpu",      required_argument, 0, OPT_PTP_CPU},
+        {"mlock",        no_argument,       0, OPT_MLOCK},
+        {"session",      required_argument, 0, OPT_SESSION},
+        {"session-timeout", required_argument, 0, OPT_SESSION_TIMEOUT},
+        {"sdp",          required_argument, 0, OPT_SDP},
+        {"channels",     required_argument, 0, OPT_CHANNELS},
+        {"osc-port",     required_argument, 0, OPT_OSC_PORT},
+        {"min-latency",  required_argument, 0, OPT_MIN_LATENCY},
+        {"max-latency",  required_argument, 0, OPT_MAX_LATENCY},
+        {"link-offset",  required_argument, 0, OPT_LINK_OFFSET},
+        {"io-backend",   required_argument, 0, OPT_IO_BACKEND},
+        {"perf",         no_argument,       0, OPT_PERF},
+        {"trace",        required_argument, 0, OPT_TRACE},
+        {"trace-window", required_argument, 0, OPT_TRACE_WINDOW},
+        {"ptp-master",   no_argument,       0, OPT_PTP_MASTER},
+        {"ptp-master-priority", required_argument, 0, OPT_PTP_MASTER_PRIORITY},
+        {"ptp-domain",   required_argument, 0, OPT_PTP_DOMAIN},
+        {"ptp-transport", required_argument, 0, OPT_PTP_TRANSPORT},
+        {"ptp-state",    required_argument, 0, OPT_PTP_STATE},
         {0, 0, 0, 0}
     };
     
     int opt;
     int option_index = 0;
     
-    while ((opt = getopt_long(argc, argv, "hm:a:p:i:b:t:s", long_options, &option_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "hm:a:p:i:A:J:b:t:sI:", long_options, &option_index)) != -1) {
         switch (opt) {
             case 'h':
                 printUsage(argv[0]);
@@ -94,6 +231,12 @@ int main(int argc, char** argv) {
             case 'i':
                 interface = optarg;
                 break;
+            case 'A':
+                secondaryAddress = optarg;
+                break;
+            case 'J':
+                secondaryInterface = optarg;
+                break;
             case 'b':
                 bitDepth = std::stoi(optarg);
                 if (bitDepth != 16 && bitDepth != 24 && bitDepth != 32) {
@@ -114,12 +257,137 @@ int main(int argc, char** argv) {
             case 's':
                 startNetworking = true;
                 break;
+            case OPT_NET_PRIORITY:
+            case OPT_PTP_PRIORITY: {
+                int priority = std::stoi(optarg);
+                if (priority < 1 || priority > 99) {
+                    std::cerr << "Invalid priority: " << priority << ". Must be 1 to 99.\n";
+                    return 1;
+                }
+                (opt == OPT_NET_PRIORITY ? networkThread : ptpThread).priority = priority;
+                break;
+            }
+            case OPT_NET_CPU:
+                networkThread.cpu = std::stoi(optarg);
+                break;
+            case OPT_PTP_CPU:
+                ptpThread.cpu = std::stoi(optarg);
+                break;
+            case OPT_MLOCK:
+                lockMemory = true;
+                break;
+            case OPT_PERF:
+                perfCounters = true;
+                break;
+            case OPT_PTP_MASTER:
+                ptpMaster = true;
+                break;
+            case OPT_PTP_MASTER_PRIORITY:
+                ptpMasterPriority = std::stoi(optarg);
+                if (ptpMasterPriority < 0 || ptpMasterPriority > 255) {
+                    std::cerr << "Invalid PTP master priority: " << ptpMasterPriority << ". Must be 0 to 255.\n";
+                    return 1;
+                }
+                break;
+            case OPT_PTP_DOMAIN:
+                ptpDomain = std::stoi(optarg);
+                if (ptpDomain < 0 || ptpDomain > 127) {
+                    std::cerr << "Invalid PTP domain: " << ptpDomain << ". Must be 0 to 127.\n";
+                    return 1;
+                }
+                break;
+            case OPT_PTP_TRANSPORT:
+                if (!aes67::parsePTPProfile(optarg, ptpProfile)) {
+                    std::cerr << "Unknown PTP transport: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case OPT_PTP_STATE:
+                ptpStateFile = optarg;
+                break;
+            case OPT_TRACE:
+                tracePrefix = optarg;
+                break;
+            case OPT_TRACE_WINDOW:
+                traceWindow = std::stod(optarg);
+                break;
+            case OPT_IO_BACKEND: {
+                aes67::IOEngine::Backend backend;
+                if (!aes67::IOEngine::parseBackend(optarg, backend)) {
+                    std::cerr << "Unknown I/O backend: " << optarg << std::endl;
+                    return 1;
+                }
+                aes67::IOEngine::setDefaultBackend(backend);
+                break;
+            }
+            case OPT_SESSION:
+                sessionName = optarg;
+                break;
+            case OPT_SESSION_TIMEOUT:
+                sessionTimeout = std::stoi(optarg);
+                break;
+            case OPT_SDP:
+                sdpFile = optarg;
+                break;
+            case OPT_OSC_PORT:
+                oscPort = std::stoi(optarg);
+                if (oscPort <= 0 || oscPort > 65535) {
+                    std::cerr << "Invalid OSC port: " << oscPort << "\n";
+                    return 1;
+                }
+                break;
+            case OPT_MIN_LATENCY:
+                minLatency = std::stof(optarg);
+                break;
+            case OPT_MAX_LATENCY:
+                maxLatency = std::stof(optarg);
+                break;
+            case OPT_LINK_OFFSET:
+                linkOffset = std::stof(optarg);
+                break;
+            case OPT_CHANNELS: {
+                // 1-based on the command line
+                int left = 0, right = 0;
+                if (sscanf(optarg, "%d,%d", &left, &right) != 2 || left < 1 || right < 1) {
+                    std::cerr << "Invalid channel map: " << optarg << ". Use e.g. 3,4.\n";
+                    return 1;
+                }
+                channelMap = { static_cast<uint16_t>(left - 1), static_cast<uint16_t>(right - 1) };
+                break;
+            }
+            case 'I':
+                if (!aes67::NetworkImpairment::parse(optarg, impairment)) {
+                    std::cerr << "Invalid impairment spec: " << optarg << "\n";
+                    return 1;
+                }
+                break;
             default:
                 printUsage(argv[0]);
                 return 1;
         }
     }
     
+    // Lock memory before any worker threads start so their stacks stay resident
+    if (lockMemory) {
+        if (aes67::realtime::lockMemory()) {
+            std::cout << "Memory locked\n";
+        } else {
+            std::cerr << "Warning: continuing without locked memory\n";
+        }
+    }
+    
+    // Trace from before the first JACK cycle
+    if (!tracePrefix.empty()) {
+        if (!aes67::Tracer::enabled) {
+            std::cerr << "Warning: --trace needs a build with -DAES67_TRACE=ON\n";
+        } else if (!aes67::Tracer::start(tracePrefix, traceWindow)) {
+            return 1;
+        } else {
+            signal(SIGUSR1, traceSignalHandler);
+            std::cout << "Tracing; send SIGUSR1 to write " << tracePrefix << "-<n>.json\n";
+        }
+    }
+    
     try {
         // Create and configure the bridge
         bridge = new aes67::AES67Bridge();
@@ -131,6 +399,18 @@ int main(int argc, char** argv) {
         bridge->setMode(transmitMode);
         bridge->setBitDepth(bitDepth);
         bridge->setPacketTime(packetTime);
+        bridge->setNetworkThreadSettings(networkThread);
+        bridge->setPTPThreadSettings(ptpThread);
+        bridge->setPerfCounters(perfCounters);
+        bridge->setPTPDomain(static_cast<uint8_t>(ptpDomain));
+        bridge->setPTPProfile(ptpProfile);
+        bridge->setPTPMaster(ptpMaster, static_cast<uint8_t>(ptpMasterPriority));
+        
+        if (!bridge->setPTPStateFile(ptpStateFile) ||
+            !bridge->setLatencyBounds(minLatency, maxLatency) ||
+            (linkOffset > 0.0f && !bridge->setLinkOffset(linkOffset))) {
+            return 1;
+        }
         
         if (!interface.empty()) {
             bridge->setNetworkInterface(interface);
@@ -138,6 +418,39 @@ int main(int argc, char** argv) {
         
         bridge->setNetworkAddress(address, port);
         
+        if (!channelMap.empty()) {
+            bridge->setChannelMap(channelMap);
+        }
+        
+        // Take the stream format from an SDP file
+        if (!sdpFile.empty()) {
+            aes67::SessionDescription description;
+            if (!aes67::SessionDescription::loadFile(sdpFile, description) ||
+                !bridge->configureFromSDP(description)) {
+                return 1;
+            }
+        }
+        
+        // Resolve the stream address from SAP announcements
+        if (!sessionName.empty()) {
+            if (transmitMode) {
+                std::cerr << "Warning: --session only applies in receive mode\n";
+            } else if (!bridge->subscribeSession(sessionName, sessionTimeout)) {
+                return 1;
+            }
+        }
+        
+        if (!secondaryAddress.empty() || !secondaryInterface.empty()) {
+            if (!bridge->setSecondaryNetwork(secondaryAddress, secondaryInterface)) {
+                std::cerr << "Failed to configure secondary network\n";
+                return 1;
+            }
+        }
+        
+        if (impairment.enabled) {
+            bridge->setImpairment(impairment);
+        }
+        
         // Start the JACK client
         bridge->start();
         
@@ -164,19 +477,65 @@ int main(int argc, char** argv) {
             std::cout << "Networking not started. Use --start or call startNetworking() to begin.\n";
         }
         
+        // From here on the OSC server is the only thread that changes settings
+        if (oscPort > 0) {
+            bridge->startDiscovery();
+            oscServer = new aes67::OSCServer(*bridge);
+            if (!oscServer->start(static_cast<uint16_t>(oscPort))) {
+                std::cerr << "Warning: OSC control unavailable\n";
+            }
+        }
+        
         // Main loop - just keep running and handle JACK callbacks
         std::cout << "AES67 Bridge is running. Press Ctrl+C to exit.\n";
         
         // Stay alive until interrupted
+        bool warmedUp = false;
         while (true) {
             sleep(1);
             
+            // The first cycles do one-time setup; steady state starts once the stream is primed
+            if (aes67::rtcheck::enabled && !warmedUp && bridge->isStreamPrimed()) {
+                aes67::rtcheck::resetReport();
+                warmedUp = true;
+                std::cout << "RT check: stream primed, counting violations from here\n";
+            }
+            
             // Print some status information periodically
             if (bridge->isNetworkActive()) {
                 std::cout << "Buffer level: " << (bridge->getBufferLevel() * 100) << "%, "
                           << "Packets: " << bridge->getPacketCount() << ", "
-                          << "Dropped: " << bridge->getDroppedPackets() 
-                          << std::endl;
+                          << "Dropped: " << bridge->getDroppedPackets() << ", "
+                          << "Concealed: " << bridge->getConcealedFrames() << " frames, "
+                          << "Latency: " << bridge->getLatencyTarget() << "ms "
+                          << "(jitter " << bridge->getJitter() << "ms)";
+                if (bridge->isPlayoutAligned()) {
+                    std::cout << ", PTP aligned";
+                }
+                if (aes67::rtcheck::enabled) {
+                    std::cout << ", RT violations: " << aes67::rtcheck::getReport().total();
+                }
+                std::cout << std::endl;
+                
+                if (transmitMode) {
+                    aes67::AES67Bridge::TransmitStats stats = bridge->getTransmitStats();
+                    std::cout << "  Sent: " << stats.packets << " packets, "
+                              << stats.concealed << " concealed, "
+                              << stats.droppedFrames << " frames dropped, "
+                              << stats.slippedFrames << " slipped, "
+                              << stats.resyncs << " resyncs" << std::endl;
+                }
+                
+                if (bridge->isRedundant()) {
+                    for (int path = 0; path < 2; path++) {
+                        aes67::RTPHandler::PathStats stats = bridge->getPathStats(path);
+                        std::cout << "  Path " << (path == 0 ? "A" : "B") << ": "
+                                  << stats.packets << " received, "
+                                  << stats.firstArrivals << " first, "
+                                  << stats.duplicates << " duplicate, "
+                                  << stats.lost << " lost" << std::endl;
+                    }
+                }
             }
         }
     }
@@ -0,0 +1,146 @@
+// simulate.cpp - aes67_sim, the virtual-clock simulation harness
+#include "Simulation.h"
+#include <iostream>
+#include <getopt.h>
+
+// Long-only options
+enum {
+    OPT_DURATION = 256,
+    OPT_PERIOD,
+    OPT_LOCAL_PPM,
+    OPT_MASTER_PPM,
+    OPT_SYNC_INTERVAL,
+    OPT_LINK_OFFSET,
+    OPT_MIN_LATENCY,
+    OPT_MAX_LATENCY,
+    OPT_PTP_NETWORK,
+    OPT_AUDIO_NETWORK,
+    OPT_MASTER_CHANGE,
+    OPT_REPORT,
+    OPT_SILENCE
+};
+
+void printUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " [options]\n"
+              << "Runs a received stream on a virtual clock: PTP, network, receive path and JACK.\n"
+              << "Options:\n"
+              << "  -h, --help                 Show this help message\n"
+              << "  --duration <s>             Simulated seconds (default 3600)\n"
+              << "  -r, --rate <hz>            Sample rate (default 48000)\n"
+              << "  -t, --packet-time <us>     Packet time in microseconds (default 1000)\n"
+              << "  --period <frames>          JACK period (default 128)\n"
+              << "  --local-ppm <ppm>          Local oscillator error against true time\n"
+              << "  --master-ppm <ppm>         Grandmaster oscillator error against true time\n"
+              << "  --sync-interval <s>        Seconds between Sync messages, rounded to a power\n"
+              << "                             of two (default 0.125)\n"
+              << "  --link-offset <ms>         Play at RTP timestamp plus this, 0 plays on arrival\n"
+              << "  --min-latency <ms>         Lowest adaptive playout latency (default 0)\n"
+              << "  --max-latency <ms>         Highest adaptive playout latency (default 20)\n"
+              << "  --ptp-network <spec>       Delay, jitter and loss of PTP messages, each way\n"
+              << "  --audio-network <spec>     Delay, jitter and loss of RTP packets\n"
+              << "                             Specs as for aes67_bridge --impair, e.g.\n"
+              << "                             seed=1,delay=200,jitter=100,jitter-shape=2.5,loss=0.001\n"
+              << "  --master-change <t:us:ppm> A better grandmaster joins at t seconds, stepped\n"
+              << "                             by us and running at ppm; it takes over through\n"
+              << "                             the BMCA (repeatable)\n"
+              << "  --report <s>               Simulated seconds between report lines (default 60)\n"
+              << "  --silence                  Send silence instead of a tone\n"
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+    aes67::Simulation::Config config;
+
+    static struct option long_options[] = {
+        {"help",          no_argument,       0, 'h'},
+        {"rate",          required_argument, 0, 'r'},
+        {"packet-time",   required_argument, 0, 't'},
+        {"duration",      required_argument, 0, OPT_DURATION},
+        {"period",        required_argument, 0, OPT_PERIOD},
+        {"local-ppm",     required_argument, 0, OPT_LOCAL_PPM},
+        {"master-ppm",    required_argument, 0, OPT_MASTER_PPM},
+        {"sync-interval", required_argument, 0, OPT_SYNC_INTERVAL},
+        {"link-offset",   required_argument, 0, OPT_LINK_OFFSET},
+        {"min-latency",   required_argument, 0, OPT_MIN_LATENCY},
+        {"max-latency",   required_argument, 0, OPT_MAX_LATENCY},
+        {"ptp-network",   required_argument, 0, OPT_PTP_NETWORK},
+        {"audio-network", required_argument, 0, OPT_AUDIO_NETWORK},
+        {"master-change", required_argument, 0, OPT_MASTER_CHANGE},
+        {"report",        required_argument, 0, OPT_REPORT},
+        {"silence",       no_argument,       0, OPT_SILENCE},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    int option_index = 0;
+    while ((opt = getopt_long(argc, argv, "hr:t:", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            case 'r':
+                config.sampleRate = static_cast<uint32_t>(std::stoul(optarg));
+                break;
+            case 't':
+                config.packetTime = std::stoi(optarg);
+                break;
+            case OPT_DURATION:
+                config.duration = std::stod(optarg);
+                break;
+            case OPT_PERIOD:
+                config.period = static_cast<uint32_t>(std::stoul(optarg));
+                break;
+            case OPT_LOCAL_PPM:
+                config.localPpm = std::stod(optarg);
+                break;
+            case OPT_MASTER_PPM:
+                config.masterPpm = std::stod(optarg);
+                break;
+            case OPT_SYNC_INTERVAL:
+                config.syncInterval = std::stod(optarg);
+                break;
+            case OPT_LINK_OFFSET:
+                config.linkOffset = std::stof(optarg);
+                break;
+            case OPT_MIN_LATENCY:
+                config.minLatency = std::stof(optarg);
+                break;
+            case OPT_MAX_LATENCY:
+                config.maxLatency = std::stof(optarg);
+                break;
+            case OPT_PTP_NETWORK:
+            case OPT_AUDIO_NETWORK:
+                if (!aes67::NetworkImpairment::parse(optarg, opt == OPT_PTP_NETWORK ?
+                                                     config.ptpNetwork : config.audioNetwork)) {
+                    return 1;
+                }
+                break;
+            case OPT_MASTER_CHANGE: {
+                aes67::Simulation::MasterChange change;
+                if (!aes67::Simulation::parseMasterChange(optarg, change)) {
+                    return 1;
+                }
+                config.masterChanges.push_back(change);
+                break;
+            }
+            case OPT_REPORT:
+                config.reportInterval = std::stod(optarg);
+                break;
+            case OPT_SILENCE:
+                config.silence = true;
+                break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (config.duration <= 0.0 || config.reportInterval <= 0.0 || config.syncInterval <= 0.0 ||
+        config.period == 0 || config.packetTime <= 0 || config.sampleRate == 0) {
+        std::cerr << "Durations, intervals, period, packet time and rate must be positive\n";
+        return 1;
+    }
+
+    aes67::Simulation simulation(config);
+    return simulation.run(std::cout) ? 0 : 2;
+}